@@ -0,0 +1,304 @@
+// bench/load_gen.cpp
+//
+// Holds many authenticated WebSocket connections open against a running
+// chat_server and measures ping/pong round trips over all of them. Pings
+// go through the same read and write path as chat frames but never touch
+// the database, so the numbers reflect the reactor, not PostgreSQL.
+//
+//   load_gen [host=127.0.0.1] [port=8080] [connections=10000] [seconds=30]
+//            [pings_per_sec=1] [source_addresses=1]
+//
+// Each source address gives roughly 28k ephemeral ports towards one
+// server port; for 100k+ connections over loopback use 4 or more
+// (127.0.0.1, 127.0.0.2, ...).
+#include "auth/jwt_handler.hpp"
+#include "server/io_backend.hpp"
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <sys/resource.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+using tcp = boost::asio::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+// Must match the secret chat_server signs with (see main.cpp)
+const char* kJwtSecret = "your-super-secret-jwt-key-change-in-production-min-32-chars";
+
+// Log-linear latency histogram in microseconds, about 6% resolution.
+class Histogram {
+public:
+    void record(std::uint64_t us) {
+        buckets_[index(us)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    std::uint64_t count() const { return count_.load(); }
+    
+    std::uint64_t percentile(double p) const {
+        std::uint64_t target = static_cast<std::uint64_t>(p * static_cast<double>(count()));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            seen += buckets_[i].load();
+            if (seen > target) {
+                return lower_bound(i);
+            }
+        }
+        return lower_bound(kBuckets - 1);
+    }
+
+private:
+    static constexpr std::size_t kBuckets = 16 + 60 * 16;
+    
+    static std::size_t index(std::uint64_t us) {
+        if (us < 16) {
+            return static_cast<std::size_t>(us);
+        }
+        int msb = 63 - __builtin_clzll(us);
+        return std::min<std::size_t>(kBuckets - 1,
+            16 + static_cast<std::size_t>(msb - 4) * 16 + ((us >> (msb - 4)) & 15));
+    }
+    
+    static std::uint64_t lower_bound(std::size_t i) {
+        if (i < 16) {
+            return i;
+        }
+        std::size_t msb = (i - 16) / 16 + 4;
+        return (16 + (i - 16) % 16) << (msb - 4);
+    }
+    
+    std::array<std::atomic<std::uint64_t>, kBuckets> buckets_{};
+    std::atomic<std::uint64_t> count_{0};
+};
+
+struct Stats {
+    std::atomic<std::uint64_t> connected{0};
+    std::atomic<std::uint64_t> failed{0};
+    std::atomic<std::uint64_t> closed{0};
+    std::atomic<std::uint64_t> skipped{0};  // previous ping still unanswered
+    std::atomic<bool> measuring{false};
+    Histogram rtt;
+};
+
+struct Options {
+    std::string host = "127.0.0.1";
+    unsigned short port = 8080;
+    std::size_t connections = 10000;
+    int seconds = 30;
+    double pings_per_sec = 1;
+    int source_addresses = 1;
+};
+
+class Client : public std::enable_shared_from_this<Client> {
+public:
+    Client(net::io_context& ioc, const Options& options, Stats& stats, std::size_t id)
+        : ws_(net::make_strand(ioc))
+        , timer_(ws_.get_executor())
+        , options_(options)
+        , stats_(stats)
+        , id_(id)
+        , ping_outstanding_(false) {
+    }
+    
+    void start(Clock::duration first_ping) {
+        first_ping_ = first_ping;
+        auto& socket = beast::get_lowest_layer(ws_).socket();
+        
+        beast::error_code ec;
+        socket.open(tcp::v4(), ec);
+        if (options_.source_addresses > 1) {
+            auto source = net::ip::make_address_v4(
+                0x7f000001u + static_cast<unsigned>(id_ % options_.source_addresses));
+            socket.bind({source, 0}, ec);
+        }
+        if (ec) {
+            return fail();
+        }
+        
+        tcp::endpoint server{net::ip::make_address(options_.host), options_.port};
+        socket.async_connect(server, [self = shared_from_this()](beast::error_code ec) {
+            self->on_connect(ec);
+        });
+    }
+
+private:
+    void on_connect(beast::error_code ec) {
+        if (ec) {
+            return fail();
+        }
+        beast::get_lowest_layer(ws_).socket().set_option(tcp::no_delay(true));
+        
+        std::string target = "/?token=" + JWTHandler::generate_token("loadgen-" + std::to_string(id_));
+        ws_.async_handshake(options_.host, target, [self = shared_from_this()](beast::error_code ec) {
+            self->on_handshake(ec);
+        });
+    }
+    
+    void on_handshake(beast::error_code ec) {
+        if (ec) {
+            return fail();
+        }
+        stats_.connected.fetch_add(1, std::memory_order_relaxed);
+        
+        ws_.control_callback([this](websocket::frame_type kind, beast::string_view) {
+            if (kind != websocket::frame_type::pong || !ping_outstanding_) {
+                return;
+            }
+            ping_outstanding_ = false;
+            if (stats_.measuring.load(std::memory_order_relaxed)) {
+                auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - ping_sent_);
+                stats_.rtt.record(static_cast<std::uint64_t>(rtt.count()));
+            }
+        });
+        
+        do_read();
+        schedule_ping(first_ping_);
+    }
+    
+    // Server frames are discarded; the read keeps control frames flowing
+    void do_read() {
+        ws_.async_read(buffer_, [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec) {
+                self->timer_.cancel();
+                self->stats_.closed.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            self->buffer_.consume(self->buffer_.size());
+            self->do_read();
+        });
+    }
+    
+    void schedule_ping(Clock::duration delay) {
+        timer_.expires_after(delay);
+        timer_.async_wait([self = shared_from_this()](beast::error_code ec) {
+            if (!ec) {
+                self->on_ping_timer();
+            }
+        });
+    }
+    
+    void on_ping_timer() {
+        if (ping_outstanding_) {
+            stats_.skipped.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            ping_outstanding_ = true;
+            ping_sent_ = Clock::now();
+            ws_.async_ping({}, [](beast::error_code) {});
+        }
+        schedule_ping(std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / options_.pings_per_sec)));
+    }
+    
+    void fail() {
+        stats_.failed.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    websocket::stream<beast::tcp_stream> ws_;
+    net::steady_timer timer_;
+    const Options& options_;
+    Stats& stats_;
+    std::size_t id_;
+    beast::flat_buffer buffer_;
+    Clock::duration first_ping_{};
+    Clock::time_point ping_sent_;
+    bool ping_outstanding_;
+};
+
+double cpu_seconds() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (argc > 1) options.host = argv[1];
+    if (argc > 2) options.port = static_cast<unsigned short>(std::atoi(argv[2]));
+    if (argc > 3) options.connections = std::strtoul(argv[3], nullptr, 10);
+    if (argc > 4) options.seconds = std::atoi(argv[4]);
+    if (argc > 5) options.pings_per_sec = std::atof(argv[5]);
+    if (argc > 6) options.source_addresses = std::max(1, std::atoi(argv[6]));
+    
+    JWTHandler::set_secret(kJwtSecret);
+    unsigned long long fd_limit = IoBackend::raise_fd_limit();
+    if (fd_limit < options.connections + 64) {
+        std::fprintf(stderr, "warning: open files limit is %llu\n", fd_limit);
+    }
+    
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    net::io_context ioc{static_cast<int>(threads)};
+    auto guard = net::make_work_guard(ioc);
+    Stats stats;
+    
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < threads; ++i) {
+        pool.emplace_back([&ioc] { ioc.run(); });
+    }
+    
+    // Ramp up in steps so the server's accept backlog is not the bottleneck,
+    // and spread first pings over one interval so they do not arrive in lockstep
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> offset(0.0, 1.0 / options.pings_per_sec);
+    std::vector<std::shared_ptr<Client>> clients;
+    clients.reserve(options.connections);
+    
+    auto ramp_start = Clock::now();
+    for (std::size_t i = 0; i < options.connections; ++i) {
+        clients.push_back(std::make_shared<Client>(ioc, options, stats, i));
+        auto first_ping = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(offset(rng)));
+        net::post(ioc, [client = clients.back(), first_ping] { client->start(first_ping); });
+        
+        if (i % 1000 == 999) {
+            while (stats.connected + stats.failed + 500 < i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+    }
+    while (stats.connected + stats.failed < options.connections) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    double ramp_seconds = std::chrono::duration<double>(Clock::now() - ramp_start).count();
+    std::printf("connected %llu, failed %llu in %.2fs\n",
+                static_cast<unsigned long long>(stats.connected.load()),
+                static_cast<unsigned long long>(stats.failed.load()),
+                ramp_seconds);
+    
+    double cpu_start = cpu_seconds();
+    stats.measuring = true;
+    std::this_thread::sleep_for(std::chrono::seconds(options.seconds));
+    stats.measuring = false;
+    double cpu_used = cpu_seconds() - cpu_start;
+    
+    std::uint64_t pongs = stats.rtt.count();
+    std::printf("pongs %llu (%.0f/s), skipped %llu, closed %llu, load_gen cpu %.2fs\n",
+                static_cast<unsigned long long>(pongs),
+                static_cast<double>(pongs) / options.seconds,
+                static_cast<unsigned long long>(stats.skipped.load()),
+                static_cast<unsigned long long>(stats.closed.load()),
+                cpu_used);
+    std::printf("rtt us: p50 %llu  p90 %llu  p99 %llu  p99.9 %llu\n",
+                static_cast<unsigned long long>(stats.rtt.percentile(0.50)),
+                static_cast<unsigned long long>(stats.rtt.percentile(0.90)),
+                static_cast<unsigned long long>(stats.rtt.percentile(0.99)),
+                static_cast<unsigned long long>(stats.rtt.percentile(0.999)));
+    
+    // Connections are dropped with the process rather than closed one by one
+    std::fflush(stdout);
+    std::_Exit(0);
+}
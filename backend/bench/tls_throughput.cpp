@@ -0,0 +1,218 @@
+// bench/tls_throughput.cpp
+//
+// Server-to-client WebSocket throughput over loopback for plain ws, wss
+// with user-space TLS, and wss with kTLS requested. The server side uses
+// the same TlsStream/TlsContext as chat_server; the client is a blocking
+// Beast client on its own thread.
+//
+//   tls_throughput [megabytes=512] [message_kb=64]
+#include "server/tls_context.hpp"
+#include "server/tls_stream.hpp"
+#include "utils/logger.hpp"
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/ssl.hpp>
+#include <openssl/ec.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace websocket = beast::websocket;
+namespace ssl = net::ssl;
+
+namespace {
+enum class Mode { Plain, Tls, Ktls };
+
+const char* mode_name(Mode mode) {
+    switch (mode) {
+    case Mode::Plain: return "plain";
+    case Mode::Tls: return "tls";
+    default: return "ktls";
+    }
+}
+
+struct Result {
+    double seconds = 0;
+    bool ktls_send = false;
+    bool ktls_recv = false;
+};
+
+// Throwaway self-signed P-256 certificate for localhost.
+bool write_test_certificate(const std::string& cert_path, const std::string& key_path) {
+    EVP_PKEY* key = EVP_EC_gen("P-256");
+    X509* cert = X509_new();
+    if (!key || !cert) {
+        return false;
+    }
+    
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_sign(cert, key, EVP_sha256());
+    
+    FILE* cert_file = std::fopen(cert_path.c_str(), "w");
+    FILE* key_file = std::fopen(key_path.c_str(), "w");
+    bool ok = cert_file && key_file &&
+              PEM_write_X509(cert_file, cert) == 1 &&
+              PEM_write_PrivateKey(key_file, key, nullptr, nullptr, 0, nullptr, nullptr) == 1;
+    if (cert_file) std::fclose(cert_file);
+    if (key_file) std::fclose(key_file);
+    
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return ok;
+}
+
+template<class WsClient>
+void drain(WsClient& ws, std::size_t total_bytes) {
+    beast::flat_buffer buffer;
+    std::size_t received = 0;
+    while (received < total_bytes) {
+        received += ws.read(buffer);
+        buffer.consume(buffer.size());
+    }
+}
+
+void run_client(Mode mode, unsigned short port, std::size_t total_bytes) {
+    net::io_context ioc;
+    tcp::socket socket(ioc);
+    socket.connect({net::ip::make_address("127.0.0.1"), port});
+    
+    if (mode == Mode::Plain) {
+        websocket::stream<tcp::socket> ws(std::move(socket));
+        ws.handshake("localhost", "/");
+        drain(ws, total_bytes);
+        ws.close(websocket::close_code::normal);
+        return;
+    }
+    
+    ssl::context ctx(ssl::context::tls_client);
+    ctx.set_verify_mode(ssl::verify_none);
+    websocket::stream<beast::ssl_stream<tcp::socket>> ws(std::move(socket), ctx);
+    ws.next_layer().handshake(ssl::stream_base::client);
+    ws.handshake("localhost", "/");
+    drain(ws, total_bytes);
+    
+    beast::error_code ec;
+    ws.close(websocket::close_code::normal, ec);
+}
+
+template<class Ws>
+void pump(Ws& ws, const std::vector<char>& message, std::size_t remaining) {
+    if (remaining == 0) {
+        ws.async_close(websocket::close_code::normal, [](beast::error_code) {});
+        return;
+    }
+    ws.async_write(net::buffer(message), [&ws, &message, remaining](beast::error_code ec, std::size_t) {
+        if (!ec) {
+            pump(ws, message, remaining - 1);
+        }
+    });
+}
+
+template<class Ws>
+void serve(Ws& ws, const std::vector<char>& message, std::size_t messages) {
+    ws.binary(true);
+    ws.async_accept([&ws, &message, messages](beast::error_code ec) {
+        if (!ec) {
+            pump(ws, message, messages);
+        }
+    });
+}
+
+Result run(Mode mode, TlsContext* tls, std::size_t total_bytes, std::size_t message_bytes) {
+    net::io_context ioc;
+    tcp::acceptor acceptor(ioc, {net::ip::make_address("127.0.0.1"), 0});
+    unsigned short port = acceptor.local_endpoint().port();
+    
+    std::size_t messages = total_bytes / message_bytes;
+    std::vector<char> message(message_bytes, 'x');
+    
+    auto start = std::chrono::steady_clock::now();
+    std::thread client(run_client, mode, port, messages * message_bytes);
+    
+    Result result;
+    tcp::socket socket = acceptor.accept();
+    
+    if (mode == Mode::Plain) {
+        websocket::stream<tcp::socket> ws(std::move(socket));
+        serve(ws, message, messages);
+        ioc.run();
+    } else {
+        std::unique_ptr<websocket::stream<TlsStream>> ws;
+        TlsStream stream(std::move(socket), tls->new_ssl());
+        stream.async_handshake([&](beast::error_code ec) {
+            if (ec) {
+                std::cerr << "handshake failed: " << ec.message() << "\n";
+                return;
+            }
+            ws = std::make_unique<websocket::stream<TlsStream>>(std::move(stream));
+            auto& tls_stream = ws->next_layer();
+            result.ktls_send = tls_stream.ktls_send();
+            result.ktls_recv = tls_stream.ktls_recv();
+            serve(*ws, message, messages);
+        });
+        ioc.run();
+    }
+    
+    client.join();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 512;
+    std::size_t message_kb = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 64;
+    std::size_t total_bytes = megabytes * 1024 * 1024;
+    std::size_t message_bytes = message_kb * 1024;
+    
+    std::filesystem::create_directories("logs");
+    Logger::init();
+    
+    auto dir = std::filesystem::temp_directory_path();
+    std::string cert_path = (dir / "tls_throughput_cert.pem").string();
+    std::string key_path = (dir / "tls_throughput_key.pem").string();
+    if (!write_test_certificate(cert_path, key_path)) {
+        std::cerr << "could not create a test certificate\n";
+        return 1;
+    }
+    
+    TlsOptions options;
+    options.cert_file = cert_path;
+    options.key_file = key_path;
+    
+    options.ktls = false;
+    auto user_space = TlsContext::create(options);
+    options.ktls = true;
+    auto kernel = TlsContext::create(options);
+    if (!user_space || !kernel) {
+        return 1;
+    }
+    
+    std::printf("%-6s %10s %10s %10s %10s\n", "mode", "MiB", "seconds", "MiB/s", "kTLS tx/rx");
+    for (Mode mode : {Mode::Plain, Mode::Tls, Mode::Ktls}) {
+        TlsContext* ctx = mode == Mode::Tls ? user_space.get() : kernel.get();
+        Result result = run(mode, ctx, total_bytes, message_bytes);
+        double mib = static_cast<double>(total_bytes / message_bytes * message_bytes) / (1024 * 1024);
+        std::printf("%-6s %10.0f %10.3f %10.1f %7s/%s\n", mode_name(mode), mib, result.seconds,
+                    mib / result.seconds,
+                    mode == Mode::Plain ? "-" : (result.ktls_send ? "on" : "off"),
+                    mode == Mode::Plain ? "-" : (result.ktls_recv ? "on" : "off"));
+    }
+    
+    std::filesystem::remove(cert_path);
+    std::filesystem::remove(key_path);
+    return 0;
+}
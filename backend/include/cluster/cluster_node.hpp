@@ -0,0 +1,83 @@
+#pragma once
+#include "cluster/hash_ring.hpp"
+#include "cluster/peer_link.hpp"
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace net = boost::asio;
+using tcp = boost::asio::ip::tcp;
+
+class SessionManager;
+class MembershipIndex;
+enum class Delivery;
+
+struct ClusterPeer {
+    std::string node_id;
+    tcp::endpoint endpoint;
+};
+
+struct ClusterOptions {
+    std::string node_id;
+    tcp::endpoint listen;          // kept apart from the public listener
+    std::vector<ClusterPeer> peers;
+    std::string secret;            // shared by every node; proves a peer in the handshake
+};
+
+// Routes deliveries to users connected to other chat_server processes.
+//
+// Every user has an owner node, chosen by consistent hashing over the live
+// nodes. The owner keeps the presence record saying which node holds the
+// user's connection. A node that cannot deliver locally forwards to the
+// owner, and the owner forwards to the holder (at most two hops).
+//
+// Only connections from the addresses of configured peers are accepted,
+// and only once they prove knowledge of the cluster secret.
+class ClusterNode {
+public:
+    ClusterNode(net::io_context& ioc, const ClusterOptions& options, SessionManager& manager);
+    
+    void start();
+    void stop();
+    const std::string& node_id() const { return node_id_; }
+    
+    void announce(const std::string& user_id, bool online);
+    void route(const std::string& user_id, const std::string& frame,
+              Delivery kind, const std::string& coalesce_key = "", int hops = 0);
+    void route_many(const std::vector<std::string>& user_ids, const std::string& frame,
+                   Delivery kind, int hops = 0);
+    
+    // Group membership is cached on every node; local changes are sent to
+    // all peers, and a node clears its cache whenever a link changes state
+    // since it may have missed some.
+    void set_membership_index(MembershipIndex* index);
+    void publish_membership(const std::string& group_id, const std::string& user_id, bool added);
+
+private:
+    void do_accept();
+    void on_link_state(const std::string& peer_id, bool up);
+    void on_envelope(const std::string& peer_id, const std::string& envelope);
+    void reannounce_local_users();
+    void send_to_node(const std::string& node_id, const boost::json::object& envelope);
+    
+    // Where a delivery for `user_id` should go next; empty when undeliverable.
+    // Caller must hold mutex_.
+    std::string next_hop(const std::string& user_id) const;
+
+    net::io_context& ioc_;
+    std::string node_id_;
+    tcp::acceptor acceptor_;
+    std::string secret_;
+    std::unordered_map<std::string, std::vector<std::string>> peers_by_address_;
+    SessionManager& manager_;
+    MembershipIndex* membership_;
+    std::unordered_map<std::string, std::shared_ptr<PeerLink>> links_;
+    
+    std::mutex mutex_;
+    HashRing ring_;
+    std::unordered_map<std::string, std::string> presence_;  // user -> node, for owned users
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+// Consistent hash ring over node ids. Each node is placed at several
+// virtual points so ownership moves in small slices when nodes come and go.
+class HashRing {
+public:
+    explicit HashRing(std::size_t virtual_nodes = 64);
+    
+    void add(const std::string& node_id);
+    void remove(const std::string& node_id);
+    std::string owner(std::string_view key) const;
+    bool empty() const { return ring_.empty(); }
+    
+    static std::uint64_t hash(std::string_view key);
+
+private:
+    std::map<std::uint64_t, std::string> ring_;
+    std::size_t virtual_nodes_;
+};
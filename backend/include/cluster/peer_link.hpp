@@ -0,0 +1,94 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace net = boost::asio;
+using tcp = boost::asio::ip::tcp;
+
+// Envelopes between nodes are length-prefixed (4 bytes, big-endian) JSON.
+constexpr std::size_t kMaxEnvelopeBytes = 16 * 1024 * 1024;
+
+// The accepting side opens with a random challenge; the connecting side
+// answers with its node id and an HMAC-SHA256 of both under the shared
+// cluster secret. Nothing else is read from a connection until then.
+std::string hello_proof(const std::string& secret, const std::string& challenge,
+                        const std::string& node_id);
+
+// Outbound, persistent connection to one peer. Envelopes queued while a
+// write is in flight are coalesced into the next write, so bursts go out
+// as one batch. Reconnects with backoff when the peer goes away.
+class PeerLink : public std::enable_shared_from_this<PeerLink> {
+public:
+    using StateHandler = std::function<void(const std::string& peer_id, bool up)>;
+    
+    PeerLink(net::io_context& ioc,
+            std::string self_id,
+            std::string peer_id,
+            tcp::endpoint endpoint,
+            std::string secret,
+            StateHandler on_state);
+    
+    void start();
+    void stop();
+    void send(const std::string& envelope);
+    bool is_up() const { return up_.load(std::memory_order_acquire); }
+    const std::string& peer_id() const { return peer_id_; }
+
+private:
+    void do_connect();
+    void on_connect(boost::system::error_code ec);
+    void read_challenge();
+    void on_challenge(const std::string& challenge);
+    void on_failure(boost::system::error_code ec);
+    void flush();
+    void on_write(boost::system::error_code ec, std::size_t bytes_transferred);
+
+    net::strand<net::io_context::executor_type> strand_;
+    tcp::socket socket_;
+    net::steady_timer retry_timer_;
+    std::string self_id_;
+    std::string peer_id_;
+    tcp::endpoint endpoint_;
+    std::string secret_;
+    StateHandler on_state_;
+    unsigned char header_[4];
+    std::string challenge_;
+    std::string pending_;
+    std::string writing_;
+    std::chrono::milliseconds backoff_;
+    std::atomic<bool> up_;
+    bool connecting_;
+    bool stopped_;
+};
+
+// Inbound connection from a peer's PeerLink. Reads envelopes and hands
+// them to the cluster node once the first one has proven the sender is
+// one of `allowed_nodes`.
+class PeerConnection : public std::enable_shared_from_this<PeerConnection> {
+public:
+    using EnvelopeHandler = std::function<void(const std::string& peer_id, const std::string& envelope)>;
+    
+    PeerConnection(tcp::socket socket,
+                  std::string secret,
+                  std::vector<std::string> allowed_nodes,
+                  EnvelopeHandler on_envelope);
+    void start();
+
+private:
+    void read_header();
+    void read_body(std::size_t length);
+    bool accept_hello();
+
+    tcp::socket socket_;
+    std::string secret_;
+    std::vector<std::string> allowed_nodes_;
+    std::string challenge_;
+    EnvelopeHandler on_envelope_;
+    unsigned char header_[4];
+    std::string body_;
+    std::string peer_id_;
+};
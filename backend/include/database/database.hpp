@@ -1,14 +1,78 @@
 #pragma once
+#include "storage.hpp"
 #include <pqxx/pqxx>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <vector>
 
-class Database {
+class Database : public Storage {
 public:
-    Database(const std::string& connection_string);
-    pqxx::connection& get_connection();
+    // Borrowed connection; goes back to the pool when destroyed.
+    class Connection {
+    public:
+        Connection(Database& db, std::unique_ptr<pqxx::connection> conn, std::size_t partition);
+        Connection(Connection&& other) noexcept;
+        Connection(const Connection&) = delete;
+        Connection& operator=(const Connection&) = delete;
+        Connection& operator=(Connection&&) = delete;
+        ~Connection();
+        
+        pqxx::connection& operator*() { return *conn_; }
+        pqxx::connection* operator->() { return conn_.get(); }
+
+    private:
+        Database* db_;
+        std::unique_ptr<pqxx::connection> conn_;
+        std::size_t partition_;
+    };
+    
+    // With `numa_nodes`, the pool is split into one partition per node and
+    // each partition's connections are allocated on that node.
+    Database(const std::string& connection_string, std::size_t pool_size = 1,
+             const std::vector<int>& numa_nodes = {});
+    
+    // Blocks until a pooled connection is free. Prefers the calling
+    // thread's partition and borrows from the others when it is empty.
+    Connection acquire();
+    // A PgTransaction on an acquired connection.
+    std::unique_ptr<Transaction> begin() override;
+    // Partition acquire() prefers on this thread.
+    static void set_thread_partition(std::size_t partition);
     bool test_connection();
+    bool migrate();
+    std::size_t pool_size() const { return pool_size_; }
+    const std::string& connection_string() const { return connection_string_; }
+
+private:
+    void release(std::unique_ptr<pqxx::connection> conn, std::size_t partition);
+
+    std::string connection_string_;
+    std::size_t pool_size_;
+    // Idle connections per partition
+    std::vector<std::vector<std::unique_ptr<pqxx::connection>>> idle_;
+    std::size_t idle_count_;
+    std::mutex mutex_;
+    std::condition_variable available_;
+};
+
+// Transaction on a pooled connection. The Postgres repositories run their
+// batch forms on work(), which is a subtransaction inside a savepoint.
+class PgTransaction : public Transaction {
+public:
+    explicit PgTransaction(Database::Connection conn);
+    
+    void savepoint(const std::function<void()>& step) override;
+    void commit() override;
+    
+    // The innermost open transaction of `txn`, which Database::begin() made.
+    static pqxx::transaction_base& work(Transaction& txn);
 
 private:
-    std::unique_ptr<pqxx::connection> conn_;
+    Database::Connection conn_;
+    pqxx::work work_;
+    std::optional<pqxx::subtransaction> step_;
 };
\ No newline at end of file
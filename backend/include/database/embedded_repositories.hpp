@@ -0,0 +1,154 @@
+#pragma once
+#include "embedded_store.hpp"
+#include "friend_repository.hpp"
+#include "group_repository.hpp"
+#include "message_repository.hpp"
+#include "user_repository.hpp"
+#include "utils/id_generator.hpp"
+
+// The repositories over an EmbeddedStore. Ids and timestamps come from the
+// IdGenerator, as PostgresMessageRepository's do; reads take the store's
+// shared lock and copy out what they return.
+
+class EmbeddedUserRepository : public UserRepository {
+public:
+    EmbeddedUserRepository(EmbeddedStore& store, IdGenerator& ids);
+    
+    std::optional<User> create_user(const std::string& username,
+                                    const std::string& email,
+                                    const std::string& password_hash,
+                                    const std::string& display_name) override;
+    std::optional<User> get_user_by_username(const std::string& username) override;
+    std::optional<User> get_user_by_id(const std::string& user_id) override;
+    bool update_user_status(const std::string& user_id, const std::string& status) override;
+    // Case-insensitive substring match on username or display name, like ILIKE.
+    std::vector<User> search_users(const std::string& query) override;
+
+private:
+    EmbeddedStore& store_;
+    IdGenerator& ids_;
+};
+
+class EmbeddedGroupRepository : public GroupRepository {
+public:
+    EmbeddedGroupRepository(EmbeddedStore& store, IdGenerator& ids);
+    
+    std::optional<Group> create_group(const std::string& group_name,
+                                     const std::string& description,
+                                     const std::string& creator_id) override;
+    
+    bool add_member(const std::string& group_id, const std::string& user_id,
+                   const std::string& role = "member") override;
+    
+    // Nothing to update after the commit: the tables are the index.
+    void add_member(Transaction& txn,
+                    const std::string& group_id,
+                    const std::string& user_id,
+                    const std::string& role,
+                    AfterCommit& after_commit) override;
+    
+    bool remove_member(const std::string& group_id, const std::string& user_id) override;
+    
+    std::vector<Group> get_user_groups(const std::string& user_id) override;
+    
+    std::vector<GroupMember> get_group_members(const std::string& group_id) override;
+    
+    IdSetPtr get_member_ids(const std::string& group_id) override;
+    IdSetPtr get_user_group_ids(const std::string& user_id) override;
+    
+    bool is_member(const std::string& group_id, const std::string& user_id) override;
+
+private:
+    EmbeddedStore& store_;
+    IdGenerator& ids_;
+};
+
+class EmbeddedMessageRepository : public MessageRepository {
+public:
+    EmbeddedMessageRepository(EmbeddedStore& store, IdGenerator& ids);
+    
+    std::optional<Message> send_message(const std::string& sender_id,
+                                       const std::string& recipient_id,
+                                       const std::string& content,
+                                       const std::string& message_type = "text",
+                                       const std::string& idempotency_key = "") override;
+    
+    std::optional<Message> send_group_message(const std::string& sender_id,
+                                             const std::string& group_id,
+                                             const std::string& content,
+                                             const std::string& message_type = "text",
+                                             const std::string& idempotency_key = "") override;
+    
+    Message send_message(Transaction& txn,
+                         const std::string& sender_id,
+                         const std::string& recipient_id,
+                         const std::string& content,
+                         const std::string& message_type = "text",
+                         const std::string& idempotency_key = "") override;
+    
+    Message send_group_message(Transaction& txn,
+                               const std::string& sender_id,
+                               const std::string& group_id,
+                               const std::string& content,
+                               const std::string& message_type = "text",
+                               const std::string& idempotency_key = "") override;
+    
+    std::vector<Message> get_conversation(const std::string& user1_id,
+                                         const std::string& user2_id,
+                                         int limit = 50,
+                                         std::uint64_t before_seq = 0) override;
+    
+    std::vector<Message> get_group_messages(const std::string& group_id,
+                                           int limit = 50) override;
+    
+    std::vector<Message> get_conversation_range(const std::string& user1_id,
+                                               const std::string& user2_id,
+                                               std::uint64_t from_seq,
+                                               std::uint64_t to_seq,
+                                               int limit) override;
+    
+    std::vector<Message> get_group_range(const std::string& group_id,
+                                        std::uint64_t from_seq,
+                                        std::uint64_t to_seq,
+                                        int limit) override;
+    
+    std::optional<SyncPage> get_messages_since(const std::string& user_id,
+                                               const std::string& cursor,
+                                               int limit) override;
+    
+    bool mark_message_read(const std::string& message_id) override;
+    
+    std::optional<std::vector<InboxEntry>> get_inbox(const std::string& user_id) override;
+    
+    bool save_read_marks(const std::vector<ReadMark>& marks) override;
+
+private:
+    // Inserts into the conversation `key` unless the sender already used
+    // `idempotency_key`, in which case it returns that message.
+    Message insert(Transaction& txn, const std::string& key, Message msg,
+                   const std::string& idempotency_key);
+    std::vector<Message> range(const std::string& key, std::uint64_t from_seq,
+                               std::uint64_t to_seq, int limit);
+    
+    EmbeddedStore& store_;
+    IdGenerator& ids_;
+};
+
+class EmbeddedFriendRepository : public FriendRepository {
+public:
+    EmbeddedFriendRepository(EmbeddedStore& store, IdGenerator& ids);
+    
+    FriendRequestResult send_request(Transaction& txn,
+                                     const std::string& sender_id,
+                                     const std::string& receiver_username) override;
+    std::optional<std::string> accept_request(const std::string& receiver_id,
+                                              const std::string& request_id) override;
+    void reject_request(const std::string& receiver_id,
+                        const std::string& request_id) override;
+    std::vector<FriendRequest> get_requests(const std::string& user_id) override;
+    std::vector<User> get_friends(const std::string& user_id) override;
+
+private:
+    EmbeddedStore& store_;
+    IdGenerator& ids_;
+};
\ No newline at end of file
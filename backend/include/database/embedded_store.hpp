@@ -0,0 +1,187 @@
+#pragma once
+#include "storage.hpp"
+#include "user_repository.hpp"
+#include "group_repository.hpp"
+#include "message_repository.hpp"
+#include "membership_index.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct EmbeddedOptions {
+    std::string directory;
+    std::size_t segment_bytes = 64 * 1024 * 1024;  // a new log segment after this much
+    bool sync_commits = true;                       // commit() waits for fdatasync
+    std::chrono::seconds snapshot_interval{300};
+    std::uint64_t snapshot_min_commits = 10000;     // logged since the last snapshot
+};
+
+// One write to the embedded tables, as logged and as replayed. Fields by
+// type, numbers in decimal:
+struct EmbeddedOp {
+    enum Type : std::uint8_t {
+        CreateUser = 1,     // user_id, username, email, password_hash, display_name, status
+        SetUserStatus,      // user_id, status
+        CreateGroup,        // group_id, group_name, description, created_by
+        AddMember,          // group_id, user_id, role
+        RemoveMember,       // group_id, user_id
+        InsertMessage,      // message_id, sender_id, recipient_id, group_id, content,
+                            // message_type, created_at, seq, idempotency_key
+        MarkMessageRead,    // message_id
+        SaveReadMark,       // user_id, conversation, read_at
+        SendFriendRequest,  // request_id, sender_id, receiver_id, created_at
+        SetRequestStatus,   // request_id, status
+        AddFriendship,      // user1_id, user2_id
+        ReadThrough,        // conversation, user_id, seq; written by snapshots only
+    };
+    
+    Type type;
+    std::vector<std::string> fields;
+};
+
+// Everything the embedded backend stores, indexed for the repository
+// queries. Only EmbeddedStore changes it.
+struct EmbeddedTables {
+    struct StoredMessage {
+        Message message;  // is_read holds mark_message_read only
+        std::string idempotency_key;
+    };
+    
+    struct Conversation {
+        std::vector<StoredMessage> messages;  // by seq
+        // DMs: each recipient's messages up to this seq were read through
+        // a read mark
+        std::unordered_map<std::string, std::uint64_t> read_through;
+        
+        // The message as the repositories return it.
+        Message view(const StoredMessage& stored) const;
+        std::uint64_t last_seq() const;
+    };
+    
+    struct GroupRow {
+        Group group;
+        std::map<std::string, std::string> roles;  // user_id -> role
+        IdSetPtr member_ids;
+    };
+    
+    struct FriendRequestRow {
+        std::string request_id;
+        std::string sender_id;
+        std::string receiver_id;
+        std::string status;
+        std::string created_at;
+    };
+    
+    std::unordered_map<std::string, User> users;
+    std::unordered_map<std::string, std::string> user_by_name;   // username -> user_id
+    std::unordered_map<std::string, std::string> user_by_email;  // email -> user_id
+    
+    std::unordered_map<std::string, GroupRow> groups;
+    std::unordered_map<std::string, IdSetPtr> user_groups;
+    
+    // Keyed "dm:<conversation_id>" or "group:<group_id>"
+    std::unordered_map<std::string, Conversation> conversations;
+    std::unordered_map<std::string, std::set<std::string>> dm_partners;
+    std::unordered_map<std::string, std::pair<std::string, std::uint64_t>> message_locations;
+    std::unordered_map<std::string, std::string> idempotency_keys;  // sender, key -> message_id
+    std::unordered_map<std::string, std::unordered_map<std::string, std::string>> read_marks;
+    
+    std::unordered_map<std::string, FriendRequestRow> friend_requests;
+    std::unordered_map<std::string, std::string> request_by_pair;  // sender, receiver -> request_id
+    std::unordered_map<std::string, std::vector<std::string>> requests_to;
+    std::unordered_map<std::string, std::set<std::string>> friends;
+    
+    static std::string pair_key(const std::string& first, const std::string& second);
+    const StoredMessage* find_message(const std::string& message_id) const;
+};
+
+// Storage without external services, for edge and single-box deployments
+// and for benchmarks. The tables live in memory; every commit appends its
+// ops to a log of segment files before it is acknowledged (a writer thread
+// fdatasyncs everything queued at once), and a snapshot thread
+// periodically writes the whole state so older segments can be deleted.
+// open() loads the newest snapshot and replays the log after it.
+//
+// Transactions hold the tables exclusively until they commit, so writes
+// are serialized; reads share the lock with each other. With sync_commits
+// off, commits return before their record is synced and a crash loses
+// the last ones.
+class EmbeddedStore : public Storage {
+public:
+    explicit EmbeddedStore(EmbeddedOptions options);
+    ~EmbeddedStore();
+    EmbeddedStore(const EmbeddedStore&) = delete;
+    EmbeddedStore& operator=(const EmbeddedStore&) = delete;
+    
+    // Recovers the tables and starts the log writer and snapshot thread.
+    // False if the directory is unusable or the log is damaged.
+    bool open();
+    // Snapshots what changed since the last snapshot and stops both threads.
+    void stop();
+    
+    std::unique_ptr<Transaction> begin() override;
+    // Applies `op` in `txn`, a transaction from begin(). Throws
+    // std::invalid_argument, changing nothing, if the op repeats a unique
+    // key or names a row that does not exist.
+    void apply(Transaction& txn, EmbeddedOp op);
+    
+    // Shared lock on the tables; none on a thread inside a transaction,
+    // which already holds them.
+    std::shared_lock<std::shared_mutex> read_lock() const;
+    const EmbeddedTables& tables() const { return tables_; }
+
+private:
+    class Txn;
+    using Undo = std::vector<std::function<void()>>;
+    
+    // Changes the tables; with `undo`, records how to revert them.
+    void apply_op(const EmbeddedOp& op, Undo* undo);
+    // Queues a commit for the log writer; returns its log sequence number.
+    std::uint64_t log_commit(const std::vector<EmbeddedOp>& ops);
+    void wait_durable(std::uint64_t lsn);
+    
+    bool load_snapshot(std::uint64_t& lsn);
+    bool replay_log(std::uint64_t& lsn);
+    bool open_segment(std::uint64_t first_lsn);
+    void writer_loop();
+    void snapshot_loop();
+    bool take_snapshot();
+    std::string segment_path(std::uint64_t first_lsn) const;
+    std::string snapshot_path(std::uint64_t lsn) const;
+    
+    EmbeddedOptions options_;
+    
+    mutable std::shared_mutex mutex_;
+    std::atomic<std::thread::id> writer_;  // holding mutex_ exclusively
+    EmbeddedTables tables_;
+    std::uint64_t next_lsn_ = 1;           // under mutex_
+    
+    std::mutex log_mutex_;
+    std::condition_variable queued_;   // writer: records to write, or stopping
+    std::condition_variable durable_;  // committers: their record is synced
+    std::vector<std::string> queue_;   // framed records
+    std::uint64_t queued_lsn_ = 0;
+    std::uint64_t durable_lsn_ = 0;
+    bool failed_ = false;
+    bool stopping_ = false;
+    int fd_ = -1;
+    std::uint64_t segment_ = 0;        // first lsn of the open segment
+    std::uint64_t segment_size_ = 0;
+    std::thread log_writer_;
+    
+    std::mutex snapshot_mutex_;
+    std::condition_variable snapshot_wake_;
+    std::uint64_t snapshot_lsn_ = 0;   // everything up to it is in the snapshot
+    bool snapshot_stopping_ = false;
+    std::thread snapshotter_;
+};
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+#include "storage.hpp"
+#include "user_repository.hpp"
+#include <optional>
+#include <string>
+#include <vector>
+
+struct FriendRequest {
+    std::string request_id;
+    std::string sender_id;
+    std::string username;      // of the sender
+    std::string display_name;  // of the sender
+    std::string created_at;
+};
+
+// What send_request did; the ids are set when the request was sent.
+struct FriendRequestResult {
+    enum class Status { Sent, UserNotFound, AlreadyFriends, AlreadyRequested };
+    
+    Status status;
+    std::string request_id;
+    std::string receiver_id;
+};
+
+// The friend_requests and friendships queries. Unlike the other
+// repositories these throw on storage errors, which FriendHandler turns
+// into error frames. Implemented by PostgresFriendRepository and
+// EmbeddedFriendRepository.
+class FriendRepository {
+public:
+    virtual ~FriendRepository() = default;
+    
+    // Runs inside the caller's transaction.
+    virtual FriendRequestResult send_request(Transaction& txn,
+                                             const std::string& sender_id,
+                                             const std::string& receiver_username) = 0;
+    
+    // Accepts a pending request to `receiver_id` and records the
+    // friendship. Returns the sender, or nullopt if there is no such request.
+    virtual std::optional<std::string> accept_request(const std::string& receiver_id,
+                                                      const std::string& request_id) = 0;
+    
+    virtual void reject_request(const std::string& receiver_id,
+                                const std::string& request_id) = 0;
+    
+    // Pending requests to the user, newest first.
+    virtual std::vector<FriendRequest> get_requests(const std::string& user_id) = 0;
+    
+    // The user's friends by username; only user_id, username,
+    // display_name and status are set.
+    virtual std::vector<User> get_friends(const std::string& user_id) = 0;
+};
\ No newline at end of file
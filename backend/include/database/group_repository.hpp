@@ -1,5 +1,6 @@
 #pragma once
-#include "database.hpp"
+#include "storage.hpp"
+#include "membership_index.hpp"
 #include <string>
 #include <vector>
 #include <optional>
@@ -17,25 +18,36 @@ struct GroupMember {
     std::string role;
 };
 
+// Implemented by PostgresGroupRepository and EmbeddedGroupRepository.
 class GroupRepository {
 public:
-    explicit GroupRepository(Database& db);
+    virtual ~GroupRepository() = default;
     
-    std::optional<Group> create_group(const std::string& group_name,
-                                     const std::string& description,
-                                     const std::string& creator_id);
+    virtual std::optional<Group> create_group(const std::string& group_name,
+                                             const std::string& description,
+                                             const std::string& creator_id) = 0;
     
-    bool add_member(const std::string& group_id, const std::string& user_id, 
-                   const std::string& role = "member");
+    virtual bool add_member(const std::string& group_id, const std::string& user_id, 
+                           const std::string& role = "member") = 0;
     
-    bool remove_member(const std::string& group_id, const std::string& user_id);
+    // Same insert inside a caller's transaction; throws on failure.
+    // Anything to update once it commits is queued on `after_commit`.
+    virtual void add_member(Transaction& txn,
+                            const std::string& group_id,
+                            const std::string& user_id,
+                            const std::string& role,
+                            AfterCommit& after_commit) = 0;
     
-    std::vector<Group> get_user_groups(const std::string& user_id);
+    virtual bool remove_member(const std::string& group_id, const std::string& user_id) = 0;
     
-    std::vector<GroupMember> get_group_members(const std::string& group_id);
+    virtual std::vector<Group> get_user_groups(const std::string& user_id) = 0;
     
-    bool is_member(const std::string& group_id, const std::string& user_id);
-
-private:
-    Database& db_;
+    virtual std::vector<GroupMember> get_group_members(const std::string& group_id) = 0;
+    
+    // Sorted snapshots, cheap enough for every send; nullptr if the
+    // membership could not be read.
+    virtual IdSetPtr get_member_ids(const std::string& group_id) = 0;
+    virtual IdSetPtr get_user_group_ids(const std::string& user_id) = 0;
+    
+    virtual bool is_member(const std::string& group_id, const std::string& user_id) = 0;
 };
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct JournalOptions {
+    std::string directory;
+    std::size_t segment_bytes = 64 * 1024 * 1024;  // a new segment file after this much
+    std::size_t drain_batch = 500;                  // records per database transaction
+    std::chrono::milliseconds retry_delay{1000};    // after a failed drain
+};
+
+// Local write-ahead log for writes acknowledged before they reach the
+// database. append() returns once its record is on disk: one writer thread
+// takes everything queued, writes it and fdatasyncs once for the whole
+// group. A drainer thread reads the segments back in order, applies them
+// through the Apply callback and deletes segments it has finished. The
+// drain position is kept in a checkpoint file; applying must be idempotent,
+// since records after the last checkpoint are applied again after a crash.
+class Journal {
+public:
+    // Applies records in order, all or none. False leaves them to be retried.
+    // A record the database will never take goes to reject() instead of
+    // failing the batch, so it cannot hold back the ones after it.
+    using Apply = std::function<bool(const std::vector<std::string>& records)>;
+    
+    explicit Journal(JournalOptions options);
+    ~Journal();
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+    
+    // Applies what a previous run left behind, then starts writing and
+    // draining. False if the directory is unusable or the replay failed.
+    bool start(Apply apply);
+    // Blocks until the record is durable. Throws if it cannot be written.
+    void append(std::string record);
+    // Drains what it can within one attempt and stops both threads.
+    void stop();
+    // Keeps records that could not be applied in rejected.log, framed like
+    // a segment, for inspection. Only called from Apply. False on error.
+    bool reject(const std::vector<std::string>& records);
+
+private:
+    struct Position {
+        std::uint64_t segment;
+        std::uint64_t offset;
+    };
+    
+    void writer_loop();
+    void drainer_loop();
+    // One batch from `position`, up to `limit` bytes into the segment.
+    // Returns false if the batch could not be applied.
+    bool drain_batch(Position& position, std::uint64_t limit, bool segment_complete);
+    bool open_segment(std::uint64_t segment);
+    std::string segment_path(std::uint64_t segment) const;
+    Position load_checkpoint() const;
+    void save_checkpoint(const Position& position) const;
+    
+    JournalOptions options_;
+    Apply apply_;
+    
+    std::mutex mutex_;
+    std::condition_variable queued_;    // writer: records to write, or stopping
+    std::condition_variable durable_;   // appenders: their record is synced
+    std::condition_variable written_;   // drainer: more on disk, or stopping
+    std::vector<std::string> queue_;
+    std::uint64_t appended_ = 0;
+    std::uint64_t synced_ = 0;
+    bool failed_ = false;
+    bool stopping_ = false;
+    bool writer_done_ = false;
+    
+    int fd_ = -1;
+    std::uint64_t segment_ = 0;       // being written
+    std::uint64_t segment_size_ = 0;  // synced bytes in it
+    Position drained_{0, 0};
+    
+    std::thread writer_;
+    std::thread drainer_;
+};
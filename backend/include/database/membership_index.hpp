@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Sorted ids; never modified once published, so readers use a snapshot
+// after dropping the lock.
+using IdSet = std::vector<std::string>;
+using IdSetPtr = std::shared_ptr<const IdSet>;
+
+// In-memory copy of group_members, indexed both ways: group -> members and
+// user -> groups. Entries are loaded from the database on first use (see
+// GroupRepository) and kept current by every membership write, so lookups
+// after the first never query.
+class MembershipIndex {
+public:
+    // Called for changes made by this process, to pass them to peers.
+    using Listener = std::function<void(const std::string& group_id,
+                                        const std::string& user_id,
+                                        bool added)>;
+    
+    explicit MembershipIndex(std::size_t max_entries = 100000);
+    
+    // nullptr when not loaded yet.
+    IdSetPtr members(const std::string& group_id) const;
+    IdSetPtr groups(const std::string& user_id) const;
+    
+    // A load reads version() before its query. The result is cached only
+    // if no write happened in between; it is returned either way.
+    std::uint64_t version() const;
+    IdSetPtr install_members(const std::string& group_id, IdSet members, std::uint64_t version);
+    IdSetPtr install_groups(const std::string& user_id, IdSet groups, std::uint64_t version);
+    
+    // Local writes, after they commit; reported to the listener.
+    void created(const std::string& group_id, const std::string& creator_id);
+    void add(const std::string& group_id, const std::string& user_id);
+    void remove(const std::string& group_id, const std::string& user_id);
+    
+    // A peer's write; not reported again.
+    void apply(const std::string& group_id, const std::string& user_id, bool added);
+    // Forget everything, e.g. when peer updates may have been missed.
+    void clear();
+    
+    void set_listener(Listener listener);
+    
+    static bool contains(const IdSet& set, const std::string& id);
+
+private:
+    using Map = std::unordered_map<std::string, IdSetPtr>;
+    
+    void update(const std::string& group_id, const std::string& user_id, bool added);
+    void install(Map& map, const std::string& key, IdSetPtr set);
+    static void update_entry(Map& map, const std::string& key, const std::string& id, bool added);
+    
+    mutable std::shared_mutex mutex_;
+    Map members_;
+    Map groups_;
+    std::uint64_t version_;
+    std::size_t max_entries_;
+    Listener listener_;
+};
@@ -0,0 +1,109 @@
+#pragma once
+#include "database.hpp"
+#include "message_repository.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct ZSTD_CCtx_s;
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+struct ArchiveOptions {
+    std::string directory;
+    std::chrono::seconds max_age{90 * 24 * 3600};  // older messages leave the database
+    std::chrono::seconds interval{3600};           // between archival runs
+    std::size_t min_messages = 50;                 // per conversation and run
+    std::size_t max_segment_messages = 50000;
+    int compression_level = 9;
+    std::size_t mapped_segments = 256;             // kept mapped between reads
+};
+
+// Cold history outside the database. An archival thread moves messages
+// older than max_age into immutable per-conversation segment files and
+// deletes them from `messages`; each conversation keeps at least its latest
+// message in the database so inboxes still list it.
+//
+// A segment holds zstd-compressed blocks of 64 messages, compressed with a
+// dictionary trained on the first archived messages, and a sparse index of
+// each block's first sequence number. Reads map the file and decompress
+// only the blocks they need. Conversations are keyed as in
+// SequenceAllocator: "dm:<conversation_id>" or "group:<group_id>".
+class MessageArchive {
+public:
+    MessageArchive(Database& db, ArchiveOptions options);
+    ~MessageArchive();
+    MessageArchive(const MessageArchive&) = delete;
+    MessageArchive& operator=(const MessageArchive&) = delete;
+    
+    // Loads dictionaries and the segment catalog. False if unusable.
+    bool open();
+    void start();
+    void stop();
+    // One archival pass; returns how many messages it moved.
+    std::size_t run_once();
+    
+    // Highest archived sequence number of the conversation, 0 if none.
+    std::uint64_t last_seq(const std::string& conversation) const;
+    // Up to `limit` messages with seq below `before_seq`, newest first.
+    std::vector<Message> read_before(const std::string& conversation,
+                                     std::uint64_t before_seq,
+                                     std::size_t limit);
+    // Up to `limit` messages with seq in [from_seq, to_seq], oldest first.
+    std::vector<Message> read_range(const std::string& conversation,
+                                    std::uint64_t from_seq,
+                                    std::uint64_t to_seq,
+                                    std::size_t limit);
+
+private:
+    struct SegmentInfo {
+        std::uint64_t first_seq;
+        std::uint64_t last_seq;
+        std::string path;
+    };
+    
+    class Mapping;
+    
+    std::size_t archive_conversation(const std::string& conversation);
+    bool train_dictionary();
+    bool load_dictionary(const std::string& path);
+    bool write_segment(const std::string& path, const std::vector<Message>& messages);
+    std::vector<SegmentInfo> segments_of(const std::string& conversation) const;
+    std::shared_ptr<Mapping> map_segment(const std::string& path);
+    // Messages of `block` in a mapped segment, in seq order.
+    std::vector<Message> read_block(const Mapping& mapping, std::size_t block);
+    std::string conversation_dir(const std::string& conversation) const;
+    
+    Database& db_;
+    ArchiveOptions options_;
+    
+    mutable std::shared_mutex catalog_mutex_;
+    std::unordered_map<std::string, std::vector<SegmentInfo>> catalog_;  // by first_seq
+    
+    // Segments name the dictionary they were compressed with; one is
+    // trained, on the first run with enough old messages, and used from then on
+    std::mutex dictionary_mutex_;
+    std::map<std::uint32_t, ZSTD_DDict_s*> ddicts_;
+    std::uint32_t dictionary_id_ = 0;
+    ZSTD_CDict_s* cdict_ = nullptr;
+    ZSTD_CCtx_s* cctx_ = nullptr;  // archival thread only
+    
+    std::mutex mappings_mutex_;
+    std::list<std::string> mapping_lru_;  // most recent first
+    std::unordered_map<std::string,
+                       std::pair<std::shared_ptr<Mapping>, std::list<std::string>::iterator>> mappings_;
+    
+    std::mutex worker_mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::thread worker_;
+};
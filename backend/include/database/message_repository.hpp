@@ -1,5 +1,6 @@
 #pragma once
-#include "database.hpp"
+#include "storage.hpp"
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <optional>
@@ -13,31 +14,115 @@ struct Message {
     std::string message_type;
     std::string created_at;
     bool is_read;
+    std::uint64_t seq = 0;  // position in its conversation or group, from 1
+    bool duplicate = false;  // an earlier send with the same idempotency key
 };
 
+// One row of a user's inbox: a DM or group conversation with its latest
+// message and how many messages from others arrived after the read mark.
+struct InboxEntry {
+    std::string conversation;  // "dm:<user_id>" or "group:<group_id>"
+    std::string last_message_id;
+    std::string last_sender_id;
+    std::string last_preview;
+    std::string last_created_at;
+    std::uint64_t last_seq = 0;
+    std::uint64_t unread = 0;
+};
+
+struct ReadMark {
+    std::string user_id;
+    std::string conversation;
+    std::string read_at;  // created_at of the last message read
+    std::uint64_t seq = 0;  // its conversation_seq; not stored
+};
+
+// One page of a sync. cursors[i] is where the next sync resumes after
+// messages[i]; clients hand it back without looking inside.
+struct SyncPage {
+    std::vector<Message> messages;
+    std::vector<std::string> cursors;
+};
+
+// Implemented by PostgresMessageRepository and EmbeddedMessageRepository.
 class MessageRepository {
 public:
-    explicit MessageRepository(Database& db);
+    virtual ~MessageRepository() = default;
+    
+    // Key shared by both directions of a DM: the two user ids in byte
+    // order, as friendships stores user1_id/user2_id.
+    static std::string conversation_id(const std::string& user1_id,
+                                       const std::string& user2_id) {
+        return user1_id < user2_id ? user1_id + ":" + user2_id : user2_id + ":" + user1_id;
+    }
+    
+    virtual std::optional<Message> send_message(const std::string& sender_id,
+                                               const std::string& recipient_id,
+                                               const std::string& content,
+                                               const std::string& message_type = "text",
+                                               const std::string& idempotency_key = "") = 0;
     
-    std::optional<Message> send_message(const std::string& sender_id,
-                                       const std::string& recipient_id,
+    virtual std::optional<Message> send_group_message(const std::string& sender_id,
+                                                     const std::string& group_id,
+                                                     const std::string& content,
+                                                     const std::string& message_type = "text",
+                                                     const std::string& idempotency_key = "") = 0;
+    
+    // Same inserts inside a caller's transaction; throw on failure.
+    // A send repeating an earlier idempotency key of the sender inserts
+    // nothing and returns the earlier message with `duplicate` set.
+    virtual Message send_message(Transaction& txn,
+                                 const std::string& sender_id,
+                                 const std::string& recipient_id,
+                                 const std::string& content,
+                                 const std::string& message_type = "text",
+                                 const std::string& idempotency_key = "") = 0;
+    
+    virtual Message send_group_message(Transaction& txn,
+                                       const std::string& sender_id,
+                                       const std::string& group_id,
                                        const std::string& content,
-                                       const std::string& message_type = "text");
+                                       const std::string& message_type = "text",
+                                       const std::string& idempotency_key = "") = 0;
     
-    std::optional<Message> send_group_message(const std::string& sender_id,
-                                             const std::string& group_id,
-                                             const std::string& content,
-                                             const std::string& message_type = "text");
+    // Newest first; with `before_seq`, the page below that sequence number.
+    virtual std::vector<Message> get_conversation(const std::string& user1_id,
+                                                 const std::string& user2_id,
+                                                 int limit = 50,
+                                                 std::uint64_t before_seq = 0) = 0;
     
-    std::vector<Message> get_conversation(const std::string& user1_id,
-                                         const std::string& user2_id,
-                                         int limit = 50);
+    virtual std::vector<Message> get_group_messages(const std::string& group_id,
+                                                   int limit = 50) = 0;
     
-    std::vector<Message> get_group_messages(const std::string& group_id,
-                                           int limit = 50);
+    // Messages whose seq lies in [from_seq, to_seq], in seq order. A number
+    // missing from the result was never used.
+    virtual std::vector<Message> get_conversation_range(const std::string& user1_id,
+                                                       const std::string& user2_id,
+                                                       std::uint64_t from_seq,
+                                                       std::uint64_t to_seq,
+                                                       int limit) = 0;
     
-    bool mark_message_read(const std::string& message_id);
-
-private:
-    Database& db_;
+    virtual std::vector<Message> get_group_range(const std::string& group_id,
+                                                std::uint64_t from_seq,
+                                                std::uint64_t to_seq,
+                                                int limit) = 0;
+    
+    // DMs to or from the user and messages in the user's groups after
+    // `cursor` (empty: from the beginning), in commit order, so a message
+    // committing late never lands behind a cursor already handed out.
+    // nullopt on failure or for a cursor this repository did not make.
+    // Only messages still in the database are returned: ones moved to the
+    // archive are reached through the history queries instead.
+    virtual std::optional<SyncPage> get_messages_since(const std::string& user_id,
+                                                       const std::string& cursor,
+                                                       int limit) = 0;
+    
+    virtual bool mark_message_read(const std::string& message_id) = 0;
+    
+    // Every conversation of the user, newest first. nullopt on failure,
+    // so an empty inbox can be told apart from an error.
+    virtual std::optional<std::vector<InboxEntry>> get_inbox(const std::string& user_id) = 0;
+    
+    // Saves read marks in one transaction; a mark never moves backwards.
+    virtual bool save_read_marks(const std::vector<ReadMark>& marks) = 0;
 };
\ No newline at end of file
@@ -0,0 +1,12 @@
+#pragma once
+#include <vector>
+
+// Schema changes applied on startup on top of the base schema.sql.
+// Append new entries with the next version number; never edit old ones.
+struct Migration {
+    int version;
+    const char* description;
+    const char* sql;
+};
+
+const std::vector<Migration>& schema_migrations();
@@ -0,0 +1,21 @@
+#pragma once
+#include "database.hpp"
+#include "friend_repository.hpp"
+
+class PostgresFriendRepository : public FriendRepository {
+public:
+    explicit PostgresFriendRepository(Database& db);
+    
+    FriendRequestResult send_request(Transaction& txn,
+                                     const std::string& sender_id,
+                                     const std::string& receiver_username) override;
+    std::optional<std::string> accept_request(const std::string& receiver_id,
+                                              const std::string& request_id) override;
+    void reject_request(const std::string& receiver_id,
+                        const std::string& request_id) override;
+    std::vector<FriendRequest> get_requests(const std::string& user_id) override;
+    std::vector<User> get_friends(const std::string& user_id) override;
+
+private:
+    Database& db_;
+};
\ No newline at end of file
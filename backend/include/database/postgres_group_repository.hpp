@@ -0,0 +1,43 @@
+#pragma once
+#include "database.hpp"
+#include "group_repository.hpp"
+#include "membership_index.hpp"
+
+class PostgresGroupRepository : public GroupRepository {
+public:
+    // `membership_entries` bounds each side of the membership index.
+    PostgresGroupRepository(Database& db, std::size_t membership_entries = 100000);
+    
+    std::optional<Group> create_group(const std::string& group_name,
+                                     const std::string& description,
+                                     const std::string& creator_id) override;
+    
+    bool add_member(const std::string& group_id, const std::string& user_id, 
+                   const std::string& role = "member") override;
+    
+    // The index learns of the member once the transaction commits.
+    void add_member(Transaction& txn,
+                    const std::string& group_id,
+                    const std::string& user_id,
+                    const std::string& role,
+                    AfterCommit& after_commit) override;
+    
+    bool remove_member(const std::string& group_id, const std::string& user_id) override;
+    
+    std::vector<Group> get_user_groups(const std::string& user_id) override;
+    
+    std::vector<GroupMember> get_group_members(const std::string& group_id) override;
+    
+    // Served from the membership index; the database is only read the
+    // first time a group or user is seen. nullptr if that read fails.
+    IdSetPtr get_member_ids(const std::string& group_id) override;
+    IdSetPtr get_user_group_ids(const std::string& user_id) override;
+    
+    bool is_member(const std::string& group_id, const std::string& user_id) override;
+    
+    MembershipIndex& index() { return index_; }
+
+private:
+    Database& db_;
+    MembershipIndex index_;
+};
\ No newline at end of file
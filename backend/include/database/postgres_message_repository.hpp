@@ -0,0 +1,120 @@
+#pragma once
+#include "database.hpp"
+#include "journal.hpp"
+#include "message_repository.hpp"
+#include "sequence_allocator.hpp"
+#include "../utils/id_generator.hpp"
+#include <mutex>
+#include <unordered_set>
+
+class MessageArchive;
+
+class PostgresMessageRepository : public MessageRepository {
+public:
+    // Message ids and created_at come from `ids`, so inserts need no
+    // RETURNING. `seq_block` sequence numbers are reserved per conversation
+    // at a time.
+    PostgresMessageRepository(Database& db, IdGenerator& ids, std::uint64_t seq_block = 100,
+                              std::size_t seq_connections = 4);
+    
+    std::optional<Message> send_message(const std::string& sender_id,
+                                       const std::string& recipient_id,
+                                       const std::string& content,
+                                       const std::string& message_type = "text",
+                                       const std::string& idempotency_key = "") override;
+    
+    std::optional<Message> send_group_message(const std::string& sender_id,
+                                             const std::string& group_id,
+                                             const std::string& content,
+                                             const std::string& message_type = "text",
+                                             const std::string& idempotency_key = "") override;
+    
+    Message send_message(Transaction& txn,
+                         const std::string& sender_id,
+                         const std::string& recipient_id,
+                         const std::string& content,
+                         const std::string& message_type = "text",
+                         const std::string& idempotency_key = "") override;
+    
+    Message send_group_message(Transaction& txn,
+                               const std::string& sender_id,
+                               const std::string& group_id,
+                               const std::string& content,
+                               const std::string& message_type = "text",
+                               const std::string& idempotency_key = "") override;
+    
+    // Pages past what the database holds come from the archive.
+    std::vector<Message> get_conversation(const std::string& user1_id,
+                                         const std::string& user2_id,
+                                         int limit = 50,
+                                         std::uint64_t before_seq = 0) override;
+    
+    std::vector<Message> get_group_messages(const std::string& group_id,
+                                           int limit = 50) override;
+    
+    std::vector<Message> get_conversation_range(const std::string& user1_id,
+                                               const std::string& user2_id,
+                                               std::uint64_t from_seq,
+                                               std::uint64_t to_seq,
+                                               int limit) override;
+    
+    std::vector<Message> get_group_range(const std::string& group_id,
+                                        std::uint64_t from_seq,
+                                        std::uint64_t to_seq,
+                                        int limit) override;
+    
+    // Sees only commits older than the oldest transaction still running in
+    // the database, so any transaction left open holds every user's sync
+    // back until it ends: set idle_in_transaction_session_timeout, and keep
+    // long jobs out of write transactions. A page fails after 5 seconds.
+    std::optional<SyncPage> get_messages_since(const std::string& user_id,
+                                               const std::string& cursor,
+                                               int limit) override;
+    
+    bool mark_message_read(const std::string& message_id) override;
+    
+    // From here on, standalone sends are acknowledged once in the journal
+    // and reach the database from its drainer; batch sends, which share a
+    // transaction with other writes, and sends with an idempotency key,
+    // which need the unique index to catch a late retry, still insert
+    // directly. A journaled message is delivered at once but stays out of
+    // history, the inbox query and sync until it is drained. Replays what
+    // the journal holds from an earlier run first; false if that fails.
+    bool use_journal(Journal& journal);
+    void set_archive(MessageArchive* archive);
+    
+    // In one aggregate query.
+    std::optional<std::vector<InboxEntry>> get_inbox(const std::string& user_id) override;
+    
+    bool save_read_marks(const std::vector<ReadMark>& marks) override;
+
+private:
+    // A message with its id, created_at and sequence number assigned.
+    Message new_message(const std::string& sender_id,
+                        const std::string& recipient_id,
+                        const std::string& group_id,
+                        const std::string& content,
+                        const std::string& message_type);
+    // False if a row with the same id or idempotency key exists.
+    static bool insert_message(pqxx::transaction_base& txn,
+                               const Message& msg,
+                               const std::string& idempotency_key);
+    bool apply_journal(Journal& journal, const std::vector<std::string>& records);
+    // Whether `user_id` names a user, remembered once it does. Throws if
+    // the lookup fails.
+    bool recipient_exists(const std::string& user_id);
+    static Message find_duplicate(pqxx::transaction_base& txn,
+                                  const std::string& sender_id,
+                                  const std::string& idempotency_key);
+    std::vector<Message> get_range(const char* query, const std::string& key,
+                                   const std::string& conversation,
+                                   std::uint64_t from_seq, std::uint64_t to_seq, int limit);
+    
+    Database& db_;
+    IdGenerator& ids_;
+    SequenceAllocator sequences_;
+    Journal* journal_;
+    MessageArchive* archive_;
+    std::mutex recipients_mutex_;
+    std::unordered_set<std::string> known_recipients_;
+};
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+#include "database.hpp"
+#include "user_repository.hpp"
+
+class PostgresUserRepository : public UserRepository {
+public:
+    explicit PostgresUserRepository(Database& db);
+    
+    std::optional<User> create_user(const std::string& username, 
+                                    const std::string& email,
+                                    const std::string& password_hash,
+                                    const std::string& display_name) override;
+    std::optional<User> get_user_by_username(const std::string& username) override;
+    std::optional<User> get_user_by_id(const std::string& user_id) override;
+    bool update_user_status(const std::string& user_id, const std::string& status) override;
+    std::vector<User> search_users(const std::string& query) override;
+
+private:
+    Database& db_;
+};
\ No newline at end of file
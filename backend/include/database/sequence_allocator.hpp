@@ -0,0 +1,48 @@
+#pragma once
+#include "database.hpp"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Hands out per-conversation message sequence numbers from memory. Each
+// conversation draws numbers from a block reserved in conversation_sequences;
+// only running out of a block costs a database round trip. Reservations
+// commit on connections of their own, outside the caller's transaction and
+// the shared pool, so a block is never handed out twice even if the insert
+// that used it rolls back. No lock is held over the round trip:
+// conversations reserve concurrently, and only the row lock in Postgres
+// orders reservations of the same conversation.
+//
+// Numbers increase per conversation but can skip: a rolled back insert, the
+// rest of a block when the process exits, or the rest of a block replaced
+// by a newer one reserved at the same time leaves a number unused.
+class SequenceAllocator {
+public:
+    SequenceAllocator(const std::string& connection_string, std::uint64_t block_size,
+                      std::size_t connections = 4, std::size_t max_entries = 100000);
+    
+    // Throws if a new block cannot be reserved.
+    std::uint64_t next(const std::string& conversation);
+
+private:
+    struct Block {
+        std::uint64_t next;
+        std::uint64_t limit;  // one past the last reserved number
+    };
+    
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Block> blocks;
+    };
+    static constexpr std::size_t kShards = 16;
+    
+    Block reserve(const std::string& conversation);
+    
+    std::uint64_t block_size_;
+    std::size_t max_entries_per_shard_;
+    std::array<Shard, kShards> shards_;
+    Database reservations_;  // its own pool, see above
+};
@@ -0,0 +1,31 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Side effects (notifications) held back until a transaction commits.
+using AfterCommit = std::vector<std::function<void()>>;
+
+// A write transaction of the configured backend. The batch forms of the
+// repositories run inside one; it only works with repositories of the
+// backend that began it.
+class Transaction {
+public:
+    virtual ~Transaction() = default;
+    
+    // Runs `step` under a savepoint: if it throws, only its writes are
+    // undone and the exception propagates.
+    virtual void savepoint(const std::function<void()>& step) = 0;
+    // Throws if the writes could not be committed. Destroying a
+    // transaction that was not committed rolls it back.
+    virtual void commit() = 0;
+};
+
+// Where the repositories keep their data: Postgres (Database) or the
+// embedded engine (EmbeddedStore).
+class Storage {
+public:
+    virtual ~Storage() = default;
+    
+    virtual std::unique_ptr<Transaction> begin() = 0;
+};
\ No newline at end of file
@@ -1,5 +1,4 @@
 #pragma once
-#include "database.hpp"
 #include <string>
 #include <optional>
 #include <vector>
@@ -13,19 +12,17 @@ struct User {
     std::string status;
 };
 
+// Implemented by PostgresUserRepository and EmbeddedUserRepository.
 class UserRepository {
 public:
-    explicit UserRepository(Database& db);
+    virtual ~UserRepository() = default;
     
-    std::optional<User> create_user(const std::string& username, 
-                                    const std::string& email,
-                                    const std::string& password_hash,
-                                    const std::string& display_name);
-    std::optional<User> get_user_by_username(const std::string& username);
-    std::optional<User> get_user_by_id(const std::string& user_id);
-    bool update_user_status(const std::string& user_id, const std::string& status);
-    std::vector<User> search_users(const std::string& query);
-
-private:
-    Database& db_;
+    virtual std::optional<User> create_user(const std::string& username, 
+                                            const std::string& email,
+                                            const std::string& password_hash,
+                                            const std::string& display_name) = 0;
+    virtual std::optional<User> get_user_by_username(const std::string& username) = 0;
+    virtual std::optional<User> get_user_by_id(const std::string& user_id) = 0;
+    virtual bool update_user_status(const std::string& user_id, const std::string& status) = 0;
+    virtual std::vector<User> search_users(const std::string& query) = 0;
 };
\ No newline at end of file
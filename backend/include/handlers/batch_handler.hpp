@@ -0,0 +1,40 @@
+#pragma once
+#include "../database/storage.hpp"
+#include <boost/json.hpp>
+#include <string>
+
+class MessageHandler;
+class GroupHandler;
+class FriendHandler;
+
+// Runs the operations of a client `batch` frame in one transaction and
+// answers with a single batch_result frame.
+class BatchHandler {
+public:
+    static constexpr std::size_t kMaxOperations = 100;
+    
+    BatchHandler(Storage& storage,
+                MessageHandler& msg_handler,
+                GroupHandler& group_handler,
+                FriendHandler& friend_handler);
+    
+    // Checks every operation up front. Returns an error frame naming the
+    // first bad operation, or an empty string if the batch can run.
+    static std::string validate(const boost::json::array& operations);
+    
+    // Each operation runs under its own savepoint, so one failing does
+    // not roll back the others; notifications go out after the commit.
+    std::string handle_batch(const std::string& user_id,
+                            const boost::json::array& operations);
+
+private:
+    std::string run_operation(Transaction& txn,
+                             const std::string& user_id,
+                             const boost::json::object& operation,
+                             AfterCommit& after_commit);
+
+    Storage& storage_;
+    MessageHandler& msg_handler_;
+    GroupHandler& group_handler_;
+    FriendHandler& friend_handler_;
+};
@@ -1,17 +1,24 @@
 #pragma once
-#include "../database/database.hpp"
+#include "../database/friend_repository.hpp"
 #include <string>
 
 class SessionManager;
 
 class FriendHandler {
 public:
-    explicit FriendHandler(Database& db);
+    FriendHandler(FriendRepository& friend_repo, Storage& storage);
     
     void set_session_manager(SessionManager* manager);
     std::string handle_send_friend_request(const std::string& sender_id,
                                           const std::string& receiver_username);
     
+    // Batch form: runs inside `txn` and queues the receiver's notification
+    // on `after_commit`. Throws on database errors.
+    std::string handle_send_friend_request(Transaction& txn,
+                                          const std::string& sender_id,
+                                          const std::string& receiver_username,
+                                          AfterCommit& after_commit);
+    
     std::string handle_accept_friend_request(const std::string& user_id,
                                             const std::string& request_id);
     
@@ -23,6 +30,7 @@ public:
     std::string handle_get_friends(const std::string& user_id);
 
 private:
-    Database& db_;
+    FriendRepository& friend_repo_;
+    Storage& storage_;
     SessionManager* session_manager_;
 };
\ No newline at end of file
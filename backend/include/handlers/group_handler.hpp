@@ -16,9 +16,18 @@ public:
     std::string handle_add_member(const std::string& group_id,
                                  const std::string& user_id);
     
+    // Batch form: stages the insert in `txn`; throws if it fails.
+    std::string handle_add_member(Transaction& txn,
+                                 const std::string& group_id,
+                                 const std::string& user_id,
+                                 AfterCommit& after_commit);
+    
     std::string handle_get_groups(const std::string& user_id);
 
 private:
+    std::string member_added(const std::string& group_id, const std::string& user_id);
+    void notify_added(const std::string& group_id, const std::string& user_id);
+    
     GroupRepository& group_repo_;
     SessionManager* session_manager_;
 };
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// Acks of recent sends by (sender, idempotency key), so a client retrying
+// after a timeout gets the original ack back without another insert.
+// Bounded: each shard drops its least recently used entry when full. A
+// retry that misses the window is still caught by the unique index on
+// messages (sender_id, idempotency_key).
+//
+// With `bloom` set, lookups first test a two-generation bloom filter and
+// skip the shard lock for keys never seen, which is nearly every send.
+class IdempotencyCache {
+public:
+    explicit IdempotencyCache(std::size_t max_entries = 100000, bool bloom = false);
+    
+    std::optional<std::string> find(const std::string& sender_id, const std::string& key);
+    void insert(const std::string& sender_id, const std::string& key, std::string ack);
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        std::list<std::pair<std::string, std::string>> lru;  // most recent first
+        std::unordered_map<std::string, std::list<std::pair<std::string, std::string>>::iterator> index;
+    };
+    static constexpr std::size_t kShards = 16;
+    
+    // Bits set by inserts. Lookups test both generations; once `current`
+    // has taken twice as many inserts as the window holds, `previous` is
+    // cleared and the two swap, so keys still cached stay covered. A key
+    // that slips out anyway costs one insert the unique index rejects.
+    class Bloom {
+    public:
+        explicit Bloom(std::size_t max_entries);
+        bool may_contain(std::size_t hash) const;
+        void add(std::size_t hash);
+    
+    private:
+        using Bits = std::unique_ptr<std::atomic<std::uint64_t>[]>;
+        bool test(const Bits& bits, std::size_t hash) const;
+        
+        std::size_t words_;
+        std::size_t rotate_after_;
+        std::mutex rotate_mutex_;
+        std::atomic<std::size_t> inserts_;
+        std::atomic<int> current_;
+        std::array<Bits, 2> generations_;
+    };
+    
+    static std::string make_key(const std::string& sender_id, const std::string& key);
+    Shard& shard_for(std::size_t hash);
+    
+    std::size_t max_entries_per_shard_;
+    std::array<Shard, kShards> shards_;
+    std::unique_ptr<Bloom> bloom_;
+};
@@ -0,0 +1,99 @@
+#pragma once
+#include "../database/membership_index.hpp"
+#include "../database/message_repository.hpp"
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class TimingWheel;
+
+// Per-user inbox: every conversation with its last message and unread
+// count. Built from one aggregate query on the user's first get_inbox,
+// then kept current from the messages sent through this process and the
+// events other nodes forward to it. It lives while the user is connected
+// to this process. Within a conversation, messages are ordered by
+// conversation_seq. Read marks are buffered and written to the database
+// periodically by a flusher thread.
+class InboxHandler {
+public:
+    explicit InboxHandler(MessageRepository& msg_repo);
+    ~InboxHandler();
+    InboxHandler(const InboxHandler&) = delete;
+    InboxHandler& operator=(const InboxHandler&) = delete;
+    
+    std::string handle_get_inbox(const std::string& user_id);
+    // Marks everything in the conversation up to its last message as read.
+    std::string handle_mark_read(const std::string& user_id, const std::string& conversation);
+    
+    // A DM, for both the sender's and the recipient's inbox.
+    void on_message_sent(const Message& message);
+    // A group message, for the inboxes of `members` loaded here.
+    void on_group_message(const Message& message, const IdSet& members);
+    // An event frame forwarded by another node, parsed once for all of
+    // `user_ids` and only if one of them has an inbox loaded.
+    void on_remote_event(const std::vector<std::string>& user_ids, const std::string& frame);
+    void evict(const std::string& user_id);
+    
+    // Writes buffered read marks; failed ones are retried on the next flush.
+    void flush();
+    // The wheel only wakes the flusher thread, so a slow database never
+    // holds up its timers.
+    void start();
+    void stop();
+    void schedule_flush(TimingWheel& wheel, std::chrono::milliseconds interval);
+
+private:
+    struct Update {
+        std::string conversation;
+        std::string message_id;
+        std::string sender_id;
+        std::string preview;
+        std::string created_at;
+        std::uint64_t seq;
+        bool incoming;
+    };
+    
+    struct Mark {
+        std::uint64_t seq = 0;
+        std::string read_at;
+    };
+    
+    struct Inbox {
+        bool loading = true;
+        std::unordered_map<std::string, InboxEntry> entries;
+        std::vector<Update> queued;  // arrived while loading
+    };
+    
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Inbox> inboxes;
+        std::map<std::pair<std::string, std::string>, Mark> marks;  // not yet saved
+    };
+    static constexpr std::size_t kShards = 16;
+    
+    Shard& shard_for(const std::string& user_id);
+    // Loads the inbox if needed and runs `fn` on it under the shard lock.
+    // Returns false if it could not be loaded.
+    template <typename Fn>
+    bool with_inbox(const std::string& user_id, Fn&& fn);
+    void apply(const std::string& user_id, Update update);
+    static void apply_locked(Shard& shard, const std::string& user_id, const Update& update);
+    static void apply_to(Inbox& inbox, const Update& update);
+    static void keep_newer(Mark& mark, std::uint64_t seq, const std::string& read_at);
+    
+    MessageRepository& msg_repo_;
+    std::array<Shard, kShards> shards_;
+    
+    std::mutex flusher_mutex_;
+    std::condition_variable wake_;
+    bool flush_requested_ = false;
+    bool stopping_ = false;
+    std::thread flusher_;
+};
@@ -1,26 +1,90 @@
 #pragma once
 #include "../database/message_repository.hpp"
+#include "../database/group_repository.hpp"
+#include "idempotency_cache.hpp"
+#include <cstdint>
+#include <optional>
 #include <string>
+#include <vector>
 
 class SessionManager;
+class InboxHandler;
 
 class MessageHandler {
 public:
-    explicit MessageHandler(MessageRepository& msg_repo);
+    // The last `dedup_entries` acks of sends carrying an idempotency key
+    // are kept for retries.
+    MessageHandler(MessageRepository& msg_repo,
+                   GroupRepository& group_repo,
+                   std::size_t dedup_entries = 100000,
+                   bool dedup_bloom = false);
     
     void set_session_manager(SessionManager* manager);
-    void handle_send_message(const std::string& sender_id,
-                           const std::string& recipient_id,
-                           const std::string& content);
+    void set_inbox_handler(InboxHandler* inbox);
+    // Delivers to the recipient and returns the sender's confirmation. A
+    // repeated `idempotency_key` returns the first send's confirmation.
+    std::string handle_send_message(const std::string& sender_id,
+                                   const std::string& recipient_id,
+                                   const std::string& content,
+                                   const std::string& idempotency_key = "");
     
-    void handle_send_group_message(const std::string& sender_id,
-                                  const std::string& group_id,
-                                  const std::string& content);
+    // Fans out to the group and returns the sender's acknowledgement.
+    std::string handle_send_group_message(const std::string& sender_id,
+                                         const std::string& group_id,
+                                         const std::string& content,
+                                         const std::string& idempotency_key = "");
     
+    // Batch forms: stage the insert in `txn` and queue the deliveries on
+    // `after_commit`. Throw if the insert fails.
+    std::string handle_send_message(Transaction& txn,
+                                   const std::string& sender_id,
+                                   const std::string& recipient_id,
+                                   const std::string& content,
+                                   const std::string& idempotency_key,
+                                   AfterCommit& after_commit);
+    
+    std::string handle_send_group_message(Transaction& txn,
+                                         const std::string& sender_id,
+                                         const std::string& group_id,
+                                         const std::string& content,
+                                         const std::string& idempotency_key,
+                                         AfterCommit& after_commit);
+    
+    // Latest page, or with `before_seq` the page below it, which reaches
+    // into archived history.
     std::string handle_get_conversation(const std::string& user1_id,
-                                       const std::string& user2_id);
+                                       const std::string& user2_id,
+                                       std::uint64_t before_seq = 0);
+    
+    // Messages of a DM (`other_user_id`) or group (`group_id`) by sequence
+    // number, for filling a gap the client detected.
+    std::string handle_get_range(const std::string& user_id,
+                                const std::string& other_user_id,
+                                const std::string& group_id,
+                                std::uint64_t from_seq,
+                                std::uint64_t to_seq);
+    
+    // Everything newer than the cursor as sync_batch frames followed by
+    // one sync_complete frame, or a single error frame if the messages
+    // could not be read; the client then retries from the same cursor.
+    std::vector<std::string> handle_sync(const std::string& user_id,
+                                        const std::string& after);
 
 private:
+    // Ack of an earlier send with this key, if still in the window.
+    std::optional<std::string> replay(const std::string& sender_id,
+                                      const std::string& idempotency_key);
+    void remember(const std::string& sender_id,
+                  const std::string& idempotency_key,
+                  const std::string& ack);
+    std::string message_sent(const Message& message);
+    void deliver_message(const Message& message);
+    std::string group_message_sent(const Message& message);
+    void deliver_group_message(const Message& message);
+    
     MessageRepository& msg_repo_;
+    GroupRepository& group_repo_;
+    IdempotencyCache idempotency_;
     SessionManager* session_manager_;
+    InboxHandler* inbox_handler_;
 };
\ No newline at end of file
@@ -0,0 +1,118 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <time.h>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace beast = boost::beast;
+namespace net = boost::asio;
+
+// Adds the calling thread's CPU time while in scope to `counter`, in
+// microseconds. Nested scopes on the same thread only count once.
+class ThreadCpuScope {
+public:
+    explicit ThreadCpuScope(std::atomic<std::uint64_t>* counter) : counter_(counter) {
+        if (!counter_ || active()) {
+            counter_ = nullptr;
+            return;
+        }
+        active() = true;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start_);
+    }
+    
+    ~ThreadCpuScope() {
+        if (!counter_) {
+            return;
+        }
+        timespec end;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+        auto us = (end.tv_sec - start_.tv_sec) * 1000000 + (end.tv_nsec - start_.tv_nsec) / 1000;
+        counter_->fetch_add(static_cast<std::uint64_t>(us), std::memory_order_relaxed);
+        active() = false;
+    }
+    
+    ThreadCpuScope(const ThreadCpuScope&) = delete;
+    ThreadCpuScope& operator=(const ThreadCpuScope&) = delete;
+
+private:
+    static bool& active() {
+        thread_local bool value = false;
+        return value;
+    }
+    
+    std::atomic<std::uint64_t>* counter_;
+    timespec start_{};
+};
+
+// Pass-through layer under a websocket::stream that counts the bytes
+// written, i.e. frames as they go on the wire: after permessage-deflate,
+// before TLS. Optionally charges the CPU time of write completions, where
+// Beast deflates the next chunk of a message, to a counter.
+template<class Next>
+class CountingStream {
+public:
+    using executor_type = typename Next::executor_type;
+    using next_layer_type = Next;
+    
+    explicit CountingStream(Next next) : next_(std::move(next)) {}
+    
+    executor_type get_executor() { return next_.get_executor(); }
+    Next& next_layer() { return next_; }
+    const Next& next_layer() const { return next_; }
+    
+    std::uint64_t bytes_written() const { return bytes_written_; }
+    void charge_write_cpu(std::atomic<std::uint64_t>* counter) { write_cpu_ = counter; }
+    
+    template<class MutableBufferSequence, class Handler>
+    auto async_read_some(const MutableBufferSequence& buffers, Handler&& handler) {
+        return next_.async_read_some(buffers, std::forward<Handler>(handler));
+    }
+    
+    template<class ConstBufferSequence, class Handler>
+    auto async_write_some(const ConstBufferSequence& buffers, Handler&& handler) {
+        return net::async_compose<Handler, void(beast::error_code, std::size_t)>(
+            WriteOp<ConstBufferSequence>{*this, buffers}, handler, next_);
+    }
+
+private:
+    template<class ConstBufferSequence>
+    struct WriteOp {
+        WriteOp(CountingStream& s, const ConstBufferSequence& b) : stream(s), buffers(b) {}
+        
+        CountingStream& stream;
+        ConstBufferSequence buffers;
+        bool started = false;
+        
+        template<class Self>
+        void operator()(Self& self, beast::error_code ec = {}, std::size_t n = 0) {
+            if (!started) {
+                started = true;
+                stream.next_.async_write_some(buffers, std::move(self));
+                return;
+            }
+            stream.bytes_written_ += n;
+            ThreadCpuScope cpu(stream.write_cpu_);
+            self.complete(ec, n);
+        }
+    };
+    
+    Next next_;
+    std::uint64_t bytes_written_ = 0;
+    std::atomic<std::uint64_t>* write_cpu_ = nullptr;
+};
+
+// Found by Beast through ADL when the websocket::stream closes.
+template<class Next>
+void teardown(beast::role_type role, CountingStream<Next>& stream, beast::error_code& ec) {
+    using beast::websocket::teardown;
+    teardown(role, stream.next_layer(), ec);
+}
+
+template<class Next, class TeardownHandler>
+void async_teardown(beast::role_type role, CountingStream<Next>& stream, TeardownHandler&& handler) {
+    using beast::websocket::async_teardown;
+    async_teardown(role, stream.next_layer(), std::forward<TeardownHandler>(handler));
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <boost/beast/websocket.hpp>
+#include <atomic>
+#include <cstddef>
+
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+
+// permessage-deflate settings (RFC 7692). "server" is what this process
+// compresses with; "client" is what it asks clients to compress with.
+struct DeflateOptions {
+    bool enabled = true;
+    int level = 6;                          // zlib level, 0-9
+    int mem_level = 4;                      // zlib memLevel, 1-9
+    int server_window_bits = 15;            // 9-15
+    int client_window_bits = 15;            // 9-15
+    bool server_context_takeover = true;    // keep the dictionary between messages
+    bool client_context_takeover = true;
+    std::size_t min_message_bytes = 256;    // smaller messages are sent raw
+    std::size_t memory_budget = 256 * 1024 * 1024;  // zlib state across all sessions
+};
+
+// Every session that negotiates permessage-deflate holds a deflate and an
+// inflate stream for its lifetime. This caps their combined size: once
+// the budget is spent, new sessions are accepted without the extension.
+class DeflateBudget {
+public:
+    explicit DeflateBudget(const DeflateOptions& options);
+    
+    const DeflateOptions& options() const { return options_; }
+    // zlib memory held by one compressed session under these options
+    std::size_t session_cost() const { return session_cost_; }
+    
+    bool try_acquire();
+    void release();
+    
+    // The option to set on a session's stream before accepting it.
+    websocket::permessage_deflate option(bool enable) const;
+    
+    // min_message_bytes needs permessage_deflate::msg_size_threshold,
+    // which older Beast releases lack; they compress every message.
+    static bool size_threshold_supported();
+
+private:
+    DeflateOptions options_;
+    std::size_t session_cost_;
+    std::atomic<std::size_t> in_use_;
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Bounded history of the outbound events sent to one user, each stamped
+// with a per-user sequence number. Used to replay what a client missed
+// during a short disconnect.
+class EventRing {
+public:
+    EventRing(std::size_t max_events, std::size_t max_bytes);
+    
+    // Stamps `frame` (a JSON object) with the next "seq" and keeps a copy.
+    std::uint64_t push(std::string& frame);
+    
+    // Returns false when events after `last_seq` have already been evicted.
+    bool replay_after(std::uint64_t last_seq, std::vector<std::string>& out) const;
+    
+    std::uint64_t last_seq() const { return next_seq_ - 1; }
+
+private:
+    struct Event {
+        std::uint64_t seq;
+        std::string frame;
+    };
+    
+    std::deque<Event> events_;
+    std::size_t bytes_;
+    std::size_t max_events_;
+    std::size_t max_bytes_;
+    std::uint64_t next_seq_;
+};
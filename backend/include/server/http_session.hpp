@@ -0,0 +1,66 @@
+#pragma once
+#include "session.hpp"
+#include "tls_stream.hpp"
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <chrono>
+#include <memory>
+#include <optional>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+using tcp = boost::asio::ip::tcp;
+
+class WebSocketServer;
+
+struct HttpLimits {
+    std::size_t max_concurrent_requests = 4;        // auth requests running, server-wide
+    std::size_t max_body_bytes = 16 * 1024;
+    std::chrono::milliseconds idle_timeout{15000};  // between keep-alive requests, and per response write
+};
+
+// Every accepted connection starts here. When TLS is configured, the
+// first byte decides between https/wss and plain http/ws, and the auth
+// endpoints refuse plain http. HTTP requests are served on a keep-alive
+// loop (POST /login, /register, /refresh); an upgrade request is
+// authenticated and the stream handed to a new Session.
+class HttpSession : public std::enable_shared_from_this<HttpSession> {
+public:
+    // `shard` is the IoPool shard the socket was accepted onto.
+    HttpSession(tcp::socket socket, WebSocketServer& server, std::size_t shard);
+    
+    void run();
+
+private:
+    using Request = http::request<http::string_body>;
+    using Response = http::response<http::string_body>;
+    
+    void detect_tls();
+    void on_detect_tls(beast::error_code ec);
+    void on_handshake(beast::error_code ec);
+    void do_read();
+    void on_read(beast::error_code ec, std::size_t bytes_transferred);
+    void upgrade(Request req);
+    void handle_request(Request req);
+    void write(std::shared_ptr<Response> res);
+    void on_write(bool close, beast::error_code ec, std::size_t bytes_transferred);
+    void do_close();
+    
+    void schedule_idle_check(std::chrono::milliseconds delay);
+    void on_idle_check();
+
+    template<class F>
+    void with_stream(F&& f) { std::visit(std::forward<F>(f), stream_); }
+
+    net::any_io_executor executor_;
+    ClientStream stream_;
+    WebSocketServer& server_;
+    std::size_t shard_;
+    beast::flat_buffer buffer_;
+    std::optional<http::request_parser<http::string_body>> parser_;
+    std::shared_ptr<Response> response_;  // kept alive while being written
+    std::chrono::steady_clock::time_point last_activity_;
+    bool busy_;  // a request is being handled on the workers
+    bool done_;  // closed, or handed over to a Session
+};
@@ -0,0 +1,19 @@
+#pragma once
+#include <string>
+
+// The Asio reactor this binary was built for, and whether the running
+// kernel can actually serve it. Builds configured with CHAT_IO_URING put
+// sockets on io_uring; everything else uses epoll.
+class IoBackend {
+public:
+    static const char* name();
+    
+    // Checks that io_uring can be set up here and supports every opcode
+    // Asio's backend issues. Containers often block it via seccomp, and
+    // kernel.io_uring_disabled can turn it off host-wide.
+    static bool io_uring_supported(std::string& reason);
+    
+    // Raises the soft open-files limit to the hard limit, since every
+    // connection holds a descriptor. Returns the new soft limit.
+    static unsigned long long raise_fd_limit();
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace net = boost::asio;
+
+enum class CpuPlacement {
+    None,   // threads float, as the scheduler sees fit
+    Cores,  // one shared io_context, each thread pinned to its own CPU
+    Numa    // one io_context per NUMA node, threads pinned within the node
+};
+
+struct PlacementOptions {
+    CpuPlacement mode = CpuPlacement::None;
+    std::vector<int> cpus;           // empty: every CPU the process may use
+    std::vector<int> reserved_cpus;  // never used, left to the kernel and IRQs
+    int threads = 0;                 // 0: one per usable CPU (None/Cores)
+};
+
+// The io_contexts the server runs on and the threads that run them.
+//
+// With Numa placement every node gets its own shard: an io_context whose
+// threads are pinned to that node's CPUs. A connection is accepted onto
+// one shard and never leaves it, so its session, buffers and handler
+// allocations are first touched, and stay, on one node.
+class IoPool {
+public:
+    explicit IoPool(const PlacementOptions& options);
+    
+    std::size_t size() const { return shards_.size(); }
+    net::io_context& context(std::size_t shard) { return *shards_[shard].ioc; }
+    // Round-robin shard for the next connection
+    std::size_t next_shard();
+    std::size_t thread_count() const;
+    // NUMA node of each shard; empty unless placement is Numa
+    std::vector<int> numa_nodes() const;
+    std::string describe() const;
+    
+    // Runs on every pool thread, after pinning, before any handler.
+    void set_thread_init(std::function<void(std::size_t shard)> init);
+    
+    // Runs every shard, using the calling thread as one of the workers.
+    // Returns once all of them have stopped.
+    void run();
+    void stop();
+
+private:
+    struct Shard {
+        std::unique_ptr<net::io_context> ioc;
+        // Keeps shards without an acceptor running while they are idle
+        net::executor_work_guard<net::io_context::executor_type> work;
+        int node;
+        std::vector<int> cpus;  // one entry per thread; -1 means unpinned
+    };
+    
+    void add_shard(int node, std::vector<int> cpus);
+    void run_thread(std::size_t shard, int cpu);
+    
+    CpuPlacement mode_;
+    std::vector<Shard> shards_;
+    std::function<void(std::size_t)> thread_init_;
+    std::atomic<std::size_t> next_;
+};
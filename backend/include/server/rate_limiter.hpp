@@ -0,0 +1,87 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Request classes that share a rate limit.
+enum class OperationClass {
+    Message,   // send_message, send_group_message
+    History,   // get_conversation, sync
+    Social,    // friend requests, group changes
+    Read,      // list queries
+    Count
+};
+
+struct RateLimit {
+    double per_second;
+    double burst;
+};
+
+struct RateLimits {
+    std::array<RateLimit, static_cast<std::size_t>(OperationClass::Count)> limits{{
+        {20.0, 40.0},   // Message
+        {5.0, 20.0},    // History
+        {2.0, 10.0},    // Social
+        {5.0, 20.0}     // Read
+    }};
+    std::chrono::milliseconds sync_interval{100};
+    
+    RateLimit& operator[](OperationClass op) { return limits[static_cast<std::size_t>(op)]; }
+    const RateLimit& operator[](OperationClass op) const { return limits[static_cast<std::size_t>(op)]; }
+};
+
+// Token buckets keyed by (user, operation class).
+//
+// The authoritative bucket lives in a sharded global table. Each thread
+// leases a few tokens from it into a thread-local bucket and spends them
+// without locks or atomics, returning leftovers and taking a new lease
+// once per sync interval or when the lease runs dry.
+class RateLimiter {
+public:
+    explicit RateLimiter(const RateLimits& limits);
+    
+    // Takes `count` tokens, all or none. A count above the burst is taken
+    // from a full bucket, which then refills from below zero.
+    bool try_acquire(const std::string& user_id, OperationClass op, double count = 1.0);
+    // Returns tokens taken by try_acquire on this thread, e.g. when a later
+    // check rejects the request they were taken for.
+    void refund(const std::string& user_id, OperationClass op, double count);
+    std::chrono::milliseconds retry_after(OperationClass op) const;
+    
+    static OperationClass classify(const std::string& type);
+    static const char* name(OperationClass op);
+
+private:
+    using Clock = std::chrono::steady_clock;
+    
+    struct GlobalBucket {
+        double tokens;
+        Clock::time_point refilled_at;
+        OperationClass op;
+    };
+    
+    struct LocalBucket {
+        double tokens = 0;
+        Clock::time_point sync_at{};
+    };
+    
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, GlobalBucket> buckets;
+    };
+    
+    static constexpr std::size_t kShards = 64;
+    
+    // This thread's bucket for the key, creating it.
+    LocalBucket& local_bucket(const std::string& user_id, OperationClass op, std::string& key);
+    // Leases at least `need` tokens if the global bucket has them, or if
+    // `need` is above the burst and the bucket is full.
+    void sync(const std::string& key, OperationClass op, LocalBucket& local,
+              Clock::time_point now, double need);
+    void prune(Shard& shard, Clock::time_point now);
+
+    RateLimits limits_;
+    std::array<Shard, kShards> shards_;
+};
@@ -1,8 +1,15 @@
 #pragma once
+#include "tls_stream.hpp"
+#include "counting_stream.hpp"
+#include "deflate_budget.hpp"
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
+#include <boost/json.hpp>
+#include <chrono>
+#include <deque>
 #include <memory>
 #include <string>
+#include <unordered_map>
 
 namespace beast = boost::beast;
 namespace http = beast::http;
@@ -11,26 +18,147 @@ namespace net = boost::asio;
 using tcp = boost::asio::ip::tcp;
 
 class SessionManager;
+class TimingWheel;
+
+// What a session does when its outbound queue hits a limit.
+enum class OverflowPolicy {
+    DropEphemeral,  // shed ephemeral events, disconnect if that is not enough
+    Coalesce,       // replace a queued event with the same key, then shed
+    Disconnect      // close with try_again_later as soon as a limit is hit
+};
+
+struct SessionLimits {
+    std::size_t max_queued_bytes = 4 * 1024 * 1024;
+    std::size_t max_queued_frames = 1024;
+    std::size_t read_pause_bytes = 1024 * 1024;  // stop reading above this
+    OverflowPolicy policy = OverflowPolicy::DropEphemeral;
+    std::chrono::milliseconds ping_interval{30000};  // ping after this much silence
+    std::chrono::milliseconds idle_timeout{75000};   // drop the peer after this much
+    std::size_t max_in_flight = 8;          // requests handled concurrently
+    std::size_t max_pending_requests = 64;  // stop reading above this
+    bool require_upgrade_auth = false;      // refuse upgrades without a token
+    DeflateOptions deflate;
+};
+
+// The HTTP request that asked for the upgrade, read by HttpSession.
+using UpgradeRequest = http::request<http::string_body>;
+
+// ws:// or wss://, decided before the session exists.
+using WsStream = std::variant<websocket::stream<CountingStream<tcp::socket>>,
+                              websocket::stream<CountingStream<TlsStream>>>;
+
+// Frame encoding, chosen per connection through Sec-WebSocket-Protocol.
+// JSON text frames remain the default; the binary protocol carries the
+// same documents as CBOR in binary frames.
+enum class WireFormat {
+    Json,  // "chat.json.v1", or no subprotocol
+    Cbor   // "chat.cbor.v1"
+};
+
+struct OutboundFrame {
+    std::string data;
+    bool ephemeral = false;
+    std::string coalesce_key;
+};
 
 class Session : public std::enable_shared_from_this<Session> {
 public:
-    explicit Session(tcp::socket socket, SessionManager& manager);
+    Session(ClientStream stream,
+           SessionManager& manager,
+           const SessionLimits& limits,
+           TimingWheel& wheel,
+           DeflateBudget& deflate_budget,
+           net::any_io_executor workers);
+    ~Session();
     
-    void run();
+    // Completes the handshake for `request`. A non-empty user_id means the
+    // upgrade request already carried a valid token.
+    void run(UpgradeRequest request, std::string user_id);
     void send(const std::string& message);
+    void send_ephemeral(const std::string& message, const std::string& coalesce_key = "");
     const std::string& get_user_id() const { return user_id_; }
     bool is_authenticated() const { return authenticated_; }
 
 private:
+    void on_run();
+    void negotiate_deflate();
+    void negotiate_protocol();
+    void account_deflate(std::size_t payload_bytes);
     void on_accept(beast::error_code ec);
     void do_read();
     void on_read(beast::error_code ec, std::size_t bytes_transferred);
     void on_write(beast::error_code ec, std::size_t bytes_transferred);
-    void handle_message(const std::string& message);
+    void handle_message(const std::string& message, bool binary);
+    bool encode_frame(const std::string& message, std::string& out);
+    
+    void queue_frame(OutboundFrame frame);
+    void on_queue_frame(OutboundFrame frame);
+    bool admit(OutboundFrame& frame);
+    bool fits(std::size_t extra_bytes, std::size_t extra_frames) const;
+    void shed_ephemeral();
+    void do_write();
+    void disconnect(websocket::close_code code);
+    void do_close();
+    void release();
+    
+    struct PendingRequest {
+        std::string key;
+        boost::json::object request;
+    };
+    
+    void submit_request(PendingRequest request);
+    void start_request(PendingRequest request);
+    void on_request_done(const std::string& key);
+    void maybe_resume_read();
+    
+    void schedule_heartbeat(std::chrono::milliseconds delay);
+    void on_heartbeat();
+    // Called for reads and pongs only: a completed write just means the
+    // kernel buffered the bytes, which it does for a dead peer too.
+    void touch();
 
-    websocket::stream<tcp::socket> ws_;
+    template<class F>
+    void with_ws(F&& f) { std::visit(std::forward<F>(f), ws_); }
+
+    WsStream ws_;
+    net::any_io_executor executor_;
     SessionManager& manager_;
+    SessionLimits limits_;
+    TimingWheel& wheel_;
+    DeflateBudget& deflate_budget_;
+    net::any_io_executor workers_;
     beast::flat_buffer buffer_;
+    // Only held until the WebSocket handshake completes
+    UpgradeRequest upgrade_request_;
     std::string user_id_;
     bool authenticated_;
-};
\ No newline at end of file
+    WireFormat format_;
+    
+    // Outbound queue; the front frame is the one being written.
+    std::deque<OutboundFrame> queue_;
+    std::size_t queued_bytes_;
+    bool read_paused_;
+    
+    // permessage-deflate holds a share of the global budget while granted
+    bool deflate_;
+    std::uint64_t wire_bytes_seen_;
+    
+    // Requests run on the worker pool, at most max_in_flight at a time.
+    // busy_keys_ holds the ordering keys with a request running, plus the
+    // requests queued behind it; waiting_ holds requests over the limit.
+    std::size_t in_flight_;
+    std::size_t pending_requests_;
+    std::deque<PendingRequest> waiting_;
+    std::unordered_map<std::string, std::deque<PendingRequest>> busy_keys_;
+
+    bool closing_;
+    bool close_deferred_;
+    websocket::close_code close_code_;
+    bool released_;
+    
+    // Liveness tracking, checked from the shared timing wheel
+    std::chrono::steady_clock::time_point last_activity_;
+    bool accepted_;
+    bool ping_in_flight_;
+    bool awaiting_pong_;
+};
@@ -1,30 +1,167 @@
 #pragma once
+#include "event_ring.hpp"
+#include "database/membership_index.hpp"
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/json.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <unordered_map>
 #include <string>
 #include <mutex>
+#include <vector>
 
 class Session;
+class TimingWheel;
+class ClusterNode;
+class RateLimiter;
 class MessageHandler;
 class GroupHandler;
 class FriendHandler;
+class BatchHandler;
+class InboxHandler;
+class IoPool;
+
+// How a frame addressed to a user is queued on their session.
+enum class Delivery {
+    Response,   // reply to the user's own request
+    Event,      // pushed event, sequenced for resume
+    Ephemeral   // pushed event the session may shed under backpressure
+};
+
+// How much recent event history is kept per user for session resumption.
+struct ResumeOptions {
+    std::size_t max_events = 256;
+    std::size_t max_bytes = 256 * 1024;
+    std::chrono::milliseconds grace_period{120000};  // kept this long after leave
+};
+
+// When a group event is split across I/O threads instead of being
+// delivered on the sender's.
+struct FanoutOptions {
+    std::size_t parallel_threshold = 2000;  // group size from which to split
+    std::size_t partitions = 0;             // 0: one per I/O thread
+};
 
 class SessionManager {
 public:
     SessionManager(MessageHandler& msg_handler,
                   GroupHandler& group_handler,
-                  FriendHandler& friend_handler);
+                  FriendHandler& friend_handler,
+                  BatchHandler& batch_handler,
+                  InboxHandler& inbox_handler,
+                  TimingWheel& wheel,
+                  const ResumeOptions& resume_options,
+                  RateLimiter& rate_limiter);
+    
+    // Returns the resume token the client can present after a disconnect.
+    std::string join(std::shared_ptr<Session> session, const std::string& user_id);
+    
+    // Re-attaches a reconnecting client and replays the events it missed,
+    // without touching the database. Returns false if the token is unknown,
+    // expired, or the missed events have already been evicted.
+    bool resume(std::shared_ptr<Session> session,
+               const std::string& user_id,
+               const std::string& resume_token,
+               std::uint64_t last_seq);
     
-    void join(std::shared_ptr<Session> session, const std::string& user_id);
-    void leave(const std::string& user_id);
+    // Only removes the entry if it still belongs to `session`, so a stale
+    // connection timing out cannot evict the user's newer one.
+    void leave(const std::string& user_id, const Session* session);
     void send_to_user(const std::string& user_id, const std::string& message);
-    void handle_client_message(const std::string& user_id, const std::string& message);
+    // Like send_to_user, but sequenced and kept for replay on resume.
+    void send_event_to_user(const std::string& user_id, const std::string& message);
+    // Droppable under backpressure. With OverflowPolicy::Coalesce a queued
+    // event with the same `coalesce_key` is replaced instead; notifications
+    // are keyed by the list they prompt the client to refresh
+    // ("friend_requests", "friends", "groups"), so the newest one stands in
+    // for the rest.
+    void send_ephemeral_to_user(const std::string& user_id, const std::string& message,
+                                const std::string& coalesce_key = "");
+    // Delivers one event to every member of a group. Local recipients come
+    // from intersecting the member set with the users held here, walking
+    // whichever side is smaller; with a cluster, the rest are batched into
+    // one envelope per node. Large groups are split by stripe and delivered
+    // in parallel, so this may return before delivery is done.
+    void send_to_group(const IdSetPtr& members, const std::string& message);
+    // Responses go back to `origin`, the connection that sent the request,
+    // never to another of the user's sessions or nodes.
+    void handle_client_message(const std::weak_ptr<Session>& origin,
+                               const std::string& user_id,
+                               const boost::json::object& request);
+    static std::string ordering_key(const boost::json::object& request);
+    // Whether the user is connected to this process.
     bool is_user_online(const std::string& user_id);
+    
+    // Cluster hooks: deliver a forwarded frame only to sessions in this
+    // process. An event for a user detached here counts as delivered once
+    // it is in the resume ring.
+    bool deliver_local(const std::string& user_id, const std::string& message,
+                      Delivery kind, const std::string& coalesce_key);
+    std::vector<std::string> deliver_local_many(const std::vector<std::string>& user_ids,
+                                                const std::string& message,
+                                                Delivery kind);
+    // Connected users and detached ones that can still resume here.
+    std::vector<std::string> local_users();
+    void set_cluster(ClusterNode* cluster);
+    void set_fanout(IoPool& pool, const FanoutOptions& options);
 
 private:
-    std::unordered_map<std::string, std::shared_ptr<Session>> sessions_;
-    std::mutex mutex_;
+    struct ResumeState {
+        EventRing ring;
+        std::string token;
+        bool detached;
+        std::uint64_t generation;
+    };
+    
+    // Users are spread over stripes by hash, each with its own lock, so
+    // fan-out partitions and unrelated users do not contend.
+    struct Stripe {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<Session>> sessions;
+        std::unordered_map<std::string, ResumeState> resume_states;
+    };
+    static constexpr std::size_t kStripes = 64;
+    
+    struct FanoutResult {
+        std::size_t delivered = 0;
+        std::vector<std::string> remaining;  // for the cluster
+    };
+    
+    static std::size_t stripe_index(const std::string& user_id);
+    Stripe& stripe_for(const std::string& user_id);
+    // False if the user has no resume state here.
+    bool record_event(Stripe& stripe, const std::string& user_id, std::string& frame);
+    bool deliver(const std::string& user_id, const std::string& message,
+                 Delivery kind, const std::string& coalesce_key);
+    bool deliver_locked(Stripe& stripe, const std::string& user_id, const std::string& message,
+                       Delivery kind, const std::string& coalesce_key);
+    void respond(const std::weak_ptr<Session>& origin, const std::string& user_id,
+                 std::string frame, Delivery kind);
+    void expire_resume_state(const std::string& user_id, std::uint64_t generation);
+    // `bucket` lists the members (as indexes) in this stripe; without one,
+    // the stripe's own users are looked up in `members` instead.
+    void deliver_stripe(std::size_t index, const IdSet& members,
+                        const std::vector<std::uint32_t>* bucket,
+                        const std::string& message, FanoutResult& result);
+    void finish_fanout(FanoutResult& result, const std::string& message);
+
+    std::array<Stripe, kStripes> stripes_;
+    std::atomic<std::size_t> tracked_users_;  // users with resume state
+    FanoutOptions fanout_options_;
+    // One per partition; posting every group event for a partition to the
+    // same strand keeps events in order for each recipient
+    std::vector<boost::asio::strand<boost::asio::any_io_executor>> fanout_strands_;
+    ClusterNode* cluster_;
+    TimingWheel& wheel_;
+    ResumeOptions resume_options_;
+    RateLimiter& rate_limiter_;
     MessageHandler& msg_handler_;
     GroupHandler& group_handler_;
     FriendHandler& friend_handler_;
+    BatchHandler& batch_handler_;
+    InboxHandler& inbox_handler_;
 };
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace net = boost::asio;
+
+// Hashed timing wheel driven by a single steady_timer. Scheduling and expiry
+// are O(1) per entry, so one wheel can track timeouts for every connection
+// instead of each session owning its own timer.
+//
+// Tasks run on the wheel's strand; anything touching a session must post
+// itself back onto that session's executor.
+class TimingWheel {
+public:
+    using Task = std::function<void()>;
+    
+    TimingWheel(net::io_context& ioc,
+               std::chrono::milliseconds tick,
+               std::size_t slots);
+    
+    void start();
+    void stop();
+    void schedule(std::chrono::milliseconds delay, Task task);
+    std::chrono::milliseconds tick() const { return tick_; }
+    std::size_t pending() const;
+
+private:
+    struct Entry {
+        std::size_t rounds;
+        Task task;
+    };
+    
+    void arm();
+    void on_tick(boost::system::error_code ec);
+
+    net::strand<net::io_context::executor_type> strand_;
+    net::steady_timer timer_;
+    std::chrono::milliseconds tick_;
+    std::chrono::steady_clock::time_point next_tick_;
+    std::vector<std::vector<Entry>> slots_;
+    std::size_t cursor_;
+    std::size_t pending_;
+    bool stopped_;
+    mutable std::mutex mutex_;
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <openssl/ssl.h>
+#include <chrono>
+#include <memory>
+#include <string>
+
+struct TlsOptions {
+    std::string cert_file;   // PEM chain; TLS is off when empty
+    std::string key_file;
+    bool ktls = true;        // let OpenSSL hand records to the kernel
+    bool session_tickets = true;
+    std::chrono::seconds session_lifetime{7200};
+};
+
+// Server-wide OpenSSL context for wss and https.
+class TlsContext {
+public:
+    // Returns nullptr (after logging why) if the certificate or key
+    // cannot be loaded.
+    static std::unique_ptr<TlsContext> create(const TlsOptions& options);
+    
+    ~TlsContext();
+    TlsContext(const TlsContext&) = delete;
+    TlsContext& operator=(const TlsContext&) = delete;
+    
+    // A fresh server-side SSL for one connection, owned by the caller.
+    SSL* new_ssl();
+    bool ktls_enabled() const { return ktls_enabled_; }
+
+private:
+    explicit TlsContext(SSL_CTX* ctx, bool ktls_enabled);
+    
+    SSL_CTX* ctx_;
+    bool ktls_enabled_;
+};
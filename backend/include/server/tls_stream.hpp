@@ -0,0 +1,195 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <boost/asio/ssl/error.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <cerrno>
+#include <memory>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+namespace beast = boost::beast;
+namespace net = boost::asio;
+using tcp = boost::asio::ip::tcp;
+
+// Server side of a TLS connection, with OpenSSL reading and writing the
+// socket itself. Beast's ssl_stream runs OpenSSL over memory BIOs, which
+// keeps the record layer in user space; over a socket BIO, OpenSSL moves
+// it into the kernel (kTLS) after the handshake when the context allows
+// it and the kernel supports it.
+//
+// Satisfies Beast's AsyncStream requirements, so it can sit under
+// http::async_read and websocket::stream.
+class TlsStream {
+public:
+    using executor_type = tcp::socket::executor_type;
+    using next_layer_type = tcp::socket;
+    
+    // Takes ownership of `ssl`.
+    TlsStream(tcp::socket socket, SSL* ssl);
+    
+    executor_type get_executor() { return socket_.get_executor(); }
+    tcp::socket& next_layer() { return socket_; }
+    const tcp::socket& next_layer() const { return socket_; }
+    
+    bool ktls_send() const;
+    bool ktls_recv() const;
+    bool session_reused() const;
+    
+    // Handler: void(error_code)
+    template<class Handler>
+    auto async_handshake(Handler&& handler) {
+        return net::async_compose<Handler, void(beast::error_code)>(
+            Op<HandshakeStep, false>{*this, HandshakeStep{}},
+            handler, socket_);
+    }
+    
+    template<class MutableBufferSequence, class Handler>
+    auto async_read_some(const MutableBufferSequence& buffers, Handler&& handler) {
+        return net::async_compose<Handler, void(beast::error_code, std::size_t)>(
+            Op<ReadStep, true>{*this, ReadStep{beast::buffers_front(buffers)}},
+            handler, socket_);
+    }
+    
+    template<class ConstBufferSequence, class Handler>
+    auto async_write_some(const ConstBufferSequence& buffers, Handler&& handler) {
+        return net::async_compose<Handler, void(beast::error_code, std::size_t)>(
+            Op<WriteStep, true>{*this, WriteStep{stage_write(buffers)}},
+            handler, socket_);
+    }
+    
+    // Sends close_notify if it fits in the socket buffer, then closes.
+    void shutdown(beast::error_code& ec);
+
+private:
+    struct SslDeleter {
+        void operator()(SSL* ssl) const { SSL_free(ssl); }
+    };
+    
+    // One TLS record holds at most 16 KiB of plaintext.
+    static constexpr std::size_t kMaxRecord = 16 * 1024;
+    
+    struct HandshakeStep {
+        int operator()(SSL* ssl, std::size_t&) { return SSL_accept(ssl); }
+    };
+    
+    struct ReadStep {
+        net::mutable_buffer buffer;
+        int operator()(SSL* ssl, std::size_t& n) {
+            if (buffer.size() == 0) {
+                return 1;
+            }
+            return SSL_read_ex(ssl, buffer.data(), buffer.size(), &n);
+        }
+    };
+    
+    struct WriteStep {
+        net::const_buffer buffer;
+        int operator()(SSL* ssl, std::size_t& n) {
+            if (buffer.size() == 0) {
+                return 1;
+            }
+            return SSL_write_ex(ssl, buffer.data(), buffer.size(), &n);
+        }
+    };
+    
+    // Retries one SSL call, waiting on socket readiness in between.
+    template<class Step, bool WithSize>
+    struct Op {
+        Op(TlsStream& s, Step st) : stream(s), step(st) {}
+        
+        TlsStream& stream;
+        Step step;
+        bool waited = false;
+        bool done = false;
+        beast::error_code result;
+        std::size_t transferred = 0;
+        
+        template<class Self>
+        void operator()(Self& self, beast::error_code ec = {}) {
+            if (done) {
+                return complete(self, result, transferred);
+            }
+            if (ec) {
+                return finish(self, ec, 0);
+            }
+            
+            ERR_clear_error();
+            errno = 0;
+            std::size_t n = 0;
+            int ret = step(stream.ssl_.get(), n);
+            if (ret == 1) {
+                return finish(self, {}, n);
+            }
+            
+            int err = SSL_get_error(stream.ssl_.get(), ret);
+            if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+                waited = true;
+                stream.socket_.async_wait(
+                    err == SSL_ERROR_WANT_READ ? tcp::socket::wait_read : tcp::socket::wait_write,
+                    std::move(self));
+                return;
+            }
+            finish(self, to_error_code(err), 0);
+        }
+        
+        // Handlers must not run inside the initiating call
+        template<class Self>
+        void finish(Self& self, beast::error_code ec, std::size_t n) {
+            if (waited) {
+                return complete(self, ec, n);
+            }
+            done = true;
+            result = ec;
+            transferred = n;
+            net::post(stream.get_executor(), std::move(self));
+        }
+        
+        template<class Self>
+        void complete(Self& self, beast::error_code ec, std::size_t n) {
+            if constexpr (WithSize) {
+                self.complete(ec, n);
+            } else {
+                self.complete(ec);
+            }
+        }
+    };
+    
+    // A WebSocket frame arrives as header + payload; coalesce small
+    // sequences so they leave as one record instead of two.
+    template<class ConstBufferSequence>
+    net::const_buffer stage_write(const ConstBufferSequence& buffers) {
+        auto prefix = beast::buffers_prefix(kMaxRecord, buffers);
+        auto first = beast::buffers_front(prefix);
+        std::size_t size = beast::buffer_bytes(prefix);
+        if (first.size() == size) {
+            return first;
+        }
+        write_scratch_.resize(size);
+        net::buffer_copy(net::buffer(write_scratch_), prefix);
+        return net::buffer(write_scratch_);
+    }
+    
+    static beast::error_code to_error_code(int ssl_error);
+    
+    tcp::socket socket_;
+    std::unique_ptr<SSL, SslDeleter> ssl_;
+    std::vector<char> write_scratch_;
+};
+
+// Found by Beast through ADL when a websocket::stream<TlsStream> closes.
+void teardown(beast::role_type role, TlsStream& stream, beast::error_code& ec);
+
+template<class TeardownHandler>
+void async_teardown(beast::role_type, TlsStream& stream, TeardownHandler&& handler) {
+    beast::error_code ec;
+    stream.shutdown(ec);
+    net::post(stream.get_executor(),
+              beast::bind_front_handler(std::forward<TeardownHandler>(handler), ec));
+}
+
+// An accepted connection before and after TLS detection.
+using ClientStream = std::variant<tcp::socket, TlsStream>;
@@ -1,24 +1,59 @@
 #pragma once
 #include "session_manager.hpp"
+#include "session.hpp"
+#include "http_session.hpp"
+#include "timing_wheel.hpp"
+#include "io_pool.hpp"
 #include <boost/asio.hpp>
+#include <atomic>
 #include <memory>
 
 namespace net = boost::asio;
 using tcp = boost::asio::ip::tcp;
 
+class AuthService;
+class TlsContext;
+
 class WebSocketServer {
 public:
-    WebSocketServer(net::io_context& ioc, 
+    WebSocketServer(IoPool& pool,
                    tcp::endpoint endpoint,
-                   SessionManager& manager);
+                   SessionManager& manager,
+                   AuthService& auth,
+                   TlsContext* tls,  // null for plain ws/http only
+                   const SessionLimits& limits,
+                   const HttpLimits& http_limits,
+                   TimingWheel& wheel);
     
     void run();
+    // Closes the listener; connections already accepted are left alone.
+    void stop();
+    
+    // Used by HttpSession
+    void start_websocket(ClientStream stream, UpgradeRequest request, std::string user_id,
+                         std::size_t shard);
+    bool try_begin_request();
+    void end_request();
+    AuthService& auth() { return auth_; }
+    TlsContext* tls() { return tls_; }
+    const SessionLimits& session_limits() const { return limits_; }
+    const HttpLimits& http_limits() const { return http_limits_; }
+    TimingWheel& wheel() { return wheel_; }
+    // Blocking work for a connection runs on its own shard
+    net::any_io_executor workers(std::size_t shard) { return pool_.context(shard).get_executor(); }
 
 private:
     void do_accept();
-    void on_accept(boost::system::error_code ec, tcp::socket socket);
+    void on_accept(std::size_t shard, boost::system::error_code ec, tcp::socket socket);
 
-    net::io_context& ioc_;
+    IoPool& pool_;
     tcp::acceptor acceptor_;
     SessionManager& manager_;
-};
\ No newline at end of file
+    AuthService& auth_;
+    TlsContext* tls_;
+    SessionLimits limits_;
+    HttpLimits http_limits_;
+    TimingWheel& wheel_;
+    DeflateBudget deflate_budget_;
+    std::atomic<std::size_t> active_requests_;
+};
@@ -0,0 +1,20 @@
+#pragma once
+#include <boost/json.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// CBOR (RFC 8949) for the JSON data model, used by clients that negotiate
+// the binary wire protocol. Encoding is canonical enough for round trips:
+// definite lengths, shortest integer heads, doubles as float64.
+std::string cbor_encode(const boost::json::value& value);
+
+// Accepts definite and indefinite lengths, half/single/double floats and
+// tagged items (the tag is dropped). Byte strings decode as strings.
+// Returns nullopt on malformed input, trailing bytes or nesting deeper
+// than 64 levels.
+std::optional<boost::json::value> cbor_decode(std::string_view data);
+
+// Serialized JSON frame -> CBOR. Remembers the last frame per thread, so
+// fanning one event out to many binary clients transcodes it once.
+std::optional<std::string> json_to_cbor(const std::string& json);
@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+
+// Reads runtime settings from environment variables, falling back to the
+// compiled-in defaults when a variable is unset or malformed.
+class Config {
+public:
+    static std::string get(const std::string& name, const std::string& fallback);
+    static long long get_int(const std::string& name, long long fallback);
+    static bool get_bool(const std::string& name, bool fallback);
+};
@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// CPUs of one NUMA node, restricted to those this process may use.
+struct NumaNode {
+    int id;
+    std::vector<int> cpus;
+};
+
+// Thin wrappers over sched_setaffinity, set_mempolicy and sysfs, so the
+// server needs no libnuma.
+class CpuAffinity {
+public:
+    // "0-3,8,10-11" -> {0,1,2,3,8,10,11}; empty on malformed input.
+    static std::vector<int> parse_list(const std::string& list);
+    static std::string format_list(const std::vector<int>& cpus);
+    
+    // CPUs the process is currently allowed to run on.
+    static std::vector<int> allowed_cpus();
+    
+    // Groups `cpus` by NUMA node. Machines without NUMA (or without sysfs)
+    // come back as a single node 0.
+    static std::vector<NumaNode> numa_nodes(const std::vector<int>& cpus);
+    
+    static bool pin_thread(int cpu);
+    static bool pin_thread(const std::vector<int>& cpus);
+    
+    // New allocations by the calling thread prefer `node`; -1 restores the
+    // default (the node the thread is running on).
+    static bool prefer_node(int node);
+};
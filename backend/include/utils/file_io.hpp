@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// POSIX file helpers for data that has to survive a crash.
+class FileIo {
+public:
+    // Writes all of `data`, retrying short writes. False on error (see errno).
+    static bool write_all(int fd, const std::string& data);
+    // Makes a new or renamed directory entry durable.
+    static void sync_directory(const std::string& directory);
+    // Writes `path` through a temporary file, fsync and rename.
+    static bool write_file_durably(const std::string& path, const std::string& data);
+    // CRC-32 (IEEE) of `data`, for telling torn records from whole ones.
+    static std::uint32_t crc32(const std::string& data);
+};
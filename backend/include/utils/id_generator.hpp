@@ -0,0 +1,35 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Time-ordered 64-bit ids made in-process: 41 bits of milliseconds since
+// 2024-01-01 UTC, 10 bits of node and 12 bits of sequence. Ids from one
+// generator always increase; a burst past 4096 per millisecond, or a clock
+// stepping back, borrows from the following milliseconds.
+class IdGenerator {
+public:
+    static constexpr unsigned kNodeBits = 10;
+    static constexpr unsigned kSequenceBits = 12;
+    static constexpr std::uint32_t kMaxNode = (1u << kNodeBits) - 1;
+    
+    // `node` must differ between processes writing the same tables.
+    explicit IdGenerator(std::uint32_t node);
+    
+    std::uint64_t next();
+    
+    static std::chrono::system_clock::time_point time_of(std::uint64_t id);
+    // The id as a UUID, its 64 bits first: ids sort by time whether the
+    // column holding them is uuid or text.
+    static std::string to_uuid(std::uint64_t id);
+    // time_of(id) as a UTC timestamptz literal, "YYYY-MM-DD HH:MM:SS.mmm+00".
+    static std::string to_timestamp(std::uint64_t id);
+    // Parses a timestamptz as Postgres renders it in any TimeZone, or as
+    // to_timestamp writes it; the epoch if it is not one.
+    static std::chrono::system_clock::time_point parse_timestamp(const std::string& text);
+
+private:
+    std::uint64_t node_bits_;
+    std::atomic<std::uint64_t> last_;  // milliseconds << kSequenceBits | sequence
+};
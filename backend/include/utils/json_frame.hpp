@@ -0,0 +1,7 @@
+#pragma once
+#include <string>
+
+// Inserts "name":json_value as the first member of a serialized JSON
+// object, so routing metadata can be stamped on an already-built frame
+// without parsing it again.
+void prepend_json_field(std::string& frame, const std::string& name, const std::string& json_value);
@@ -0,0 +1,15 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Process-wide named counters. Callers look a counter up once and keep the
+// reference, e.g. `static auto& dropped = Metrics::counter("x");`.
+class Metrics {
+public:
+    static std::atomic<std::uint64_t>& counter(const std::string& name);
+    static std::vector<std::pair<std::string, std::uint64_t>> snapshot();
+    static void log_snapshot();
+};
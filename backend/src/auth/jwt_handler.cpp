@@ -3,6 +3,7 @@
 #include <boost/json.hpp>
 #include <openssl/hmac.h>
 #include <openssl/evp.h>
+#include <openssl/crypto.h>
 #include <chrono>
 #include <sstream>
 #include <iomanip>
@@ -50,6 +51,36 @@ std::string base64_encode(const std::string& input) {
     return ret;
 }
 
+// Accepts both the standard and the URL-safe alphabet, padded or not.
+std::optional<std::string> base64_decode(const std::string& input) {
+    std::string ret;
+    ret.reserve(input.length() / 4 * 3 + 3);
+    
+    unsigned int bits = 0;
+    int bit_count = 0;
+    
+    for (size_t n = 0; n < input.length(); n++) {
+        char c = input[n];
+        int value;
+        if (c >= 'A' && c <= 'Z') value = c - 'A';
+        else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') value = c - '0' + 52;
+        else if (c == '+' || c == '-') value = 62;
+        else if (c == '/' || c == '_') value = 63;
+        else if (c == '=') break;
+        else return std::nullopt;
+        
+        bits = (bits << 6) | static_cast<unsigned int>(value);
+        bit_count += 6;
+        if (bit_count >= 8) {
+            bit_count -= 8;
+            ret += static_cast<char>((bits >> bit_count) & 0xff);
+        }
+    }
+    
+    return ret;
+}
+
 std::string JWTHandler::generate_token(const std::string& user_id) {
     namespace json = boost::json;
     
@@ -87,22 +118,60 @@ std::string JWTHandler::generate_token(const std::string& user_id) {
 }
 
 std::optional<std::string> JWTHandler::validate_token(const std::string& token) {
-    // Simple validation - in production, use a proper JWT library
     size_t first_dot = token.find('.');
     size_t second_dot = token.find('.', first_dot + 1);
     
-    if (first_dot == std::string::npos || second_dot == std::string::npos) {
+    if (first_dot == std::string::npos || second_dot == std::string::npos ||
+        token.find('.', second_dot + 1) != std::string::npos) {
         return std::nullopt;
     }
     
+    std::string header_encoded = token.substr(0, first_dot);
     std::string payload_encoded = token.substr(first_dot + 1, second_dot - first_dot - 1);
     
-    // Decode payload (simplified)
+    auto signature = base64_decode(token.substr(second_dot + 1));
+    if (!signature) {
+        return std::nullopt;
+    }
+    
+    // Recompute the signature over header.payload and compare in constant time
+    std::string message = token.substr(0, second_dot);
+    unsigned char hmac_result[EVP_MAX_MD_SIZE];
+    unsigned int hmac_len;
+    
+    HMAC(EVP_sha256(), secret_.c_str(), secret_.length(),
+         reinterpret_cast<const unsigned char*>(message.c_str()), message.length(),
+         hmac_result, &hmac_len);
+    
+    if (signature->size() != hmac_len ||
+        CRYPTO_memcmp(signature->data(), hmac_result, hmac_len) != 0) {
+        return std::nullopt;
+    }
+    
     try {
         namespace json = boost::json;
-        // In production, properly decode base64 and verify signature
-        // For now, we'll accept the token format
-        return "user_id_from_token"; // Simplified
+        
+        auto header_str = base64_decode(header_encoded);
+        auto payload_str = base64_decode(payload_encoded);
+        if (!header_str || !payload_str) {
+            return std::nullopt;
+        }
+        
+        // Only accept the algorithm we sign with
+        auto header = json::parse(*header_str).as_object();
+        if (std::string(header.at("alg").as_string().c_str()) != "HS256") {
+            return std::nullopt;
+        }
+        
+        auto payload = json::parse(*payload_str).as_object();
+        auto exp_time = payload.at("exp").to_number<long long>();
+        auto now = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        if (now >= exp_time) {
+            return std::nullopt;
+        }
+        
+        return std::string(payload.at("user_id").as_string().c_str());
     } catch (...) {
         return std::nullopt;
     }
@@ -0,0 +1,356 @@
+// src/cluster/cluster_node.cpp
+#include "cluster/cluster_node.hpp"
+#include "server/session_manager.hpp"
+#include "database/membership_index.hpp"
+#include "utils/logger.hpp"
+#include "utils/metrics.hpp"
+
+namespace {
+// origin -> owner -> holder; anything beyond that is a routing loop
+constexpr int kMaxHops = 2;
+}
+
+ClusterNode::ClusterNode(net::io_context& ioc,
+                         const ClusterOptions& options,
+                         SessionManager& manager)
+    : ioc_(ioc)
+    , node_id_(options.node_id)
+    , acceptor_(ioc)
+    , secret_(options.secret)
+    , manager_(manager)
+    , membership_(nullptr) {
+    
+    ring_.add(node_id_);
+    
+    for (const auto& peer : options.peers) {
+        links_[peer.node_id] = std::make_shared<PeerLink>(
+            ioc, node_id_, peer.node_id, peer.endpoint, secret_,
+            [this](const std::string& peer_id, bool up) { on_link_state(peer_id, up); }
+        );
+        peers_by_address_[peer.endpoint.address().to_string()].push_back(peer.node_id);
+    }
+    
+    boost::system::error_code ec;
+    acceptor_.open(options.listen.protocol(), ec);
+    if (!ec) acceptor_.set_option(net::socket_base::reuse_address(true), ec);
+    if (!ec) acceptor_.bind(options.listen, ec);
+    if (!ec) acceptor_.listen(net::socket_base::max_listen_connections, ec);
+    if (ec) {
+        Logger::get()->error("Failed to open cluster listener: {}", ec.message());
+        throw boost::system::system_error(ec);
+    }
+    
+    Logger::get()->info("Cluster node {} listening on {}:{} with {} peers",
+                       node_id_,
+                       options.listen.address().to_string(),
+                       options.listen.port(),
+                       links_.size());
+}
+
+void ClusterNode::start() {
+    do_accept();
+    for (auto& [peer_id, link] : links_) {
+        link->start();
+    }
+}
+
+void ClusterNode::stop() {
+    boost::system::error_code ec;
+    acceptor_.close(ec);
+    for (auto& [peer_id, link] : links_) {
+        link->stop();
+    }
+}
+
+void ClusterNode::do_accept() {
+    acceptor_.async_accept(
+        net::make_strand(ioc_),
+        [this](boost::system::error_code ec, tcp::socket socket) {
+            if (ec == net::error::operation_aborted) {
+                return;
+            }
+            if (ec) {
+                Logger::get()->error("Cluster accept error: {}", ec.message());
+                do_accept();
+                return;
+            }
+            
+            boost::system::error_code endpoint_ec;
+            auto remote = socket.remote_endpoint(endpoint_ec);
+            auto peers = endpoint_ec
+                ? peers_by_address_.end()
+                : peers_by_address_.find(remote.address().to_string());
+            if (peers == peers_by_address_.end()) {
+                static auto& rejected = Metrics::counter("cluster.connections_rejected");
+                rejected.fetch_add(1, std::memory_order_relaxed);
+                Logger::get()->warn("Rejected cluster connection from {}",
+                                   endpoint_ec ? endpoint_ec.message() : remote.address().to_string());
+                socket.close(endpoint_ec);
+            } else {
+                std::make_shared<PeerConnection>(
+                    std::move(socket), secret_, peers->second,
+                    [this](const std::string& peer_id, const std::string& envelope) {
+                        on_envelope(peer_id, envelope);
+                    }
+                )->start();
+            }
+            do_accept();
+        }
+    );
+}
+
+void ClusterNode::on_link_state(const std::string& peer_id, bool up) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (up) {
+            ring_.add(peer_id);
+        } else {
+            ring_.remove(peer_id);
+        }
+        
+        // Drop records for users we no longer own or whose node went away
+        for (auto it = presence_.begin(); it != presence_.end();) {
+            if (it->second == peer_id && !up) {
+                it = presence_.erase(it);
+            } else if (ring_.owner(it->first) != node_id_) {
+                it = presence_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    
+    // Ownership moved, so tell the new owners about our connections
+    reannounce_local_users();
+    
+    if (membership_) {
+        membership_->clear();
+    }
+}
+
+std::string ClusterNode::next_hop(const std::string& user_id) const {
+    std::string owner = ring_.owner(user_id);
+    if (owner != node_id_) {
+        return owner;
+    }
+    
+    auto it = presence_.find(user_id);
+    if (it == presence_.end() || it->second == node_id_) {
+        return "";
+    }
+    return it->second;
+}
+
+void ClusterNode::send_to_node(const std::string& node_id, const boost::json::object& envelope) {
+    auto it = links_.find(node_id);
+    if (it != links_.end()) {
+        it->second->send(boost::json::serialize(envelope));
+    }
+}
+
+void ClusterNode::announce(const std::string& user_id, bool online) {
+    std::string owner;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        owner = ring_.owner(user_id);
+        if (owner == node_id_) {
+            if (online) {
+                presence_[user_id] = node_id_;
+            } else {
+                auto it = presence_.find(user_id);
+                if (it != presence_.end() && it->second == node_id_) {
+                    presence_.erase(it);
+                }
+            }
+            return;
+        }
+    }
+    
+    namespace json = boost::json;
+    json::array users;
+    users.push_back(json::value(user_id));
+    
+    json::object envelope;
+    envelope["op"] = "presence";
+    envelope["node"] = node_id_;
+    envelope["online"] = online;
+    envelope["users"] = users;
+    send_to_node(owner, envelope);
+}
+
+void ClusterNode::reannounce_local_users() {
+    namespace json = boost::json;
+    
+    auto users = manager_.local_users();
+    std::unordered_map<std::string, json::array> by_owner;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& user_id : users) {
+            std::string owner = ring_.owner(user_id);
+            if (owner == node_id_) {
+                presence_[user_id] = node_id_;
+            } else {
+                by_owner[owner].push_back(json::value(user_id));
+            }
+        }
+    }
+    
+    for (auto& [owner, owned_users] : by_owner) {
+        json::object envelope;
+        envelope["op"] = "presence";
+        envelope["node"] = node_id_;
+        envelope["online"] = true;
+        envelope["users"] = std::move(owned_users);
+        send_to_node(owner, envelope);
+    }
+}
+
+void ClusterNode::route(const std::string& user_id,
+                        const std::string& frame,
+                        Delivery kind,
+                        const std::string& coalesce_key,
+                        int hops) {
+    static auto& forwarded = Metrics::counter("cluster.deliveries_forwarded");
+    static auto& looped = Metrics::counter("cluster.deliveries_dropped_hops");
+    
+    if (hops >= kMaxHops) {
+        looped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    
+    std::string hop;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        hop = next_hop(user_id);
+    }
+    if (hop.empty()) {
+        return;
+    }
+    
+    namespace json = boost::json;
+    json::object envelope;
+    envelope["op"] = "deliver";
+    envelope["user"] = user_id;
+    envelope["frame"] = frame;
+    envelope["kind"] = static_cast<int>(kind);
+    envelope["key"] = coalesce_key;
+    envelope["hops"] = hops + 1;
+    send_to_node(hop, envelope);
+    
+    forwarded.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ClusterNode::route_many(const std::vector<std::string>& user_ids,
+                             const std::string& frame,
+                             Delivery kind,
+                             int hops) {
+    static auto& fanouts = Metrics::counter("cluster.fanouts_forwarded");
+    
+    if (user_ids.empty() || hops >= kMaxHops) {
+        return;
+    }
+    
+    namespace json = boost::json;
+    
+    // One envelope per next hop instead of one per recipient
+    std::unordered_map<std::string, json::array> by_hop;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& user_id : user_ids) {
+            std::string hop = next_hop(user_id);
+            if (!hop.empty()) {
+                by_hop[hop].push_back(json::value(user_id));
+            }
+        }
+    }
+    
+    for (auto& [hop, users] : by_hop) {
+        json::object envelope;
+        envelope["op"] = "fanout";
+        envelope["users"] = std::move(users);
+        envelope["frame"] = frame;
+        envelope["kind"] = static_cast<int>(kind);
+        envelope["hops"] = hops + 1;
+        send_to_node(hop, envelope);
+        fanouts.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void ClusterNode::set_membership_index(MembershipIndex* index) {
+    membership_ = index;
+}
+
+void ClusterNode::publish_membership(const std::string& group_id,
+                                     const std::string& user_id,
+                                     bool added) {
+    boost::json::object envelope;
+    envelope["op"] = "membership";
+    envelope["group"] = group_id;
+    envelope["user"] = user_id;
+    envelope["added"] = added;
+    for (const auto& [peer_id, link] : links_) {
+        send_to_node(peer_id, envelope);
+    }
+}
+
+void ClusterNode::on_envelope(const std::string& peer_id, const std::string& envelope) {
+    try {
+        namespace json = boost::json;
+        auto parsed = json::parse(envelope);
+        auto& obj = parsed.as_object();
+        
+        std::string op = obj.at("op").as_string().c_str();
+        
+        if (op == "presence") {
+            std::string node = obj.at("node").as_string().c_str();
+            bool online = obj.at("online").as_bool();
+            
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& user : obj.at("users").as_array()) {
+                std::string user_id = user.as_string().c_str();
+                if (online) {
+                    presence_[user_id] = node;
+                } else {
+                    auto it = presence_.find(user_id);
+                    if (it != presence_.end() && it->second == node) {
+                        presence_.erase(it);
+                    }
+                }
+            }
+            
+        } else if (op == "deliver") {
+            std::string user_id = obj.at("user").as_string().c_str();
+            std::string frame = obj.at("frame").as_string().c_str();
+            auto kind = static_cast<Delivery>(obj.at("kind").to_number<int>());
+            std::string coalesce_key = obj.at("key").as_string().c_str();
+            int hops = obj.at("hops").to_number<int>();
+            
+            if (!manager_.deliver_local(user_id, frame, kind, coalesce_key)) {
+                route(user_id, frame, kind, coalesce_key, hops);
+            }
+            
+        } else if (op == "fanout") {
+            std::string frame = obj.at("frame").as_string().c_str();
+            auto kind = static_cast<Delivery>(obj.at("kind").to_number<int>());
+            int hops = obj.at("hops").to_number<int>();
+            
+            std::vector<std::string> user_ids;
+            for (const auto& user : obj.at("users").as_array()) {
+                user_ids.push_back(user.as_string().c_str());
+            }
+            
+            auto remaining = manager_.deliver_local_many(user_ids, frame, kind);
+            route_many(remaining, frame, kind, hops);
+            
+        } else if (op == "membership") {
+            if (membership_) {
+                membership_->apply(obj.at("group").as_string().c_str(),
+                                   obj.at("user").as_string().c_str(),
+                                   obj.at("added").as_bool());
+            }
+        }
+        
+    } catch (const std::exception& e) {
+        Logger::get()->error("Invalid cluster envelope from {}: {}", peer_id, e.what());
+    }
+}
@@ -0,0 +1,49 @@
+// src/cluster/hash_ring.cpp
+#include "cluster/hash_ring.hpp"
+
+HashRing::HashRing(std::size_t virtual_nodes)
+    : virtual_nodes_(virtual_nodes > 0 ? virtual_nodes : 1) {
+}
+
+std::uint64_t HashRing::hash(std::string_view key) {
+    // FNV-1a followed by a 64-bit finalizer; stable across processes
+    std::uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : key) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+void HashRing::add(const std::string& node_id) {
+    for (std::size_t i = 0; i < virtual_nodes_; ++i) {
+        ring_[hash(node_id + "#" + std::to_string(i))] = node_id;
+    }
+}
+
+void HashRing::remove(const std::string& node_id) {
+    for (auto it = ring_.begin(); it != ring_.end();) {
+        if (it->second == node_id) {
+            it = ring_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::string HashRing::owner(std::string_view key) const {
+    if (ring_.empty()) {
+        return "";
+    }
+    
+    auto it = ring_.lower_bound(hash(key));
+    if (it == ring_.end()) {
+        it = ring_.begin();
+    }
+    return it->second;
+}
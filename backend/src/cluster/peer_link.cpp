@@ -0,0 +1,357 @@
+// src/cluster/peer_link.cpp
+#include "cluster/peer_link.hpp"
+#include "utils/logger.hpp"
+#include "utils/metrics.hpp"
+#include <boost/json.hpp>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+// Envelopes queued for a peer beyond this are dropped rather than buffered
+constexpr std::size_t kMaxPendingBytes = 64 * 1024 * 1024;
+constexpr std::chrono::milliseconds kMinBackoff{200};
+constexpr std::chrono::milliseconds kMaxBackoff{5000};
+// A challenge is far smaller; anything bigger is not a peer
+constexpr std::size_t kMaxChallengeBytes = 1024;
+
+std::string to_hex(const unsigned char* bytes, std::size_t size) {
+    std::stringstream ss;
+    for (std::size_t i = 0; i < size; ++i) {
+        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(bytes[i]);
+    }
+    return ss.str();
+}
+
+std::size_t decode_length(const unsigned char* header) {
+    return (static_cast<std::size_t>(header[0]) << 24) |
+           (static_cast<std::size_t>(header[1]) << 16) |
+           (static_cast<std::size_t>(header[2]) << 8) |
+           static_cast<std::size_t>(header[3]);
+}
+
+void append_envelope(std::string& buffer, const std::string& envelope) {
+    std::uint32_t length = static_cast<std::uint32_t>(envelope.size());
+    char header[4] = {
+        static_cast<char>((length >> 24) & 0xff),
+        static_cast<char>((length >> 16) & 0xff),
+        static_cast<char>((length >> 8) & 0xff),
+        static_cast<char>(length & 0xff)
+    };
+    buffer.append(header, sizeof(header));
+    buffer.append(envelope);
+}
+}
+
+std::string hello_proof(const std::string& secret, const std::string& challenge,
+                        const std::string& node_id) {
+    std::string message = challenge + ":" + node_id;
+    unsigned char mac[EVP_MAX_MD_SIZE];
+    unsigned int mac_len = 0;
+    HMAC(EVP_sha256(), secret.data(), static_cast<int>(secret.size()),
+         reinterpret_cast<const unsigned char*>(message.data()), message.size(),
+         mac, &mac_len);
+    return to_hex(mac, mac_len);
+}
+
+PeerLink::PeerLink(net::io_context& ioc,
+                   std::string self_id,
+                   std::string peer_id,
+                   tcp::endpoint endpoint,
+                   std::string secret,
+                   StateHandler on_state)
+    : strand_(net::make_strand(ioc))
+    , socket_(strand_)
+    , retry_timer_(strand_)
+    , self_id_(std::move(self_id))
+    , peer_id_(std::move(peer_id))
+    , endpoint_(endpoint)
+    , secret_(std::move(secret))
+    , on_state_(std::move(on_state))
+    , backoff_(kMinBackoff)
+    , up_(false)
+    , connecting_(false)
+    , stopped_(false) {
+}
+
+void PeerLink::start() {
+    net::dispatch(strand_, [self = shared_from_this()] { self->do_connect(); });
+}
+
+void PeerLink::stop() {
+    net::dispatch(strand_, [self = shared_from_this()] {
+        self->stopped_ = true;
+        self->retry_timer_.cancel();
+        boost::system::error_code ec;
+        self->socket_.close(ec);
+    });
+}
+
+void PeerLink::send(const std::string& envelope) {
+    net::post(strand_, [self = shared_from_this(), envelope] {
+        static auto& sent = Metrics::counter("cluster.envelopes_sent");
+        static auto& dropped = Metrics::counter("cluster.envelopes_dropped");
+        
+        if (!self->up_ || self->pending_.size() + envelope.size() > kMaxPendingBytes) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        
+        append_envelope(self->pending_, envelope);
+        sent.fetch_add(1, std::memory_order_relaxed);
+        
+        if (self->writing_.empty()) {
+            self->flush();
+        }
+    });
+}
+
+void PeerLink::do_connect() {
+    if (stopped_ || connecting_) {
+        return;
+    }
+    connecting_ = true;
+    
+    socket_.async_connect(endpoint_, [self = shared_from_this()](boost::system::error_code ec) {
+        self->on_connect(ec);
+    });
+}
+
+void PeerLink::on_connect(boost::system::error_code ec) {
+    connecting_ = false;
+    if (ec) {
+        on_failure(ec);
+        return;
+    }
+    
+    boost::system::error_code opt_ec;
+    socket_.set_option(tcp::no_delay(true), opt_ec);
+    read_challenge();
+}
+
+void PeerLink::read_challenge() {
+    net::async_read(
+        socket_,
+        net::buffer(header_),
+        [self = shared_from_this()](boost::system::error_code ec, std::size_t) {
+            if (ec) {
+                self->on_failure(ec);
+                return;
+            }
+            std::size_t length = decode_length(self->header_);
+            if (length > kMaxChallengeBytes) {
+                self->on_failure(net::error::message_size);
+                return;
+            }
+            
+            self->challenge_.resize(length);
+            net::async_read(
+                self->socket_,
+                net::buffer(self->challenge_),
+                [self](boost::system::error_code read_ec, std::size_t) {
+                    if (read_ec) {
+                        self->on_failure(read_ec);
+                        return;
+                    }
+                    self->on_challenge(self->challenge_);
+                }
+            );
+        }
+    );
+}
+
+void PeerLink::on_challenge(const std::string& challenge) {
+    namespace json = boost::json;
+    std::string nonce;
+    try {
+        auto envelope = json::parse(challenge).as_object();
+        std::string op = envelope.at("op").as_string().c_str();
+        if (op != "challenge") {
+            throw std::runtime_error("expected challenge");
+        }
+        nonce = envelope.at("nonce").as_string().c_str();
+    } catch (const std::exception& e) {
+        Logger::get()->error("Invalid cluster challenge from {}: {}", peer_id_, e.what());
+        on_failure(net::error::connection_refused);
+        return;
+    }
+    backoff_ = kMinBackoff;
+    
+    // Identify ourselves before anything else goes out
+    json::object hello;
+    hello["op"] = "hello";
+    hello["node"] = self_id_;
+    hello["proof"] = hello_proof(secret_, nonce, self_id_);
+    pending_.clear();
+    append_envelope(pending_, json::serialize(hello));
+    
+    up_ = true;
+    Logger::get()->info("Cluster link to {} established", peer_id_);
+    on_state_(peer_id_, true);
+    
+    flush();
+}
+
+void PeerLink::on_failure(boost::system::error_code ec) {
+    bool was_up = up_.exchange(false);
+    pending_.clear();
+    writing_.clear();
+    
+    boost::system::error_code close_ec;
+    socket_.close(close_ec);
+    
+    if (was_up) {
+        Logger::get()->warn("Cluster link to {} lost: {}", peer_id_, ec.message());
+        on_state_(peer_id_, false);
+    }
+    
+    if (stopped_) {
+        return;
+    }
+    
+    retry_timer_.expires_after(backoff_);
+    backoff_ = std::min(backoff_ * 2, kMaxBackoff);
+    retry_timer_.async_wait([self = shared_from_this()](boost::system::error_code wait_ec) {
+        if (!wait_ec) {
+            self->do_connect();
+        }
+    });
+}
+
+void PeerLink::flush() {
+    if (pending_.empty() || !writing_.empty()) {
+        return;
+    }
+    
+    writing_.swap(pending_);
+    net::async_write(
+        socket_,
+        net::buffer(writing_),
+        [self = shared_from_this()](boost::system::error_code ec, std::size_t bytes) {
+            self->on_write(ec, bytes);
+        }
+    );
+}
+
+void PeerLink::on_write(boost::system::error_code ec, std::size_t) {
+    if (ec) {
+        on_failure(ec);
+        return;
+    }
+    
+    writing_.clear();
+    flush();
+}
+
+PeerConnection::PeerConnection(tcp::socket socket,
+                               std::string secret,
+                               std::vector<std::string> allowed_nodes,
+                               EnvelopeHandler on_envelope)
+    : socket_(std::move(socket))
+    , secret_(std::move(secret))
+    , allowed_nodes_(std::move(allowed_nodes))
+    , on_envelope_(std::move(on_envelope)) {
+}
+
+void PeerConnection::start() {
+    unsigned char bytes[16];
+    if (RAND_bytes(bytes, sizeof(bytes)) != 1) {
+        Logger::get()->error("Cluster challenge unavailable: RAND_bytes failed");
+        return;
+    }
+    challenge_ = to_hex(bytes, sizeof(bytes));
+    
+    boost::json::object envelope;
+    envelope["op"] = "challenge";
+    envelope["nonce"] = challenge_;
+    auto frame = std::make_shared<std::string>();
+    append_envelope(*frame, boost::json::serialize(envelope));
+    
+    net::async_write(
+        socket_,
+        net::buffer(*frame),
+        [self = shared_from_this(), frame](boost::system::error_code ec, std::size_t) {
+            if (!ec) {
+                self->read_header();
+            }
+        }
+    );
+}
+
+bool PeerConnection::accept_hello() {
+    try {
+        auto hello = boost::json::parse(body_).as_object();
+        std::string op = hello.at("op").as_string().c_str();
+        if (op != "hello") {
+            throw std::runtime_error("expected hello");
+        }
+        std::string node = hello.at("node").as_string().c_str();
+        std::string proof = hello.at("proof").as_string().c_str();
+        
+        std::string expected = hello_proof(secret_, challenge_, node);
+        if (proof.size() != expected.size() ||
+            CRYPTO_memcmp(proof.data(), expected.data(), expected.size()) != 0) {
+            throw std::runtime_error("bad proof for " + node);
+        }
+        if (std::find(allowed_nodes_.begin(), allowed_nodes_.end(), node) == allowed_nodes_.end()) {
+            throw std::runtime_error(node + " is not a peer at this address");
+        }
+        peer_id_ = std::move(node);
+        Logger::get()->info("Cluster connection from {} accepted", peer_id_);
+        return true;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Invalid cluster handshake: {}", e.what());
+        return false;
+    }
+}
+
+void PeerConnection::read_header() {
+    net::async_read(
+        socket_,
+        net::buffer(header_),
+        [self = shared_from_this()](boost::system::error_code ec, std::size_t) {
+            if (ec) {
+                if (!self->peer_id_.empty()) {
+                    Logger::get()->info("Cluster connection from {} closed", self->peer_id_);
+                }
+                return;
+            }
+            
+            std::size_t length = decode_length(self->header_);
+            // Until the hello is accepted, only something hello-sized is read
+            std::size_t limit = self->peer_id_.empty() ? kMaxChallengeBytes : kMaxEnvelopeBytes;
+            if (length > limit) {
+                Logger::get()->error("Cluster envelope too large ({} bytes), dropping link", length);
+                return;
+            }
+            self->read_body(length);
+        }
+    );
+}
+
+void PeerConnection::read_body(std::size_t length) {
+    body_.resize(length);
+    net::async_read(
+        socket_,
+        net::buffer(body_),
+        [self = shared_from_this()](boost::system::error_code ec, std::size_t) {
+            if (ec) {
+                return;
+            }
+            
+            if (self->peer_id_.empty()) {
+                if (!self->accept_hello()) {
+                    return;
+                }
+            } else {
+                self->on_envelope_(self->peer_id_, self->body_);
+            }
+            
+            self->read_header();
+        }
+    );
+}
@@ -1,24 +1,140 @@
 // src/database/database.cpp
 #include "database/database.hpp"
+#include "database/migrations.hpp"
+#include "utils/cpu_affinity.hpp"
 #include "utils/logger.hpp"
+#include <algorithm>
 
-Database::Database(const std::string& connection_string) {
+namespace {
+thread_local std::size_t thread_partition = 0;
+
+// Key of the advisory lock that serializes migration runs across nodes
+constexpr long long kMigrationLockKey = 0x63686174;  // "chat"
+
+// Session-level advisory lock, held until destruction. If the unlock
+// fails the connection is broken, and its session's locks are gone anyway.
+class AdvisoryLock {
+public:
+    AdvisoryLock(pqxx::connection& conn, long long key)
+        : conn_(conn)
+        , key_(key) {
+        pqxx::nontransaction(conn_).exec_params("SELECT pg_advisory_lock($1)", key_);
+    }
+    
+    ~AdvisoryLock() {
+        try {
+            pqxx::nontransaction(conn_).exec_params("SELECT pg_advisory_unlock($1)", key_);
+        } catch (const std::exception&) {
+        }
+    }
+    
+    AdvisoryLock(const AdvisoryLock&) = delete;
+    AdvisoryLock& operator=(const AdvisoryLock&) = delete;
+
+private:
+    pqxx::connection& conn_;
+    long long key_;
+};
+}
+
+Database::Connection::Connection(Database& db, std::unique_ptr<pqxx::connection> conn,
+                                 std::size_t partition)
+    : db_(&db)
+    , conn_(std::move(conn))
+    , partition_(partition) {
+}
+
+Database::Connection::Connection(Connection&& other) noexcept
+    : db_(other.db_)
+    , conn_(std::move(other.conn_))
+    , partition_(other.partition_) {
+}
+
+Database::Connection::~Connection() {
+    if (conn_) {
+        db_->release(std::move(conn_), partition_);
+    }
+}
+
+Database::Database(const std::string& connection_string, std::size_t pool_size,
+                   const std::vector<int>& numa_nodes)
+    : connection_string_(connection_string)
+    , pool_size_(std::max<std::size_t>({pool_size, numa_nodes.size(), 1}))
+    , idle_(std::max<std::size_t>(numa_nodes.size(), 1))
+    , idle_count_(0) {
     try {
-        conn_ = std::make_unique<pqxx::connection>(connection_string);
-        Logger::get()->info("Database connection established");
+        for (std::size_t p = 0; p < idle_.size(); ++p) {
+            // libpq's buffers land on the node whose threads will use them
+            if (!numa_nodes.empty()) {
+                CpuAffinity::prefer_node(numa_nodes[p]);
+            }
+            std::size_t count = pool_size_ / idle_.size() + (p < pool_size_ % idle_.size() ? 1 : 0);
+            for (std::size_t i = 0; i < count; ++i) {
+                idle_[p].push_back(std::make_unique<pqxx::connection>(connection_string_));
+                ++idle_count_;
+            }
+        }
+        if (!numa_nodes.empty()) {
+            CpuAffinity::prefer_node(-1);
+        }
+        Logger::get()->info("Database connection pool established ({} connections, {} partitions)",
+                           pool_size_, idle_.size());
     } catch (const std::exception& e) {
         Logger::get()->error("Database connection failed: {}", e.what());
         throw;
     }
 }
 
-pqxx::connection& Database::get_connection() {
-    return *conn_;
+void Database::set_thread_partition(std::size_t partition) {
+    thread_partition = partition;
+}
+
+Database::Connection Database::acquire() {
+    std::unique_ptr<pqxx::connection> conn;
+    std::size_t partition = thread_partition % idle_.size();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        available_.wait(lock, [this] { return idle_count_ > 0; });
+        if (idle_[partition].empty()) {
+            partition = 0;
+            while (idle_[partition].empty()) ++partition;
+        }
+        conn = std::move(idle_[partition].back());
+        idle_[partition].pop_back();
+        --idle_count_;
+    }
+    
+    // Replace connections the server dropped while they sat idle
+    if (!conn->is_open()) {
+        Logger::get()->warn("Reconnecting dropped database connection");
+        try {
+            conn = std::make_unique<pqxx::connection>(connection_string_);
+        } catch (...) {
+            release(std::move(conn), partition);
+            throw;
+        }
+    }
+    
+    return Connection(*this, std::move(conn), partition);
+}
+
+std::unique_ptr<Transaction> Database::begin() {
+    return std::make_unique<PgTransaction>(acquire());
+}
+
+void Database::release(std::unique_ptr<pqxx::connection> conn, std::size_t partition) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_[partition].push_back(std::move(conn));
+        ++idle_count_;
+    }
+    available_.notify_one();
 }
 
 bool Database::test_connection() {
     try {
-        pqxx::work txn(*conn_);
+        auto conn = acquire();
+        pqxx::work txn(*conn);
         txn.exec("SELECT 1");
         txn.commit();
         return true;
@@ -28,4 +144,72 @@ bool Database::test_connection() {
     }
 }
 
+bool Database::migrate() {
+    try {
+        auto conn = acquire();
+        // Nodes starting together wait here; the later ones then find the
+        // migrations applied
+        AdvisoryLock lock(*conn, kMigrationLockKey);
+        
+        pqxx::work setup(*conn);
+        setup.exec(
+            "CREATE TABLE IF NOT EXISTS schema_migrations ("
+            "  version INTEGER PRIMARY KEY,"
+            "  description TEXT NOT NULL,"
+            "  applied_at TIMESTAMPTZ NOT NULL DEFAULT CURRENT_TIMESTAMP)"
+        );
+        auto result = setup.exec("SELECT COALESCE(MAX(version), 0) FROM schema_migrations");
+        int current = result[0][0].as<int>();
+        setup.commit();
+        
+        for (const auto& migration : schema_migrations()) {
+            if (migration.version <= current) {
+                continue;
+            }
+            
+            pqxx::work txn(*conn);
+            txn.exec(migration.sql);
+            txn.exec_params(
+                "INSERT INTO schema_migrations (version, description) VALUES ($1, $2)",
+                migration.version, std::string(migration.description)
+            );
+            txn.commit();
+            
+            Logger::get()->info("Applied migration {}: {}", migration.version, migration.description);
+        }
+        return true;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Database migration failed: {}", e.what());
+        return false;
+    }
+}
+
+PgTransaction::PgTransaction(Database::Connection conn)
+    : conn_(std::move(conn))
+    , work_(*conn_) {
+}
+
+void PgTransaction::savepoint(const std::function<void()>& step) {
+    step_.emplace(work_);
+    try {
+        step();
+    } catch (...) {
+        // Aborting the subtransaction rolls back to the savepoint
+        step_.reset();
+        throw;
+    }
+    step_->commit();
+    step_.reset();
+}
+
+void PgTransaction::commit() {
+    work_.commit();
+}
 
+pqxx::transaction_base& PgTransaction::work(Transaction& txn) {
+    auto& pg = static_cast<PgTransaction&>(txn);
+    if (pg.step_) {
+        return *pg.step_;
+    }
+    return pg.work_;
+}
@@ -0,0 +1,737 @@
+// src/database/embedded_repositories.cpp
+#include "database/embedded_repositories.hpp"
+#include "utils/logger.hpp"
+#include <algorithm>
+#include <cctype>
+#include <queue>
+#include <tuple>
+
+namespace {
+// Inbox rows carry the start of the last message, not all of it
+constexpr std::size_t kInboxPreviewChars = 200;
+constexpr std::size_t kSearchLimit = 20;
+
+std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+// The first `chars` UTF-8 characters, as LEFT() counts them
+std::string utf8_prefix(const std::string& text, std::size_t chars) {
+    std::size_t pos = 0;
+    for (std::size_t seen = 0; pos < text.size(); ++pos) {
+        bool continuation = (static_cast<unsigned char>(text[pos]) & 0xC0) == 0x80;
+        if (!continuation && seen++ == chars) {
+            break;
+        }
+    }
+    return text.substr(0, pos);
+}
+
+const EmbeddedTables::Conversation* find_conversation(const EmbeddedTables& tables,
+                                                      const std::string& key) {
+    auto it = tables.conversations.find(key);
+    return it == tables.conversations.end() ? nullptr : &it->second;
+}
+
+Message view_message(const EmbeddedTables& tables, const std::string& message_id) {
+    const auto* stored = tables.find_message(message_id);
+    return tables.conversations.at(tables.message_locations.at(message_id).first).view(*stored);
+}
+
+// Index of the first message with seq >= `seq`
+std::size_t seq_position(const EmbeddedTables::Conversation& conversation, std::uint64_t seq) {
+    const auto& messages = conversation.messages;
+    auto it = std::lower_bound(messages.begin(), messages.end(), seq,
+        [](const EmbeddedTables::StoredMessage& m, std::uint64_t s) { return m.message.seq < s; });
+    return static_cast<std::size_t>(it - messages.begin());
+}
+
+std::size_t to_limit(int limit) {
+    return limit > 0 ? static_cast<std::size_t>(limit) : 0;
+}
+}
+
+EmbeddedUserRepository::EmbeddedUserRepository(EmbeddedStore& store, IdGenerator& ids)
+    : store_(store)
+    , ids_(ids) {
+}
+
+std::optional<User> EmbeddedUserRepository::create_user(
+    const std::string& username,
+    const std::string& email,
+    const std::string& password_hash,
+    const std::string& display_name) {
+    
+    try {
+        User user{IdGenerator::to_uuid(ids_.next()), username, email, password_hash,
+                  display_name, "offline"};
+        auto txn = store_.begin();
+        store_.apply(*txn, {EmbeddedOp::CreateUser, {user.user_id, user.username, user.email,
+                                                     user.password_hash, user.display_name,
+                                                     user.status}});
+        txn->commit();
+        return user;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to create user: {}", e.what());
+    }
+    
+    return std::nullopt;
+}
+
+std::optional<User> EmbeddedUserRepository::get_user_by_username(const std::string& username) {
+    auto lock = store_.read_lock();
+    const auto& tables = store_.tables();
+    auto it = tables.user_by_name.find(username);
+    if (it == tables.user_by_name.end()) {
+        return std::nullopt;
+    }
+    return tables.users.at(it->second);
+}
+
+std::optional<User> EmbeddedUserRepository::get_user_by_id(const std::string& user_id) {
+    auto lock = store_.read_lock();
+    const auto& tables = store_.tables();
+    auto it = tables.users.find(user_id);
+    if (it == tables.users.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+bool EmbeddedUserRepository::update_user_status(const std::string& user_id, const std::string& status) {
+    try {
+        auto txn = store_.begin();
+        store_.apply(*txn, {EmbeddedOp::SetUserStatus, {user_id, status}});
+        txn->commit();
+        return true;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to update user status: {}", e.what());
+        return false;
+    }
+}
+
+std::vector<User> EmbeddedUserRepository::search_users(const std::string& query) {
+    std::string needle = lowercase(query);
+    std::vector<User> users;
+    {
+        auto lock = store_.read_lock();
+        for (const auto& [id, user] : store_.tables().users) {
+            if (lowercase(user.username).find(needle) != std::string::npos ||
+                lowercase(user.display_name).find(needle) != std::string::npos) {
+                users.push_back(user);
+            }
+        }
+    }
+    
+    // The table has no order of its own; keep the same 20 from call to call
+    std::size_t count = std::min(users.size(), kSearchLimit);
+    std::partial_sort(users.begin(), users.begin() + count, users.end(),
+                      [](const User& a, const User& b) { return a.username < b.username; });
+    users.resize(count);
+    return users;
+}
+
+EmbeddedGroupRepository::EmbeddedGroupRepository(EmbeddedStore& store, IdGenerator& ids)
+    : store_(store)
+    , ids_(ids) {
+}
+
+std::optional<Group> EmbeddedGroupRepository::create_group(
+    const std::string& group_name,
+    const std::string& description,
+    const std::string& creator_id) {
+    
+    try {
+        Group group{IdGenerator::to_uuid(ids_.next()), group_name, description, creator_id};
+        auto txn = store_.begin();
+        store_.apply(*txn, {EmbeddedOp::CreateGroup, {group.group_id, group.group_name,
+                                                      group.description, group.created_by}});
+        store_.apply(*txn, {EmbeddedOp::AddMember, {group.group_id, creator_id, "admin"}});
+        txn->commit();
+        
+        Logger::get()->info("Group created: {} by {}", group_name, creator_id);
+        return group;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to create group: {}", e.what());
+    }
+    
+    return std::nullopt;
+}
+
+bool EmbeddedGroupRepository::add_member(
+    const std::string& group_id,
+    const std::string& user_id,
+    const std::string& role) {
+    
+    try {
+        auto txn = store_.begin();
+        AfterCommit after_commit;
+        add_member(*txn, group_id, user_id, role, after_commit);
+        txn->commit();
+        
+        Logger::get()->info("User {} added to group {}", user_id, group_id);
+        return true;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to add member to group: {}", e.what());
+        return false;
+    }
+}
+
+void EmbeddedGroupRepository::add_member(
+    Transaction& txn,
+    const std::string& group_id,
+    const std::string& user_id,
+    const std::string& role,
+    AfterCommit&) {
+    
+    store_.apply(txn, {EmbeddedOp::AddMember, {group_id, user_id, role}});
+}
+
+bool EmbeddedGroupRepository::remove_member(
+    const std::string& group_id,
+    const std::string& user_id) {
+    
+    try {
+        auto txn = store_.begin();
+        store_.apply(*txn, {EmbeddedOp::RemoveMember, {group_id, user_id}});
+        txn->commit();
+        
+        Logger::get()->info("User {} removed from group {}", user_id, group_id);
+        return true;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to remove member from group: {}", e.what());
+        return false;
+    }
+}
+
+std::vector<Group> EmbeddedGroupRepository::get_user_groups(const std::string& user_id) {
+    auto lock = store_.read_lock();
+    const auto& tables = store_.tables();
+    std::vector<Group> groups;
+    auto it = tables.user_groups.find(user_id);
+    if (it != tables.user_groups.end()) {
+        groups.reserve(it->second->size());
+        for (const auto& group_id : *it->second) {
+            groups.push_back(tables.groups.at(group_id).group);
+        }
+    }
+    return groups;
+}
+
+std::vector<GroupMember> EmbeddedGroupRepository::get_group_members(const std::string& group_id) {
+    auto lock = store_.read_lock();
+    const auto& tables = store_.tables();
+    std::vector<GroupMember> members;
+    auto it = tables.groups.find(group_id);
+    if (it != tables.groups.end()) {
+        members.reserve(it->second.roles.size());
+        for (const auto& [user_id, role] : it->second.roles) {
+            members.push_back(GroupMember{group_id, user_id, role});
+        }
+    }
+    return members;
+}
+
+IdSetPtr EmbeddedGroupRepository::get_member_ids(const std::string& group_id) {
+    auto lock = store_.read_lock();
+    const auto& tables = store_.tables();
+    auto it = tables.groups.find(group_id);
+    return it != tables.groups.end() ? it->second.member_ids : std::make_shared<const IdSet>();
+}
+
+IdSetPtr EmbeddedGroupRepository::get_user_group_ids(const std::string& user_id) {
+    auto lock = store_.read_lock();
+    const auto& tables = store_.tables();
+    auto it = tables.user_groups.find(user_id);
+    return it != tables.user_groups.end() ? it->second : std::make_shared<const IdSet>();
+}
+
+bool EmbeddedGroupRepository::is_member(const std::string& group_id, const std::string& user_id) {
+    auto lock = store_.read_lock();
+    const auto& tables = store_.tables();
+    auto it = tables.groups.find(group_id);
+    return it != tables.groups.end() && it->second.roles.count(user_id) > 0;
+}
+
+EmbeddedMessageRepository::EmbeddedMessageRepository(EmbeddedStore& store, IdGenerator& ids)
+    : store_(store)
+    , ids_(ids) {
+}
+
+std::optional<Message> EmbeddedMessageRepository::send_message(
+    const std::string& sender_id,
+    const std::string& recipient_id,
+    const std::string& content,
+    const std::string& message_type,
+    const std::string& idempotency_key) {
+    
+    try {
+        auto txn = store_.begin();
+        Message msg = send_message(*txn, sender_id, recipient_id, content, message_type,
+                                   idempotency_key);
+        txn->commit();
+        
+        Logger::get()->info("Message sent from {} to {}", sender_id, recipient_id);
+        return msg;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to send message: {}", e.what());
+    }
+    
+    return std::nullopt;
+}
+
+std::optional<Message> EmbeddedMessageRepository::send_group_message(
+    const std::string& sender_id,
+    const std::string& group_id,
+    const std::string& content,
+    const std::string& message_type,
+    const std::string& idempotency_key) {
+    
+    try {
+        auto txn = store_.begin();
+        Message msg = send_group_message(*txn, sender_id, group_id, content, message_type,
+                                         idempotency_key);
+        txn->commit();
+        
+        Logger::get()->info("Group message sent from {} to group {}", sender_id, group_id);
+        return msg;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to send group message: {}", e.what());
+    }
+    
+    return std::nullopt;
+}
+
+Message EmbeddedMessageRepository::send_message(
+    Transaction& txn,
+    const std::string& sender_id,
+    const std::string& recipient_id,
+    const std::string& content,
+    const std::string& message_type,
+    const std::string& idempotency_key) {
+    
+    Message msg;
+    msg.sender_id = sender_id;
+    msg.recipient_id = recipient_id;
+    msg.content = content;
+    msg.message_type = message_type;
+    msg.is_read = false;
+    return insert(txn, "dm:" + conversation_id(sender_id, recipient_id), std::move(msg),
+                  idempotency_key);
+}
+
+Message EmbeddedMessageRepository::send_group_message(
+    Transaction& txn,
+    const std::string& sender_id,
+    const std::string& group_id,
+    const std::string& content,
+    const std::string& message_type,
+    const std::string& idempotency_key) {
+    
+    Message msg;
+    msg.sender_id = sender_id;
+    msg.group_id = group_id;
+    msg.content = content;
+    msg.message_type = message_type;
+    msg.is_read = false;
+    return insert(txn, "group:" + group_id, std::move(msg), idempotency_key);
+}
+
+Message EmbeddedMessageRepository::insert(Transaction& txn,
+                                          const std::string& key,
+                                          Message msg,
+                                          const std::string& idempotency_key) {
+    // The transaction holds the tables, so the lookups below and the
+    // insert see the same state
+    const auto& tables = store_.tables();
+    if (!idempotency_key.empty()) {
+        auto earlier = tables.idempotency_keys.find(EmbeddedTables::pair_key(msg.sender_id, idempotency_key));
+        if (earlier != tables.idempotency_keys.end()) {
+            Message duplicate = view_message(tables, earlier->second);
+            duplicate.duplicate = true;
+            return duplicate;
+        }
+    }
+    
+    // Taken under the transaction, so created_at rises with seq in every
+    // conversation
+    std::uint64_t id = ids_.next();
+    const auto* conversation = find_conversation(tables, key);
+    msg.message_id = IdGenerator::to_uuid(id);
+    msg.created_at = IdGenerator::to_timestamp(id);
+    msg.is_read = false;
+    msg.seq = (conversation ? conversation->last_seq() : 0) + 1;
+    
+    store_.apply(txn, {EmbeddedOp::InsertMessage, {msg.message_id, msg.sender_id, msg.recipient_id,
+                                                   msg.group_id, msg.content, msg.message_type,
+                                                   msg.created_at, std::to_string(msg.seq),
+                                                   idempotency_key}});
+    return msg;
+}
+
+std::vector<Message> EmbeddedMessageRepository::get_conversation(
+    const std::string& user1_id,
+    const std::string& user2_id,
+    int limit,
+    std::uint64_t before_seq) {
+    
+    auto lock = store_.read_lock();
+    std::vector<Message> messages;
+    const auto* conversation = find_conversation(store_.tables(), "dm:" + conversation_id(user1_id, user2_id));
+    if (!conversation) {
+        return messages;
+    }
+    
+    std::size_t end = before_seq == 0 ? conversation->messages.size() : seq_position(*conversation, before_seq);
+    for (std::size_t i = end; i > 0 && messages.size() < to_limit(limit); --i) {
+        messages.push_back(conversation->view(conversation->messages[i - 1]));
+    }
+    return messages;
+}
+
+std::vector<Message> EmbeddedMessageRepository::get_group_messages(
+    const std::string& group_id,
+    int limit) {
+    
+    auto lock = store_.read_lock();
+    std::vector<Message> messages;
+    const auto* conversation = find_conversation(store_.tables(), "group:" + group_id);
+    if (!conversation) {
+        return messages;
+    }
+    
+    for (auto it = conversation->messages.rbegin();
+         it != conversation->messages.rend() && messages.size() < to_limit(limit); ++it) {
+        messages.push_back(conversation->view(*it));
+    }
+    return messages;
+}
+
+std::vector<Message> EmbeddedMessageRepository::get_conversation_range(
+    const std::string& user1_id,
+    const std::string& user2_id,
+    std::uint64_t from_seq,
+    std::uint64_t to_seq,
+    int limit) {
+    
+    return range("dm:" + conversation_id(user1_id, user2_id), from_seq, to_seq, limit);
+}
+
+std::vector<Message> EmbeddedMessageRepository::get_group_range(
+    const std::string& group_id,
+    std::uint64_t from_seq,
+    std::uint64_t to_seq,
+    int limit) {
+    
+    return range("group:" + group_id, from_seq, to_seq, limit);
+}
+
+std::vector<Message> EmbeddedMessageRepository::range(
+    const std::string& key,
+    std::uint64_t from_seq,
+    std::uint64_t to_seq,
+    int limit) {
+    
+    auto lock = store_.read_lock();
+    std::vector<Message> messages;
+    const auto* conversation = find_conversation(store_.tables(), key);
+    if (!conversation) {
+        return messages;
+    }
+    
+    for (std::size_t i = seq_position(*conversation, from_seq);
+         i < conversation->messages.size() && messages.size() < to_limit(limit); ++i) {
+        const auto& stored = conversation->messages[i];
+        if (stored.message.seq > to_seq) {
+            break;
+        }
+        messages.push_back(conversation->view(stored));
+    }
+    return messages;
+}
+
+std::optional<SyncPage> EmbeddedMessageRepository::get_messages_since(
+    const std::string& user_id,
+    const std::string& cursor,
+    int limit) {
+    
+    // "<created_at>|<message_id>". Both are drawn inside the write
+    // transaction, so that order is also commit order.
+    std::string after_created_at;
+    std::string after_message_id;
+    if (!cursor.empty()) {
+        std::size_t bar = cursor.find('|');
+        if (bar == std::string::npos) {
+            Logger::get()->error("Invalid sync cursor for {}: {}", user_id, cursor);
+            return std::nullopt;
+        }
+        after_created_at = cursor.substr(0, bar);
+        after_message_id = cursor.substr(bar + 1);
+    }
+    
+    using Cursor = std::pair<const EmbeddedTables::Conversation*, std::size_t>;
+    auto key_of = [](const Cursor& c) -> std::pair<const std::string&, const std::string&> {
+        const Message& msg = c.first->messages[c.second].message;
+        return {msg.created_at, msg.message_id};
+    };
+    auto later = [&](const Cursor& a, const Cursor& b) { return key_of(a) > key_of(b); };
+    
+    auto lock = store_.read_lock();
+    const auto& tables = store_.tables();
+    
+    // Each conversation is already in (created_at, message_id) order, so
+    // the result is a merge of their tails after the cursor
+    std::vector<std::string> keys;
+    if (auto partners = tables.dm_partners.find(user_id); partners != tables.dm_partners.end()) {
+        for (const auto& partner : partners->second) {
+            keys.push_back("dm:" + conversation_id(user_id, partner));
+        }
+    }
+    if (auto groups = tables.user_groups.find(user_id); groups != tables.user_groups.end()) {
+        for (const auto& group_id : *groups->second) {
+            keys.push_back("group:" + group_id);
+        }
+    }
+    
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(later)> heads(later);
+    for (const auto& key : keys) {
+        const auto* conversation = find_conversation(tables, key);
+        if (!conversation) {
+            continue;
+        }
+        const auto& messages = conversation->messages;
+        auto first = std::upper_bound(messages.begin(), messages.end(),
+            std::tie(after_created_at, after_message_id),
+            [](const auto& cursor, const EmbeddedTables::StoredMessage& m) {
+                return cursor < std::tie(m.message.created_at, m.message.message_id);
+            });
+        if (first != messages.end()) {
+            heads.push({conversation, static_cast<std::size_t>(first - messages.begin())});
+        }
+    }
+    
+    SyncPage page;
+    while (!heads.empty() && page.messages.size() < to_limit(limit)) {
+        Cursor head = heads.top();
+        heads.pop();
+        page.messages.push_back(head.first->view(head.first->messages[head.second]));
+        const Message& msg = page.messages.back();
+        page.cursors.push_back(msg.created_at + "|" + msg.message_id);
+        if (++head.second < head.first->messages.size()) {
+            heads.push(head);
+        }
+    }
+    return page;
+}
+
+bool EmbeddedMessageRepository::mark_message_read(const std::string& message_id) {
+    try {
+        auto txn = store_.begin();
+        store_.apply(*txn, {EmbeddedOp::MarkMessageRead, {message_id}});
+        txn->commit();
+        return true;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to mark message as read: {}", e.what());
+        return false;
+    }
+}
+
+std::optional<std::vector<InboxEntry>> EmbeddedMessageRepository::get_inbox(const std::string& user_id) {
+    auto lock = store_.read_lock();
+    const auto& tables = store_.tables();
+    
+    const std::unordered_map<std::string, std::string>* marks = nullptr;
+    if (auto it = tables.read_marks.find(user_id); it != tables.read_marks.end()) {
+        marks = &it->second;
+    }
+    
+    std::vector<InboxEntry> entries;
+    auto add_entry = [&](const std::string& name, const std::string& key, bool dm) {
+        const auto* conversation = find_conversation(tables, key);
+        if (!conversation || conversation->messages.empty()) {
+            return;
+        }
+        
+        std::string read_at;
+        if (marks) {
+            if (auto mark = marks->find(name); mark != marks->end()) {
+                read_at = mark->second;
+            }
+        }
+        
+        // Only messages after the read mark can be unread; a DM also needs
+        // its read flag unset, as in PostgresMessageRepository::get_inbox
+        InboxEntry entry;
+        entry.conversation = name;
+        for (auto it = conversation->messages.rbegin();
+             it != conversation->messages.rend() && it->message.created_at > read_at; ++it) {
+            if (it->message.sender_id != user_id && !(dm && conversation->view(*it).is_read)) {
+                ++entry.unread;
+            }
+        }
+        
+        const Message& last = conversation->messages.back().message;
+        entry.last_message_id = last.message_id;
+        entry.last_sender_id = last.sender_id;
+        entry.last_preview = utf8_prefix(last.content, kInboxPreviewChars);
+        entry.last_created_at = last.created_at;
+        entry.last_seq = last.seq;
+        entries.push_back(std::move(entry));
+    };
+    
+    if (auto partners = tables.dm_partners.find(user_id); partners != tables.dm_partners.end()) {
+        for (const auto& partner : partners->second) {
+            add_entry("dm:" + partner, "dm:" + conversation_id(user_id, partner), true);
+        }
+    }
+    if (auto groups = tables.user_groups.find(user_id); groups != tables.user_groups.end()) {
+        for (const auto& group_id : *groups->second) {
+            add_entry("group:" + group_id, "group:" + group_id, false);
+        }
+    }
+    
+    std::sort(entries.begin(), entries.end(), [](const InboxEntry& a, const InboxEntry& b) {
+        return std::tie(a.last_created_at, a.last_message_id) > std::tie(b.last_created_at, b.last_message_id);
+    });
+    return entries;
+}
+
+bool EmbeddedMessageRepository::save_read_marks(const std::vector<ReadMark>& marks) {
+    try {
+        auto txn = store_.begin();
+        for (const auto& mark : marks) {
+            store_.apply(*txn, {EmbeddedOp::SaveReadMark, {mark.user_id, mark.conversation, mark.read_at}});
+        }
+        txn->commit();
+        return true;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to save {} read marks: {}", marks.size(), e.what());
+        return false;
+    }
+}
+
+EmbeddedFriendRepository::EmbeddedFriendRepository(EmbeddedStore& store, IdGenerator& ids)
+    : store_(store)
+    , ids_(ids) {
+}
+
+FriendRequestResult EmbeddedFriendRepository::send_request(
+    Transaction& txn,
+    const std::string& sender_id,
+    const std::string& receiver_username) {
+    
+    const auto& tables = store_.tables();
+    FriendRequestResult outcome;
+    
+    auto receiver = tables.user_by_name.find(receiver_username);
+    if (receiver == tables.user_by_name.end()) {
+        outcome.status = FriendRequestResult::Status::UserNotFound;
+        return outcome;
+    }
+    const std::string& receiver_id = receiver->second;
+    
+    auto friends = tables.friends.find(sender_id);
+    if (friends != tables.friends.end() && friends->second.count(receiver_id)) {
+        outcome.status = FriendRequestResult::Status::AlreadyFriends;
+        return outcome;
+    }
+    
+    // One request per direction, whatever became of it, as the unique
+    // (sender_id, receiver_id) constraint allows
+    if (tables.request_by_pair.count(EmbeddedTables::pair_key(sender_id, receiver_id))) {
+        outcome.status = FriendRequestResult::Status::AlreadyRequested;
+        return outcome;
+    }
+    
+    std::uint64_t id = ids_.next();
+    outcome.status = FriendRequestResult::Status::Sent;
+    outcome.request_id = IdGenerator::to_uuid(id);
+    outcome.receiver_id = receiver_id;
+    store_.apply(txn, {EmbeddedOp::SendFriendRequest, {outcome.request_id, sender_id, receiver_id,
+                                                       IdGenerator::to_timestamp(id)}});
+    return outcome;
+}
+
+std::optional<std::string> EmbeddedFriendRepository::accept_request(
+    const std::string& receiver_id,
+    const std::string& request_id) {
+    
+    auto txn = store_.begin();
+    const auto& tables = store_.tables();
+    
+    auto request = tables.friend_requests.find(request_id);
+    if (request == tables.friend_requests.end() || request->second.receiver_id != receiver_id ||
+        request->second.status != "pending") {
+        return std::nullopt;
+    }
+    std::string sender_id = request->second.sender_id;
+    
+    store_.apply(*txn, {EmbeddedOp::SetRequestStatus, {request_id, "accepted"}});
+    store_.apply(*txn, {EmbeddedOp::AddFriendship, {
+        sender_id < receiver_id ? sender_id : receiver_id,
+        sender_id < receiver_id ? receiver_id : sender_id}});
+    txn->commit();
+    return sender_id;
+}
+
+void EmbeddedFriendRepository::reject_request(
+    const std::string& receiver_id,
+    const std::string& request_id) {
+    
+    auto txn = store_.begin();
+    const auto& tables = store_.tables();
+    
+    auto request = tables.friend_requests.find(request_id);
+    if (request != tables.friend_requests.end() && request->second.receiver_id == receiver_id) {
+        store_.apply(*txn, {EmbeddedOp::SetRequestStatus, {request_id, "rejected"}});
+    }
+    txn->commit();
+}
+
+std::vector<FriendRequest> EmbeddedFriendRepository::get_requests(const std::string& user_id) {
+    auto lock = store_.read_lock();
+    const auto& tables = store_.tables();
+    std::vector<FriendRequest> requests;
+    
+    auto ids = tables.requests_to.find(user_id);
+    if (ids == tables.requests_to.end()) {
+        return requests;
+    }
+    // Appended as they were sent, so newest first is back to front
+    for (auto it = ids->second.rbegin(); it != ids->second.rend(); ++it) {
+        const auto& row = tables.friend_requests.at(*it);
+        if (row.status != "pending") {
+            continue;
+        }
+        const auto& sender = tables.users.at(row.sender_id);
+        requests.push_back(FriendRequest{row.request_id, row.sender_id, sender.username,
+                                         sender.display_name, row.created_at});
+    }
+    return requests;
+}
+
+std::vector<User> EmbeddedFriendRepository::get_friends(const std::string& user_id) {
+    auto lock = store_.read_lock();
+    const auto& tables = store_.tables();
+    std::vector<User> friends;
+    
+    auto ids = tables.friends.find(user_id);
+    if (ids == tables.friends.end()) {
+        return friends;
+    }
+    friends.reserve(ids->second.size());
+    for (const auto& friend_id : ids->second) {
+        const auto& row = tables.users.at(friend_id);
+        User user;
+        user.user_id = row.user_id;
+        user.username = row.username;
+        user.display_name = row.display_name;
+        user.status = row.status;
+        friends.push_back(std::move(user));
+    }
+    std::sort(friends.begin(), friends.end(),
+              [](const User& a, const User& b) { return a.username < b.username; });
+    return friends;
+}
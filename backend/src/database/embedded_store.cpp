@@ -0,0 +1,1048 @@
+// src/database/embedded_store.cpp
+#include "database/embedded_store.hpp"
+#include "utils/file_io.hpp"
+#include "utils/logger.hpp"
+#include "utils/metrics.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+// Log and snapshot records: length and CRC-32 of the payload, little
+// endian, then the payload
+constexpr std::size_t kHeaderBytes = 8;
+// Anything longer is a damaged header, not a record
+constexpr std::uint32_t kMaxRecordBytes = 256 * 1024 * 1024;
+// First byte of a payload, for changing the layout later
+constexpr char kRecordVersion = 1;
+// A snapshot starts with this and the log position it covers
+constexpr char kSnapshotMagic[8] = {'C', 'H', 'A', 'T', 'S', 'N', 'P', '1'};
+// Ops per snapshot record
+constexpr std::size_t kSnapshotBatch = 1024;
+
+void put_u32(std::string& out, std::uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+void put_u64(std::string& out, std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+std::uint32_t get_u32(const char* in) {
+    std::uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<std::uint32_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return value;
+}
+
+std::uint64_t get_u64(const char* in) {
+    std::uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value |= static_cast<std::uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return value;
+}
+
+void put_string(std::string& out, const std::string& value) {
+    put_u32(out, static_cast<std::uint32_t>(value.size()));
+    out += value;
+}
+
+bool get_string(const std::string& in, std::size_t& pos, std::string& value) {
+    if (in.size() - pos < 4) {
+        return false;
+    }
+    std::uint32_t size = get_u32(in.data() + pos);
+    pos += 4;
+    if (in.size() - pos < size) {
+        return false;
+    }
+    value.assign(in, pos, size);
+    pos += size;
+    return true;
+}
+
+std::string frame(const std::string& payload) {
+    std::string out;
+    out.reserve(kHeaderBytes + payload.size());
+    put_u32(out, static_cast<std::uint32_t>(payload.size()));
+    put_u32(out, FileIo::crc32(payload));
+    out += payload;
+    return out;
+}
+
+// Payloads from `pos` on, up to the end of `data` or the first torn or
+// damaged record, which sets `torn`.
+std::vector<std::string> read_frames(const std::string& data, std::size_t pos, bool& torn) {
+    std::vector<std::string> payloads;
+    torn = false;
+    while (pos < data.size()) {
+        if (data.size() - pos < kHeaderBytes) {
+            torn = true;
+            break;
+        }
+        std::uint32_t length = get_u32(data.data() + pos);
+        std::uint32_t crc = get_u32(data.data() + pos + 4);
+        if (length > kMaxRecordBytes || data.size() - pos - kHeaderBytes < length) {
+            torn = true;
+            break;
+        }
+        std::string payload = data.substr(pos + kHeaderBytes, length);
+        if (FileIo::crc32(payload) != crc) {
+            torn = true;
+            break;
+        }
+        payloads.push_back(std::move(payload));
+        pos += kHeaderBytes + length;
+    }
+    return payloads;
+}
+
+std::string encode_ops(std::uint64_t lsn, const EmbeddedOp* first, const EmbeddedOp* last) {
+    std::string out(1, kRecordVersion);
+    put_u64(out, lsn);
+    for (const EmbeddedOp* op = first; op != last; ++op) {
+        out.push_back(static_cast<char>(op->type));
+        out.push_back(static_cast<char>(op->fields.size()));
+        for (const auto& field : op->fields) {
+            put_string(out, field);
+        }
+    }
+    return out;
+}
+
+bool decode_ops(const std::string& payload, std::uint64_t& lsn, std::vector<EmbeddedOp>& ops) {
+    if (payload.size() < 9 || payload[0] != kRecordVersion) {
+        return false;
+    }
+    lsn = get_u64(payload.data() + 1);
+    
+    std::size_t pos = 9;
+    while (pos < payload.size()) {
+        if (payload.size() - pos < 2) {
+            return false;
+        }
+        auto type = static_cast<std::uint8_t>(payload[pos]);
+        auto count = static_cast<std::uint8_t>(payload[pos + 1]);
+        pos += 2;
+        if (type < EmbeddedOp::CreateUser || type > EmbeddedOp::ReadThrough) {
+            return false;
+        }
+        
+        EmbeddedOp op{static_cast<EmbeddedOp::Type>(type), std::vector<std::string>(count)};
+        for (auto& field : op.fields) {
+            if (!get_string(payload, pos, field)) {
+                return false;
+            }
+        }
+        ops.push_back(std::move(op));
+    }
+    return true;
+}
+
+bool read_file(const std::string& path, std::string& data) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !in.bad();
+}
+
+// Numbers of the files named "<20 digits><suffix>" in `directory`, ascending
+std::vector<std::uint64_t> numbered_files(const std::string& directory, const std::string& suffix) {
+    std::vector<std::uint64_t> numbers;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(directory, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.size() != 20 + suffix.size() ||
+            name.compare(20, std::string::npos, suffix) != 0 ||
+            !std::all_of(name.begin(), name.begin() + 20, [](char c) { return c >= '0' && c <= '9'; })) {
+            continue;
+        }
+        numbers.push_back(std::stoull(name.substr(0, 20)));
+    }
+    std::sort(numbers.begin(), numbers.end());
+    return numbers;
+}
+
+std::string numbered_path(const std::string& directory, std::uint64_t number, const char* suffix) {
+    char name[40];
+    std::snprintf(name, sizeof(name), "%020llu%s", static_cast<unsigned long long>(number), suffix);
+    return (fs::path(directory) / name).string();
+}
+
+std::uint64_t to_u64(const std::string& field) {
+    try {
+        return std::stoull(field);
+    } catch (const std::exception&) {
+        throw std::invalid_argument("not a number: " + field);
+    }
+}
+
+// Copy of a sorted id set with `id` added or removed
+IdSetPtr with_id(const IdSetPtr& set, const std::string& id, bool added) {
+    IdSet ids = set ? *set : IdSet{};
+    auto it = std::lower_bound(ids.begin(), ids.end(), id);
+    if (added && (it == ids.end() || *it != id)) {
+        ids.insert(it, id);
+    } else if (!added && it != ids.end() && *it == id) {
+        ids.erase(it);
+    }
+    return std::make_shared<const IdSet>(std::move(ids));
+}
+}
+
+Message EmbeddedTables::Conversation::view(const StoredMessage& stored) const {
+    Message msg = stored.message;
+    if (!msg.is_read && msg.group_id.empty()) {
+        auto it = read_through.find(msg.recipient_id);
+        msg.is_read = it != read_through.end() && msg.seq <= it->second;
+    }
+    return msg;
+}
+
+std::uint64_t EmbeddedTables::Conversation::last_seq() const {
+    return messages.empty() ? 0 : messages.back().message.seq;
+}
+
+std::string EmbeddedTables::pair_key(const std::string& first, const std::string& second) {
+    return first + '\0' + second;
+}
+
+const EmbeddedTables::StoredMessage* EmbeddedTables::find_message(const std::string& message_id) const {
+    auto location = message_locations.find(message_id);
+    if (location == message_locations.end()) {
+        return nullptr;
+    }
+    const auto& messages = conversations.at(location->second.first).messages;
+    auto it = std::lower_bound(messages.begin(), messages.end(), location->second.second,
+                               [](const StoredMessage& m, std::uint64_t seq) { return m.message.seq < seq; });
+    return it != messages.end() && it->message.seq == location->second.second ? &*it : nullptr;
+}
+
+// Holds the tables exclusively from begin() until commit or destruction
+class EmbeddedStore::Txn : public Transaction {
+public:
+    explicit Txn(EmbeddedStore& store)
+        : store_(store)
+        , lock_(store.mutex_) {
+        store_.writer_ = std::this_thread::get_id();
+    }
+    
+    ~Txn() override {
+        if (lock_.owns_lock()) {
+            rollback(0, 0);
+            release();
+        }
+    }
+    
+    void savepoint(const std::function<void()>& step) override {
+        std::size_t ops = ops_.size();
+        std::size_t undo = undo_.size();
+        try {
+            step();
+        } catch (...) {
+            rollback(ops, undo);
+            throw;
+        }
+    }
+    
+    void commit() override {
+        if (!lock_.owns_lock()) {
+            throw std::logic_error("transaction already finished");
+        }
+        
+        // Queued while the tables are still held, so the log keeps commit order.
+        // If it throws, the destructor rolls back.
+        std::uint64_t lsn = ops_.empty() ? 0 : store_.log_commit(ops_);
+        undo_.clear();
+        release();
+        
+        if (lsn > 0 && store_.options_.sync_commits) {
+            store_.wait_durable(lsn);
+        }
+    }
+    
+    void add(EmbeddedOp op) {
+        store_.apply_op(op, &undo_);
+        ops_.push_back(std::move(op));
+    }
+
+private:
+    void rollback(std::size_t ops, std::size_t undo) {
+        while (undo_.size() > undo) {
+            undo_.back()();
+            undo_.pop_back();
+        }
+        ops_.resize(ops);
+    }
+    
+    void release() {
+        store_.writer_ = std::thread::id();
+        lock_.unlock();
+    }
+    
+    EmbeddedStore& store_;
+    std::unique_lock<std::shared_mutex> lock_;
+    std::vector<EmbeddedOp> ops_;
+    Undo undo_;
+};
+
+EmbeddedStore::EmbeddedStore(EmbeddedOptions options)
+    : options_(std::move(options))
+    , writer_(std::thread::id()) {
+}
+
+EmbeddedStore::~EmbeddedStore() {
+    stop();
+}
+
+bool EmbeddedStore::open() {
+    std::error_code ec;
+    fs::create_directories(options_.directory, ec);
+    if (ec) {
+        Logger::get()->error("Embedded store directory {} unusable: {}", options_.directory, ec.message());
+        return false;
+    }
+    
+    std::uint64_t lsn = 0;
+    if (!load_snapshot(lsn) || !replay_log(lsn)) {
+        return false;
+    }
+    next_lsn_ = lsn + 1;
+    queued_lsn_ = lsn;
+    durable_lsn_ = lsn;
+    
+    // Every segment left behind is complete: this run writes a new one
+    if (!open_segment(next_lsn_)) {
+        return false;
+    }
+    
+    log_writer_ = std::thread([this] { writer_loop(); });
+    snapshotter_ = std::thread([this] { snapshot_loop(); });
+    Logger::get()->info("Embedded store in {} at log position {}: {} users, {} groups, {} conversations",
+                       options_.directory, lsn, tables_.users.size(), tables_.groups.size(),
+                       tables_.conversations.size());
+    return true;
+}
+
+void EmbeddedStore::stop() {
+    if (snapshotter_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(snapshot_mutex_);
+            snapshot_stopping_ = true;
+        }
+        snapshot_wake_.notify_all();
+        snapshotter_.join();
+        take_snapshot();
+    }
+    
+    if (log_writer_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(log_mutex_);
+            stopping_ = true;
+        }
+        queued_.notify_all();
+        log_writer_.join();
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+std::unique_ptr<Transaction> EmbeddedStore::begin() {
+    if (writer_.load() == std::this_thread::get_id()) {
+        throw std::logic_error("embedded transactions do not nest");
+    }
+    return std::make_unique<Txn>(*this);
+}
+
+void EmbeddedStore::apply(Transaction& txn, EmbeddedOp op) {
+    static_cast<Txn&>(txn).add(std::move(op));
+}
+
+std::shared_lock<std::shared_mutex> EmbeddedStore::read_lock() const {
+    if (writer_.load() == std::this_thread::get_id()) {
+        return std::shared_lock<std::shared_mutex>(mutex_, std::defer_lock);
+    }
+    return std::shared_lock<std::shared_mutex>(mutex_);
+}
+
+void EmbeddedStore::apply_op(const EmbeddedOp& op, Undo* undo) {
+    const auto& f = op.fields;
+    auto& t = tables_;
+    auto expect_fields = [&](std::size_t count) {
+        if (f.size() != count) {
+            throw std::invalid_argument("op " + std::to_string(op.type) + " needs " +
+                                        std::to_string(count) + " fields");
+        }
+    };
+    auto expect_user = [&](const std::string& user_id) {
+        if (!t.users.count(user_id)) {
+            throw std::invalid_argument("no user " + user_id);
+        }
+    };
+    
+    switch (op.type) {
+    case EmbeddedOp::CreateUser: {
+        expect_fields(6);
+        if (t.users.count(f[0]) || t.user_by_name.count(f[1]) || t.user_by_email.count(f[2])) {
+            throw std::invalid_argument("user " + f[1] + " already exists");
+        }
+        t.users.emplace(f[0], User{f[0], f[1], f[2], f[3], f[4], f[5]});
+        t.user_by_name.emplace(f[1], f[0]);
+        t.user_by_email.emplace(f[2], f[0]);
+        if (undo) {
+            undo->push_back([&t, user_id = f[0], username = f[1], email = f[2]] {
+                t.users.erase(user_id);
+                t.user_by_name.erase(username);
+                t.user_by_email.erase(email);
+            });
+        }
+        break;
+    }
+    case EmbeddedOp::SetUserStatus: {
+        expect_fields(2);
+        expect_user(f[0]);
+        std::string old = std::exchange(t.users.at(f[0]).status, f[1]);
+        if (undo) {
+            undo->push_back([&t, user_id = f[0], old] { t.users.at(user_id).status = old; });
+        }
+        break;
+    }
+    case EmbeddedOp::CreateGroup: {
+        expect_fields(4);
+        expect_user(f[3]);
+        if (t.groups.count(f[0])) {
+            throw std::invalid_argument("group " + f[0] + " already exists");
+        }
+        EmbeddedTables::GroupRow row;
+        row.group = Group{f[0], f[1], f[2], f[3]};
+        row.member_ids = std::make_shared<const IdSet>();
+        t.groups.emplace(f[0], std::move(row));
+        if (undo) {
+            undo->push_back([&t, group_id = f[0]] { t.groups.erase(group_id); });
+        }
+        break;
+    }
+    case EmbeddedOp::AddMember: {
+        expect_fields(3);
+        expect_user(f[1]);
+        auto group = t.groups.find(f[0]);
+        if (group == t.groups.end()) {
+            throw std::invalid_argument("no group " + f[0]);
+        }
+        // Adding a member twice changes nothing, like ON CONFLICT DO NOTHING
+        if (!group->second.roles.emplace(f[1], f[2]).second) {
+            break;
+        }
+        group->second.member_ids = with_id(group->second.member_ids, f[1], true);
+        t.user_groups[f[1]] = with_id(t.user_groups[f[1]], f[0], true);
+        if (undo) {
+            undo->push_back([&t, group_id = f[0], user_id = f[1]] {
+                auto& row = t.groups.at(group_id);
+                row.roles.erase(user_id);
+                row.member_ids = with_id(row.member_ids, user_id, false);
+                t.user_groups[user_id] = with_id(t.user_groups[user_id], group_id, false);
+            });
+        }
+        break;
+    }
+    case EmbeddedOp::RemoveMember: {
+        expect_fields(2);
+        auto group = t.groups.find(f[0]);
+        if (group == t.groups.end()) {
+            break;
+        }
+        auto member = group->second.roles.find(f[1]);
+        if (member == group->second.roles.end()) {
+            break;
+        }
+        std::string role = member->second;
+        group->second.roles.erase(member);
+        group->second.member_ids = with_id(group->second.member_ids, f[1], false);
+        t.user_groups[f[1]] = with_id(t.user_groups[f[1]], f[0], false);
+        if (undo) {
+            undo->push_back([&t, group_id = f[0], user_id = f[1], role] {
+                auto& row = t.groups.at(group_id);
+                row.roles.emplace(user_id, role);
+                row.member_ids = with_id(row.member_ids, user_id, true);
+                t.user_groups[user_id] = with_id(t.user_groups[user_id], group_id, true);
+            });
+        }
+        break;
+    }
+    case EmbeddedOp::InsertMessage: {
+        expect_fields(9);
+        Message msg;
+        msg.message_id = f[0];
+        msg.sender_id = f[1];
+        msg.recipient_id = f[2];
+        msg.group_id = f[3];
+        msg.content = f[4];
+        msg.message_type = f[5];
+        msg.created_at = f[6];
+        msg.is_read = false;
+        msg.seq = to_u64(f[7]);
+        const std::string& idempotency_key = f[8];
+        
+        expect_user(msg.sender_id);
+        std::string key;
+        if (msg.group_id.empty()) {
+            expect_user(msg.recipient_id);
+            key = "dm:" + MessageRepository::conversation_id(msg.sender_id, msg.recipient_id);
+        } else {
+            if (!t.groups.count(msg.group_id)) {
+                throw std::invalid_argument("no group " + msg.group_id);
+            }
+            key = "group:" + msg.group_id;
+        }
+        std::string idempotency = EmbeddedTables::pair_key(msg.sender_id, idempotency_key);
+        if (t.message_locations.count(msg.message_id) ||
+            (!idempotency_key.empty() && t.idempotency_keys.count(idempotency))) {
+            throw std::invalid_argument("message " + msg.message_id + " already exists");
+        }
+        
+        auto inserted = t.conversations.try_emplace(key);
+        auto& conversation = inserted.first->second;
+        if (msg.seq <= conversation.last_seq()) {
+            if (inserted.second) {
+                t.conversations.erase(inserted.first);
+            }
+            throw std::invalid_argument("message seq " + f[7] + " out of order in " + key);
+        }
+        
+        t.message_locations.emplace(msg.message_id, std::make_pair(key, msg.seq));
+        if (!idempotency_key.empty()) {
+            t.idempotency_keys.emplace(idempotency, msg.message_id);
+        }
+        bool new_partners = false;
+        if (msg.group_id.empty()) {
+            new_partners = t.dm_partners[msg.sender_id].insert(msg.recipient_id).second;
+            t.dm_partners[msg.recipient_id].insert(msg.sender_id);
+        }
+        std::string message_id = msg.message_id;
+        std::string sender_id = msg.sender_id;
+        std::string recipient_id = msg.recipient_id;
+        conversation.messages.push_back(EmbeddedTables::StoredMessage{std::move(msg), idempotency_key});
+        
+        if (undo) {
+            undo->push_back([&t, key, created = inserted.second, message_id, idempotency,
+                             keyed = !idempotency_key.empty(), new_partners, sender_id, recipient_id] {
+                auto conversation = t.conversations.find(key);
+                conversation->second.messages.pop_back();
+                if (created) {
+                    t.conversations.erase(conversation);
+                }
+                t.message_locations.erase(message_id);
+                if (keyed) {
+                    t.idempotency_keys.erase(idempotency);
+                }
+                if (new_partners) {
+                    t.dm_partners[sender_id].erase(recipient_id);
+                    t.dm_partners[recipient_id].erase(sender_id);
+                }
+            });
+        }
+        break;
+    }
+    case EmbeddedOp::MarkMessageRead: {
+        expect_fields(1);
+        // Like an UPDATE, an unknown id changes nothing
+        auto location = t.message_locations.find(f[0]);
+        if (location == t.message_locations.end()) {
+            break;
+        }
+        auto* stored = const_cast<EmbeddedTables::StoredMessage*>(t.find_message(f[0]));
+        bool old = std::exchange(stored->message.is_read, true);
+        if (undo) {
+            undo->push_back([&t, message_id = f[0], old] {
+                const_cast<EmbeddedTables::StoredMessage*>(t.find_message(message_id))->message.is_read = old;
+            });
+        }
+        break;
+    }
+    case EmbeddedOp::SaveReadMark: {
+        expect_fields(3);
+        const std::string& user_id = f[0];
+        const std::string& conversation_key = f[1];
+        const std::string& read_at = f[2];
+        
+        // A mark never moves backwards
+        auto& marks = t.read_marks[user_id];
+        auto mark = marks.find(conversation_key);
+        std::optional<std::string> old_mark;
+        if (mark != marks.end()) {
+            old_mark = mark->second;
+            mark->second = std::max(mark->second, read_at);
+        } else {
+            marks.emplace(conversation_key, read_at);
+        }
+        
+        // DMs from the other user up to the mark count as read
+        std::string dm_key;
+        std::optional<std::uint64_t> old_through;
+        bool through_changed = false;
+        if (conversation_key.compare(0, 3, "dm:") == 0) {
+            dm_key = "dm:" + MessageRepository::conversation_id(user_id, conversation_key.substr(3));
+            auto conversation = t.conversations.find(dm_key);
+            if (conversation != t.conversations.end()) {
+                const auto& messages = conversation->second.messages;
+                auto end = std::upper_bound(messages.begin(), messages.end(), read_at,
+                    [](const std::string& at, const EmbeddedTables::StoredMessage& m) {
+                        return at < m.message.created_at;
+                    });
+                if (end != messages.begin()) {
+                    std::uint64_t seq = std::prev(end)->message.seq;
+                    auto& through = conversation->second.read_through;
+                    auto it = through.find(user_id);
+                    if (it == through.end() || it->second < seq) {
+                        if (it != through.end()) {
+                            old_through = it->second;
+                        }
+                        through[user_id] = seq;
+                        through_changed = true;
+                    }
+                }
+            }
+        }
+        
+        if (undo) {
+            undo->push_back([&t, user_id, conversation_key, old_mark, dm_key, old_through, through_changed] {
+                auto& marks = t.read_marks[user_id];
+                if (old_mark) {
+                    marks[conversation_key] = *old_mark;
+                } else {
+                    marks.erase(conversation_key);
+                }
+                if (through_changed) {
+                    auto& through = t.conversations.at(dm_key).read_through;
+                    if (old_through) {
+                        through[user_id] = *old_through;
+                    } else {
+                        through.erase(user_id);
+                    }
+                }
+            });
+        }
+        break;
+    }
+    case EmbeddedOp::SendFriendRequest: {
+        expect_fields(4);
+        expect_user(f[1]);
+        expect_user(f[2]);
+        std::string pair = EmbeddedTables::pair_key(f[1], f[2]);
+        if (t.friend_requests.count(f[0]) || t.request_by_pair.count(pair)) {
+            throw std::invalid_argument("friend request " + f[0] + " already exists");
+        }
+        t.friend_requests.emplace(f[0], EmbeddedTables::FriendRequestRow{f[0], f[1], f[2], "pending", f[3]});
+        t.request_by_pair.emplace(pair, f[0]);
+        t.requests_to[f[2]].push_back(f[0]);
+        if (undo) {
+            undo->push_back([&t, request_id = f[0], receiver_id = f[2], pair] {
+                t.friend_requests.erase(request_id);
+                t.request_by_pair.erase(pair);
+                t.requests_to[receiver_id].pop_back();
+            });
+        }
+        break;
+    }
+    case EmbeddedOp::SetRequestStatus: {
+        expect_fields(2);
+        auto request = t.friend_requests.find(f[0]);
+        if (request == t.friend_requests.end()) {
+            break;
+        }
+        std::string old = std::exchange(request->second.status, f[1]);
+        if (undo) {
+            undo->push_back([&t, request_id = f[0], old] { t.friend_requests.at(request_id).status = old; });
+        }
+        break;
+    }
+    case EmbeddedOp::AddFriendship: {
+        expect_fields(2);
+        expect_user(f[0]);
+        expect_user(f[1]);
+        if (t.friends[f[0]].count(f[1])) {
+            throw std::invalid_argument("already friends");
+        }
+        t.friends[f[0]].insert(f[1]);
+        t.friends[f[1]].insert(f[0]);
+        if (undo) {
+            undo->push_back([&t, user1_id = f[0], user2_id = f[1]] {
+                t.friends[user1_id].erase(user2_id);
+                t.friends[user2_id].erase(user1_id);
+            });
+        }
+        break;
+    }
+    case EmbeddedOp::ReadThrough: {
+        expect_fields(3);
+        auto conversation = t.conversations.find(f[0]);
+        if (conversation == t.conversations.end()) {
+            break;
+        }
+        auto& through = conversation->second.read_through;
+        std::optional<std::uint64_t> old;
+        if (auto it = through.find(f[1]); it != through.end()) {
+            old = it->second;
+        }
+        through[f[1]] = to_u64(f[2]);
+        if (undo) {
+            undo->push_back([&t, key = f[0], user_id = f[1], old] {
+                auto& through = t.conversations.at(key).read_through;
+                if (old) {
+                    through[user_id] = *old;
+                } else {
+                    through.erase(user_id);
+                }
+            });
+        }
+        break;
+    }
+    default:
+        throw std::invalid_argument("unknown op " + std::to_string(op.type));
+    }
+}
+
+std::uint64_t EmbeddedStore::log_commit(const std::vector<EmbeddedOp>& ops) {
+    static auto& commits = Metrics::counter("embedded.commits");
+    
+    std::uint64_t lsn = next_lsn_;
+    std::string record = frame(encode_ops(lsn, ops.data(), ops.data() + ops.size()));
+    {
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        if (failed_ || stopping_) {
+            throw std::runtime_error("embedded store is not accepting writes");
+        }
+        queue_.push_back(std::move(record));
+        queued_lsn_ = lsn;
+    }
+    queued_.notify_one();
+    ++next_lsn_;
+    commits.fetch_add(1, std::memory_order_relaxed);
+    return lsn;
+}
+
+void EmbeddedStore::wait_durable(std::uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(log_mutex_);
+    durable_.wait(lock, [&] { return durable_lsn_ >= lsn || failed_; });
+    if (durable_lsn_ < lsn) {
+        throw std::runtime_error("embedded log write failed");
+    }
+}
+
+bool EmbeddedStore::load_snapshot(std::uint64_t& lsn) {
+    auto snapshots = numbered_files(options_.directory, ".snap");
+    if (snapshots.empty()) {
+        lsn = 0;
+        return true;
+    }
+    
+    std::string path = snapshot_path(snapshots.back());
+    std::string data;
+    if (!read_file(path, data) || data.size() < sizeof(kSnapshotMagic) + 8 ||
+        data.compare(0, sizeof(kSnapshotMagic), kSnapshotMagic, sizeof(kSnapshotMagic)) != 0) {
+        Logger::get()->error("Embedded snapshot {} unreadable", path);
+        return false;
+    }
+    lsn = get_u64(data.data() + sizeof(kSnapshotMagic));
+    
+    bool torn = false;
+    auto payloads = read_frames(data, sizeof(kSnapshotMagic) + 8, torn);
+    if (torn) {
+        Logger::get()->error("Embedded snapshot {} is damaged", path);
+        return false;
+    }
+    
+    try {
+        for (const auto& payload : payloads) {
+            std::uint64_t record_lsn = 0;
+            std::vector<EmbeddedOp> ops;
+            if (!decode_ops(payload, record_lsn, ops)) {
+                throw std::invalid_argument("undecodable record");
+            }
+            for (const auto& op : ops) {
+                apply_op(op, nullptr);
+            }
+        }
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to load embedded snapshot {}: {}", path, e.what());
+        return false;
+    }
+    
+    snapshot_lsn_ = lsn;
+    Logger::get()->info("Loaded embedded snapshot at log position {}", lsn);
+    return true;
+}
+
+bool EmbeddedStore::replay_log(std::uint64_t& lsn) {
+    std::uint64_t replayed = 0;
+    for (std::uint64_t segment : numbered_files(options_.directory, ".log")) {
+        std::string path = segment_path(segment);
+        std::string data;
+        if (!read_file(path, data)) {
+            Logger::get()->error("Failed to read embedded log segment {}", path);
+            return false;
+        }
+        
+        bool torn = false;
+        for (const auto& payload : read_frames(data, 0, torn)) {
+            std::uint64_t record_lsn = 0;
+            std::vector<EmbeddedOp> ops;
+            if (!decode_ops(payload, record_lsn, ops)) {
+                Logger::get()->error("Undecodable record in embedded log segment {}", path);
+                return false;
+            }
+            if (record_lsn <= lsn) {
+                continue;  // in the snapshot
+            }
+            if (record_lsn != lsn + 1) {
+                Logger::get()->error("Embedded log jumps from {} to {} in {}", lsn, record_lsn, path);
+                return false;
+            }
+            
+            try {
+                for (const auto& op : ops) {
+                    apply_op(op, nullptr);
+                }
+            } catch (const std::exception& e) {
+                Logger::get()->error("Failed to replay embedded log record {}: {}", record_lsn, e.what());
+                return false;
+            }
+            lsn = record_lsn;
+            ++replayed;
+        }
+        if (torn) {
+            // Left by a crash mid-write; that commit was never acknowledged
+            Logger::get()->warn("Embedded log segment {} ends in a torn record", path);
+        }
+    }
+    
+    if (replayed > 0) {
+        Logger::get()->info("Replayed {} embedded log records up to {}", replayed, lsn);
+    }
+    return true;
+}
+
+bool EmbeddedStore::open_segment(std::uint64_t first_lsn) {
+    std::string path = segment_path(first_lsn);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        Logger::get()->error("Failed to open embedded log segment {}: {}", path, std::strerror(errno));
+        return false;
+    }
+    // The new segment's directory entry has to be durable too
+    FileIo::sync_directory(options_.directory);
+    
+    fd_ = fd;
+    segment_ = first_lsn;
+    segment_size_ = 0;
+    return true;
+}
+
+void EmbeddedStore::writer_loop() {
+    static auto& group_commits = Metrics::counter("embedded.group_commits");
+    
+    for (;;) {
+        std::vector<std::string> batch;
+        std::uint64_t last = 0;
+        {
+            std::unique_lock<std::mutex> lock(log_mutex_);
+            queued_.wait(lock, [&] { return !queue_.empty() || stopping_; });
+            if (queue_.empty()) {
+                break;
+            }
+            batch.swap(queue_);
+            last = queued_lsn_;
+        }
+        
+        // Everything committed while the last fdatasync ran goes out in one write
+        std::string buffer;
+        for (const auto& record : batch) {
+            buffer += record;
+        }
+        bool ok = FileIo::write_all(fd_, buffer) && ::fdatasync(fd_) == 0;
+        int error = errno;
+        
+        {
+            std::lock_guard<std::mutex> lock(log_mutex_);
+            if (ok) {
+                durable_lsn_ = last;
+                segment_size_ += buffer.size();
+            } else {
+                failed_ = true;
+            }
+        }
+        durable_.notify_all();
+        
+        if (!ok) {
+            Logger::get()->error("Embedded log write to segment {} failed: {}", segment_, std::strerror(error));
+            break;
+        }
+        group_commits.fetch_add(1, std::memory_order_relaxed);
+        
+        if (segment_size_ >= options_.segment_bytes) {
+            ::close(fd_);
+            fd_ = -1;
+            std::lock_guard<std::mutex> lock(log_mutex_);
+            if (!open_segment(last + 1)) {
+                failed_ = true;
+                break;
+            }
+        }
+    }
+    durable_.notify_all();
+}
+
+void EmbeddedStore::snapshot_loop() {
+    std::unique_lock<std::mutex> lock(snapshot_mutex_);
+    while (!snapshot_stopping_) {
+        snapshot_wake_.wait_for(lock, options_.snapshot_interval, [&] { return snapshot_stopping_; });
+        if (snapshot_stopping_) {
+            break;
+        }
+        
+        std::uint64_t pending = 0;
+        {
+            auto tables = read_lock();
+            pending = next_lsn_ - 1 - snapshot_lsn_;
+        }
+        if (pending >= options_.snapshot_min_commits) {
+            lock.unlock();
+            take_snapshot();
+            lock.lock();
+        }
+    }
+}
+
+bool EmbeddedStore::take_snapshot() {
+    static auto& snapshots = Metrics::counter("embedded.snapshots");
+    
+    std::string data(kSnapshotMagic, sizeof(kSnapshotMagic));
+    std::uint64_t lsn = 0;
+    {
+        // Writers wait while the tables are copied out
+        auto lock = read_lock();
+        lsn = next_lsn_ - 1;
+        if (lsn == snapshot_lsn_) {
+            return true;
+        }
+        put_u64(data, lsn);
+        
+        std::vector<EmbeddedOp> ops;
+        auto add = [&](EmbeddedOp::Type type, std::vector<std::string> fields) {
+            ops.push_back(EmbeddedOp{type, std::move(fields)});
+            if (ops.size() >= kSnapshotBatch) {
+                data += frame(encode_ops(lsn, ops.data(), ops.data() + ops.size()));
+                ops.clear();
+            }
+        };
+        const auto& t = tables_;
+        
+        for (const auto& [id, user] : t.users) {
+            add(EmbeddedOp::CreateUser, {id, user.username, user.email, user.password_hash,
+                                         user.display_name, user.status});
+        }
+        for (const auto& [id, row] : t.groups) {
+            add(EmbeddedOp::CreateGroup, {id, row.group.group_name, row.group.description,
+                                          row.group.created_by});
+            for (const auto& [user_id, role] : row.roles) {
+                add(EmbeddedOp::AddMember, {id, user_id, role});
+            }
+        }
+        // Before the messages, so loading them leaves read_through to the
+        // ReadThrough ops
+        for (const auto& [user_id, marks] : t.read_marks) {
+            for (const auto& [conversation, read_at] : marks) {
+                add(EmbeddedOp::SaveReadMark, {user_id, conversation, read_at});
+            }
+        }
+        for (const auto& [key, conversation] : t.conversations) {
+            for (const auto& stored : conversation.messages) {
+                const Message& msg = stored.message;
+                add(EmbeddedOp::InsertMessage, {msg.message_id, msg.sender_id, msg.recipient_id,
+                                                msg.group_id, msg.content, msg.message_type,
+                                                msg.created_at, std::to_string(msg.seq),
+                                                stored.idempotency_key});
+                if (msg.is_read) {
+                    add(EmbeddedOp::MarkMessageRead, {msg.message_id});
+                }
+            }
+            for (const auto& [user_id, seq] : conversation.read_through) {
+                add(EmbeddedOp::ReadThrough, {key, user_id, std::to_string(seq)});
+            }
+        }
+        for (const auto& [id, request] : t.friend_requests) {
+            add(EmbeddedOp::SendFriendRequest, {id, request.sender_id, request.receiver_id,
+                                                request.created_at});
+            if (request.status != "pending") {
+                add(EmbeddedOp::SetRequestStatus, {id, request.status});
+            }
+        }
+        for (const auto& [user_id, friends] : t.friends) {
+            for (const auto& friend_id : friends) {
+                if (user_id < friend_id) {
+                    add(EmbeddedOp::AddFriendship, {user_id, friend_id});
+                }
+            }
+        }
+        if (!ops.empty()) {
+            data += frame(encode_ops(lsn, ops.data(), ops.data() + ops.size()));
+        }
+    }
+    
+    if (!FileIo::write_file_durably(snapshot_path(lsn), data)) {
+        Logger::get()->error("Failed to write embedded snapshot at log position {}: {}",
+                            lsn, std::strerror(errno));
+        return false;
+    }
+    snapshot_lsn_ = lsn;
+    snapshots.fetch_add(1, std::memory_order_relaxed);
+    
+    // Older snapshots and segments whose records are all in this one go
+    std::uint64_t open_segment = 0;
+    {
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        open_segment = segment_;
+    }
+    std::error_code ec;
+    auto segments = numbered_files(options_.directory, ".log");
+    for (std::size_t i = 0; i + 1 < segments.size() && segments[i] < open_segment; ++i) {
+        if (segments[i + 1] - 1 <= lsn) {
+            fs::remove(segment_path(segments[i]), ec);
+        }
+    }
+    for (std::uint64_t older : numbered_files(options_.directory, ".snap")) {
+        if (older < lsn) {
+            fs::remove(snapshot_path(older), ec);
+        }
+    }
+    
+    Logger::get()->info("Embedded snapshot at log position {} ({} KiB)", lsn, data.size() / 1024);
+    return true;
+}
+
+std::string EmbeddedStore::segment_path(std::uint64_t first_lsn) const {
+    return numbered_path(options_.directory, first_lsn, ".log");
+}
+
+std::string EmbeddedStore::snapshot_path(std::uint64_t lsn) const {
+    return numbered_path(options_.directory, lsn, ".snap");
+}
@@ -0,0 +1,388 @@
+// src/database/journal.cpp
+#include "database/journal.hpp"
+#include "utils/logger.hpp"
+#include "utils/metrics.hpp"
+#include "utils/file_io.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+// Each record: length and CRC-32 of the payload, little endian, then the payload
+constexpr std::size_t kHeaderBytes = 8;
+// Anything longer is a damaged header, not a record
+constexpr std::uint32_t kMaxRecordBytes = 16 * 1024 * 1024;
+
+void put_u32(std::string& out, std::uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+std::uint32_t get_u32(const unsigned char* in) {
+    return static_cast<std::uint32_t>(in[0]) |
+           static_cast<std::uint32_t>(in[1]) << 8 |
+           static_cast<std::uint32_t>(in[2]) << 16 |
+           static_cast<std::uint32_t>(in[3]) << 24;
+}
+
+bool parse_segment_name(const std::string& name, std::uint64_t& segment) {
+    unsigned long long number = 0;
+    char tail = 0;
+    if (std::sscanf(name.c_str(), "segment-%llu.lo%c", &number, &tail) != 2 || tail != 'g' ||
+        name.size() != std::string("segment-000000000000.log").size()) {
+        return false;
+    }
+    segment = number;
+    return true;
+}
+}
+
+Journal::Journal(JournalOptions options)
+    : options_(std::move(options)) {
+}
+
+Journal::~Journal() {
+    stop();
+}
+
+bool Journal::start(Apply apply) {
+    apply_ = std::move(apply);
+    
+    std::error_code ec;
+    fs::create_directories(options_.directory, ec);
+    if (ec) {
+        Logger::get()->error("Journal directory {} unusable: {}", options_.directory, ec.message());
+        return false;
+    }
+    
+    std::uint64_t first = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t last = 0;
+    for (const auto& entry : fs::directory_iterator(options_.directory, ec)) {
+        std::uint64_t segment = 0;
+        if (parse_segment_name(entry.path().filename().string(), segment)) {
+            first = std::min(first, segment);
+            last = std::max(last, segment);
+        }
+    }
+    if (ec) {
+        Logger::get()->error("Failed to list journal {}: {}", options_.directory, ec.message());
+        return false;
+    }
+    
+    // Every segment left behind is complete: this run writes a new one
+    Position position = load_checkpoint();
+    if (last > 0 && position.segment < first) {
+        position = Position{first, 0};
+    }
+    if (last > 0) {
+        Logger::get()->info("Replaying journal segments {} to {}...", position.segment, last);
+    }
+    while (last > 0 && position.segment <= last) {
+        if (!drain_batch(position, std::numeric_limits<std::uint64_t>::max(), true)) {
+            Logger::get()->error("Journal replay stopped at segment {} offset {}",
+                                position.segment, position.offset);
+            return false;
+        }
+    }
+    
+    if (!open_segment(std::max<std::uint64_t>(1, std::max(position.segment, last + 1)))) {
+        return false;
+    }
+    drained_ = Position{segment_, 0};
+    save_checkpoint(drained_);
+    
+    writer_ = std::thread([this] { writer_loop(); });
+    drainer_ = std::thread([this] { drainer_loop(); });
+    Logger::get()->info("Journal writing segment {} in {}", segment_, options_.directory);
+    return true;
+}
+
+void Journal::append(std::string record) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (failed_ || stopping_ || !writer_.joinable()) {
+        throw std::runtime_error("journal is not accepting writes");
+    }
+    
+    queue_.push_back(std::move(record));
+    std::uint64_t mine = ++appended_;
+    queued_.notify_one();
+    durable_.wait(lock, [&] { return synced_ >= mine || failed_; });
+    if (synced_ < mine) {
+        throw std::runtime_error("journal write failed");
+    }
+}
+
+void Journal::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    queued_.notify_all();
+    written_.notify_all();
+    
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+    if (drainer_.joinable()) {
+        drainer_.join();
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+void Journal::writer_loop() {
+    static auto& commits = Metrics::counter("journal.group_commits");
+    static auto& appended = Metrics::counter("journal.appended");
+    
+    for (;;) {
+        std::vector<std::string> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queued_.wait(lock, [&] { return !queue_.empty() || stopping_; });
+            if (queue_.empty()) {
+                break;
+            }
+            batch.swap(queue_);
+        }
+        
+        // Everything queued while the last fdatasync ran goes out in one write
+        std::string buffer;
+        for (const auto& record : batch) {
+            put_u32(buffer, static_cast<std::uint32_t>(record.size()));
+            put_u32(buffer, FileIo::crc32(record));
+            buffer += record;
+        }
+        bool ok = FileIo::write_all(fd_, buffer) && ::fdatasync(fd_) == 0;
+        int error = errno;
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (ok) {
+                synced_ += batch.size();
+                segment_size_ += buffer.size();
+            } else {
+                failed_ = true;
+            }
+        }
+        durable_.notify_all();
+        written_.notify_all();
+        
+        if (!ok) {
+            Logger::get()->error("Journal write to segment {} failed: {}", segment_, std::strerror(error));
+            break;
+        }
+        commits.fetch_add(1, std::memory_order_relaxed);
+        appended.fetch_add(batch.size(), std::memory_order_relaxed);
+        
+        if (segment_size_ >= options_.segment_bytes) {
+            ::close(fd_);
+            fd_ = -1;
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!open_segment(segment_ + 1)) {
+                failed_ = true;
+                break;
+            }
+        }
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        writer_done_ = true;
+    }
+    durable_.notify_all();
+    written_.notify_all();
+}
+
+void Journal::drainer_loop() {
+    Position position = drained_;
+    bool retrying = false;
+    
+    for (;;) {
+        std::uint64_t limit = 0;
+        bool complete = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (retrying) {
+                written_.wait_for(lock, options_.retry_delay, [&] { return stopping_; });
+            }
+            written_.wait(lock, [&] {
+                return position.segment < segment_ || position.offset < segment_size_ || writer_done_;
+            });
+            complete = position.segment < segment_;
+            limit = complete ? std::numeric_limits<std::uint64_t>::max() : segment_size_;
+            if (!complete && position.offset >= limit) {
+                break;  // writer finished and everything is drained
+            }
+        }
+        
+        bool stopping_now = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_now = stopping_;
+        }
+        if (drain_batch(position, limit, complete)) {
+            retrying = false;
+        } else if (stopping_now) {
+            Logger::get()->warn("Journal not fully drained; the rest is replayed on next start");
+            break;
+        } else {
+            retrying = true;
+        }
+    }
+}
+
+bool Journal::drain_batch(Position& position, std::uint64_t limit, bool segment_complete) {
+    static auto& drained = Metrics::counter("journal.drained");
+    
+    std::vector<std::string> records;
+    std::uint64_t offset = position.offset;
+    bool at_end = false;
+    bool torn = false;
+    
+    std::ifstream in(segment_path(position.segment), std::ios::binary);
+    if (!in) {
+        at_end = true;
+    } else {
+        in.seekg(static_cast<std::streamoff>(offset));
+        while (records.size() < options_.drain_batch) {
+            unsigned char header[kHeaderBytes];
+            if (offset + kHeaderBytes > limit ||
+                !in.read(reinterpret_cast<char*>(header), kHeaderBytes)) {
+                at_end = true;
+                break;
+            }
+            std::uint32_t length = get_u32(header);
+            std::uint32_t crc = get_u32(header + 4);
+            if (length > kMaxRecordBytes || offset + kHeaderBytes + length > limit) {
+                at_end = torn = true;
+                break;
+            }
+            
+            std::string record(length, '\0');
+            if (!in.read(&record[0], length) || FileIo::crc32(record) != crc) {
+                at_end = torn = true;
+                break;
+            }
+            records.push_back(std::move(record));
+            offset += kHeaderBytes + length;
+        }
+    }
+    
+    if (torn && segment_complete) {
+        // Left by a crash mid-write; that record was never acknowledged
+        Logger::get()->warn("Journal segment {} ends in a torn record at offset {}",
+                           position.segment, offset);
+    }
+    
+    if (!records.empty()) {
+        if (!apply_(records)) {
+            return false;
+        }
+        drained.fetch_add(records.size(), std::memory_order_relaxed);
+        position.offset = offset;
+    }
+    
+    if (at_end && segment_complete) {
+        std::error_code ec;
+        fs::remove(segment_path(position.segment), ec);
+        position = Position{position.segment + 1, 0};
+    }
+    if (!records.empty() || (at_end && segment_complete)) {
+        save_checkpoint(position);
+    }
+    return true;
+}
+
+bool Journal::open_segment(std::uint64_t segment) {
+    std::string path = segment_path(segment);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        Logger::get()->error("Failed to open journal segment {}: {}", path, std::strerror(errno));
+        return false;
+    }
+    // The new segment's directory entry has to be durable too
+    FileIo::sync_directory(options_.directory);
+    
+    fd_ = fd;
+    segment_ = segment;
+    segment_size_ = 0;
+    return true;
+}
+
+bool Journal::reject(const std::vector<std::string>& records) {
+    static auto& rejected = Metrics::counter("journal.rejected");
+    
+    std::string path = (fs::path(options_.directory) / "rejected.log").string();
+    std::error_code ec;
+    bool created = !fs::exists(path, ec);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        Logger::get()->error("Failed to open {}: {}", path, std::strerror(errno));
+        return false;
+    }
+    std::string buffer;
+    for (const auto& record : records) {
+        put_u32(buffer, static_cast<std::uint32_t>(record.size()));
+        put_u32(buffer, FileIo::crc32(record));
+        buffer += record;
+    }
+    bool ok = FileIo::write_all(fd, buffer) && ::fdatasync(fd) == 0;
+    int error = errno;
+    ::close(fd);
+    if (!ok) {
+        Logger::get()->error("Failed to write {}: {}", path, std::strerror(error));
+        return false;
+    }
+    if (created) {
+        FileIo::sync_directory(options_.directory);
+    }
+    rejected.fetch_add(records.size(), std::memory_order_relaxed);
+    return true;
+}
+
+std::string Journal::segment_path(std::uint64_t segment) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "segment-%012llu.log", static_cast<unsigned long long>(segment));
+    return (fs::path(options_.directory) / name).string();
+}
+
+Journal::Position Journal::load_checkpoint() const {
+    Position position{0, 0};
+    std::ifstream in(fs::path(options_.directory) / "checkpoint");
+    unsigned long long segment = 0;
+    unsigned long long offset = 0;
+    if (in >> segment >> offset) {
+        position = Position{segment, offset};
+    }
+    return position;
+}
+
+void Journal::save_checkpoint(const Position& position) const {
+    // Not synced: losing it only means applying some records again
+    fs::path path = fs::path(options_.directory) / "checkpoint";
+    fs::path tmp = fs::path(options_.directory) / "checkpoint.tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << position.segment << ' ' << position.offset << '\n';
+        if (!out) {
+            Logger::get()->error("Failed to write journal checkpoint");
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        Logger::get()->error("Failed to save journal checkpoint: {}", ec.message());
+    }
+}
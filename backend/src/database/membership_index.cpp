@@ -0,0 +1,137 @@
+// src/database/membership_index.cpp
+#include "database/membership_index.hpp"
+#include <algorithm>
+#include <mutex>
+
+MembershipIndex::MembershipIndex(std::size_t max_entries)
+    : version_(0)
+    , max_entries_(std::max<std::size_t>(1, max_entries)) {
+}
+
+IdSetPtr MembershipIndex::members(const std::string& group_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = members_.find(group_id);
+    return it == members_.end() ? nullptr : it->second;
+}
+
+IdSetPtr MembershipIndex::groups(const std::string& user_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = groups_.find(user_id);
+    return it == groups_.end() ? nullptr : it->second;
+}
+
+std::uint64_t MembershipIndex::version() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return version_;
+}
+
+IdSetPtr MembershipIndex::install_members(const std::string& group_id,
+                                          IdSet members,
+                                          std::uint64_t version) {
+    std::sort(members.begin(), members.end());
+    members.erase(std::unique(members.begin(), members.end()), members.end());
+    auto set = std::make_shared<const IdSet>(std::move(members));
+    
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (version == version_) {
+        install(members_, group_id, set);
+    }
+    return set;
+}
+
+IdSetPtr MembershipIndex::install_groups(const std::string& user_id,
+                                         IdSet groups,
+                                         std::uint64_t version) {
+    std::sort(groups.begin(), groups.end());
+    groups.erase(std::unique(groups.begin(), groups.end()), groups.end());
+    auto set = std::make_shared<const IdSet>(std::move(groups));
+    
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (version == version_) {
+        install(groups_, user_id, set);
+    }
+    return set;
+}
+
+void MembershipIndex::created(const std::string& group_id, const std::string& creator_id) {
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        install(members_, group_id, std::make_shared<const IdSet>(IdSet{creator_id}));
+    }
+    add(group_id, creator_id);
+}
+
+void MembershipIndex::add(const std::string& group_id, const std::string& user_id) {
+    update(group_id, user_id, true);
+    if (listener_) {
+        listener_(group_id, user_id, true);
+    }
+}
+
+void MembershipIndex::remove(const std::string& group_id, const std::string& user_id) {
+    update(group_id, user_id, false);
+    if (listener_) {
+        listener_(group_id, user_id, false);
+    }
+}
+
+void MembershipIndex::apply(const std::string& group_id, const std::string& user_id, bool added) {
+    update(group_id, user_id, added);
+}
+
+void MembershipIndex::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    members_.clear();
+    groups_.clear();
+    ++version_;
+}
+
+void MembershipIndex::set_listener(Listener listener) {
+    listener_ = std::move(listener);
+}
+
+bool MembershipIndex::contains(const IdSet& set, const std::string& id) {
+    return std::binary_search(set.begin(), set.end(), id);
+}
+
+void MembershipIndex::update(const std::string& group_id, const std::string& user_id, bool added) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    update_entry(members_, group_id, user_id, added);
+    update_entry(groups_, user_id, group_id, added);
+    ++version_;
+}
+
+void MembershipIndex::install(Map& map, const std::string& key, IdSetPtr set) {
+    // Any entry can be reloaded, so the cheapest one to find goes
+    if (map.size() >= max_entries_ && map.find(key) == map.end()) {
+        map.erase(map.begin());
+    }
+    map[key] = std::move(set);
+}
+
+void MembershipIndex::update_entry(Map& map, const std::string& key,
+                                   const std::string& id, bool added) {
+    auto it = map.find(key);
+    if (it == map.end()) {
+        return;  // loaded later, the database already has the change
+    }
+    
+    const IdSet& current = *it->second;
+    auto pos = std::lower_bound(current.begin(), current.end(), id);
+    bool present = pos != current.end() && *pos == id;
+    if (present == added) {
+        return;
+    }
+    
+    // Copy on write: readers may still hold the old set
+    IdSet next;
+    next.reserve(current.size() + 1);
+    next.insert(next.end(), current.begin(), pos);
+    if (added) {
+        next.push_back(id);
+        next.insert(next.end(), pos, current.end());
+    } else {
+        next.insert(next.end(), pos + 1, current.end());
+    }
+    it->second = std::make_shared<const IdSet>(std::move(next));
+}
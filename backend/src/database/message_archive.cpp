@@ -0,0 +1,766 @@
+// src/database/message_archive.cpp
+#include "database/message_archive.hpp"
+#include "utils/file_io.hpp"
+#include "utils/logger.hpp"
+#include "utils/metrics.hpp"
+#include <zstd.h>
+#include <zdict.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+// Segment layout, little endian:
+//   header  "CHATARC1", u32 dictionary id (0: none), u32 block count,
+//           u64 first seq, u64 last seq
+//   index   per block: u64 first seq, u64 offset, u32 compressed size, u32 messages
+//   blocks  one zstd frame each
+constexpr char kMagic[8] = {'C', 'H', 'A', 'T', 'A', 'R', 'C', '1'};
+constexpr std::size_t kHeaderBytes = 32;
+constexpr std::size_t kIndexEntryBytes = 24;
+constexpr std::size_t kBlockMessages = 64;
+// A decompressed block claiming more than this is damaged
+constexpr unsigned long long kMaxBlockBytes = 64 * 1024 * 1024;
+
+constexpr std::size_t kDictionaryBytes = 64 * 1024;
+constexpr std::size_t kDictionarySamples = 20000;
+constexpr std::size_t kMinDictionarySamples = 1000;
+constexpr int kMaxConversationsPerRun = 1000;
+
+const char* kColumns =
+    "message_id, sender_id, recipient_id, group_id, content, "
+    "message_type, created_at, is_read, conversation_seq";
+
+void put_u32(std::string& out, std::uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+void put_u64(std::string& out, std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+std::uint32_t get_u32(const unsigned char* in) {
+    std::uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<std::uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+std::uint64_t get_u64(const unsigned char* in) {
+    std::uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value |= static_cast<std::uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+void put_string(std::string& out, const std::string& value) {
+    put_u32(out, static_cast<std::uint32_t>(value.size()));
+    out += value;
+}
+
+bool get_string(const std::string& in, std::size_t& pos, std::string& value) {
+    if (in.size() - pos < 4) {
+        return false;
+    }
+    std::uint32_t size = get_u32(reinterpret_cast<const unsigned char*>(in.data() + pos));
+    pos += 4;
+    if (in.size() - pos < size) {
+        return false;
+    }
+    value.assign(in, pos, size);
+    pos += size;
+    return true;
+}
+
+void encode_message(std::string& out, const Message& msg) {
+    for (const std::string* field : {&msg.message_id, &msg.sender_id, &msg.recipient_id,
+                                     &msg.group_id, &msg.content, &msg.message_type,
+                                     &msg.created_at}) {
+        put_string(out, *field);
+    }
+    out.push_back(msg.is_read ? 1 : 0);
+    put_u64(out, msg.seq);
+}
+
+bool decode_message(const std::string& in, std::size_t& pos, Message& msg) {
+    for (std::string* field : {&msg.message_id, &msg.sender_id, &msg.recipient_id,
+                               &msg.group_id, &msg.content, &msg.message_type,
+                               &msg.created_at}) {
+        if (!get_string(in, pos, *field)) {
+            return false;
+        }
+    }
+    if (in.size() - pos < 9) {
+        return false;
+    }
+    msg.is_read = in[pos] != 0;
+    msg.seq = get_u64(reinterpret_cast<const unsigned char*>(in.data() + pos + 1));
+    pos += 9;
+    return true;
+}
+
+Message message_from_row(const pqxx::row& row) {
+    Message msg;
+    msg.message_id = row["message_id"].as<std::string>();
+    msg.sender_id = row["sender_id"].as<std::string>();
+    msg.recipient_id = row["recipient_id"].is_null() ? "" : row["recipient_id"].as<std::string>();
+    msg.group_id = row["group_id"].is_null() ? "" : row["group_id"].as<std::string>();
+    msg.content = row["content"].as<std::string>();
+    msg.message_type = row["message_type"].as<std::string>();
+    msg.created_at = row["created_at"].as<std::string>();
+    msg.is_read = row["is_read"].as<bool>();
+    msg.seq = row["conversation_seq"].as<std::uint64_t>();
+    return msg;
+}
+
+// Conversation keys hold ':' and user ids; directory names are their hex
+std::string hex_encode(const std::string& in) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    out.reserve(in.size() * 2);
+    for (unsigned char c : in) {
+        out.push_back(digits[c >> 4]);
+        out.push_back(digits[c & 0x0F]);
+    }
+    return out;
+}
+
+bool hex_decode(const std::string& in, std::string& out) {
+    if (in.size() % 2 != 0) {
+        return false;
+    }
+    auto nibble = [](char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    };
+    out.clear();
+    for (std::size_t i = 0; i < in.size(); i += 2) {
+        int high = nibble(in[i]);
+        int low = nibble(in[i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        out.push_back(static_cast<char>(high << 4 | low));
+    }
+    return true;
+}
+
+std::string segment_name(std::uint64_t first_seq, std::uint64_t last_seq) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "%020llu-%020llu.seg",
+                  static_cast<unsigned long long>(first_seq),
+                  static_cast<unsigned long long>(last_seq));
+    return name;
+}
+
+struct DctxDeleter {
+    void operator()(ZSTD_DCtx* dctx) const { ZSTD_freeDCtx(dctx); }
+};
+}
+
+// A segment file mapped read-only; unmapped when the last reader lets go.
+class MessageArchive::Mapping {
+public:
+    struct Block {
+        std::uint64_t first_seq;
+        std::uint64_t offset;
+        std::uint32_t size;
+        std::uint32_t messages;
+    };
+    
+    static std::shared_ptr<Mapping> open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return nullptr;
+        }
+        struct stat st {};
+        if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < kHeaderBytes) {
+            ::close(fd);
+            return nullptr;
+        }
+        std::size_t size = static_cast<std::size_t>(st.st_size);
+        void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            return nullptr;
+        }
+        
+        auto mapping = std::shared_ptr<Mapping>(new Mapping(static_cast<const unsigned char*>(data), size));
+        if (std::memcmp(mapping->data_, kMagic, sizeof(kMagic)) != 0 ||
+            (size - kHeaderBytes) / kIndexEntryBytes < mapping->block_count()) {
+            return nullptr;
+        }
+        return mapping;
+    }
+    
+    ~Mapping() {
+        ::munmap(const_cast<unsigned char*>(data_), size_);
+    }
+    
+    std::uint32_t dictionary_id() const { return get_u32(data_ + 8); }
+    std::size_t block_count() const { return get_u32(data_ + 12); }
+    
+    Block block(std::size_t i) const {
+        const unsigned char* entry = data_ + kHeaderBytes + i * kIndexEntryBytes;
+        return Block{get_u64(entry), get_u64(entry + 8), get_u32(entry + 16), get_u32(entry + 20)};
+    }
+    
+    // The block that would hold `seq`: the last one starting at or below it
+    std::size_t find_block(std::uint64_t seq) const {
+        std::size_t low = 0;
+        std::size_t high = block_count();
+        while (low < high) {
+            std::size_t mid = (low + high) / 2;
+            if (block(mid).first_seq <= seq) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low == 0 ? 0 : low - 1;
+    }
+    
+    const unsigned char* bytes(const Block& b) const {
+        return b.offset <= size_ && b.size <= size_ - b.offset ? data_ + b.offset : nullptr;
+    }
+
+private:
+    Mapping(const unsigned char* data, std::size_t size)
+        : data_(data)
+        , size_(size) {
+    }
+    
+    const unsigned char* data_;
+    std::size_t size_;
+};
+
+MessageArchive::MessageArchive(Database& db, ArchiveOptions options)
+    : db_(db)
+    , options_(std::move(options)) {
+}
+
+MessageArchive::~MessageArchive() {
+    stop();
+    for (auto& entry : ddicts_) {
+        ZSTD_freeDDict(entry.second);
+    }
+    if (cdict_) {
+        ZSTD_freeCDict(cdict_);
+    }
+    if (cctx_) {
+        ZSTD_freeCCtx(cctx_);
+    }
+}
+
+bool MessageArchive::open() {
+    std::error_code ec;
+    fs::path root(options_.directory);
+    fs::create_directories(root / "dictionaries", ec);
+    if (ec) {
+        Logger::get()->error("Archive directory {} unusable: {}", options_.directory, ec.message());
+        return false;
+    }
+    
+    for (const auto& entry : fs::directory_iterator(root / "dictionaries", ec)) {
+        if (entry.path().extension() == ".zdict") {
+            load_dictionary(entry.path().string());
+        }
+    }
+    
+    std::size_t segments = 0;
+    for (const auto& dir : fs::directory_iterator(root, ec)) {
+        std::string conversation;
+        if (!dir.is_directory() || !hex_decode(dir.path().filename().string(), conversation)) {
+            continue;
+        }
+        auto& list = catalog_[conversation];
+        for (const auto& file : fs::directory_iterator(dir.path(), ec)) {
+            unsigned long long first = 0;
+            unsigned long long last = 0;
+            std::string name = file.path().filename().string();
+            if (name.size() == segment_name(0, 0).size() &&
+                std::sscanf(name.c_str(), "%20llu-%20llu.seg", &first, &last) == 2) {
+                list.push_back(SegmentInfo{first, last, file.path().string()});
+            }
+        }
+        std::sort(list.begin(), list.end(), [](const SegmentInfo& a, const SegmentInfo& b) {
+            return a.first_seq < b.first_seq;
+        });
+        segments += list.size();
+    }
+    if (ec) {
+        Logger::get()->error("Failed to read archive {}: {}", options_.directory, ec.message());
+        return false;
+    }
+    
+    cctx_ = ZSTD_createCCtx();
+    Logger::get()->info("Archive holds {} segments of {} conversations", segments, catalog_.size());
+    return cctx_ != nullptr;
+}
+
+void MessageArchive::start() {
+    worker_ = std::thread([this] {
+        std::unique_lock<std::mutex> lock(worker_mutex_);
+        while (!stopping_) {
+            lock.unlock();
+            run_once();
+            lock.lock();
+            wake_.wait_for(lock, options_.interval, [&] { return stopping_; });
+        }
+    });
+}
+
+void MessageArchive::stop() {
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+std::size_t MessageArchive::run_once() {
+    std::vector<std::string> conversations;
+    try {
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
+        auto result = txn.exec_params(
+            "SELECT COALESCE('group:' || group_id::text, 'dm:' || conversation_id) AS conversation "
+            "FROM messages "
+            "WHERE created_at < NOW() - make_interval(secs => $1::double precision) "
+            "  AND conversation_seq IS NOT NULL "
+            "GROUP BY 1 HAVING COUNT(*) > $2 LIMIT $3",
+            static_cast<double>(options_.max_age.count()),
+            static_cast<long long>(options_.min_messages), kMaxConversationsPerRun
+        );
+        txn.commit();
+        for (const auto& row : result) {
+            conversations.push_back(row["conversation"].as<std::string>());
+        }
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to find conversations to archive: {}", e.what());
+        return 0;
+    }
+    if (conversations.empty()) {
+        return 0;
+    }
+    
+    bool has_dictionary;
+    {
+        std::lock_guard<std::mutex> lock(dictionary_mutex_);
+        has_dictionary = dictionary_id_ != 0;
+    }
+    if (!has_dictionary) {
+        train_dictionary();
+    }
+    
+    static auto& archived = Metrics::counter("archive.messages");
+    std::size_t total = 0;
+    for (const auto& conversation : conversations) {
+        {
+            std::lock_guard<std::mutex> lock(worker_mutex_);
+            if (stopping_) {
+                break;
+            }
+        }
+        total += archive_conversation(conversation);
+    }
+    archived.fetch_add(total, std::memory_order_relaxed);
+    Logger::get()->info("Archived {} messages from {} conversations", total, conversations.size());
+    return total;
+}
+
+std::size_t MessageArchive::archive_conversation(const std::string& conversation) {
+    bool group = conversation.rfind("group:", 0) == 0;
+    std::string id = conversation.substr(group ? 6 : 3);
+    std::string filter = group ? "group_id = $1" : "conversation_id = $1 AND group_id IS NULL";
+    // The latest message stays, so the conversation keeps its inbox row
+    std::string cold = filter +
+        " AND created_at < NOW() - make_interval(secs => $2::double precision)"
+        " AND conversation_seq < (SELECT MAX(conversation_seq) FROM messages WHERE " + filter + ")";
+    const double age = static_cast<double>(options_.max_age.count());
+    
+    std::vector<Message> messages;
+    std::string path;
+    bool committing = false;
+    try {
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
+        // The delete has to see exactly the rows that were written out
+        txn.exec("SET TRANSACTION ISOLATION LEVEL REPEATABLE READ");
+        
+        auto rows = txn.exec_params(
+            std::string("SELECT ") + kColumns + " FROM messages WHERE " + cold +
+            " ORDER BY conversation_seq LIMIT $3",
+            id, age, static_cast<long long>(options_.max_segment_messages)
+        );
+        if (rows.size() < options_.min_messages) {
+            return 0;
+        }
+        for (const auto& row : rows) {
+            messages.push_back(message_from_row(row));
+        }
+        
+        std::uint64_t first = messages.front().seq;
+        std::uint64_t last = messages.back().seq;
+        fs::create_directories(conversation_dir(conversation));
+        path = (fs::path(conversation_dir(conversation)) / segment_name(first, last)).string();
+        if (!write_segment(path, messages)) {
+            path.clear();
+            return 0;
+        }
+        
+        auto deleted = txn.exec_params(
+            "DELETE FROM messages WHERE " + cold + " AND conversation_seq BETWEEN $3 AND $4",
+            id, age, static_cast<long long>(first), static_cast<long long>(last)
+        );
+        if (deleted.affected_rows() != messages.size()) {
+            throw std::runtime_error("rows changed while being archived");
+        }
+        committing = true;
+        txn.commit();
+    } catch (const std::exception& e) {
+        // Only an error reported by the server proves the delete rolled back.
+        // An in-doubt or dropped commit may have removed the rows, so the
+        // segment stays; reads dedupe by seq if the rows are still there.
+        if (!committing || dynamic_cast<const pqxx::sql_error*>(&e)) {
+            Logger::get()->error("Failed to archive {}: {}", conversation, e.what());
+            if (!path.empty()) {
+                std::error_code ec;
+                fs::remove(path, ec);
+            }
+            return 0;
+        }
+        Logger::get()->warn("Archive commit for {} is in doubt, keeping {}: {}",
+                            conversation, path, e.what());
+        static auto& in_doubt = Metrics::counter("archive.commits_in_doubt");
+        in_doubt.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    {
+        std::unique_lock<std::shared_mutex> lock(catalog_mutex_);
+        auto& list = catalog_[conversation];
+        SegmentInfo info{messages.front().seq, messages.back().seq, path};
+        // A retry after a rolled-back commit rewrites the same segment
+        auto same = std::find_if(list.begin(), list.end(),
+                                 [&](const SegmentInfo& s) { return s.path == path; });
+        if (same != list.end()) {
+            return messages.size();
+        }
+        list.insert(std::upper_bound(list.begin(), list.end(), info,
+                                     [](const SegmentInfo& a, const SegmentInfo& b) {
+                                         return a.first_seq < b.first_seq;
+                                     }),
+                    info);
+    }
+    return messages.size();
+}
+
+bool MessageArchive::train_dictionary() {
+    std::string samples;
+    std::vector<std::size_t> sizes;
+    try {
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
+        auto rows = txn.exec_params(
+            std::string("SELECT ") + kColumns + " FROM messages "
+            "WHERE created_at < NOW() - make_interval(secs => $1::double precision) "
+            "  AND conversation_seq IS NOT NULL LIMIT $2",
+            static_cast<double>(options_.max_age.count()),
+            static_cast<long long>(kDictionarySamples)
+        );
+        txn.commit();
+        for (const auto& row : rows) {
+            std::size_t before = samples.size();
+            encode_message(samples, message_from_row(row));
+            sizes.push_back(samples.size() - before);
+        }
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to sample messages for the archive dictionary: {}", e.what());
+        return false;
+    }
+    if (sizes.size() < kMinDictionarySamples) {
+        return false;  // compressed without one until there is enough to learn from
+    }
+    
+    std::string dictionary(kDictionaryBytes, '\0');
+    std::size_t size = ZDICT_trainFromBuffer(&dictionary[0], dictionary.size(), samples.data(),
+                                             sizes.data(), static_cast<unsigned>(sizes.size()));
+    if (ZDICT_isError(size)) {
+        Logger::get()->warn("Archive dictionary training failed: {}", ZDICT_getErrorName(size));
+        return false;
+    }
+    dictionary.resize(size);
+    
+    std::uint32_t id = ZDICT_getDictID(dictionary.data(), dictionary.size());
+    std::string path = (fs::path(options_.directory) / "dictionaries" /
+                        (std::to_string(id) + ".zdict")).string();
+    if (!FileIo::write_file_durably(path, dictionary)) {
+        Logger::get()->error("Failed to save archive dictionary {}", path);
+        return false;
+    }
+    Logger::get()->info("Trained archive dictionary {} ({} bytes) from {} messages",
+                       id, size, sizes.size());
+    return load_dictionary(path);
+}
+
+bool MessageArchive::load_dictionary(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::uint32_t id = bytes.empty() ? 0 : ZDICT_getDictID(bytes.data(), bytes.size());
+    if (id == 0) {
+        Logger::get()->error("Archive dictionary {} is not readable", path);
+        return false;
+    }
+    
+    ZSTD_DDict* ddict = ZSTD_createDDict(bytes.data(), bytes.size());
+    ZSTD_CDict* cdict = ZSTD_createCDict(bytes.data(), bytes.size(), options_.compression_level);
+    if (!ddict || !cdict) {
+        ZSTD_freeDDict(ddict);
+        ZSTD_freeCDict(cdict);
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(dictionary_mutex_);
+    if (ddicts_.count(id)) {
+        ZSTD_freeDDict(ddict);
+        ZSTD_freeCDict(cdict);
+        return true;
+    }
+    ddicts_[id] = ddict;
+    if (cdict_) {
+        ZSTD_freeCDict(cdict_);
+    }
+    cdict_ = cdict;
+    dictionary_id_ = id;
+    return true;
+}
+
+bool MessageArchive::write_segment(const std::string& path, const std::vector<Message>& messages) {
+    ZSTD_CDict* cdict;
+    std::uint32_t dictionary_id;
+    {
+        std::lock_guard<std::mutex> lock(dictionary_mutex_);
+        cdict = cdict_;
+        dictionary_id = dictionary_id_;
+    }
+    
+    std::string index;
+    std::string blocks;
+    std::size_t block_count = (messages.size() + kBlockMessages - 1) / kBlockMessages;
+    std::size_t data_start = kHeaderBytes + block_count * kIndexEntryBytes;
+    for (std::size_t i = 0; i < messages.size(); i += kBlockMessages) {
+        std::size_t end = std::min(messages.size(), i + kBlockMessages);
+        std::string raw;
+        for (std::size_t j = i; j < end; ++j) {
+            encode_message(raw, messages[j]);
+        }
+        
+        std::string compressed(ZSTD_compressBound(raw.size()), '\0');
+        std::size_t size = cdict
+            ? ZSTD_compress_usingCDict(cctx_, &compressed[0], compressed.size(),
+                                       raw.data(), raw.size(), cdict)
+            : ZSTD_compressCCtx(cctx_, &compressed[0], compressed.size(),
+                                raw.data(), raw.size(), options_.compression_level);
+        if (ZSTD_isError(size)) {
+            Logger::get()->error("Archive compression failed: {}", ZSTD_getErrorName(size));
+            return false;
+        }
+        
+        put_u64(index, messages[i].seq);
+        put_u64(index, data_start + blocks.size());
+        put_u32(index, static_cast<std::uint32_t>(size));
+        put_u32(index, static_cast<std::uint32_t>(end - i));
+        blocks.append(compressed, 0, size);
+    }
+    
+    std::string file(kMagic, sizeof(kMagic));
+    put_u32(file, dictionary_id);
+    put_u32(file, static_cast<std::uint32_t>(block_count));
+    put_u64(file, messages.front().seq);
+    put_u64(file, messages.back().seq);
+    file += index;
+    file += blocks;
+    
+    if (!FileIo::write_file_durably(path, file)) {
+        Logger::get()->error("Failed to write archive segment {}", path);
+        return false;
+    }
+    return true;
+}
+
+std::uint64_t MessageArchive::last_seq(const std::string& conversation) const {
+    std::shared_lock<std::shared_mutex> lock(catalog_mutex_);
+    auto it = catalog_.find(conversation);
+    if (it == catalog_.end()) {
+        return 0;
+    }
+    std::uint64_t last = 0;
+    for (const auto& segment : it->second) {
+        last = std::max(last, segment.last_seq);
+    }
+    return last;
+}
+
+std::vector<Message> MessageArchive::read_before(const std::string& conversation,
+                                                 std::uint64_t before_seq,
+                                                 std::size_t limit) {
+    std::vector<Message> messages;
+    auto segments = segments_of(conversation);
+    for (auto segment = segments.rbegin(); segment != segments.rend(); ++segment) {
+        if (segment->first_seq >= before_seq) {
+            continue;
+        }
+        auto mapping = map_segment(segment->path);
+        if (!mapping || mapping->block_count() == 0) {
+            continue;
+        }
+        for (std::size_t b = mapping->find_block(before_seq - 1) + 1; b-- > 0;) {
+            auto block = read_block(*mapping, b);
+            for (auto msg = block.rbegin(); msg != block.rend(); ++msg) {
+                if (msg->seq < before_seq) {
+                    messages.push_back(std::move(*msg));
+                    if (messages.size() >= limit) {
+                        return messages;
+                    }
+                }
+            }
+        }
+    }
+    return messages;
+}
+
+std::vector<Message> MessageArchive::read_range(const std::string& conversation,
+                                                std::uint64_t from_seq,
+                                                std::uint64_t to_seq,
+                                                std::size_t limit) {
+    std::vector<Message> messages;
+    for (const auto& segment : segments_of(conversation)) {
+        if (segment.last_seq < from_seq || segment.first_seq > to_seq) {
+            continue;
+        }
+        auto mapping = map_segment(segment.path);
+        if (!mapping) {
+            continue;
+        }
+        for (std::size_t b = mapping->find_block(from_seq);
+             b < mapping->block_count() && mapping->block(b).first_seq <= to_seq; ++b) {
+            for (auto& msg : read_block(*mapping, b)) {
+                if (msg.seq >= from_seq && msg.seq <= to_seq) {
+                    messages.push_back(std::move(msg));
+                    if (messages.size() >= limit) {
+                        return messages;
+                    }
+                }
+            }
+        }
+    }
+    return messages;
+}
+
+std::vector<MessageArchive::SegmentInfo> MessageArchive::segments_of(const std::string& conversation) const {
+    std::shared_lock<std::shared_mutex> lock(catalog_mutex_);
+    auto it = catalog_.find(conversation);
+    return it == catalog_.end() ? std::vector<SegmentInfo>{} : it->second;
+}
+
+std::shared_ptr<MessageArchive::Mapping> MessageArchive::map_segment(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(mappings_mutex_);
+        auto it = mappings_.find(path);
+        if (it != mappings_.end()) {
+            mapping_lru_.splice(mapping_lru_.begin(), mapping_lru_, it->second.second);
+            return it->second.first;
+        }
+    }
+    
+    auto mapping = Mapping::open(path);
+    if (!mapping) {
+        Logger::get()->error("Archive segment {} is unreadable", path);
+        return nullptr;
+    }
+    
+    std::lock_guard<std::mutex> lock(mappings_mutex_);
+    auto it = mappings_.find(path);
+    if (it != mappings_.end()) {
+        return it->second.first;  // mapped by another reader meanwhile
+    }
+    if (mappings_.size() >= std::max<std::size_t>(1, options_.mapped_segments)) {
+        mappings_.erase(mapping_lru_.back());
+        mapping_lru_.pop_back();
+    }
+    mapping_lru_.push_front(path);
+    mappings_.emplace(path, std::make_pair(mapping, mapping_lru_.begin()));
+    return mapping;
+}
+
+std::vector<Message> MessageArchive::read_block(const Mapping& mapping, std::size_t block) {
+    static auto& reads = Metrics::counter("archive.block_reads");
+    thread_local std::unique_ptr<ZSTD_DCtx, DctxDeleter> dctx(ZSTD_createDCtx());
+    
+    std::vector<Message> messages;
+    Mapping::Block b = mapping.block(block);
+    const unsigned char* bytes = mapping.bytes(b);
+    unsigned long long raw_size = bytes ? ZSTD_getFrameContentSize(bytes, b.size) : ZSTD_CONTENTSIZE_ERROR;
+    if (raw_size == ZSTD_CONTENTSIZE_ERROR || raw_size == ZSTD_CONTENTSIZE_UNKNOWN ||
+        raw_size > kMaxBlockBytes) {
+        Logger::get()->error("Archive block {} is damaged", block);
+        return messages;
+    }
+    
+    const ZSTD_DDict* ddict = nullptr;
+    if (mapping.dictionary_id() != 0) {
+        std::lock_guard<std::mutex> lock(dictionary_mutex_);
+        auto it = ddicts_.find(mapping.dictionary_id());
+        if (it == ddicts_.end()) {
+            Logger::get()->error("Archive dictionary {} is missing", mapping.dictionary_id());
+            return messages;
+        }
+        ddict = it->second;
+    }
+    
+    std::string raw(static_cast<std::size_t>(raw_size), '\0');
+    std::size_t size = ddict
+        ? ZSTD_decompress_usingDDict(dctx.get(), &raw[0], raw.size(), bytes, b.size, ddict)
+        : ZSTD_decompressDCtx(dctx.get(), &raw[0], raw.size(), bytes, b.size);
+    if (ZSTD_isError(size) || size != raw.size()) {
+        Logger::get()->error("Archive block {} failed to decompress", block);
+        return messages;
+    }
+    reads.fetch_add(1, std::memory_order_relaxed);
+    
+    messages.reserve(b.messages);
+    std::size_t pos = 0;
+    while (pos < raw.size()) {
+        Message msg;
+        if (!decode_message(raw, pos, msg)) {
+            Logger::get()->error("Archive block {} holds a damaged message", block);
+            break;
+        }
+        messages.push_back(std::move(msg));
+    }
+    return messages;
+}
+
+std::string MessageArchive::conversation_dir(const std::string& conversation) const {
+    return (fs::path(options_.directory) / hex_encode(conversation)).string();
+}
@@ -0,0 +1,86 @@
+// src/database/migrations.cpp
+#include "database/migrations.hpp"
+
+const std::vector<Migration>& schema_migrations() {
+    static const std::vector<Migration> migrations = {
+        {
+            1,
+            "sync indexes on recipient and group timelines",
+            "CREATE INDEX IF NOT EXISTS idx_messages_recipient_created "
+            "ON messages (recipient_id, created_at, message_id); "
+            "CREATE INDEX IF NOT EXISTS idx_messages_group_created "
+            "ON messages (group_id, created_at, message_id); "
+            "CREATE INDEX IF NOT EXISTS idx_group_members_user "
+            "ON group_members (user_id, group_id);"
+        },
+        {
+            2,
+            "per-user read marks for inbox unread counts",
+            "CREATE TABLE IF NOT EXISTS conversation_reads ("
+            "  user_id TEXT NOT NULL, "
+            "  conversation TEXT NOT NULL, "
+            "  last_read_at TIMESTAMPTZ NOT NULL, "
+            "  PRIMARY KEY (user_id, conversation)"
+            ");"
+        },
+        {
+            3,
+            "canonical conversation id on direct messages",
+            // COLLATE "C" compares bytes, matching MessageRepository::conversation_id
+            "ALTER TABLE messages ADD COLUMN IF NOT EXISTS conversation_id TEXT; "
+            "UPDATE messages SET conversation_id = "
+            "  LEAST(sender_id::text COLLATE \"C\", recipient_id::text COLLATE \"C\") || ':' || "
+            "  GREATEST(sender_id::text COLLATE \"C\", recipient_id::text COLLATE \"C\") "
+            "WHERE group_id IS NULL AND recipient_id IS NOT NULL AND conversation_id IS NULL; "
+            "CREATE INDEX IF NOT EXISTS idx_messages_conversation_created "
+            "ON messages (conversation_id, created_at, message_id);"
+        },
+        {
+            4,
+            "per-conversation message sequence numbers",
+            "ALTER TABLE messages ADD COLUMN IF NOT EXISTS conversation_seq BIGINT; "
+            "WITH numbered AS ("
+            "  SELECT message_id, ROW_NUMBER() OVER ("
+            "    PARTITION BY COALESCE('group:' || group_id::text, 'dm:' || conversation_id) "
+            "    ORDER BY created_at, message_id) AS seq "
+            "  FROM messages "
+            "  WHERE group_id IS NOT NULL OR conversation_id IS NOT NULL"
+            ") "
+            "UPDATE messages m SET conversation_seq = n.seq "
+            "FROM numbered n WHERE m.message_id = n.message_id; "
+            "CREATE TABLE IF NOT EXISTS conversation_sequences ("
+            "  conversation TEXT PRIMARY KEY, "
+            "  reserved_until BIGINT NOT NULL"
+            "); "
+            "INSERT INTO conversation_sequences (conversation, reserved_until) "
+            "SELECT COALESCE('group:' || group_id::text, 'dm:' || conversation_id), MAX(conversation_seq) "
+            "FROM messages WHERE conversation_seq IS NOT NULL GROUP BY 1 "
+            "ON CONFLICT (conversation) DO NOTHING; "
+            "CREATE UNIQUE INDEX IF NOT EXISTS idx_messages_conversation_seq "
+            "ON messages (conversation_id, conversation_seq) WHERE group_id IS NULL; "
+            "CREATE UNIQUE INDEX IF NOT EXISTS idx_messages_group_seq "
+            "ON messages (group_id, conversation_seq) WHERE group_id IS NOT NULL;"
+        },
+        {
+            5,
+            "client idempotency keys on sent messages",
+            "ALTER TABLE messages ADD COLUMN IF NOT EXISTS idempotency_key TEXT; "
+            "CREATE UNIQUE INDEX IF NOT EXISTS idx_messages_sender_idempotency_key "
+            "ON messages (sender_id, idempotency_key) WHERE idempotency_key IS NOT NULL;"
+        },
+        {
+            6,
+            "commit-ordered sync position on messages",
+            // Existing rows all get this migration's transaction id
+            "ALTER TABLE messages ADD COLUMN IF NOT EXISTS sync_xid xid8 "
+            "  NOT NULL DEFAULT pg_current_xact_id(); "
+            "CREATE INDEX IF NOT EXISTS idx_messages_recipient_sync "
+            "ON messages (recipient_id, sync_xid); "
+            "CREATE INDEX IF NOT EXISTS idx_messages_sender_sync "
+            "ON messages (sender_id, sync_xid); "
+            "CREATE INDEX IF NOT EXISTS idx_messages_group_sync "
+            "ON messages (group_id, sync_xid);"
+        },
+    };
+    return migrations;
+}
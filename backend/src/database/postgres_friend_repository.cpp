@@ -0,0 +1,171 @@
+// src/database/postgres_friend_repository.cpp
+#include "database/postgres_friend_repository.hpp"
+
+PostgresFriendRepository::PostgresFriendRepository(Database& db)
+    : db_(db) {
+}
+
+FriendRequestResult PostgresFriendRepository::send_request(
+    Transaction& txn,
+    const std::string& sender_id,
+    const std::string& receiver_username) {
+    
+    auto& work = PgTransaction::work(txn);
+    FriendRequestResult outcome;
+    
+    // Get receiver user_id
+    auto user_result = work.exec_params(
+        "SELECT user_id FROM users WHERE username = $1",
+        receiver_username
+    );
+    
+    if (user_result.empty()) {
+        outcome.status = FriendRequestResult::Status::UserNotFound;
+        return outcome;
+    }
+    
+    std::string receiver_id = user_result[0]["user_id"].as<std::string>();
+    
+    // Check if already friends
+    auto friendship_check = work.exec_params(
+        "SELECT 1 FROM friendships "
+        "WHERE (user1_id = $1 AND user2_id = $2) OR (user1_id = $2 AND user2_id = $1)",
+        sender_id < receiver_id ? sender_id : receiver_id,
+        sender_id < receiver_id ? receiver_id : sender_id
+    );
+    
+    if (!friendship_check.empty()) {
+        outcome.status = FriendRequestResult::Status::AlreadyFriends;
+        return outcome;
+    }
+    
+    // Create friend request
+    auto result = work.exec_params(
+        "INSERT INTO friend_requests (sender_id, receiver_id) "
+        "VALUES ($1, $2) "
+        "ON CONFLICT (sender_id, receiver_id) DO NOTHING "
+        "RETURNING request_id",
+        sender_id, receiver_id
+    );
+    
+    if (result.empty()) {
+        outcome.status = FriendRequestResult::Status::AlreadyRequested;
+        return outcome;
+    }
+    
+    outcome.status = FriendRequestResult::Status::Sent;
+    outcome.request_id = result[0]["request_id"].as<std::string>();
+    outcome.receiver_id = receiver_id;
+    return outcome;
+}
+
+std::optional<std::string> PostgresFriendRepository::accept_request(
+    const std::string& receiver_id,
+    const std::string& request_id) {
+    
+    auto conn = db_.acquire();
+    pqxx::work txn(*conn);
+    
+    // Get request details
+    auto request_result = txn.exec_params(
+        "SELECT sender_id FROM friend_requests "
+        "WHERE request_id = $1 AND receiver_id = $2 AND status = 'pending'",
+        request_id, receiver_id
+    );
+    
+    if (request_result.empty()) {
+        return std::nullopt;
+    }
+    
+    std::string sender_id = request_result[0]["sender_id"].as<std::string>();
+    
+    // Update request status
+    txn.exec_params(
+        "UPDATE friend_requests SET status = 'accepted', updated_at = CURRENT_TIMESTAMP "
+        "WHERE request_id = $1",
+        request_id
+    );
+    
+    // Create friendship
+    txn.exec_params(
+        "INSERT INTO friendships (user1_id, user2_id) VALUES ($1, $2)",
+        sender_id < receiver_id ? sender_id : receiver_id,
+        sender_id < receiver_id ? receiver_id : sender_id
+    );
+    
+    txn.commit();
+    return sender_id;
+}
+
+void PostgresFriendRepository::reject_request(
+    const std::string& receiver_id,
+    const std::string& request_id) {
+    
+    auto conn = db_.acquire();
+    pqxx::work txn(*conn);
+    
+    txn.exec_params(
+        "UPDATE friend_requests SET status = 'rejected', updated_at = CURRENT_TIMESTAMP "
+        "WHERE request_id = $1 AND receiver_id = $2",
+        request_id, receiver_id
+    );
+    
+    txn.commit();
+}
+
+std::vector<FriendRequest> PostgresFriendRepository::get_requests(const std::string& user_id) {
+    auto conn = db_.acquire();
+    pqxx::work txn(*conn);
+    
+    auto result = txn.exec_params(
+        "SELECT fr.request_id, fr.sender_id, u.username, u.display_name, fr.created_at "
+        "FROM friend_requests fr "
+        "JOIN users u ON fr.sender_id = u.user_id "
+        "WHERE fr.receiver_id = $1 AND fr.status = 'pending' "
+        "ORDER BY fr.created_at DESC",
+        user_id
+    );
+    
+    txn.commit();
+    
+    std::vector<FriendRequest> requests;
+    requests.reserve(result.size());
+    for (const auto& row : result) {
+        FriendRequest request;
+        request.request_id = row["request_id"].as<std::string>();
+        request.sender_id = row["sender_id"].as<std::string>();
+        request.username = row["username"].as<std::string>();
+        request.display_name = row["display_name"].as<std::string>();
+        request.created_at = row["created_at"].as<std::string>();
+        requests.push_back(std::move(request));
+    }
+    return requests;
+}
+
+std::vector<User> PostgresFriendRepository::get_friends(const std::string& user_id) {
+    auto conn = db_.acquire();
+    pqxx::work txn(*conn);
+    
+    auto result = txn.exec_params(
+        "SELECT u.user_id, u.username, u.display_name, u.status "
+        "FROM friendships f "
+        "JOIN users u ON (CASE WHEN f.user1_id = $1 THEN f.user2_id ELSE f.user1_id END) = u.user_id "
+        "WHERE f.user1_id = $1 OR f.user2_id = $1 "
+        "ORDER BY u.username",
+        user_id
+    );
+    
+    txn.commit();
+    
+    std::vector<User> friends;
+    friends.reserve(result.size());
+    for (const auto& row : result) {
+        User user;
+        user.user_id = row["user_id"].as<std::string>();
+        user.username = row["username"].as<std::string>();
+        user.display_name = row["display_name"].as<std::string>();
+        user.status = row["status"].as<std::string>();
+        friends.push_back(std::move(user));
+    }
+    return friends;
+}
@@ -1,17 +1,22 @@
 
-// src/database/group_repository.cpp
-#include "database/group_repository.hpp"
+// src/database/postgres_group_repository.cpp
+#include "database/postgres_group_repository.hpp"
 #include "utils/logger.hpp"
+#include "utils/metrics.hpp"
 
-GroupRepository::GroupRepository(Database& db) : db_(db) {}
+PostgresGroupRepository::PostgresGroupRepository(Database& db, std::size_t membership_entries)
+    : db_(db)
+    , index_(membership_entries) {
+}
 
-std::optional<Group> GroupRepository::create_group(
+std::optional<Group> PostgresGroupRepository::create_group(
     const std::string& group_name,
     const std::string& description,
     const std::string& creator_id) {
     
     try {
-        pqxx::work txn(db_.get_connection());
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
         
         // Create group
         auto result = txn.exec_params(
@@ -32,6 +37,7 @@ std::optional<Group> GroupRepository::create_group(
             );
             
             txn.commit();
+            index_.created(group_id, creator_id);
             
             Group group;
             group.group_id = group_id;
@@ -49,20 +55,19 @@ std::optional<Group> GroupRepository::create_group(
     return std::nullopt;
 }
 
-bool GroupRepository::add_member(
+bool PostgresGroupRepository::add_member(
     const std::string& group_id,
     const std::string& user_id,
     const std::string& role) {
     
     try {
-        pqxx::work txn(db_.get_connection());
-        txn.exec_params(
-            "INSERT INTO group_members (group_id, user_id, role) "
-            "VALUES ($1, $2, $3) "
-            "ON CONFLICT (group_id, user_id) DO NOTHING",
-            group_id, user_id, role
-        );
-        txn.commit();
+        auto txn = db_.begin();
+        AfterCommit after_commit;
+        add_member(*txn, group_id, user_id, role, after_commit);
+        txn->commit();
+        for (auto& update : after_commit) {
+            update();
+        }
         
         Logger::get()->info("User {} added to group {}", user_id, group_id);
         return true;
@@ -72,17 +77,37 @@ bool GroupRepository::add_member(
     }
 }
 
-bool GroupRepository::remove_member(
+void PostgresGroupRepository::add_member(
+    Transaction& txn,
+    const std::string& group_id,
+    const std::string& user_id,
+    const std::string& role,
+    AfterCommit& after_commit) {
+    
+    PgTransaction::work(txn).exec_params(
+        "INSERT INTO group_members (group_id, user_id, role) "
+        "VALUES ($1, $2, $3) "
+        "ON CONFLICT (group_id, user_id) DO NOTHING",
+        group_id, user_id, role
+    );
+    after_commit.push_back([this, group_id, user_id] {
+        index_.add(group_id, user_id);
+    });
+}
+
+bool PostgresGroupRepository::remove_member(
     const std::string& group_id,
     const std::string& user_id) {
     
     try {
-        pqxx::work txn(db_.get_connection());
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
         txn.exec_params(
             "DELETE FROM group_members WHERE group_id = $1 AND user_id = $2",
             group_id, user_id
         );
         txn.commit();
+        index_.remove(group_id, user_id);
         
         Logger::get()->info("User {} removed from group {}", user_id, group_id);
         return true;
@@ -92,10 +117,11 @@ bool GroupRepository::remove_member(
     }
 }
 
-std::vector<Group> GroupRepository::get_user_groups(const std::string& user_id) {
+std::vector<Group> PostgresGroupRepository::get_user_groups(const std::string& user_id) {
     std::vector<Group> groups;
     try {
-        pqxx::work txn(db_.get_connection());
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
         auto result = txn.exec_params(
             "SELECT g.group_id, g.group_name, g.description, g.created_by "
             "FROM groups g "
@@ -121,10 +147,11 @@ std::vector<Group> GroupRepository::get_user_groups(const std::string& user_id)
     return groups;
 }
 
-std::vector<GroupMember> GroupRepository::get_group_members(const std::string& group_id) {
+std::vector<GroupMember> PostgresGroupRepository::get_group_members(const std::string& group_id) {
     std::vector<GroupMember> members;
     try {
-        pqxx::work txn(db_.get_connection());
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
         auto result = txn.exec_params(
             "SELECT group_id, user_id, role FROM group_members WHERE group_id = $1",
             group_id
@@ -146,18 +173,71 @@ std::vector<GroupMember> GroupRepository::get_group_members(const std::string& g
     return members;
 }
 
-bool GroupRepository::is_member(const std::string& group_id, const std::string& user_id) {
+IdSetPtr PostgresGroupRepository::get_member_ids(const std::string& group_id) {
+    static auto& hits = Metrics::counter("membership.hits");
+    static auto& loads = Metrics::counter("membership.loads");
+    
+    if (auto members = index_.members(group_id)) {
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return members;
+    }
+    loads.fetch_add(1, std::memory_order_relaxed);
+    
     try {
-        pqxx::work txn(db_.get_connection());
+        std::uint64_t version = index_.version();
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
         auto result = txn.exec_params(
-            "SELECT 1 FROM group_members WHERE group_id = $1 AND user_id = $2",
-            group_id, user_id
+            "SELECT user_id FROM group_members WHERE group_id = $1",
+            group_id
+        );
+        txn.commit();
+        
+        IdSet members;
+        members.reserve(result.size());
+        for (const auto& row : result) {
+            members.push_back(row["user_id"].as<std::string>());
+        }
+        return index_.install_members(group_id, std::move(members), version);
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to load group members: {}", e.what());
+        return nullptr;
+    }
+}
+
+IdSetPtr PostgresGroupRepository::get_user_group_ids(const std::string& user_id) {
+    static auto& hits = Metrics::counter("membership.hits");
+    static auto& loads = Metrics::counter("membership.loads");
+    
+    if (auto groups = index_.groups(user_id)) {
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return groups;
+    }
+    loads.fetch_add(1, std::memory_order_relaxed);
+    
+    try {
+        std::uint64_t version = index_.version();
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
+        auto result = txn.exec_params(
+            "SELECT group_id FROM group_members WHERE user_id = $1",
+            user_id
         );
         txn.commit();
         
-        return !result.empty();
+        IdSet groups;
+        groups.reserve(result.size());
+        for (const auto& row : result) {
+            groups.push_back(row["group_id"].as<std::string>());
+        }
+        return index_.install_groups(user_id, std::move(groups), version);
     } catch (const std::exception& e) {
-        Logger::get()->error("Failed to check group membership: {}", e.what());
-        return false;
+        Logger::get()->error("Failed to load user groups: {}", e.what());
+        return nullptr;
     }
 }
+
+bool PostgresGroupRepository::is_member(const std::string& group_id, const std::string& user_id) {
+    auto members = get_member_ids(group_id);
+    return members && MembershipIndex::contains(*members, user_id);
+}
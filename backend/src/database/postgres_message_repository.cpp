@@ -0,0 +1,759 @@
+// src/database/postgres_message_repository.cpp
+#include "database/postgres_message_repository.hpp"
+#include "database/message_archive.hpp"
+#include "utils/logger.hpp"
+#include "utils/metrics.hpp"
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+// Inbox rows carry the start of the last message, not all of it
+constexpr std::size_t kInboxPreviewChars = 200;
+// Recipients already checked before a journal append
+constexpr std::size_t kMaxKnownRecipients = 100000;
+// A sync page that takes longer fails, and the client retries it
+constexpr const char* kSyncStatementTimeout = "5s";
+
+// One arm of the sync query, on the index for `who`: rows after the cursor
+// and below the oldest transaction still running, in commit order.
+std::string sync_branch(const std::string& who) {
+    return "(SELECT message_id, sender_id, recipient_id, group_id, content, "
+           "message_type, created_at, is_read, conversation_seq, sync_xid "
+           "FROM messages WHERE " + who +
+           " AND (sync_xid, message_id::text) > ($2::xid8, $3) "
+           " AND sync_xid < pg_snapshot_xmin(pg_current_snapshot()) "
+           "ORDER BY sync_xid, message_id::text LIMIT $4)";
+}
+// First byte of a journal record, for changing the layout later
+constexpr char kJournalRecordVersion = 1;
+
+void put_string(std::string& out, const std::string& value) {
+    std::uint32_t size = static_cast<std::uint32_t>(value.size());
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>((size >> (8 * i)) & 0xFF));
+    }
+    out += value;
+}
+
+bool get_string(const std::string& in, std::size_t& pos, std::string& value) {
+    if (in.size() - pos < 4) {
+        return false;
+    }
+    std::uint32_t size = 0;
+    for (int i = 0; i < 4; ++i) {
+        size |= static_cast<std::uint32_t>(static_cast<unsigned char>(in[pos + i])) << (8 * i);
+    }
+    pos += 4;
+    if (in.size() - pos < size) {
+        return false;
+    }
+    value.assign(in, pos, size);
+    pos += size;
+    return true;
+}
+
+// The canonical text form, the only one ids are handed out in.
+bool is_uuid(const std::string& value) {
+    if (value.size() != 36) {
+        return false;
+    }
+    for (std::size_t i = 0; i < value.size(); ++i) {
+        bool dash = i == 8 || i == 13 || i == 18 || i == 23;
+        if (dash ? value[i] != '-' : !std::isxdigit(static_cast<unsigned char>(value[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string encode_journal_record(const Message& msg, const std::string& idempotency_key) {
+    std::string record(1, kJournalRecordVersion);
+    for (const std::string* field : {&msg.message_id, &msg.sender_id, &msg.recipient_id,
+                                     &msg.group_id, &msg.content, &msg.message_type,
+                                     &msg.created_at, &idempotency_key}) {
+        put_string(record, *field);
+    }
+    put_string(record, std::to_string(msg.seq));
+    return record;
+}
+
+// Adds archived messages to a database page: ordered by seq, without the
+// duplicates a failed archival run can leave, at most `limit`.
+void merge_archived(std::vector<Message>& messages, std::vector<Message> archived,
+                    bool newest_first, std::size_t limit) {
+    messages.insert(messages.end(), std::make_move_iterator(archived.begin()),
+                    std::make_move_iterator(archived.end()));
+    std::sort(messages.begin(), messages.end(), [&](const Message& a, const Message& b) {
+        return newest_first ? a.seq > b.seq : a.seq < b.seq;
+    });
+    messages.erase(std::unique(messages.begin(), messages.end(),
+                               [](const Message& a, const Message& b) { return a.seq == b.seq; }),
+                   messages.end());
+    if (messages.size() > limit) {
+        messages.resize(limit);
+    }
+}
+
+std::optional<Message> decode_journal_record(const std::string& record, std::string& idempotency_key) {
+    if (record.empty() || record[0] != kJournalRecordVersion) {
+        return std::nullopt;
+    }
+    
+    Message msg;
+    msg.is_read = false;
+    std::string seq;
+    std::size_t pos = 1;
+    for (std::string* field : {&msg.message_id, &msg.sender_id, &msg.recipient_id,
+                               &msg.group_id, &msg.content, &msg.message_type,
+                               &msg.created_at, &idempotency_key, &seq}) {
+        if (!get_string(record, pos, *field)) {
+            return std::nullopt;
+        }
+    }
+    try {
+        msg.seq = std::stoull(seq);
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+    return msg;
+}
+}
+
+PostgresMessageRepository::PostgresMessageRepository(Database& db,
+                                                     IdGenerator& ids,
+                                                     std::uint64_t seq_block,
+                                                     std::size_t seq_connections)
+    : db_(db)
+    , ids_(ids)
+    , sequences_(db.connection_string(), seq_block, seq_connections)
+    , journal_(nullptr)
+    , archive_(nullptr) {
+}
+
+std::optional<Message> PostgresMessageRepository::send_message(
+    const std::string& sender_id,
+    const std::string& recipient_id,
+    const std::string& content,
+    const std::string& message_type,
+    const std::string& idempotency_key) {
+    
+    try {
+        // A keyed send goes straight to the database: only the unique index
+        // can tell a retry apart once the ack cache has forgotten it
+        if (journal_ && idempotency_key.empty()) {
+            // Nothing checks the row before the ack, so check what the
+            // insert would refuse
+            if (!recipient_exists(recipient_id)) {
+                Logger::get()->warn("Not journaling message to unknown recipient {}", recipient_id);
+                return std::nullopt;
+            }
+            Message msg = new_message(sender_id, recipient_id, "", content, message_type);
+            journal_->append(encode_journal_record(msg, idempotency_key));
+            return msg;
+        }
+        
+        auto txn = db_.begin();
+        Message msg = send_message(*txn, sender_id, recipient_id, content, message_type,
+                                   idempotency_key);
+        txn->commit();
+        
+        Logger::get()->info("Message sent from {} to {}", sender_id, recipient_id);
+        return msg;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to send message: {}", e.what());
+    }
+    
+    return std::nullopt;
+}
+
+std::optional<Message> PostgresMessageRepository::send_group_message(
+    const std::string& sender_id,
+    const std::string& group_id,
+    const std::string& content,
+    const std::string& message_type,
+    const std::string& idempotency_key) {
+    
+    try {
+        if (journal_ && idempotency_key.empty()) {
+            // The sender's membership, checked by the caller, vouches for the group
+            if (!is_uuid(group_id)) {
+                Logger::get()->warn("Not journaling message to invalid group {}", group_id);
+                return std::nullopt;
+            }
+            Message msg = new_message(sender_id, "", group_id, content, message_type);
+            journal_->append(encode_journal_record(msg, idempotency_key));
+            return msg;
+        }
+        
+        auto txn = db_.begin();
+        Message msg = send_group_message(*txn, sender_id, group_id, content, message_type,
+                                         idempotency_key);
+        txn->commit();
+        
+        Logger::get()->info("Group message sent from {} to group {}", sender_id, group_id);
+        return msg;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to send group message: {}", e.what());
+    }
+    
+    return std::nullopt;
+}
+
+Message PostgresMessageRepository::send_message(
+    Transaction& txn,
+    const std::string& sender_id,
+    const std::string& recipient_id,
+    const std::string& content,
+    const std::string& message_type,
+    const std::string& idempotency_key) {
+    
+    Message msg = new_message(sender_id, recipient_id, "", content, message_type);
+    if (!insert_message(PgTransaction::work(txn), msg, idempotency_key)) {
+        return find_duplicate(PgTransaction::work(txn), sender_id, idempotency_key);
+    }
+    return msg;
+}
+
+Message PostgresMessageRepository::send_group_message(
+    Transaction& txn,
+    const std::string& sender_id,
+    const std::string& group_id,
+    const std::string& content,
+    const std::string& message_type,
+    const std::string& idempotency_key) {
+    
+    Message msg = new_message(sender_id, "", group_id, content, message_type);
+    if (!insert_message(PgTransaction::work(txn), msg, idempotency_key)) {
+        return find_duplicate(PgTransaction::work(txn), sender_id, idempotency_key);
+    }
+    return msg;
+}
+
+bool PostgresMessageRepository::use_journal(Journal& journal) {
+    if (!journal.start([this, &journal](const std::vector<std::string>& records) {
+            return apply_journal(journal, records);
+        })) {
+        return false;
+    }
+    journal_ = &journal;
+    return true;
+}
+
+void PostgresMessageRepository::set_archive(MessageArchive* archive) {
+    archive_ = archive;
+}
+
+Message PostgresMessageRepository::new_message(const std::string& sender_id,
+                                       const std::string& recipient_id,
+                                       const std::string& group_id,
+                                       const std::string& content,
+                                       const std::string& message_type) {
+    std::uint64_t id = ids_.next();
+    
+    Message msg;
+    msg.message_id = IdGenerator::to_uuid(id);
+    msg.sender_id = sender_id;
+    msg.recipient_id = recipient_id;
+    msg.group_id = group_id;
+    msg.content = content;
+    msg.message_type = message_type;
+    msg.created_at = IdGenerator::to_timestamp(id);
+    msg.is_read = false;
+    msg.seq = sequences_.next(group_id.empty()
+        ? "dm:" + conversation_id(sender_id, recipient_id)
+        : "group:" + group_id);
+    return msg;
+}
+
+bool PostgresMessageRepository::insert_message(pqxx::transaction_base& txn,
+                                       const Message& msg,
+                                       const std::string& idempotency_key) {
+    // Skips a repeated idempotency key, and a journal record applied twice
+    if (msg.group_id.empty()) {
+        auto result = txn.exec_params(
+            "INSERT INTO messages (message_id, sender_id, recipient_id, content, message_type, "
+            "created_at, conversation_id, conversation_seq, idempotency_key) "
+            "VALUES ($1, $2, $3, $4, $5, $6, $7, $8, NULLIF($9, '')) "
+            "ON CONFLICT DO NOTHING",
+            msg.message_id, msg.sender_id, msg.recipient_id, msg.content, msg.message_type,
+            msg.created_at, conversation_id(msg.sender_id, msg.recipient_id),
+            static_cast<long long>(msg.seq), idempotency_key
+        );
+        return result.affected_rows() == 1;
+    }
+    
+    auto result = txn.exec_params(
+        "INSERT INTO messages (message_id, sender_id, group_id, content, message_type, "
+        "created_at, conversation_seq, idempotency_key) "
+        "VALUES ($1, $2, $3, $4, $5, $6, $7, NULLIF($8, '')) "
+        "ON CONFLICT DO NOTHING",
+        msg.message_id, msg.sender_id, msg.group_id, msg.content, msg.message_type,
+        msg.created_at, static_cast<long long>(msg.seq), idempotency_key
+    );
+    return result.affected_rows() == 1;
+}
+
+bool PostgresMessageRepository::apply_journal(Journal& journal,
+                                              const std::vector<std::string>& records) {
+    static auto& skipped = Metrics::counter("journal.skipped_inserts");
+    
+    std::vector<std::string> rejected;
+    try {
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
+        for (const auto& record : records) {
+            std::string idempotency_key;
+            auto msg = decode_journal_record(record, idempotency_key);
+            if (!msg) {
+                Logger::get()->error("Rejecting unreadable journal record ({} bytes)", record.size());
+                rejected.push_back(record);
+                continue;
+            }
+            // A savepoint each: a row the database refuses is set aside
+            // instead of failing the batch forever. Anything but an SQL
+            // error, like a lost connection, still fails the batch.
+            try {
+                pqxx::subtransaction insert(txn);
+                if (!insert_message(insert, *msg, idempotency_key)) {
+                    skipped.fetch_add(1, std::memory_order_relaxed);
+                }
+                insert.commit();
+            } catch (const pqxx::sql_error& e) {
+                Logger::get()->error("Rejecting journal record for message {}: {}",
+                                    msg->message_id, e.what());
+                rejected.push_back(record);
+            }
+        }
+        txn.commit();
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to apply {} journal records: {}", records.size(), e.what());
+        return false;
+    }
+    
+    // Only once committed, so a retried batch is not rejected twice
+    return rejected.empty() || journal.reject(rejected);
+}
+
+bool PostgresMessageRepository::recipient_exists(const std::string& user_id) {
+    if (!is_uuid(user_id)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(recipients_mutex_);
+        if (known_recipients_.count(user_id) > 0) {
+            return true;
+        }
+    }
+    
+    auto conn = db_.acquire();
+    pqxx::nontransaction txn(*conn);
+    auto result = txn.exec_params("SELECT 1 FROM users WHERE user_id = $1", user_id);
+    if (result.empty()) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(recipients_mutex_);
+    if (known_recipients_.size() >= kMaxKnownRecipients) {
+        known_recipients_.clear();
+    }
+    known_recipients_.insert(user_id);
+    return true;
+}
+
+Message PostgresMessageRepository::find_duplicate(pqxx::transaction_base& txn,
+                                          const std::string& sender_id,
+                                          const std::string& idempotency_key) {
+    // The sequence number reserved for the skipped insert stays unused
+    auto result = txn.exec_params(
+        "SELECT message_id, sender_id, recipient_id, group_id, content, "
+        "message_type, created_at, is_read, conversation_seq "
+        "FROM messages WHERE sender_id = $1 AND idempotency_key = $2",
+        sender_id, idempotency_key
+    );
+    
+    if (result.empty()) {
+        throw std::runtime_error("message insert skipped without a conflicting row");
+    }
+    
+    const auto& row = result[0];
+    Message msg;
+    msg.message_id = row["message_id"].as<std::string>();
+    msg.sender_id = row["sender_id"].as<std::string>();
+    msg.recipient_id = row["recipient_id"].is_null() ? "" : row["recipient_id"].as<std::string>();
+    msg.group_id = row["group_id"].is_null() ? "" : row["group_id"].as<std::string>();
+    msg.content = row["content"].as<std::string>();
+    msg.message_type = row["message_type"].as<std::string>();
+    msg.created_at = row["created_at"].as<std::string>();
+    msg.is_read = row["is_read"].as<bool>();
+    msg.seq = row["conversation_seq"].is_null() ? 0 : row["conversation_seq"].as<std::uint64_t>();
+    msg.duplicate = true;
+    return msg;
+}
+
+std::vector<Message> PostgresMessageRepository::get_conversation(
+    const std::string& user1_id,
+    const std::string& user2_id,
+    int limit,
+    std::uint64_t before_seq) {
+    
+    std::string conversation = conversation_id(user1_id, user2_id);
+    std::vector<Message> messages;
+    try {
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
+        // Every page in seq order, so paging neither skips nor repeats
+        long long below = before_seq == 0
+            ? std::numeric_limits<long long>::max()
+            : static_cast<long long>(before_seq);
+        auto result = txn.exec_params(
+            "SELECT message_id, sender_id, recipient_id, group_id, content, "
+            "message_type, created_at, is_read, conversation_seq "
+            "FROM messages "
+            "WHERE conversation_id = $1 AND group_id IS NULL AND conversation_seq < $2 "
+            "ORDER BY conversation_seq DESC LIMIT $3",
+            conversation, below, limit);
+        
+        txn.commit();
+        
+        for (const auto& row : result) {
+            Message msg;
+            msg.message_id = row["message_id"].as<std::string>();
+            msg.sender_id = row["sender_id"].as<std::string>();
+            msg.recipient_id = row["recipient_id"].as<std::string>();
+            msg.group_id = row["group_id"].is_null() ? "" : row["group_id"].as<std::string>();
+            msg.content = row["content"].as<std::string>();
+            msg.message_type = row["message_type"].as<std::string>();
+            msg.created_at = row["created_at"].as<std::string>();
+            msg.is_read = row["is_read"].as<bool>();
+            msg.seq = row["conversation_seq"].is_null() ? 0 : row["conversation_seq"].as<std::uint64_t>();
+            messages.push_back(msg);
+        }
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to get conversation: {}", e.what());
+        return messages;
+    }
+    
+    // The page reaches below the hot rows when it came back short or its
+    // oldest message is at or under what has been archived
+    if (archive_) {
+        std::string key = "dm:" + conversation;
+        std::uint64_t archived_until = archive_->last_seq(key);
+        std::uint64_t oldest = messages.empty() ? 0 : messages.back().seq;
+        if (archived_until > 0 &&
+            (messages.size() < static_cast<std::size_t>(limit) || oldest <= archived_until)) {
+            std::uint64_t below = before_seq == 0 ? archived_until + 1 : before_seq;
+            merge_archived(messages, archive_->read_before(key, below, limit), true, limit);
+        }
+    }
+    return messages;
+}
+
+std::vector<Message> PostgresMessageRepository::get_group_messages(
+    const std::string& group_id,
+    int limit) {
+    
+    std::vector<Message> messages;
+    try {
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
+        auto result = txn.exec_params(
+            "SELECT message_id, sender_id, recipient_id, group_id, content, "
+            "message_type, created_at, is_read, conversation_seq "
+            "FROM messages "
+            "WHERE group_id = $1 "
+            "ORDER BY conversation_seq DESC LIMIT $2",
+            group_id, limit
+        );
+        
+        txn.commit();
+        
+        for (const auto& row : result) {
+            Message msg;
+            msg.message_id = row["message_id"].as<std::string>();
+            msg.sender_id = row["sender_id"].as<std::string>();
+            msg.recipient_id = row["recipient_id"].is_null() ? "" : row["recipient_id"].as<std::string>();
+            msg.group_id = row["group_id"].as<std::string>();
+            msg.content = row["content"].as<std::string>();
+            msg.message_type = row["message_type"].as<std::string>();
+            msg.created_at = row["created_at"].as<std::string>();
+            msg.is_read = row["is_read"].as<bool>();
+            msg.seq = row["conversation_seq"].is_null() ? 0 : row["conversation_seq"].as<std::uint64_t>();
+            messages.push_back(msg);
+        }
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to get group messages: {}", e.what());
+        return messages;
+    }
+    
+    if (archive_) {
+        std::string key = "group:" + group_id;
+        std::uint64_t archived_until = archive_->last_seq(key);
+        std::uint64_t oldest = messages.empty() ? 0 : messages.back().seq;
+        if (archived_until > 0 &&
+            (messages.size() < static_cast<std::size_t>(limit) || oldest <= archived_until)) {
+            merge_archived(messages, archive_->read_before(key, archived_until + 1, limit), true, limit);
+        }
+    }
+    return messages;
+}
+
+std::optional<SyncPage> PostgresMessageRepository::get_messages_since(
+    const std::string& user_id,
+    const std::string& cursor,
+    int limit) {
+    
+    // "<sync_xid>:<message_id>"; an empty cursor means "from the beginning"
+    std::string after_xid = "0";
+    std::string after_message_id;
+    if (!cursor.empty()) {
+        std::size_t colon = cursor.find(':');
+        if (colon == std::string::npos || colon == 0 ||
+            cursor.find_first_not_of("0123456789") != colon) {
+            Logger::get()->error("Invalid sync cursor for {}: {}", user_id, cursor);
+            return std::nullopt;
+        }
+        after_xid = cursor.substr(0, colon);
+        after_message_id = cursor.substr(colon + 1);
+    }
+    
+    try {
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
+        txn.exec(std::string("SET LOCAL statement_timeout = '") + kSyncStatementTimeout + "'");
+        
+        // Positions are the inserting transaction's id, taken only below
+        // the oldest transaction still running: everything there has
+        // committed or never will, so nothing can appear behind the cursor.
+        // One arm per index instead of an OR no single index serves; a
+        // message can match more than one, e.g. a user's own group message.
+        auto result = txn.exec_params(
+            "SELECT DISTINCT ON (sync_xid, message_id::text) "
+            "message_id, sender_id, recipient_id, group_id, content, "
+            "message_type, created_at, is_read, conversation_seq, sync_xid::text AS sync_position "
+            "FROM (" + sync_branch("recipient_id = $1") +
+            " UNION ALL " + sync_branch("sender_id = $1") +
+            " UNION ALL " + sync_branch(
+                "group_id IN (SELECT group_id FROM group_members WHERE user_id = $1)") +
+            ") m ORDER BY sync_xid, message_id::text LIMIT $4",
+            user_id, after_xid, after_message_id, limit
+        );
+        
+        txn.commit();
+        
+        SyncPage page;
+        page.messages.reserve(result.size());
+        page.cursors.reserve(result.size());
+        for (const auto& row : result) {
+            Message msg;
+            msg.message_id = row["message_id"].as<std::string>();
+            msg.sender_id = row["sender_id"].as<std::string>();
+            msg.recipient_id = row["recipient_id"].is_null() ? "" : row["recipient_id"].as<std::string>();
+            msg.group_id = row["group_id"].is_null() ? "" : row["group_id"].as<std::string>();
+            msg.content = row["content"].as<std::string>();
+            msg.message_type = row["message_type"].as<std::string>();
+            msg.created_at = row["created_at"].as<std::string>();
+            msg.is_read = row["is_read"].as<bool>();
+            msg.seq = row["conversation_seq"].is_null() ? 0 : row["conversation_seq"].as<std::uint64_t>();
+            page.cursors.push_back(row["sync_position"].as<std::string>() + ":" + msg.message_id);
+            page.messages.push_back(std::move(msg));
+        }
+        return page;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to get messages since cursor: {}", e.what());
+        return std::nullopt;
+    }
+}
+
+std::vector<Message> PostgresMessageRepository::get_conversation_range(
+    const std::string& user1_id,
+    const std::string& user2_id,
+    std::uint64_t from_seq,
+    std::uint64_t to_seq,
+    int limit) {
+    
+    return get_range(
+        "SELECT message_id, sender_id, recipient_id, group_id, content, "
+        "message_type, created_at, is_read, conversation_seq "
+        "FROM messages "
+        "WHERE conversation_id = $1 AND group_id IS NULL "
+        "  AND conversation_seq BETWEEN $2 AND $3 "
+        "ORDER BY conversation_seq LIMIT $4",
+        conversation_id(user1_id, user2_id), "dm:" + conversation_id(user1_id, user2_id),
+        from_seq, to_seq, limit);
+}
+
+std::vector<Message> PostgresMessageRepository::get_group_range(
+    const std::string& group_id,
+    std::uint64_t from_seq,
+    std::uint64_t to_seq,
+    int limit) {
+    
+    return get_range(
+        "SELECT message_id, sender_id, recipient_id, group_id, content, "
+        "message_type, created_at, is_read, conversation_seq "
+        "FROM messages "
+        "WHERE group_id = $1 "
+        "  AND conversation_seq BETWEEN $2 AND $3 "
+        "ORDER BY conversation_seq LIMIT $4",
+        group_id, "group:" + group_id, from_seq, to_seq, limit);
+}
+
+std::vector<Message> PostgresMessageRepository::get_range(
+    const char* query,
+    const std::string& key,
+    const std::string& conversation,
+    std::uint64_t from_seq,
+    std::uint64_t to_seq,
+    int limit) {
+    
+    std::vector<Message> messages;
+    try {
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
+        auto result = txn.exec_params(
+            query, key, static_cast<long long>(from_seq), static_cast<long long>(to_seq), limit
+        );
+        
+        txn.commit();
+        
+        for (const auto& row : result) {
+            Message msg;
+            msg.message_id = row["message_id"].as<std::string>();
+            msg.sender_id = row["sender_id"].as<std::string>();
+            msg.recipient_id = row["recipient_id"].is_null() ? "" : row["recipient_id"].as<std::string>();
+            msg.group_id = row["group_id"].is_null() ? "" : row["group_id"].as<std::string>();
+            msg.content = row["content"].as<std::string>();
+            msg.message_type = row["message_type"].as<std::string>();
+            msg.created_at = row["created_at"].as<std::string>();
+            msg.is_read = row["is_read"].as<bool>();
+            msg.seq = row["conversation_seq"].as<std::uint64_t>();
+            messages.push_back(msg);
+        }
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to get message range: {}", e.what());
+        return messages;
+    }
+    
+    if (archive_) {
+        std::uint64_t archived_until = archive_->last_seq(conversation);
+        if (from_seq <= archived_until) {
+            merge_archived(messages,
+                           archive_->read_range(conversation, from_seq,
+                                                std::min(to_seq, archived_until), limit),
+                           false, limit);
+        }
+    }
+    return messages;
+}
+
+bool PostgresMessageRepository::mark_message_read(const std::string& message_id) {
+    try {
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
+        txn.exec_params(
+            "UPDATE messages SET is_read = TRUE WHERE message_id = $1",
+            message_id
+        );
+        txn.commit();
+        return true;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to mark message as read: {}", e.what());
+        return false;
+    }
+}
+
+std::optional<std::vector<InboxEntry>> PostgresMessageRepository::get_inbox(const std::string& user_id) {
+    try {
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
+        
+        // A DM counts as unread until both the read mark and its is_read
+        // flag say otherwise, so rows read before read marks existed stay read
+        auto result = txn.exec_params(
+            "WITH mine AS ("
+            "  SELECT CASE WHEN m.group_id IS NOT NULL THEN 'group:' || m.group_id::text "
+            "              WHEN m.sender_id = $1 THEN 'dm:' || m.recipient_id::text "
+            "              ELSE 'dm:' || m.sender_id::text END AS conversation, "
+            "         m.message_id, m.sender_id, m.content, m.created_at, "
+            "         COALESCE(m.conversation_seq, 0) AS seq, "
+            "         m.sender_id = $1 AS outgoing, "
+            "         m.group_id IS NULL AND m.is_read AS dm_read "
+            "  FROM messages m "
+            "  WHERE m.recipient_id = $1 OR m.sender_id = $1 "
+            "     OR m.group_id IN (SELECT group_id FROM group_members WHERE user_id = $1)"
+            "), ranked AS ("
+            "  SELECT mine.*, "
+            "         COUNT(*) FILTER (WHERE NOT mine.outgoing AND NOT mine.dm_read "
+            "                            AND mine.created_at > COALESCE(r.last_read_at, '-infinity')) "
+            "           OVER (PARTITION BY mine.conversation) AS unread, "
+            "         ROW_NUMBER() OVER (PARTITION BY mine.conversation "
+            "                            ORDER BY mine.seq DESC, mine.created_at DESC, "
+            "                                     mine.message_id DESC) AS recency "
+            "  FROM mine "
+            "  LEFT JOIN conversation_reads r "
+            "         ON r.user_id = $2 AND r.conversation = mine.conversation"
+            ") "
+            "SELECT conversation, message_id, sender_id, LEFT(content, $3) AS preview, "
+            "       created_at, seq, unread "
+            "FROM ranked WHERE recency = 1 "
+            "ORDER BY created_at DESC",
+            user_id, user_id, static_cast<int>(kInboxPreviewChars)
+        );
+        
+        txn.commit();
+        
+        std::vector<InboxEntry> entries;
+        entries.reserve(result.size());
+        for (const auto& row : result) {
+            InboxEntry entry;
+            entry.conversation = row["conversation"].as<std::string>();
+            entry.last_message_id = row["message_id"].as<std::string>();
+            entry.last_sender_id = row["sender_id"].as<std::string>();
+            entry.last_preview = row["preview"].as<std::string>();
+            entry.last_created_at = row["created_at"].as<std::string>();
+            entry.last_seq = row["seq"].as<std::uint64_t>();
+            entry.unread = row["unread"].as<std::uint64_t>();
+            entries.push_back(std::move(entry));
+        }
+        return entries;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to load inbox: {}", e.what());
+        return std::nullopt;
+    }
+}
+
+bool PostgresMessageRepository::save_read_marks(const std::vector<ReadMark>& marks) {
+    try {
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
+        
+        for (const auto& mark : marks) {
+            txn.exec_params(
+                "INSERT INTO conversation_reads (user_id, conversation, last_read_at) "
+                "VALUES ($1, $2, $3) "
+                "ON CONFLICT (user_id, conversation) DO UPDATE "
+                "SET last_read_at = GREATEST(conversation_reads.last_read_at, EXCLUDED.last_read_at)",
+                mark.user_id, mark.conversation, mark.read_at
+            );
+            
+            // Keep the per-message flag that get_conversation returns in step
+            if (mark.conversation.compare(0, 3, "dm:") == 0) {
+                txn.exec_params(
+                    "UPDATE messages SET is_read = TRUE "
+                    "WHERE recipient_id = $1 AND sender_id = $2 "
+                    "  AND NOT is_read AND created_at <= $3",
+                    mark.user_id, mark.conversation.substr(3), mark.read_at
+                );
+            }
+        }
+        
+        txn.commit();
+        return true;
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to save {} read marks: {}", marks.size(), e.what());
+        return false;
+    }
+}
@@ -1,16 +1,17 @@
-#include "database/user_repository.hpp"
+#include "database/postgres_user_repository.hpp"
 #include "utils/logger.hpp"
 
-UserRepository::UserRepository(Database& db) : db_(db) {}
+PostgresUserRepository::PostgresUserRepository(Database& db) : db_(db) {}
 
-std::optional<User> UserRepository::create_user(
+std::optional<User> PostgresUserRepository::create_user(
     const std::string& username,
     const std::string& email,
     const std::string& password_hash,
     const std::string& display_name) {
     
     try {
-        pqxx::work txn(db_.get_connection());
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
         auto result = txn.exec_params(
             "INSERT INTO users (username, email, password_hash, display_name) "
             "VALUES ($1, $2, $3, $4) "
@@ -37,9 +38,10 @@ std::optional<User> UserRepository::create_user(
     return std::nullopt;
 }
 
-std::optional<User> UserRepository::get_user_by_username(const std::string& username) {
+std::optional<User> PostgresUserRepository::get_user_by_username(const std::string& username) {
     try {
-        pqxx::work txn(db_.get_connection());
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
         auto result = txn.exec_params(
             "SELECT user_id, username, email, password_hash, display_name, status "
             "FROM users WHERE username = $1",
@@ -65,9 +67,10 @@ std::optional<User> UserRepository::get_user_by_username(const std::string& user
     return std::nullopt;
 }
 
-std::optional<User> UserRepository::get_user_by_id(const std::string& user_id) {
+std::optional<User> PostgresUserRepository::get_user_by_id(const std::string& user_id) {
     try {
-        pqxx::work txn(db_.get_connection());
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
         auto result = txn.exec_params(
             "SELECT user_id, username, email, password_hash, display_name, status "
             "FROM users WHERE user_id = $1",
@@ -93,9 +96,10 @@ std::optional<User> UserRepository::get_user_by_id(const std::string& user_id) {
     return std::nullopt;
 }
 
-bool UserRepository::update_user_status(const std::string& user_id, const std::string& status) {
+bool PostgresUserRepository::update_user_status(const std::string& user_id, const std::string& status) {
     try {
-        pqxx::work txn(db_.get_connection());
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
         txn.exec_params(
             "UPDATE users SET status = $1, last_seen = CURRENT_TIMESTAMP WHERE user_id = $2",
             status, user_id
@@ -108,10 +112,11 @@ bool UserRepository::update_user_status(const std::string& user_id, const std::s
     }
 }
 
-std::vector<User> UserRepository::search_users(const std::string& query) {
+std::vector<User> PostgresUserRepository::search_users(const std::string& query) {
     std::vector<User> users;
     try {
-        pqxx::work txn(db_.get_connection());
+        auto conn = db_.acquire();
+        pqxx::work txn(*conn);
         auto result = txn.exec_params(
             "SELECT user_id, username, email, password_hash, display_name, status "
             "FROM users WHERE username ILIKE $1 OR display_name ILIKE $1 LIMIT 20",
@@ -0,0 +1,63 @@
+// src/database/sequence_allocator.cpp
+#include "database/sequence_allocator.hpp"
+#include "utils/logger.hpp"
+#include "utils/metrics.hpp"
+#include <algorithm>
+
+SequenceAllocator::SequenceAllocator(const std::string& connection_string,
+                                     std::uint64_t block_size,
+                                     std::size_t connections,
+                                     std::size_t max_entries)
+    : block_size_(std::max<std::uint64_t>(1, block_size))
+    , max_entries_per_shard_(std::max<std::size_t>(1, max_entries / kShards))
+    , reservations_(connection_string, connections) {
+}
+
+std::uint64_t SequenceAllocator::next(const std::string& conversation) {
+    Shard& shard = shards_[std::hash<std::string>{}(conversation) % kShards];
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.blocks.find(conversation);
+        if (it != shard.blocks.end() && it->second.next < it->second.limit) {
+            return it->second.next++;
+        }
+    }
+    
+    Block block = reserve(conversation);
+    std::uint64_t seq = block.next++;
+    
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.blocks.find(conversation);
+    if (it == shard.blocks.end()) {
+        // Dropping an entry forfeits the rest of its block
+        if (shard.blocks.size() >= max_entries_per_shard_) {
+            shard.blocks.erase(shard.blocks.begin());
+        }
+        shard.blocks.emplace(conversation, block);
+    } else if (block.limit > it->second.limit) {
+        // Reservations only grow, so a block reserved meanwhile by another
+        // sender is kept if it lies above this one
+        it->second = block;
+    }
+    return seq;
+}
+
+SequenceAllocator::Block SequenceAllocator::reserve(const std::string& conversation) {
+    static auto& reservations = Metrics::counter("seq.blocks_reserved");
+    
+    auto conn = reservations_.acquire();
+    pqxx::work txn(*conn);
+    auto result = txn.exec_params(
+        "INSERT INTO conversation_sequences (conversation, reserved_until) "
+        "VALUES ($1, $2) "
+        "ON CONFLICT (conversation) DO UPDATE "
+        "SET reserved_until = conversation_sequences.reserved_until + EXCLUDED.reserved_until "
+        "RETURNING reserved_until",
+        conversation, static_cast<long long>(block_size_)
+    );
+    txn.commit();
+    
+    auto reserved_until = result[0][0].as<std::uint64_t>();
+    reservations.fetch_add(1, std::memory_order_relaxed);
+    return Block{reserved_until - block_size_ + 1, reserved_until + 1};
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+// src/handlers/batch_handler.cpp
+#include "handlers/batch_handler.hpp"
+#include "handlers/message_handler.hpp"
+#include "handlers/group_handler.hpp"
+#include "handlers/friend_handler.hpp"
+#include "utils/logger.hpp"
+#include "utils/metrics.hpp"
+#include <initializer_list>
+
+namespace {
+// Operation types allowed in a batch, with the string fields each needs.
+struct BatchOperation {
+    const char* type;
+    std::initializer_list<const char*> fields;
+};
+
+const BatchOperation kBatchOperations[] = {
+    {"send_message", {"recipient_id", "content"}},
+    {"send_group_message", {"group_id", "content"}},
+    {"add_group_member", {"group_id", "user_id"}},
+    {"send_friend_request", {"username"}}
+};
+
+std::string batch_error(const std::string& message, std::size_t index) {
+    boost::json::object error;
+    error["type"] = "error";
+    error["code"] = "invalid_batch";
+    error["message"] = message;
+    error["index"] = index;
+    return boost::json::serialize(error);
+}
+
+std::string field(const boost::json::object& operation, const char* name) {
+    return operation.at(name).as_string().c_str();
+}
+
+std::string optional_field(const boost::json::object& operation, const char* name) {
+    const auto* value = operation.if_contains(name);
+    return value ? value->as_string().c_str() : "";
+}
+}
+
+BatchHandler::BatchHandler(Storage& storage,
+                           MessageHandler& msg_handler,
+                           GroupHandler& group_handler,
+                           FriendHandler& friend_handler)
+    : storage_(storage)
+    , msg_handler_(msg_handler)
+    , group_handler_(group_handler)
+    , friend_handler_(friend_handler) {
+}
+
+std::string BatchHandler::validate(const boost::json::array& operations) {
+    if (operations.empty() || operations.size() > kMaxOperations) {
+        return batch_error("A batch holds 1 to " + std::to_string(kMaxOperations) +
+                           " operations", 0);
+    }
+    
+    for (std::size_t i = 0; i < operations.size(); ++i) {
+        const auto* operation = operations[i].if_object();
+        const auto* type = operation ? operation->if_contains("type") : nullptr;
+        if (!type || !type->is_string()) {
+            return batch_error("Operation has no type", i);
+        }
+        
+        const BatchOperation* known = nullptr;
+        for (const auto& candidate : kBatchOperations) {
+            if (type->as_string() == candidate.type) {
+                known = &candidate;
+                break;
+            }
+        }
+        if (!known) {
+            return batch_error(std::string("Operation not allowed in a batch: ") +
+                               type->as_string().c_str(), i);
+        }
+        
+        for (const char* name : known->fields) {
+            const auto* value = operation->if_contains(name);
+            if (!value || !value->is_string()) {
+                return batch_error(std::string("Missing field: ") + name, i);
+            }
+        }
+        
+        const auto* key = operation->if_contains("idempotency_key");
+        if (key && !key->is_string()) {
+            return batch_error("idempotency_key must be a string", i);
+        }
+    }
+    
+    return "";
+}
+
+std::string BatchHandler::handle_batch(
+    const std::string& user_id,
+    const boost::json::array& operations) {
+    
+    static auto& batches = Metrics::counter("batch.committed");
+    static auto& failed_operations = Metrics::counter("batch.failed_operations");
+    
+    std::vector<std::string> results;
+    results.reserve(operations.size());
+    AfterCommit after_commit;
+    
+    try {
+        auto txn = storage_.begin();
+        
+        for (const auto& operation : operations) {
+            std::size_t done = results.size();
+            std::size_t staged = after_commit.size();
+            try {
+                txn->savepoint([&] {
+                    results.push_back(run_operation(*txn, user_id, operation.as_object(), after_commit));
+                });
+            } catch (const std::exception& e) {
+                Logger::get()->error("Batch operation failed: {}", e.what());
+                failed_operations.fetch_add(1, std::memory_order_relaxed);
+                
+                // Rolled back to the savepoint; drop its notifications too
+                after_commit.resize(staged);
+                results.resize(done);
+                
+                boost::json::object error;
+                error["type"] = "error";
+                error["message"] = "Operation failed";
+                results.push_back(boost::json::serialize(error));
+            }
+        }
+        
+        txn->commit();
+    } catch (const std::exception& e) {
+        Logger::get()->error("Failed to commit batch: {}", e.what());
+        boost::json::object error;
+        error["type"] = "error";
+        error["message"] = "Failed to run batch";
+        return boost::json::serialize(error);
+    }
+    
+    batches.fetch_add(1, std::memory_order_relaxed);
+    for (auto& notify : after_commit) {
+        notify();
+    }
+    
+    // The per-operation frames are already serialized; splice them in
+    std::string frame = "{\"type\":\"batch_result\",\"count\":" +
+                        std::to_string(results.size()) + ",\"results\":[";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        if (i > 0) {
+            frame += ',';
+        }
+        frame += results[i];
+    }
+    frame += "]}";
+    
+    Logger::get()->info("Batch of {} operations committed for {}", results.size(), user_id);
+    return frame;
+}
+
+std::string BatchHandler::run_operation(
+    Transaction& txn,
+    const std::string& user_id,
+    const boost::json::object& operation,
+    AfterCommit& after_commit) {
+    
+    std::string type = field(operation, "type");
+    
+    if (type == "send_message") {
+        return msg_handler_.handle_send_message(
+            txn, user_id, field(operation, "recipient_id"), field(operation, "content"),
+            optional_field(operation, "idempotency_key"), after_commit);
+    }
+    if (type == "send_group_message") {
+        return msg_handler_.handle_send_group_message(
+            txn, user_id, field(operation, "group_id"), field(operation, "content"),
+            optional_field(operation, "idempotency_key"), after_commit);
+    }
+    if (type == "add_group_member") {
+        return group_handler_.handle_add_member(
+            txn, field(operation, "group_id"), field(operation, "user_id"), after_commit);
+    }
+    return friend_handler_.handle_send_friend_request(
+        txn, user_id, field(operation, "username"), after_commit);
+}
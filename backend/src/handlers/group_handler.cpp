@@ -43,29 +43,47 @@ std::string GroupHandler::handle_add_member(
     const std::string& group_id,
     const std::string& user_id) {
     
-    bool success = group_repo_.add_member(group_id, user_id);
+    if (!group_repo_.add_member(group_id, user_id)) {
+        boost::json::object error;
+        error["type"] = "error";
+        error["message"] = "Failed to add member";
+        return boost::json::serialize(error);
+    }
     
-    namespace json = boost::json;
-    json::object response;
+    notify_added(group_id, user_id);
+    return member_added(group_id, user_id);
+}
+
+std::string GroupHandler::handle_add_member(
+    Transaction& txn,
+    const std::string& group_id,
+    const std::string& user_id,
+    AfterCommit& after_commit) {
     
-    if (success) {
-        response["type"] = "member_added";
-        response["group_id"] = group_id;
-        response["user_id"] = user_id;
-        
-        // Notify the added member if online
-        if (session_manager_ && session_manager_->is_user_online(user_id)) {
-            json::object notification;
-            notification["type"] = "added_to_group";
-            notification["group_id"] = group_id;
-            session_manager_->send_to_user(user_id, json::serialize(notification));
-        }
-    } else {
-        response["type"] = "error";
-        response["message"] = "Failed to add member";
+    group_repo_.add_member(txn, group_id, user_id, "member", after_commit);
+    after_commit.push_back([this, group_id, user_id] {
+        notify_added(group_id, user_id);
+    });
+    return member_added(group_id, user_id);
+}
+
+std::string GroupHandler::member_added(const std::string& group_id, const std::string& user_id) {
+    boost::json::object response;
+    response["type"] = "member_added";
+    response["group_id"] = group_id;
+    response["user_id"] = user_id;
+    return boost::json::serialize(response);
+}
+
+void GroupHandler::notify_added(const std::string& group_id, const std::string& user_id) {
+    // Notify the added member if online, on this node or another
+    if (session_manager_) {
+        boost::json::object notification;
+        notification["type"] = "added_to_group";
+        notification["group_id"] = group_id;
+        session_manager_->send_ephemeral_to_user(user_id, boost::json::serialize(notification),
+                                                 "groups");
     }
-    
-    return json::serialize(response);
 }
 
 std::string GroupHandler::handle_get_groups(const std::string& user_id) {
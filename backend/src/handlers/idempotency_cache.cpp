@@ -0,0 +1,138 @@
+// src/handlers/idempotency_cache.cpp
+#include "handlers/idempotency_cache.hpp"
+#include "utils/metrics.hpp"
+#include <algorithm>
+
+namespace {
+// About 1% false positives at a full generation
+constexpr std::size_t kBloomBitsPerEntry = 10;
+constexpr std::size_t kBloomProbes = 7;
+// Inserts per generation, in windows; above 1 to allow for uneven shards
+constexpr std::size_t kBloomGenerationWindows = 2;
+}
+
+IdempotencyCache::Bloom::Bloom(std::size_t max_entries)
+    : words_(std::max<std::size_t>(
+          1, max_entries * kBloomGenerationWindows * kBloomBitsPerEntry / 64))
+    , rotate_after_(std::max<std::size_t>(1, max_entries * kBloomGenerationWindows))
+    , inserts_(0)
+    , current_(0) {
+    for (auto& bits : generations_) {
+        bits = std::make_unique<std::atomic<std::uint64_t>[]>(words_);
+        for (std::size_t i = 0; i < words_; ++i) {
+            bits[i].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+bool IdempotencyCache::Bloom::may_contain(std::size_t hash) const {
+    return test(generations_[0], hash) || test(generations_[1], hash);
+}
+
+bool IdempotencyCache::Bloom::test(const Bits& bits, std::size_t hash) const {
+    // Double hashing: probe i is h1 + i * h2
+    const std::uint64_t h1 = hash;
+    const std::uint64_t h2 = (static_cast<std::uint64_t>(hash) >> 32) | 1;
+    const std::uint64_t total = words_ * 64;
+    for (std::size_t i = 0; i < kBloomProbes; ++i) {
+        std::uint64_t bit = (h1 + i * h2) % total;
+        if (!(bits[bit / 64].load(std::memory_order_relaxed) & (std::uint64_t{1} << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void IdempotencyCache::Bloom::add(std::size_t hash) {
+    const Bits& bits = generations_[current_.load(std::memory_order_acquire)];
+    const std::uint64_t h1 = hash;
+    const std::uint64_t h2 = (static_cast<std::uint64_t>(hash) >> 32) | 1;
+    const std::uint64_t total = words_ * 64;
+    for (std::size_t i = 0; i < kBloomProbes; ++i) {
+        std::uint64_t bit = (h1 + i * h2) % total;
+        bits[bit / 64].fetch_or(std::uint64_t{1} << (bit % 64), std::memory_order_relaxed);
+    }
+    
+    if (inserts_.fetch_add(1, std::memory_order_relaxed) + 1 < rotate_after_) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(rotate_mutex_, std::try_to_lock);
+    if (!lock || inserts_.load(std::memory_order_relaxed) < rotate_after_) {
+        return;
+    }
+    // Nobody adds to the previous generation, so it can be cleared in place
+    int next = 1 - current_.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < words_; ++i) {
+        generations_[next][i].store(0, std::memory_order_relaxed);
+    }
+    current_.store(next, std::memory_order_release);
+    inserts_.store(0, std::memory_order_relaxed);
+}
+
+IdempotencyCache::IdempotencyCache(std::size_t max_entries, bool bloom)
+    : max_entries_per_shard_(std::max<std::size_t>(1, max_entries / kShards))
+    , bloom_(bloom ? std::make_unique<Bloom>(max_entries) : nullptr) {
+}
+
+std::optional<std::string> IdempotencyCache::find(const std::string& sender_id,
+                                                  const std::string& key) {
+    std::string full_key = make_key(sender_id, key);
+    std::size_t hash = std::hash<std::string>{}(full_key);
+    if (bloom_ && !bloom_->may_contain(hash)) {
+        return std::nullopt;
+    }
+    
+    Shard& shard = shard_for(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(full_key);
+    if (it == shard.index.end()) {
+        return std::nullopt;
+    }
+    
+    static auto& hits = Metrics::counter("idempotency.hits");
+    hits.fetch_add(1, std::memory_order_relaxed);
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    if (bloom_) {
+        bloom_->add(hash);  // keep it in the live generation while it is in use
+    }
+    return it->second->second;
+}
+
+void IdempotencyCache::insert(const std::string& sender_id, const std::string& key, std::string ack) {
+    std::string full_key = make_key(sender_id, key);
+    std::size_t hash = std::hash<std::string>{}(full_key);
+    
+    {
+        Shard& shard = shard_for(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(full_key);
+        if (it != shard.index.end()) {
+            it->second->second = std::move(ack);
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        } else {
+            if (shard.index.size() >= max_entries_per_shard_) {
+                shard.index.erase(shard.lru.back().first);
+                shard.lru.pop_back();
+            }
+            shard.lru.emplace_front(full_key, std::move(ack));
+            shard.index.emplace(std::move(full_key), shard.lru.begin());
+        }
+    }
+    
+    if (bloom_) {
+        bloom_->add(hash);
+    }
+}
+
+std::string IdempotencyCache::make_key(const std::string& sender_id, const std::string& key) {
+    std::string full_key;
+    full_key.reserve(sender_id.size() + 1 + key.size());
+    full_key += sender_id;
+    full_key += '\0';
+    full_key += key;
+    return full_key;
+}
+
+IdempotencyCache::Shard& IdempotencyCache::shard_for(std::size_t hash) {
+    return shards_[hash % kShards];
+}
@@ -0,0 +1,415 @@
+// src/handlers/inbox_handler.cpp
+#include "handlers/inbox_handler.hpp"
+#include "server/timing_wheel.hpp"
+#include "utils/id_generator.hpp"
+#include "utils/logger.hpp"
+#include "utils/metrics.hpp"
+#include <boost/json.hpp>
+#include <algorithm>
+
+namespace {
+// Same cut as the inbox query's LEFT(content, 200), in code points
+std::string preview_of(const std::string& content) {
+    constexpr std::size_t kPreviewChars = 200;
+    std::size_t chars = 0;
+    for (std::size_t i = 0; i < content.size(); ++i) {
+        if ((static_cast<unsigned char>(content[i]) & 0xC0) != 0x80 && chars++ == kPreviewChars) {
+            return content.substr(0, i);
+        }
+    }
+    return content;
+}
+}
+
+InboxHandler::InboxHandler(MessageRepository& msg_repo)
+    : msg_repo_(msg_repo) {
+}
+
+InboxHandler::~InboxHandler() {
+    stop();
+}
+
+InboxHandler::Shard& InboxHandler::shard_for(const std::string& user_id) {
+    return shards_[std::hash<std::string>{}(user_id) % kShards];
+}
+
+template <typename Fn>
+bool InboxHandler::with_inbox(const std::string& user_id, Fn&& fn) {
+    static auto& loads = Metrics::counter("inbox.loads");
+    
+    Shard& shard = shard_for(user_id);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.inboxes.find(user_id);
+        if (it != shard.inboxes.end() && !it->second.loading) {
+            fn(shard, it->second);
+            return true;
+        }
+        if (it == shard.inboxes.end()) {
+            // Updates from here on are queued until the query's result is in
+            shard.inboxes.emplace(user_id, Inbox{});
+        }
+    }
+    
+    loads.fetch_add(1, std::memory_order_relaxed);
+    auto entries = msg_repo_.get_inbox(user_id);
+    
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.inboxes.find(user_id);
+    if (!entries) {
+        if (it != shard.inboxes.end() && it->second.loading) {
+            shard.inboxes.erase(it);
+        }
+        return false;
+    }
+    
+    Inbox uncached;
+    Inbox* inbox = it != shard.inboxes.end() ? &it->second : &uncached;
+    if (inbox->loading) {
+        for (auto& entry : *entries) {
+            // A read mark not saved yet is newer than what the query saw
+            auto mark = shard.marks.find({user_id, entry.conversation});
+            if (mark != shard.marks.end() && mark->second.seq >= entry.last_seq) {
+                entry.unread = 0;
+            }
+            std::string conversation = entry.conversation;
+            inbox->entries.emplace(std::move(conversation), std::move(entry));
+        }
+        
+        // Skip what the query already counted
+        for (const auto& update : inbox->queued) {
+            auto loaded = inbox->entries.find(update.conversation);
+            if (loaded == inbox->entries.end() || update.seq > loaded->second.last_seq) {
+                apply_to(*inbox, update);
+            }
+        }
+        inbox->queued.clear();
+        inbox->loading = false;
+    }
+    
+    fn(shard, *inbox);
+    return true;
+}
+
+std::string InboxHandler::handle_get_inbox(const std::string& user_id) {
+    namespace json = boost::json;
+    
+    std::vector<InboxEntry> entries;
+    bool loaded = with_inbox(user_id, [&](Shard&, Inbox& inbox) {
+        entries.reserve(inbox.entries.size());
+        for (const auto& [conversation, entry] : inbox.entries) {
+            entries.push_back(entry);
+        }
+    });
+    
+    if (!loaded) {
+        json::object error;
+        error["type"] = "error";
+        error["message"] = "Failed to load inbox";
+        return json::serialize(error);
+    }
+    
+    // Timestamps from the query and from this process differ in format
+    std::vector<std::pair<std::chrono::system_clock::time_point, const InboxEntry*>> order;
+    order.reserve(entries.size());
+    for (const auto& entry : entries) {
+        order.emplace_back(IdGenerator::parse_timestamp(entry.last_created_at), &entry);
+    }
+    std::sort(order.begin(), order.end(), [](const auto& a, const auto& b) {
+        return a.first > b.first;
+    });
+    
+    json::array conversations;
+    conversations.reserve(entries.size());
+    std::uint64_t total_unread = 0;
+    for (const auto& ordered : order) {
+        const InboxEntry& entry = *ordered.second;
+        bool group = entry.conversation.compare(0, 6, "group:") == 0;
+        
+        json::object last_message;
+        last_message["message_id"] = entry.last_message_id;
+        last_message["sender_id"] = entry.last_sender_id;
+        last_message["content"] = entry.last_preview;
+        last_message["created_at"] = entry.last_created_at;
+        
+        json::object item;
+        item["conversation"] = entry.conversation;
+        item["kind"] = group ? "group" : "direct";
+        item["id"] = entry.conversation.substr(group ? 6 : 3);
+        item["unread"] = entry.unread;
+        item["last_message"] = last_message;
+        conversations.push_back(item);
+        total_unread += entry.unread;
+    }
+    
+    json::object response;
+    response["type"] = "inbox";
+    response["conversations"] = conversations;
+    response["total_unread"] = total_unread;
+    return json::serialize(response);
+}
+
+std::string InboxHandler::handle_mark_read(const std::string& user_id, const std::string& conversation) {
+    namespace json = boost::json;
+    
+    bool found = false;
+    std::string read_at;
+    bool loaded = with_inbox(user_id, [&](Shard& shard, Inbox& inbox) {
+        auto it = inbox.entries.find(conversation);
+        if (it == inbox.entries.end()) {
+            return;
+        }
+        found = true;
+        it->second.unread = 0;
+        read_at = it->second.last_created_at;
+        keep_newer(shard.marks[{user_id, conversation}], it->second.last_seq, read_at);
+    });
+    
+    if (!loaded || !found) {
+        json::object error;
+        error["type"] = "error";
+        error["message"] = loaded ? "Unknown conversation" : "Failed to load inbox";
+        error["conversation"] = conversation;
+        return json::serialize(error);
+    }
+    
+    json::object response;
+    response["type"] = "marked_read";
+    response["conversation"] = conversation;
+    response["read_at"] = read_at;
+    return json::serialize(response);
+}
+
+void InboxHandler::on_message_sent(const Message& message) {
+    std::string preview = preview_of(message.content);
+    apply(message.sender_id, Update{
+        "dm:" + message.recipient_id,
+        message.message_id,
+        message.sender_id,
+        preview,
+        message.created_at,
+        message.seq,
+        false
+    });
+    if (message.recipient_id != message.sender_id) {
+        apply(message.recipient_id, Update{
+            "dm:" + message.sender_id,
+            message.message_id,
+            message.sender_id,
+            std::move(preview),
+            message.created_at,
+            message.seq,
+            true
+        });
+    }
+}
+
+void InboxHandler::on_group_message(const Message& message, const IdSet& members) {
+    Update update{
+        "group:" + message.group_id,
+        message.message_id,
+        message.sender_id,
+        preview_of(message.content),
+        message.created_at,
+        message.seq,
+        true
+    };
+    
+    // Each shard walks whichever is smaller: its loaded inboxes or its
+    // share of the members
+    std::array<std::vector<const std::string*>, kShards> buckets;
+    for (const auto& member : members) {
+        buckets[std::hash<std::string>{}(member) % kShards].push_back(&member);
+    }
+
+    for (std::size_t i = 0; i < kShards; ++i) {
+        if (buckets[i].empty()) {
+            continue;
+        }
+        Shard& shard = shards_[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto deliver = [&](const std::string& user_id) {
+            update.incoming = user_id != message.sender_id;
+            apply_locked(shard, user_id, update);
+        };
+        if (shard.inboxes.size() < buckets[i].size()) {
+            for (const auto& [user_id, inbox] : shard.inboxes) {
+                if (MembershipIndex::contains(members, user_id)) {
+                    deliver(user_id);
+                }
+            }
+        } else {
+            for (const auto* user_id : buckets[i]) {
+                deliver(*user_id);
+            }
+        }
+    }
+}
+
+void InboxHandler::on_remote_event(const std::vector<std::string>& user_ids, const std::string& frame) {
+    std::vector<std::string> loaded;
+    for (const auto& user_id : user_ids) {
+        Shard& shard = shard_for(user_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.inboxes.find(user_id) != shard.inboxes.end()) {
+            loaded.push_back(user_id);
+        }
+    }
+    if (loaded.empty()) {
+        return;
+    }
+    
+    namespace json = boost::json;
+    try {
+        auto parsed = json::parse(frame);
+        const auto& obj = parsed.as_object();
+        const auto* type = obj.if_contains("type");
+        if (!type || !type->is_string()) {
+            return;
+        }
+        
+        Message message;
+        message.message_id = obj.at("message_id").as_string().c_str();
+        message.sender_id = obj.at("sender_id").as_string().c_str();
+        message.content = obj.at("content").as_string().c_str();
+        message.created_at = obj.at("created_at").as_string().c_str();
+        message.seq = obj.at("conversation_seq").to_number<std::uint64_t>();
+        
+        std::string conversation;
+        if (type->as_string() == "new_message") {
+            conversation = "dm:" + message.sender_id;
+        } else if (type->as_string() == "group_message") {
+            conversation = std::string("group:") + obj.at("group_id").as_string().c_str();
+        } else {
+            return;
+        }
+        
+        std::string preview = preview_of(message.content);
+        for (const auto& user_id : loaded) {
+            apply(user_id, Update{
+                conversation,
+                message.message_id,
+                message.sender_id,
+                preview,
+                message.created_at,
+                message.seq,
+                message.sender_id != user_id
+            });
+        }
+    } catch (const std::exception& e) {
+        Logger::get()->error("Inbox update from malformed forwarded event: {}", e.what());
+    }
+}
+
+void InboxHandler::evict(const std::string& user_id) {
+    Shard& shard = shard_for(user_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.inboxes.erase(user_id);
+}
+
+void InboxHandler::apply(const std::string& user_id, Update update) {
+    Shard& shard = shard_for(user_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    apply_locked(shard, user_id, update);
+}
+
+void InboxHandler::apply_locked(Shard& shard, const std::string& user_id, const Update& update) {
+    auto it = shard.inboxes.find(user_id);
+    if (it == shard.inboxes.end()) {
+        return;
+    }
+    if (it->second.loading) {
+        it->second.queued.push_back(update);
+    } else {
+        apply_to(it->second, update);
+    }
+}
+
+void InboxHandler::apply_to(Inbox& inbox, const Update& update) {
+    auto& entry = inbox.entries[update.conversation];
+    entry.conversation = update.conversation;
+    if (update.incoming) {
+        ++entry.unread;
+    }
+    // Fan-outs for different messages may land out of order
+    if (update.seq >= entry.last_seq) {
+        entry.last_message_id = update.message_id;
+        entry.last_sender_id = update.sender_id;
+        entry.last_preview = update.preview;
+        entry.last_created_at = update.created_at;
+        entry.last_seq = update.seq;
+    }
+}
+
+void InboxHandler::keep_newer(Mark& mark, std::uint64_t seq, const std::string& read_at) {
+    if (mark.read_at.empty() || seq > mark.seq) {
+        mark.seq = seq;
+        mark.read_at = read_at;
+    }
+}
+
+void InboxHandler::flush() {
+    static auto& saved = Metrics::counter("inbox.read_marks_saved");
+    
+    std::vector<ReadMark> marks;
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto& [key, mark] : shard.marks) {
+            marks.push_back(ReadMark{key.first, key.second, std::move(mark.read_at), mark.seq});
+        }
+        shard.marks.clear();
+    }
+    if (marks.empty()) {
+        return;
+    }
+    
+    if (msg_repo_.save_read_marks(marks)) {
+        saved.fetch_add(marks.size(), std::memory_order_relaxed);
+        return;
+    }
+    
+    // Put them back unless a newer mark arrived meanwhile
+    for (auto& mark : marks) {
+        Shard& shard = shard_for(mark.user_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        keep_newer(shard.marks[{mark.user_id, mark.conversation}], mark.seq, mark.read_at);
+    }
+}
+
+void InboxHandler::start() {
+    flusher_ = std::thread([this] {
+        std::unique_lock<std::mutex> lock(flusher_mutex_);
+        while (true) {
+            wake_.wait(lock, [&] { return flush_requested_ || stopping_; });
+            if (stopping_) {
+                return;
+            }
+            flush_requested_ = false;
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    });
+}
+
+void InboxHandler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(flusher_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+}
+
+void InboxHandler::schedule_flush(TimingWheel& wheel, std::chrono::milliseconds interval) {
+    wheel.schedule(interval, [this, &wheel, interval] {
+        {
+            std::lock_guard<std::mutex> lock(flusher_mutex_);
+            flush_requested_ = true;
+        }
+        wake_.notify_one();
+        schedule_flush(wheel, interval);
+    });
+}
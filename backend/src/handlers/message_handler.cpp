@@ -1,89 +1,273 @@
 // src/handlers/message_handler.cpp
 #include "handlers/message_handler.hpp"
+#include "handlers/inbox_handler.hpp"
 #include "server/session_manager.hpp"
 #include "utils/logger.hpp"
+#include "utils/metrics.hpp"
 #include <boost/json.hpp>
+#include <algorithm>
+#include <stdexcept>
 
-MessageHandler::MessageHandler(MessageRepository& msg_repo)
+namespace {
+// Messages per sync_batch frame, and per sync request overall; a client
+// that gets has_more=true sends another sync from the returned cursor.
+constexpr int kSyncBatchSize = 100;
+constexpr int kSyncMaxMessages = 1000;
+// Most messages one get_range returns; the client continues from the last seq
+constexpr int kRangeMaxMessages = 1000;
+constexpr std::size_t kMaxIdempotencyKeyLength = 128;
+
+std::string error_frame(const char* message) {
+    boost::json::object error;
+    error["type"] = "error";
+    error["message"] = message;
+    return boost::json::serialize(error);
+}
+}
+
+MessageHandler::MessageHandler(MessageRepository& msg_repo,
+                               GroupRepository& group_repo,
+                               std::size_t dedup_entries,
+                               bool dedup_bloom)
     : msg_repo_(msg_repo)
-    , session_manager_(nullptr) {
+    , group_repo_(group_repo)
+    , idempotency_(dedup_entries, dedup_bloom)
+    , session_manager_(nullptr)
+    , inbox_handler_(nullptr) {
 }
 
 void MessageHandler::set_session_manager(SessionManager* manager) {
     session_manager_ = manager;
 }
 
-void MessageHandler::handle_send_message(
+void MessageHandler::set_inbox_handler(InboxHandler* inbox) {
+    inbox_handler_ = inbox;
+}
+
+std::string MessageHandler::handle_send_message(
     const std::string& sender_id,
     const std::string& recipient_id,
-    const std::string& content) {
+    const std::string& content,
+    const std::string& idempotency_key) {
     
-    auto message = msg_repo_.send_message(sender_id, recipient_id, content);
+    if (idempotency_key.size() > kMaxIdempotencyKeyLength) {
+        return error_frame("Invalid idempotency key");
+    }
+    if (auto ack = replay(sender_id, idempotency_key)) {
+        return *ack;
+    }
     
-    if (message) {
-        namespace json = boost::json;
-        
-        // Send to sender (confirmation)
-        json::object sender_response;
-        sender_response["type"] = "message_sent";
-        sender_response["message_id"] = message->message_id;
-        sender_response["recipient_id"] = recipient_id;
-        sender_response["content"] = content;
-        sender_response["created_at"] = message->created_at;
-        
-        if (session_manager_) {
-            session_manager_->send_to_user(sender_id, json::serialize(sender_response));
-            
-            // Send to recipient if online
-            if (session_manager_->is_user_online(recipient_id)) {
-                json::object recipient_response;
-                recipient_response["type"] = "new_message";
-                recipient_response["message_id"] = message->message_id;
-                recipient_response["sender_id"] = sender_id;
-                recipient_response["content"] = content;
-                recipient_response["created_at"] = message->created_at;
-                
-                session_manager_->send_to_user(recipient_id, json::serialize(recipient_response));
-            }
-        }
-        
-        Logger::get()->info("Message delivered from {} to {}", sender_id, recipient_id);
-    } else {
+    auto message = msg_repo_.send_message(sender_id, recipient_id, content, "text", idempotency_key);
+    
+    if (!message) {
         Logger::get()->error("Failed to send message from {} to {}", sender_id, recipient_id);
+        return error_frame("Failed to send message");
+    }
+    
+    if (!message->duplicate) {
+        deliver_message(*message);
     }
+    std::string ack = message_sent(*message);
+    remember(sender_id, idempotency_key, ack);
+    return ack;
 }
 
-void MessageHandler::handle_send_group_message(
+std::string MessageHandler::handle_send_message(
+    Transaction& txn,
+    const std::string& sender_id,
+    const std::string& recipient_id,
+    const std::string& content,
+    const std::string& idempotency_key,
+    AfterCommit& after_commit) {
+    
+    if (idempotency_key.size() > kMaxIdempotencyKeyLength) {
+        throw std::runtime_error("Invalid idempotency key");
+    }
+    if (auto ack = replay(sender_id, idempotency_key)) {
+        return *ack;
+    }
+    
+    Message message = msg_repo_.send_message(txn, sender_id, recipient_id, content, "text",
+                                             idempotency_key);
+    std::string ack = message_sent(message);
+    after_commit.push_back([this, message, idempotency_key, ack] {
+        if (!message.duplicate) {
+            deliver_message(message);
+        }
+        remember(message.sender_id, idempotency_key, ack);
+    });
+    return ack;
+}
+
+std::string MessageHandler::handle_send_group_message(
     const std::string& sender_id,
     const std::string& group_id,
-    const std::string& content) {
+    const std::string& content,
+    const std::string& idempotency_key) {
     
-    auto message = msg_repo_.send_group_message(sender_id, group_id, content);
+    if (idempotency_key.size() > kMaxIdempotencyKeyLength) {
+        return error_frame("Invalid idempotency key");
+    }
+    if (auto ack = replay(sender_id, idempotency_key)) {
+        return *ack;
+    }
     
-    if (message && session_manager_) {
-        namespace json = boost::json;
-        
-        json::object response;
-        response["type"] = "group_message";
-        response["message_id"] = message->message_id;
-        response["sender_id"] = sender_id;
-        response["group_id"] = group_id;
-        response["content"] = content;
-        response["created_at"] = message->created_at;
-        
-        std::string response_str = json::serialize(response);
+    if (!group_repo_.is_member(group_id, sender_id)) {
+        static auto& rejected = Metrics::counter("group.not_member_rejected");
+        rejected.fetch_add(1, std::memory_order_relaxed);
+        boost::json::object error;
+        error["type"] = "error";
+        error["message"] = "Not a member of this group";
+        error["group_id"] = group_id;
+        return boost::json::serialize(error);
+    }
+    
+    auto message = msg_repo_.send_group_message(sender_id, group_id, content, "text",
+                                                idempotency_key);
+    
+    if (!message) {
+        return error_frame("Failed to send group message");
+    }
+    
+    if (!message->duplicate) {
+        deliver_group_message(*message);
+    }
+    std::string ack = group_message_sent(*message);
+    remember(sender_id, idempotency_key, ack);
+    return ack;
+}
+
+std::string MessageHandler::handle_send_group_message(
+    Transaction& txn,
+    const std::string& sender_id,
+    const std::string& group_id,
+    const std::string& content,
+    const std::string& idempotency_key,
+    AfterCommit& after_commit) {
+    
+    if (idempotency_key.size() > kMaxIdempotencyKeyLength) {
+        throw std::runtime_error("Invalid idempotency key");
+    }
+    if (auto ack = replay(sender_id, idempotency_key)) {
+        return *ack;
+    }
+    
+    if (!group_repo_.is_member(group_id, sender_id)) {
+        static auto& rejected = Metrics::counter("group.not_member_rejected");
+        rejected.fetch_add(1, std::memory_order_relaxed);
+        throw std::runtime_error("Not a member of group " + group_id);
+    }
+    
+    Message message = msg_repo_.send_group_message(txn, sender_id, group_id, content, "text",
+                                                   idempotency_key);
+    std::string ack = group_message_sent(message);
+    after_commit.push_back([this, message, idempotency_key, ack] {
+        if (!message.duplicate) {
+            deliver_group_message(message);
+        }
+        remember(message.sender_id, idempotency_key, ack);
+    });
+    return ack;
+}
+
+std::optional<std::string> MessageHandler::replay(const std::string& sender_id,
+                                                  const std::string& idempotency_key) {
+    if (idempotency_key.empty()) {
+        return std::nullopt;
+    }
+    auto ack = idempotency_.find(sender_id, idempotency_key);
+    if (ack) {
+        Logger::get()->info("Replayed ack for retried send {} from {}", idempotency_key, sender_id);
+    }
+    return ack;
+}
+
+void MessageHandler::remember(const std::string& sender_id,
+                              const std::string& idempotency_key,
+                              const std::string& ack) {
+    if (!idempotency_key.empty()) {
+        idempotency_.insert(sender_id, idempotency_key, ack);
+    }
+}
+
+std::string MessageHandler::message_sent(const Message& message) {
+    // Confirmation for the sender
+    boost::json::object response;
+    response["type"] = "message_sent";
+    response["message_id"] = message.message_id;
+    response["recipient_id"] = message.recipient_id;
+    response["content"] = message.content;
+    response["created_at"] = message.created_at;
+    response["conversation_seq"] = message.seq;
+    return boost::json::serialize(response);
+}
+
+void MessageHandler::deliver_message(const Message& message) {
+    if (inbox_handler_) {
+        inbox_handler_->on_message_sent(message);
+    }
+    
+    if (session_manager_) {
+        // Send to recipient; if they just dropped, it is kept for resume
+        boost::json::object response;
+        response["type"] = "new_message";
+        response["message_id"] = message.message_id;
+        response["sender_id"] = message.sender_id;
+        response["content"] = message.content;
+        response["created_at"] = message.created_at;
+        response["conversation_seq"] = message.seq;
         
-        // In production, get all group members and send to online ones
-        // For now, simplified implementation
-        Logger::get()->info("Group message sent from {} to group {}", sender_id, group_id);
+        session_manager_->send_event_to_user(message.recipient_id, boost::json::serialize(response));
     }
+    
+    Logger::get()->info("Message delivered from {} to {}", message.sender_id, message.recipient_id);
+}
+
+std::string MessageHandler::group_message_sent(const Message& message) {
+    boost::json::object ack;
+    ack["type"] = "group_message_sent";
+    ack["message_id"] = message.message_id;
+    ack["group_id"] = message.group_id;
+    ack["created_at"] = message.created_at;
+    ack["conversation_seq"] = message.seq;
+    return boost::json::serialize(ack);
+}
+
+void MessageHandler::deliver_group_message(const Message& message) {
+    if (!session_manager_) {
+        return;
+    }
+    
+    boost::json::object response;
+    response["type"] = "group_message";
+    response["message_id"] = message.message_id;
+    response["sender_id"] = message.sender_id;
+    response["group_id"] = message.group_id;
+    response["content"] = message.content;
+    response["created_at"] = message.created_at;
+    response["conversation_seq"] = message.seq;
+    
+    auto members = group_repo_.get_member_ids(message.group_id);
+    if (!members) {
+        Logger::get()->error("Group message {} not delivered: members of {} unavailable",
+                            message.message_id, message.group_id);
+        return;
+    }
+    if (inbox_handler_) {
+        inbox_handler_->on_group_message(message, *members);
+    }
+    session_manager_->send_to_group(members, boost::json::serialize(response));
+    
+    Logger::get()->info("Group message sent from {} to group {} ({} members)",
+                       message.sender_id, message.group_id, members->size());
 }
 
 std::string MessageHandler::handle_get_conversation(
     const std::string& user1_id,
-    const std::string& user2_id) {
+    const std::string& user2_id,
+    std::uint64_t before_seq) {
     
-    auto messages = msg_repo_.get_conversation(user1_id, user2_id);
+    auto messages = msg_repo_.get_conversation(user1_id, user2_id, 50, before_seq);
     
     namespace json = boost::json;
     json::object response;
@@ -98,10 +282,131 @@ std::string MessageHandler::handle_get_conversation(
         msg_obj["content"] = msg.content;
         msg_obj["message_type"] = msg.message_type;
         msg_obj["created_at"] = msg.created_at;
+        msg_obj["conversation_seq"] = msg.seq;
+        msg_obj["is_read"] = msg.is_read;
+        messages_array.push_back(msg_obj);
+    }
+    
+    response["messages"] = messages_array;
+    return json::serialize(response);
+}
+
+std::string MessageHandler::handle_get_range(
+    const std::string& user_id,
+    const std::string& other_user_id,
+    const std::string& group_id,
+    std::uint64_t from_seq,
+    std::uint64_t to_seq) {
+    
+    namespace json = boost::json;
+    
+    auto error = [&](const char* message) {
+        json::object response;
+        response["type"] = "error";
+        response["message"] = message;
+        return json::serialize(response);
+    };
+    
+    if (from_seq == 0 || to_seq < from_seq) {
+        return error("Invalid sequence range");
+    }
+    
+    std::vector<Message> messages;
+    if (!group_id.empty()) {
+        if (!group_repo_.is_member(group_id, user_id)) {
+            return error("Not a member of this group");
+        }
+        messages = msg_repo_.get_group_range(group_id, from_seq, to_seq, kRangeMaxMessages);
+    } else {
+        messages = msg_repo_.get_conversation_range(user_id, other_user_id, from_seq, to_seq,
+                                                    kRangeMaxMessages);
+    }
+    
+    json::array messages_array;
+    messages_array.reserve(messages.size());
+    for (const auto& msg : messages) {
+        json::object msg_obj;
+        msg_obj["message_id"] = msg.message_id;
+        msg_obj["sender_id"] = msg.sender_id;
+        msg_obj["recipient_id"] = msg.recipient_id;
+        msg_obj["group_id"] = msg.group_id;
+        msg_obj["content"] = msg.content;
+        msg_obj["message_type"] = msg.message_type;
+        msg_obj["created_at"] = msg.created_at;
+        msg_obj["conversation_seq"] = msg.seq;
         msg_obj["is_read"] = msg.is_read;
         messages_array.push_back(msg_obj);
     }
     
+    json::object response;
+    response["type"] = "message_range";
+    if (!group_id.empty()) {
+        response["group_id"] = group_id;
+    } else {
+        response["user_id"] = other_user_id;
+    }
+    response["from_seq"] = from_seq;
+    response["to_seq"] = to_seq;
     response["messages"] = messages_array;
+    response["has_more"] = messages.size() >= static_cast<std::size_t>(kRangeMaxMessages);
     return json::serialize(response);
 }
+
+std::vector<std::string> MessageHandler::handle_sync(
+    const std::string& user_id,
+    const std::string& after) {
+    
+    namespace json = boost::json;
+    
+    auto page = msg_repo_.get_messages_since(user_id, after, kSyncMaxMessages);
+    if (!page) {
+        json::object error;
+        error["type"] = "error";
+        error["message"] = "Failed to sync";
+        error["cursor"] = after;
+        return {json::serialize(error)};
+    }
+    
+    std::vector<std::string> frames;
+    const auto& messages = page->messages;
+    std::string cursor = after;
+    
+    for (std::size_t start = 0; start < messages.size(); start += kSyncBatchSize) {
+        std::size_t end = std::min(messages.size(), start + kSyncBatchSize);
+        
+        json::array messages_array;
+        messages_array.reserve(end - start);
+        for (std::size_t i = start; i < end; ++i) {
+            const auto& msg = messages[i];
+            json::object msg_obj;
+            msg_obj["message_id"] = msg.message_id;
+            msg_obj["sender_id"] = msg.sender_id;
+            msg_obj["recipient_id"] = msg.recipient_id;
+            msg_obj["group_id"] = msg.group_id;
+            msg_obj["content"] = msg.content;
+            msg_obj["message_type"] = msg.message_type;
+            msg_obj["created_at"] = msg.created_at;
+            msg_obj["conversation_seq"] = msg.seq;
+            msg_obj["is_read"] = msg.is_read;
+            messages_array.push_back(msg_obj);
+        }
+        
+        cursor = page->cursors[end - 1];
+        
+        json::object batch;
+        batch["type"] = "sync_batch";
+        batch["messages"] = messages_array;
+        batch["cursor"] = cursor;
+        frames.push_back(json::serialize(batch));
+    }
+    
+    json::object complete;
+    complete["type"] = "sync_complete";
+    complete["count"] = messages.size();
+    complete["cursor"] = cursor;
+    complete["has_more"] = messages.size() >= static_cast<std::size_t>(kSyncMaxMessages);
+    frames.push_back(json::serialize(complete));
+    
+    Logger::get()->info("Synced {} messages for {}", messages.size(), user_id);
+    return frames;
+}
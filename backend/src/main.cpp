@@ -1,32 +1,88 @@
 #include "database/database.hpp"
-#include "database/user_repository.hpp"
-#include "database/message_repository.hpp"
-#include "database/group_repository.hpp"
+#include "database/postgres_user_repository.hpp"
+#include "database/postgres_message_repository.hpp"
+#include "database/postgres_group_repository.hpp"
+#include "database/postgres_friend_repository.hpp"
+#include "database/message_archive.hpp"
+#include "database/embedded_store.hpp"
+#include "database/embedded_repositories.hpp"
 #include "auth/auth_service.hpp"
 #include "auth/jwt_handler.hpp"
 #include "server/websocket_server.hpp"
 #include "server/session_manager.hpp"
+#include "server/rate_limiter.hpp"
+#include "server/tls_context.hpp"
+#include "server/io_backend.hpp"
+#include "server/io_pool.hpp"
+#include "cluster/cluster_node.hpp"
 #include "handlers/message_handler.hpp"
 #include "handlers/group_handler.hpp"
 #include "handlers/friend_handler.hpp"
+#include "handlers/batch_handler.hpp"
+#include "handlers/inbox_handler.hpp"
 #include "utils/logger.hpp"
+#include "utils/config.hpp"
+#include "utils/metrics.hpp"
+#include "utils/cpu_affinity.hpp"
 
 #include <boost/asio.hpp>
 #include <iostream>
 #include <memory>
 #include <thread>
 #include <csignal>
-#include <atomic>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
 
-// Global flag for graceful shutdown
-std::atomic<bool> shutdown_requested{false};
+// Parses "node-b@127.0.0.1:9081,node-c@127.0.0.1:9082"
+std::vector<ClusterPeer> parse_cluster_peers(const std::string& spec) {
+    std::vector<ClusterPeer> peers;
+    std::size_t start = 0;
+    while (start < spec.size()) {
+        std::size_t end = spec.find(',', start);
+        if (end == std::string::npos) end = spec.size();
+        std::string entry = spec.substr(start, end - start);
+        start = end + 1;
+        
+        std::size_t at = entry.find('@');
+        std::size_t colon = entry.rfind(':');
+        if (at == std::string::npos || colon == std::string::npos || colon < at) {
+            throw std::runtime_error("Invalid cluster peer: " + entry);
+        }
+        
+        ClusterPeer peer;
+        peer.node_id = entry.substr(0, at);
+        peer.endpoint = boost::asio::ip::tcp::endpoint{
+            boost::asio::ip::make_address(entry.substr(at + 1, colon - at - 1)),
+            static_cast<unsigned short>(std::stoi(entry.substr(colon + 1)))
+        };
+        peers.push_back(peer);
+    }
+    return peers;
+}
 
-void signal_handler(int signal) {
-    if (signal == SIGINT || signal == SIGTERM) {
-        std::cout << "\nShutdown signal received. Cleaning up...\n";
-        shutdown_requested = true;
+// A size or count setting; zero or negative is refused rather than cast
+// to an enormous limit
+std::size_t positive_setting(const std::string& name, long long fallback) {
+    long long value = Config::get_int(name, fallback);
+    if (value <= 0) {
+        throw std::runtime_error(name + " must be positive, got " + std::to_string(value));
     }
+    return static_cast<std::size_t>(value);
+}
+
+#ifdef CHAT_IO_URING
+// The epoll build of this server, installed next to this binary.
+std::string epoll_fallback_path() {
+    char self[4096];
+    ssize_t n = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    std::string dir = n > 0 ? std::string(self, static_cast<std::size_t>(n)) : std::string(".");
+    return dir.substr(0, dir.rfind('/') + 1) + CHAT_EPOLL_FALLBACK;
 }
+#endif
 
 int main(int argc, char* argv[]) {
     try {
@@ -36,6 +92,21 @@ int main(int argc, char* argv[]) {
         Logger::get()->info("  Chat Server Starting...");
         Logger::get()->info("==============================================");
         
+#ifdef CHAT_IO_URING
+        // ==================== I/O BACKEND ====================
+        // Asio cannot switch reactors at runtime, so hand over to the epoll build
+        std::string io_uring_reason = "disabled by CHAT_IO_URING=0";
+        if (!Config::get_bool("CHAT_IO_URING", true) ||
+            !IoBackend::io_uring_supported(io_uring_reason)) {
+            std::string fallback = epoll_fallback_path();
+            Logger::get()->warn("io_uring unavailable ({}), starting {}", io_uring_reason, fallback);
+            Logger::get()->flush();
+            execv(fallback.c_str(), argv);
+            Logger::get()->error("Could not start {}: {}", fallback, std::strerror(errno));
+            return 1;
+        }
+#endif
+        
         // ==================== CONFIGURATION ====================
         // TODO: Move these to config file or environment variables in production
         
@@ -59,60 +130,389 @@ int main(int argc, char* argv[]) {
         
         // Server configuration
         const std::string host = "0.0.0.0";  // Listen on all interfaces
-        const unsigned short port = 8080;     // WebSocket port
+        const unsigned short port = static_cast<unsigned short>(
+            Config::get_int("CHAT_PORT", 8080));  // WebSocket port
+        
+        // Cluster mode: enabled when peers are configured. The cluster port
+        // binds its own address, loopback unless told otherwise, and peers
+        // must know CHAT_CLUSTER_SECRET.
+        ClusterOptions cluster_options;
+        cluster_options.node_id = Config::get("CHAT_NODE_ID", "node-1");
+        cluster_options.listen = boost::asio::ip::tcp::endpoint{
+            boost::asio::ip::make_address(Config::get("CHAT_CLUSTER_HOST", "127.0.0.1")),
+            static_cast<unsigned short>(Config::get_int("CHAT_CLUSTER_PORT", 9080))
+        };
+        cluster_options.peers = parse_cluster_peers(Config::get("CHAT_CLUSTER_PEERS", ""));
+        cluster_options.secret = Config::get("CHAT_CLUSTER_SECRET", "");
+        
+        // Per-session outbound limits (slow consumer protection)
+        SessionLimits session_limits;
+        session_limits.max_queued_bytes = positive_setting("CHAT_SESSION_MAX_QUEUED_BYTES", 4 * 1024 * 1024);
+        session_limits.max_queued_frames = positive_setting("CHAT_SESSION_MAX_QUEUED_FRAMES", 1024);
+        session_limits.read_pause_bytes = positive_setting("CHAT_SESSION_READ_PAUSE_BYTES", 1024 * 1024);
+        
+        const std::string overflow_policy = Config::get("CHAT_SESSION_OVERFLOW_POLICY", "drop");
+        if (overflow_policy == "coalesce") {
+            session_limits.policy = OverflowPolicy::Coalesce;
+        } else if (overflow_policy == "disconnect") {
+            session_limits.policy = OverflowPolicy::Disconnect;
+        } else {
+            session_limits.policy = OverflowPolicy::DropEphemeral;
+        }
+        
+        session_limits.ping_interval = std::chrono::milliseconds(
+            Config::get_int("CHAT_PING_INTERVAL_MS", 30000));
+        session_limits.idle_timeout = std::chrono::milliseconds(
+            Config::get_int("CHAT_IDLE_TIMEOUT_MS", 75000));
+        
+        // Requests from one client handled concurrently on the worker pool
+        session_limits.max_in_flight = positive_setting("CHAT_SESSION_MAX_IN_FLIGHT", 8);
+        session_limits.max_pending_requests = positive_setting("CHAT_SESSION_MAX_PENDING_REQUESTS", 64);
+        
+        // Refuse WebSocket upgrades that carry no bearer token, instead of
+        // waiting for an auth frame
+        session_limits.require_upgrade_auth = Config::get_bool("CHAT_REQUIRE_UPGRADE_AUTH", false);
+        
+        // permessage-deflate for clients that offer it, within a global
+        // budget for the zlib state each compressed session holds
+        DeflateOptions& deflate = session_limits.deflate;
+        deflate.enabled = Config::get_bool("CHAT_WS_DEFLATE", true);
+        deflate.level = static_cast<int>(Config::get_int("CHAT_WS_DEFLATE_LEVEL", 6));
+        deflate.mem_level = static_cast<int>(Config::get_int("CHAT_WS_DEFLATE_MEM_LEVEL", 4));
+        deflate.server_window_bits = static_cast<int>(
+            Config::get_int("CHAT_WS_DEFLATE_WINDOW_BITS", 15));
+        deflate.client_window_bits = static_cast<int>(
+            Config::get_int("CHAT_WS_DEFLATE_CLIENT_WINDOW_BITS", 15));
+        deflate.server_context_takeover = Config::get_bool("CHAT_WS_DEFLATE_CONTEXT_TAKEOVER", true);
+        deflate.client_context_takeover = Config::get_bool("CHAT_WS_DEFLATE_CLIENT_CONTEXT_TAKEOVER", true);
+        deflate.min_message_bytes = static_cast<std::size_t>(
+            Config::get_int("CHAT_WS_DEFLATE_MIN_BYTES", 256));
+        deflate.memory_budget = static_cast<std::size_t>(
+            Config::get_int("CHAT_WS_DEFLATE_MEMORY_MB", 256)) * 1024 * 1024;
+        
+        // HTTP auth endpoints served on the WebSocket port
+        HttpLimits http_limits;
+        http_limits.max_concurrent_requests = static_cast<std::size_t>(
+            Config::get_int("CHAT_HTTP_MAX_CONCURRENT", 4));
+        http_limits.max_body_bytes = static_cast<std::size_t>(
+            Config::get_int("CHAT_HTTP_MAX_BODY_BYTES", 16 * 1024));
+        http_limits.idle_timeout = std::chrono::milliseconds(
+            Config::get_int("CHAT_HTTP_IDLE_TIMEOUT_MS", 15000));
+        
+        // Native wss/https on the same port when a certificate is configured
+        TlsOptions tls_options;
+        tls_options.cert_file = Config::get("CHAT_TLS_CERT", "");
+        tls_options.key_file = Config::get("CHAT_TLS_KEY", "");
+        tls_options.ktls = Config::get_bool("CHAT_TLS_KTLS", true);
+        tls_options.session_tickets = Config::get_bool("CHAT_TLS_SESSION_TICKETS", true);
+        tls_options.session_lifetime = std::chrono::seconds(
+            Config::get_int("CHAT_TLS_SESSION_LIFETIME_S", 7200));
+        
+        // Shared timer wheel for heartbeats and idle timeouts
+        const auto timer_tick = std::chrono::milliseconds(
+            Config::get_int("CHAT_TIMER_TICK_MS", 500));
+        const std::size_t timer_slots = static_cast<std::size_t>(
+            Config::get_int("CHAT_TIMER_SLOTS", 512));
+        
+        // Event history kept per user for resuming after short disconnects
+        ResumeOptions resume_options;
+        resume_options.max_events = static_cast<std::size_t>(
+            Config::get_int("CHAT_RESUME_MAX_EVENTS", 256));
+        resume_options.max_bytes = static_cast<std::size_t>(
+            Config::get_int("CHAT_RESUME_MAX_BYTES", 256 * 1024));
+        resume_options.grace_period = std::chrono::milliseconds(
+            Config::get_int("CHAT_RESUME_GRACE_MS", 120000));
+        
+        // Sequence numbers reserved per conversation at a time. Nodes of a
+        // cluster take one at a time so numbers follow arrival order.
+        const std::uint64_t seq_block = positive_setting(
+            "CHAT_SEQ_BLOCK", cluster_options.peers.empty() ? 100 : 1);
+        // Connections reserving them, apart from the pool so a reservation
+        // inside a transaction never waits on it
+        const std::size_t seq_connections = positive_setting("CHAT_SEQ_CONNECTIONS", 4);
+        
+        // Node bits of message ids; must be unique per process. Defaults to
+        // a hash of the cluster node id, so set it explicitly on clusters.
+        const std::uint32_t id_node = static_cast<std::uint32_t>(Config::get_int(
+            "CHAT_ID_NODE",
+            static_cast<int>(std::hash<std::string>{}(cluster_options.node_id) % (IdGenerator::kMaxNode + 1))));
+        
+        // Acks of keyed sends remembered for retries, and whether a bloom
+        // filter screens out first sends before the cache is locked
+        const std::size_t dedup_entries = static_cast<std::size_t>(
+            Config::get_int("CHAT_IDEMPOTENCY_ENTRIES", 100000));
+        const bool dedup_bloom = Config::get_bool("CHAT_IDEMPOTENCY_BLOOM", false);
+        
+        // With a journal directory, unkeyed sends are acknowledged once they
+        // are on local disk and written to the database in the background;
+        // history and sync show them only after that
+        JournalOptions journal_options;
+        journal_options.directory = Config::get("CHAT_JOURNAL_DIR", "");
+        journal_options.segment_bytes = static_cast<std::size_t>(
+            Config::get_int("CHAT_JOURNAL_SEGMENT_MB", 64)) * 1024 * 1024;
+        
+        // With an archive directory, messages older than the archive age are
+        // moved out of the database into compressed per-conversation files
+        ArchiveOptions archive_options;
+        archive_options.directory = Config::get("CHAT_ARCHIVE_DIR", "");
+        archive_options.max_age = std::chrono::hours(
+            24 * Config::get_int("CHAT_ARCHIVE_AGE_DAYS", 90));
+        archive_options.interval = std::chrono::seconds(
+            Config::get_int("CHAT_ARCHIVE_INTERVAL_S", 3600));
+        archive_options.min_messages = static_cast<std::size_t>(
+            Config::get_int("CHAT_ARCHIVE_MIN_MESSAGES", 50));
+        
+        // CHAT_STORAGE=embedded keeps everything in a local directory instead
+        // of Postgres, for single-node deployments without a database
+        const std::string storage_backend = Config::get("CHAT_STORAGE", "postgres");
+        const bool embedded = storage_backend == "embedded";
+        EmbeddedOptions embedded_options;
+        embedded_options.directory = Config::get("CHAT_EMBEDDED_DIR", "data");
+        embedded_options.sync_commits = Config::get_bool("CHAT_EMBEDDED_SYNC", true);
+        embedded_options.snapshot_interval = std::chrono::seconds(
+            Config::get_int("CHAT_EMBEDDED_SNAPSHOT_S", 300));
+        embedded_options.segment_bytes = static_cast<std::size_t>(
+            Config::get_int("CHAT_EMBEDDED_SEGMENT_MB", 64)) * 1024 * 1024;
+        
+        // How often buffered inbox read marks are written to the database
+        const auto inbox_flush_interval = std::chrono::milliseconds(
+            Config::get_int("CHAT_INBOX_FLUSH_MS", 2000));
+        
+        // Groups and users whose memberships are cached, each way round
+        const std::size_t membership_entries = static_cast<std::size_t>(
+            Config::get_int("CHAT_MEMBERSHIP_CACHE_ENTRIES", 100000));
+        
+        // Group events for large groups are delivered by several threads
+        FanoutOptions fanout_options;
+        fanout_options.parallel_threshold = static_cast<std::size_t>(
+            Config::get_int("CHAT_FANOUT_PARALLEL_THRESHOLD", 2000));
+        fanout_options.partitions = static_cast<std::size_t>(
+            Config::get_int("CHAT_FANOUT_PARTITIONS", 0));
+        
+        // Per-user request rate limits, by operation class
+        RateLimits rate_limits;
+        for (auto op : {OperationClass::Message, OperationClass::History,
+                        OperationClass::Social, OperationClass::Read}) {
+            std::string prefix = std::string("CHAT_RATE_") + RateLimiter::name(op);
+            std::transform(prefix.begin(), prefix.end(), prefix.begin(), ::toupper);
+            rate_limits[op].per_second = static_cast<double>(
+                Config::get_int(prefix + "_PER_SEC", static_cast<long long>(rate_limits[op].per_second)));
+            rate_limits[op].burst = static_cast<double>(
+                Config::get_int(prefix + "_BURST", static_cast<long long>(rate_limits[op].burst)));
+        }
+        rate_limits.sync_interval = std::chrono::milliseconds(
+            Config::get_int("CHAT_RATE_SYNC_MS", 100));
+        
+        // Thread pool configuration: CHAT_CPU_AFFINITY=none|cores|numa
+        PlacementOptions placement;
+        const std::string affinity = Config::get("CHAT_CPU_AFFINITY", "none");
+        if (affinity == "cores") {
+            placement.mode = CpuPlacement::Cores;
+        } else if (affinity == "numa") {
+            placement.mode = CpuPlacement::Numa;
+        }
+        placement.cpus = CpuAffinity::parse_list(Config::get("CHAT_CPUS", ""));
+        placement.reserved_cpus = CpuAffinity::parse_list(Config::get("CHAT_RESERVED_CPUS", ""));
+        placement.threads = static_cast<int>(Config::get_int("CHAT_THREADS", 0));
+        
+        IoPool io_pool(placement);
+        const int num_threads = static_cast<int>(io_pool.thread_count());
         
-        // Thread pool configuration
-        int num_threads = std::thread::hardware_concurrency();
-        if (num_threads == 0) num_threads = 4;  // Fallback if detection fails
+        // One database connection per worker thread by default
+        const std::size_t db_pool_size = static_cast<std::size_t>(
+            Config::get_int("CHAT_DB_POOL_SIZE", num_threads));
         
         Logger::get()->info("Configuration:");
-        Logger::get()->info("  - Database: {}@{}/{}", db_user, db_host, db_name);
+        if (embedded) {
+            Logger::get()->info("  - Storage: embedded in {} (commits {})", embedded_options.directory,
+                               embedded_options.sync_commits ? "synced" : "synced in the background");
+        } else {
+            Logger::get()->info("  - Database: {}@{}/{}", db_user, db_host, db_name);
+        }
         Logger::get()->info("  - Server: {}:{}", host, port);
-        Logger::get()->info("  - Threads: {}", num_threads);
+        if (!cluster_options.peers.empty()) {
+            Logger::get()->info("  - Cluster: node {} on port {}, {} peers",
+                               cluster_options.node_id,
+                               cluster_options.listen.port(),
+                               cluster_options.peers.size());
+        }
+        Logger::get()->info("  - Threads: {} ({})", num_threads, io_pool.describe());
+        Logger::get()->info("  - I/O backend: {}, open files limit {}",
+                           IoBackend::name(), IoBackend::raise_fd_limit());
+        Logger::get()->info("  - Database pool: {} connections", db_pool_size);
+        Logger::get()->info("  - Session queue limit: {} bytes / {} frames, policy: {}",
+                           session_limits.max_queued_bytes,
+                           session_limits.max_queued_frames,
+                           overflow_policy);
+        Logger::get()->info("  - Heartbeat: ping after {}ms idle, drop after {}ms",
+                           session_limits.ping_interval.count(),
+                           session_limits.idle_timeout.count());
+        Logger::get()->info("  - TLS: {}", tls_options.cert_file.empty() ? "off" : tls_options.cert_file);
+        if (deflate.enabled) {
+            DeflateBudget deflate_sizing(deflate);
+            Logger::get()->info("  - permessage-deflate: level {}, {} KiB per session, {} MiB budget",
+                               deflate_sizing.options().level,
+                               deflate_sizing.session_cost() / 1024,
+                               deflate.memory_budget / (1024 * 1024));
+            if (deflate.min_message_bytes > 0 && !DeflateBudget::size_threshold_supported()) {
+                Logger::get()->warn("CHAT_WS_DEFLATE_MIN_BYTES needs a newer Boost.Beast; "
+                                   "every message will be compressed");
+            }
+        } else {
+            Logger::get()->info("  - permessage-deflate: off");
+        }
         
         // ==================== SET JWT SECRET ====================
         JWTHandler::set_secret(jwt_secret);
         Logger::get()->info("JWT secret configured");
         
         // ==================== DATABASE INITIALIZATION ====================
-        Logger::get()->info("Connecting to database...");
-        Database db(db_connection);
-        
-        if (!db.test_connection()) {
-            Logger::get()->error("Database connection test failed!");
-            Logger::get()->error("Please ensure PostgreSQL is running and database exists.");
-            Logger::get()->error("Run: psql -U chatuser -d chat_app -h localhost < schema.sql");
-            return 1;
+        std::unique_ptr<Database> db;
+        std::unique_ptr<EmbeddedStore> embedded_store;
+        if (embedded) {
+            if (!cluster_options.peers.empty()) {
+                Logger::get()->error("Embedded storage is single-node; unset CHAT_CLUSTER_PEERS");
+                return 1;
+            }
+            Logger::get()->info("Opening embedded store...");
+            embedded_store = std::make_unique<EmbeddedStore>(embedded_options);
+            if (!embedded_store->open()) {
+                Logger::get()->error("Embedded store in {} unusable!", embedded_options.directory);
+                return 1;
+            }
+            Logger::get()->info("Embedded store opened ✓");
+        } else {
+            Logger::get()->info("Connecting to database...");
+            db = std::make_unique<Database>(db_connection, db_pool_size, io_pool.numa_nodes());
+            
+            if (!db->test_connection()) {
+                Logger::get()->error("Database connection test failed!");
+                Logger::get()->error("Please ensure PostgreSQL is running and database exists.");
+                Logger::get()->error("Run: psql -U chatuser -d chat_app -h localhost < schema.sql");
+                return 1;
+            }
+            Logger::get()->info("Database connected successfully ✓");
+            
+            if (!db->migrate()) {
+                Logger::get()->error("Database migrations failed!");
+                return 1;
+            }
+            Logger::get()->info("Database schema up to date ✓");
         }
-        Logger::get()->info("Database connected successfully ✓");
+        Storage& storage = embedded_store ? static_cast<Storage&>(*embedded_store) : *db;
         
         // ==================== INITIALIZE REPOSITORIES ====================
         Logger::get()->info("Initializing repositories...");
-        UserRepository user_repo(db);
-        MessageRepository msg_repo(db);
-        GroupRepository group_repo(db);
-        Logger::get()->info("Repositories initialized ✓");
+        // Embedded storage takes user, group and request ids from it too
+        IdGenerator message_ids(id_node);
+        std::unique_ptr<UserRepository> user_repo;
+        std::unique_ptr<MessageRepository> msg_repo;
+        std::unique_ptr<GroupRepository> group_repo;
+        std::unique_ptr<FriendRepository> friend_repo;
+        PostgresGroupRepository* pg_groups = nullptr;
+        // Declared after msg_repo: its drainer writes through it until stopped
+        std::unique_ptr<Journal> journal;
+        std::unique_ptr<MessageArchive> archive;
+        if (embedded_store) {
+            user_repo = std::make_unique<EmbeddedUserRepository>(*embedded_store, message_ids);
+            msg_repo = std::make_unique<EmbeddedMessageRepository>(*embedded_store, message_ids);
+            group_repo = std::make_unique<EmbeddedGroupRepository>(*embedded_store, message_ids);
+            friend_repo = std::make_unique<EmbeddedFriendRepository>(*embedded_store, message_ids);
+            if (!journal_options.directory.empty() || !archive_options.directory.empty()) {
+                Logger::get()->warn("CHAT_JOURNAL_DIR and CHAT_ARCHIVE_DIR only apply to Postgres storage; ignored");
+            }
+        } else {
+            user_repo = std::make_unique<PostgresUserRepository>(*db);
+            auto pg_messages = std::make_unique<PostgresMessageRepository>(*db, message_ids, seq_block,
+                                                                           seq_connections);
+            auto pg_group_repo = std::make_unique<PostgresGroupRepository>(*db, membership_entries);
+            pg_groups = pg_group_repo.get();
+            group_repo = std::move(pg_group_repo);
+            friend_repo = std::make_unique<PostgresFriendRepository>(*db);
+            if (!journal_options.directory.empty()) {
+                journal = std::make_unique<Journal>(journal_options);
+                if (!pg_messages->use_journal(*journal)) {
+                    Logger::get()->error("Message journal in {} unusable!", journal_options.directory);
+                    return 1;
+                }
+            }
+            if (!archive_options.directory.empty()) {
+                archive = std::make_unique<MessageArchive>(*db, archive_options);
+                if (!archive->open()) {
+                    Logger::get()->error("Message archive in {} unusable!", archive_options.directory);
+                    return 1;
+                }
+                pg_messages->set_archive(archive.get());
+                archive->start();
+            }
+            msg_repo = std::move(pg_messages);
+        }
+        Logger::get()->info("Repositories initialized ✓ (message id node {})", id_node);
         
         // ==================== INITIALIZE SERVICES ====================
         Logger::get()->info("Initializing services...");
-        AuthService auth_service(user_repo);
+        AuthService auth_service(*user_repo);
         Logger::get()->info("Auth service initialized ✓");
         
         // ==================== INITIALIZE HANDLERS ====================
         Logger::get()->info("Initializing handlers...");
-        MessageHandler msg_handler(msg_repo);
-        GroupHandler group_handler(group_repo);
-        FriendHandler friend_handler(db);
+        MessageHandler msg_handler(*msg_repo, *group_repo, dedup_entries, dedup_bloom);
+        GroupHandler group_handler(*group_repo);
+        FriendHandler friend_handler(*friend_repo, storage);
+        BatchHandler batch_handler(storage, msg_handler, group_handler, friend_handler);
+        InboxHandler inbox_handler(*msg_repo);
+        msg_handler.set_inbox_handler(&inbox_handler);
         Logger::get()->info("Handlers initialized ✓");
         
+        // ==================== INITIALIZE IO CONTEXT ====================
+        Logger::get()->info("Initializing I/O context with {} threads...", num_threads);
+        boost::asio::io_context& ioc = io_pool.context(0);
+        
+        // ==================== START TIMING WHEEL ====================
+        TimingWheel timing_wheel(ioc, timer_tick, timer_slots);
+        timing_wheel.start();
+        
         // ==================== INITIALIZE SESSION MANAGER ====================
         Logger::get()->info("Initializing session manager...");
-        SessionManager session_manager(msg_handler, group_handler, friend_handler);
+        RateLimiter rate_limiter(rate_limits);
+        SessionManager session_manager(msg_handler, group_handler, friend_handler,
+                                       batch_handler, inbox_handler, timing_wheel,
+                                       resume_options, rate_limiter);
+        session_manager.set_fanout(io_pool, fanout_options);
+        inbox_handler.start();
+        inbox_handler.schedule_flush(timing_wheel, inbox_flush_interval);
         Logger::get()->info("Session manager initialized ✓");
         
-        // ==================== INITIALIZE IO CONTEXT ====================
-        Logger::get()->info("Initializing I/O context with {} threads...", num_threads);
-        boost::asio::io_context ioc{num_threads};
+        // ==================== JOIN CLUSTER ====================
+        std::unique_ptr<ClusterNode> cluster;
+        if (!cluster_options.peers.empty()) {
+            if (cluster_options.secret.size() < 32) {
+                Logger::get()->error("CHAT_CLUSTER_SECRET must be set to at least 32 characters in cluster mode");
+                return 1;
+            }
+            Logger::get()->info("Joining cluster as {}...", cluster_options.node_id);
+            cluster = std::make_unique<ClusterNode>(ioc, cluster_options, session_manager);
+            session_manager.set_cluster(cluster.get());
+            cluster->set_membership_index(&pg_groups->index());
+            pg_groups->index().set_listener(
+                [node = cluster.get()](const std::string& group_id, const std::string& user_id, bool added) {
+                    node->publish_membership(group_id, user_id, added);
+                });
+            cluster->start();
+            Logger::get()->info("Cluster node started ✓");
+        }
+        
+        // ==================== LOAD TLS CERTIFICATE ====================
+        std::unique_ptr<TlsContext> tls_context;
+        if (!tls_options.cert_file.empty()) {
+            tls_context = TlsContext::create(tls_options);
+            if (!tls_context) {
+                Logger::get()->error("TLS configuration failed!");
+                return 1;
+            }
+            Logger::get()->info("TLS enabled (kTLS {}) ✓",
+                               tls_context->ktls_enabled() ? "requested" : "unavailable");
+        }
         
         // ==================== CREATE WEBSOCKET SERVER ====================
         Logger::get()->info("Creating WebSocket server...");
@@ -121,54 +521,66 @@ int main(int argc, char* argv[]) {
             port
         };
         
-        WebSocketServer server(ioc, endpoint, session_manager);
+        WebSocketServer server(io_pool, endpoint, session_manager, auth_service,
+                               tls_context.get(), session_limits, http_limits, timing_wheel);
         server.run();
         
         Logger::get()->info("==============================================");
         Logger::get()->info("🚀 Server started successfully!");
         Logger::get()->info("==============================================");
-        Logger::get()->info("WebSocket server listening on ws://{}:{}", host, port);
+        Logger::get()->info("WebSocket server listening on {}://{}:{}",
+                           tls_context ? "ws(s)" : "ws", host, port);
+        Logger::get()->info("Auth endpoints: POST {}://{}:{}/login, /register, /refresh",
+                           tls_context ? "https" : "http", host, port);
         Logger::get()->info("Using {} worker threads", num_threads);
         Logger::get()->info("Press Ctrl+C to stop the server");
         Logger::get()->info("==============================================");
         
         // ==================== SETUP SIGNAL HANDLERS ====================
-        std::signal(SIGINT, signal_handler);
-        std::signal(SIGTERM, signal_handler);
+        // Stops taking connections and lets the pool return, so the
+        // shutdown below runs
+        boost::asio::signal_set signals(ioc, SIGINT, SIGTERM);
+        signals.async_wait([&](const boost::system::error_code& ec, int signal) {
+            if (ec) {
+                return;
+            }
+            Logger::get()->info("Shutdown signal {} received. Cleaning up...", signal);
+            // A second signal ends the process at once, e.g. while the
+            // journal drain waits on an unreachable database
+            boost::system::error_code ignored;
+            signals.clear(ignored);
+            server.stop();
+            if (cluster) {
+                cluster->stop();
+            }
+            io_pool.stop();
+        });
         
         // ==================== RUN IO CONTEXT ON MULTIPLE THREADS ====================
-        std::vector<std::thread> threads;
-        threads.reserve(num_threads - 1);
-        
-        // Spawn worker threads
-        for (int i = 0; i < num_threads - 1; ++i) {
-            threads.emplace_back([&ioc, i] {
-                Logger::get()->debug("Worker thread {} started", i + 1);
-                try {
-                    ioc.run();
-                    Logger::get()->debug("Worker thread {} stopped", i + 1);
-                } catch (const std::exception& e) {
-                    Logger::get()->error("Worker thread {} error: {}", i + 1, e.what());
-                }
-            });
-        }
+        // Database calls on a pool thread prefer connections from its own node
+        io_pool.set_thread_init([](std::size_t shard) {
+            Database::set_thread_partition(shard);
+        });
+        io_pool.run();
         
-        // Run on main thread as well
-        Logger::get()->debug("Main I/O thread started");
-        try {
-            ioc.run();
-            Logger::get()->debug("Main I/O thread stopped");
-        } catch (const std::exception& e) {
-            Logger::get()->error("Main I/O thread error: {}", e.what());
+        inbox_handler.stop();
+        inbox_handler.flush();
+        if (journal) {
+            // What is left is replayed on the next start
+            Logger::get()->info("Draining message journal...");
+            journal->stop();
         }
-        
-        // ==================== WAIT FOR ALL THREADS ====================
-        Logger::get()->info("Waiting for worker threads to finish...");
-        for (auto& t : threads) {
-            if (t.joinable()) {
-                t.join();
-            }
+        if (archive) {
+            archive->stop();
         }
+        if (embedded_store) {
+            // So the next start loads it instead of replaying the whole log
+            Logger::get()->info("Writing final embedded store snapshot...");
+            embedded_store->stop();
+        }
+        
+        Logger::get()->info("Metrics:");
+        Metrics::log_snapshot();
         
         Logger::get()->info("==============================================");
         Logger::get()->info("Server stopped gracefully");
@@ -0,0 +1,83 @@
+// src/server/deflate_budget.cpp
+#include "server/deflate_budget.hpp"
+#include "utils/metrics.hpp"
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+namespace {
+template<class T, class = void>
+struct has_size_threshold : std::false_type {};
+
+template<class T>
+struct has_size_threshold<T, std::void_t<decltype(std::declval<T&>().msg_size_threshold)>>
+    : std::true_type {};
+
+template<class Option>
+void set_size_threshold(Option& option, std::size_t bytes) {
+    if constexpr (has_size_threshold<Option>::value) {
+        option.msg_size_threshold = bytes;
+    } else {
+        (void)option;
+        (void)bytes;
+    }
+}
+
+DeflateOptions clamp(DeflateOptions options) {
+    options.level = std::clamp(options.level, 0, 9);
+    options.mem_level = std::clamp(options.mem_level, 1, 9);
+    options.server_window_bits = std::clamp(options.server_window_bits, 9, 15);
+    options.client_window_bits = std::clamp(options.client_window_bits, 9, 15);
+    return options;
+}
+}
+
+DeflateBudget::DeflateBudget(const DeflateOptions& options)
+    : options_(clamp(options))
+    , in_use_(0) {
+    
+    // zlib's documented footprint: deflate needs (1 << (windowBits + 2)) +
+    // (1 << (memLevel + 9)) bytes, inflate (1 << windowBits) plus ~7 KiB
+    std::size_t deflate = (std::size_t{1} << (options_.server_window_bits + 2)) +
+                          (std::size_t{1} << (options_.mem_level + 9));
+    std::size_t inflate = (std::size_t{1} << options_.client_window_bits) + 7 * 1024;
+    session_cost_ = deflate + inflate;
+}
+
+bool DeflateBudget::try_acquire() {
+    static auto& memory = Metrics::counter("ws.deflate.memory_bytes");
+    
+    std::size_t current = in_use_.load(std::memory_order_relaxed);
+    do {
+        if (current + session_cost_ > options_.memory_budget) {
+            return false;
+        }
+    } while (!in_use_.compare_exchange_weak(current, current + session_cost_,
+                                            std::memory_order_relaxed));
+    
+    memory.fetch_add(session_cost_, std::memory_order_relaxed);
+    return true;
+}
+
+void DeflateBudget::release() {
+    static auto& memory = Metrics::counter("ws.deflate.memory_bytes");
+    in_use_.fetch_sub(session_cost_, std::memory_order_relaxed);
+    memory.fetch_sub(session_cost_, std::memory_order_relaxed);
+}
+
+websocket::permessage_deflate DeflateBudget::option(bool enable) const {
+    websocket::permessage_deflate option;
+    option.server_enable = enable;
+    option.server_max_window_bits = options_.server_window_bits;
+    option.client_max_window_bits = options_.client_window_bits;
+    option.server_no_context_takeover = !options_.server_context_takeover;
+    option.client_no_context_takeover = !options_.client_context_takeover;
+    option.compLevel = options_.level;
+    option.memLevel = options_.mem_level;
+    set_size_threshold(option, options_.min_message_bytes);
+    return option;
+}
+
+bool DeflateBudget::size_threshold_supported() {
+    return has_size_threshold<websocket::permessage_deflate>::value;
+}
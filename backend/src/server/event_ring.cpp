@@ -0,0 +1,49 @@
+// src/server/event_ring.cpp
+#include "server/event_ring.hpp"
+#include "utils/json_frame.hpp"
+
+EventRing::EventRing(std::size_t max_events, std::size_t max_bytes)
+    : bytes_(0)
+    , max_events_(max_events)
+    , max_bytes_(max_bytes)
+    , next_seq_(1) {
+}
+
+std::uint64_t EventRing::push(std::string& frame) {
+    std::uint64_t seq = next_seq_++;
+    
+    prepend_json_field(frame, "seq", std::to_string(seq));
+    
+    bytes_ += frame.size();
+    events_.push_back(Event{seq, frame});
+    
+    while (!events_.empty() &&
+           (events_.size() > max_events_ || bytes_ > max_bytes_)) {
+        bytes_ -= events_.front().frame.size();
+        events_.pop_front();
+    }
+    
+    return seq;
+}
+
+bool EventRing::replay_after(std::uint64_t last_seq, std::vector<std::string>& out) const {
+    if (last_seq >= next_seq_) {
+        return false;
+    }
+    
+    // Nothing was missed
+    if (last_seq + 1 == next_seq_) {
+        return true;
+    }
+    
+    if (events_.empty() || events_.front().seq > last_seq + 1) {
+        return false;
+    }
+    
+    for (const auto& event : events_) {
+        if (event.seq > last_seq) {
+            out.push_back(event.frame);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,482 @@
+// src/server/http_session.cpp
+#include "server/http_session.hpp"
+#include "server/websocket_server.hpp"
+#include "server/timing_wheel.hpp"
+#include "server/tls_context.hpp"
+#include "auth/auth_service.hpp"
+#include "auth/jwt_handler.hpp"
+#include "utils/logger.hpp"
+#include "utils/metrics.hpp"
+#include <boost/json.hpp>
+#include <cctype>
+
+namespace {
+// Requests here are small JSON documents; anything larger is not a client.
+constexpr std::uint32_t kHeaderLimit = 8 * 1024;
+
+// First byte of a TLS record carrying a handshake message (ClientHello).
+constexpr unsigned char kTlsHandshakeRecord = 0x16;
+
+void close_stream(tcp::socket& socket) {
+    beast::error_code ec;
+    socket.shutdown(tcp::socket::shutdown_send, ec);
+}
+
+void close_stream(TlsStream& stream) {
+    beast::error_code ec;
+    stream.shutdown(ec);
+}
+
+std::string percent_decode(beast::string_view value) {
+    std::string out;
+    out.reserve(value.size());
+    for (std::size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '%' && i + 2 < value.size() &&
+            std::isxdigit(static_cast<unsigned char>(value[i + 1])) &&
+            std::isxdigit(static_cast<unsigned char>(value[i + 2]))) {
+            out += static_cast<char>(std::stoi(std::string(value.substr(i + 1, 2)), nullptr, 16));
+            i += 2;
+        } else {
+            out += value[i];
+        }
+    }
+    return out;
+}
+
+// Bearer token from the Authorization header, or the token/access_token
+// query parameter for browsers, which cannot set headers on a WebSocket.
+std::string bearer_token(const http::request<http::string_body>& req) {
+    auto authorization = req[http::field::authorization];
+    if (authorization.size() > 7 && beast::iequals(authorization.substr(0, 7), "Bearer ")) {
+        return std::string(authorization.substr(7));
+    }
+    
+    beast::string_view target = req.target();
+    auto query_start = target.find('?');
+    if (query_start == beast::string_view::npos) {
+        return "";
+    }
+    
+    beast::string_view query = target.substr(query_start + 1);
+    while (!query.empty()) {
+        auto end = query.find('&');
+        beast::string_view param = query.substr(0, end);
+        auto eq = param.find('=');
+        if (eq != beast::string_view::npos) {
+            beast::string_view name = param.substr(0, eq);
+            if (name == "token" || name == "access_token") {
+                return percent_decode(param.substr(eq + 1));
+            }
+        }
+        if (end == beast::string_view::npos) {
+            break;
+        }
+        query.remove_prefix(end + 1);
+    }
+    return "";
+}
+
+std::shared_ptr<http::response<http::string_body>> make_response(
+    http::status status,
+    const http::request<http::string_body>& req,
+    const boost::json::object& body) {
+    
+    auto res = std::make_shared<http::response<http::string_body>>(status, req.version());
+    res->set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res->set(http::field::content_type, "application/json");
+    res->keep_alive(req.keep_alive());
+    res->body() = boost::json::serialize(body);
+    res->prepare_payload();
+    return res;
+}
+
+std::shared_ptr<http::response<http::string_body>> make_error(
+    http::status status,
+    const http::request<http::string_body>& req,
+    const std::string& message) {
+    
+    boost::json::object body;
+    body["error"] = message;
+    return make_response(status, req, body);
+}
+
+std::string string_field(const boost::json::object& obj, const char* name) {
+    const auto* value = obj.if_contains(name);
+    return value && value->is_string() ? std::string(value->as_string().c_str()) : "";
+}
+
+// Runs on the worker pool; the AuthService calls block on the database.
+std::shared_ptr<http::response<http::string_body>> handle_auth(
+    AuthService& auth,
+    const http::request<http::string_body>& req,
+    beast::string_view path) {
+    
+    namespace json = boost::json;
+    
+    if (path == "/refresh") {
+        auto user_id = JWTHandler::validate_token(bearer_token(req));
+        if (!user_id) {
+            auto res = make_error(http::status::unauthorized, req, "Invalid or expired token");
+            res->set(http::field::www_authenticate, "Bearer");
+            return res;
+        }
+        
+        json::object body;
+        body["user_id"] = *user_id;
+        body["token"] = JWTHandler::generate_token(*user_id);
+        return make_response(http::status::ok, req, body);
+    }
+    
+    json::object request;
+    try {
+        request = json::parse(req.body()).as_object();
+    } catch (const std::exception&) {
+        return make_error(http::status::bad_request, req, "Expected a JSON object");
+    }
+    
+    std::string username = string_field(request, "username");
+    std::string password = string_field(request, "password");
+    
+    if (path == "/login") {
+        if (username.empty() || password.empty()) {
+            return make_error(http::status::bad_request, req, "username and password are required");
+        }
+        
+        auto session = auth.login(username, password);
+        if (!session) {
+            return make_error(http::status::unauthorized, req, "Invalid username or password");
+        }
+        
+        json::object body;
+        body["user_id"] = session->first;
+        body["token"] = session->second;
+        return make_response(http::status::ok, req, body);
+    }
+    
+    std::string email = string_field(request, "email");
+    std::string display_name = string_field(request, "display_name");
+    if (username.empty() || password.empty() || email.empty()) {
+        return make_error(http::status::bad_request, req,
+                          "username, email and password are required");
+    }
+    
+    auto user_id = auth.register_user(username, email, password,
+                                      display_name.empty() ? username : display_name);
+    if (!user_id) {
+        return make_error(http::status::conflict, req, "Registration failed");
+    }
+    
+    json::object body;
+    body["user_id"] = *user_id;
+    body["token"] = JWTHandler::generate_token(*user_id);
+    return make_response(http::status::created, req, body);
+}
+}
+
+HttpSession::HttpSession(tcp::socket socket, WebSocketServer& server, std::size_t shard)
+    : executor_(socket.get_executor())
+    , stream_(std::move(socket))
+    , server_(server)
+    , shard_(shard)
+    , last_activity_(std::chrono::steady_clock::now())
+    , busy_(false)
+    , done_(false) {
+}
+
+void HttpSession::run() {
+    // The socket was accepted onto a strand; run everything from there
+    net::dispatch(
+        executor_,
+        [self = shared_from_this()] {
+            self->schedule_idle_check(self->server_.http_limits().idle_timeout);
+            if (self->server_.tls()) {
+                self->detect_tls();
+            } else {
+                self->do_read();
+            }
+        }
+    );
+}
+
+void HttpSession::detect_tls() {
+    // Peek rather than read, so OpenSSL sees the ClientHello on the socket
+    std::get<tcp::socket>(stream_).async_wait(
+        tcp::socket::wait_read,
+        beast::bind_front_handler(&HttpSession::on_detect_tls, shared_from_this())
+    );
+}
+
+void HttpSession::on_detect_tls(beast::error_code ec) {
+    if (ec) {
+        done_ = true;
+        return;
+    }
+    
+    auto& socket = std::get<tcp::socket>(stream_);
+    unsigned char first = 0;
+    std::size_t n = socket.receive(net::buffer(&first, 1), tcp::socket::message_peek, ec);
+    if (ec || n == 0) {
+        done_ = true;
+        return;
+    }
+    
+    if (first != kTlsHandshakeRecord) {
+        do_read();
+        return;
+    }
+    
+    SSL* ssl = server_.tls()->new_ssl();
+    if (!ssl) {
+        Logger::get()->error("Failed to allocate TLS session");
+        done_ = true;
+        return;
+    }
+    
+    tcp::socket plain = std::move(socket);
+    auto& tls = stream_.emplace<TlsStream>(std::move(plain), ssl);
+    tls.async_handshake(
+        beast::bind_front_handler(&HttpSession::on_handshake, shared_from_this())
+    );
+}
+
+void HttpSession::on_handshake(beast::error_code ec) {
+    static auto& handshakes = Metrics::counter("tls.handshakes");
+    static auto& failures = Metrics::counter("tls.handshake_failures");
+    static auto& resumed = Metrics::counter("tls.sessions_resumed");
+    static auto& ktls_tx = Metrics::counter("tls.ktls_send");
+    static auto& ktls_rx = Metrics::counter("tls.ktls_recv");
+    
+    if (ec) {
+        failures.fetch_add(1, std::memory_order_relaxed);
+        if (!done_) {
+            Logger::get()->warn("TLS handshake failed: {}", ec.message());
+        }
+        done_ = true;
+        return;
+    }
+    
+    last_activity_ = std::chrono::steady_clock::now();
+    
+    const auto& tls = std::get<TlsStream>(stream_);
+    handshakes.fetch_add(1, std::memory_order_relaxed);
+    if (tls.session_reused()) {
+        resumed.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (tls.ktls_send()) {
+        ktls_tx.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (tls.ktls_recv()) {
+        ktls_rx.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    do_read();
+}
+
+void HttpSession::do_read() {
+    parser_.emplace();
+    parser_->header_limit(kHeaderLimit);
+    parser_->body_limit(server_.http_limits().max_body_bytes);
+    
+    with_stream([this](auto& stream) {
+        http::async_read(
+            stream,
+            buffer_,
+            *parser_,
+            beast::bind_front_handler(&HttpSession::on_read, shared_from_this())
+        );
+    });
+}
+
+void HttpSession::on_read(beast::error_code ec, std::size_t) {
+    if (ec == http::error::end_of_stream) {
+        do_close();
+        return;
+    }
+    
+    if (ec) {
+        if (!done_ && ec != net::error::operation_aborted) {
+            Logger::get()->error("HTTP read error: {}", ec.message());
+        }
+        done_ = true;
+        return;
+    }
+    
+    last_activity_ = std::chrono::steady_clock::now();
+    Request req = parser_->release();
+    parser_.reset();
+    
+    if (websocket::is_upgrade(req)) {
+        upgrade(std::move(req));
+    } else {
+        handle_request(std::move(req));
+    }
+}
+
+void HttpSession::upgrade(Request req) {
+    static auto& rejected = Metrics::counter("session.upgrades_rejected");
+    
+    // Clients without a token may still authenticate with an auth frame
+    std::string user_id;
+    std::string token = bearer_token(req);
+    if (!token.empty()) {
+        auto token_user = JWTHandler::validate_token(token);
+        if (!token_user) {
+            rejected.fetch_add(1, std::memory_order_relaxed);
+            req.keep_alive(false);
+            auto res = make_error(http::status::unauthorized, req, "Invalid or expired token");
+            res->set(http::field::www_authenticate, "Bearer");
+            write(std::move(res));
+            return;
+        }
+        user_id = std::move(*token_user);
+    } else if (server_.session_limits().require_upgrade_auth) {
+        rejected.fetch_add(1, std::memory_order_relaxed);
+        req.keep_alive(false);
+        auto res = make_error(http::status::unauthorized, req, "Missing bearer token");
+        res->set(http::field::www_authenticate, "Bearer");
+        write(std::move(res));
+        return;
+    }
+    
+    done_ = true;
+    server_.start_websocket(std::move(stream_), std::move(req), std::move(user_id), shard_);
+}
+
+void HttpSession::handle_request(Request req) {
+    static auto& requests = Metrics::counter("http.requests");
+    static auto& shed = Metrics::counter("http.rejected_busy");
+    static auto& plaintext = Metrics::counter("http.rejected_plaintext");
+    requests.fetch_add(1, std::memory_order_relaxed);
+    
+    beast::string_view target = req.target();
+    beast::string_view path = target.substr(0, target.find('?'));
+    
+    if (path != "/login" && path != "/register" && path != "/refresh") {
+        write(make_error(http::status::not_found, req, "Not found"));
+        return;
+    }
+    // With a certificate configured, credentials only travel over TLS. The
+    // body has already arrived, but the client learns not to send it again.
+    if (server_.tls() && std::holds_alternative<tcp::socket>(stream_)) {
+        plaintext.fetch_add(1, std::memory_order_relaxed);
+        req.keep_alive(false);
+        write(make_error(http::status::forbidden, req, "Use https"));
+        return;
+    }
+    if (req.method() != http::verb::post) {
+        auto res = make_error(http::status::method_not_allowed, req, "Use POST");
+        res->set(http::field::allow, "POST");
+        write(std::move(res));
+        return;
+    }
+    
+    // Cap auth work across the server so a login storm leaves the pool
+    // free for WebSocket traffic
+    if (!server_.try_begin_request()) {
+        shed.fetch_add(1, std::memory_order_relaxed);
+        auto res = make_error(http::status::service_unavailable, req, "Server busy, retry shortly");
+        res->set(http::field::retry_after, "1");
+        write(std::move(res));
+        return;
+    }
+    
+    busy_ = true;
+    std::string route(path);
+    net::post(
+        server_.workers(shard_),
+        [self = shared_from_this(), req = std::move(req), route = std::move(route)] {
+            std::shared_ptr<Response> res;
+            try {
+                res = handle_auth(self->server_.auth(), req, route);
+            } catch (const std::exception& e) {
+                Logger::get()->error("HTTP {} failed: {}", route, e.what());
+                res = make_error(http::status::internal_server_error, req, "Internal error");
+            }
+            self->server_.end_request();
+            
+            net::post(
+                self->executor_,
+                [self, res = std::move(res)]() mutable { self->write(std::move(res)); }
+            );
+        }
+    );
+}
+
+void HttpSession::write(std::shared_ptr<Response> res) {
+    // The idle timeout runs again from here, so a client that never reads
+    // its response cannot hold the connection
+    busy_ = false;
+    last_activity_ = std::chrono::steady_clock::now();
+    response_ = std::move(res);
+    
+    with_stream([this](auto& stream) {
+        http::async_write(
+            stream,
+            *response_,
+            beast::bind_front_handler(&HttpSession::on_write, shared_from_this(),
+                                      response_->need_eof())
+        );
+    });
+}
+
+void HttpSession::on_write(bool close, beast::error_code ec, std::size_t) {
+    busy_ = false;
+    response_.reset();
+    last_activity_ = std::chrono::steady_clock::now();
+    
+    if (ec) {
+        if (!done_) {
+            Logger::get()->error("HTTP write error: {}", ec.message());
+        }
+        done_ = true;
+        return;
+    }
+    
+    if (close) {
+        do_close();
+        return;
+    }
+    
+    do_read();
+}
+
+void HttpSession::do_close() {
+    done_ = true;
+    with_stream([](auto& stream) { close_stream(stream); });
+}
+
+void HttpSession::schedule_idle_check(std::chrono::milliseconds delay) {
+    // Same pattern as Session heartbeats: a weak reference on the shared wheel
+    std::weak_ptr<HttpSession> weak = shared_from_this();
+    server_.wheel().schedule(delay, [weak = std::move(weak)] {
+        if (auto self = weak.lock()) {
+            net::post(
+                self->executor_,
+                beast::bind_front_handler(&HttpSession::on_idle_check, self)
+            );
+        }
+    });
+}
+
+void HttpSession::on_idle_check() {
+    if (done_) {
+        return;
+    }
+    
+    using namespace std::chrono;
+    auto timeout = server_.http_limits().idle_timeout;
+    auto idle = duration_cast<milliseconds>(steady_clock::now() - last_activity_);
+    
+    if (busy_ || idle < timeout) {
+        schedule_idle_check(busy_ ? timeout : timeout - idle);
+        return;
+    }
+    
+    // Cancels the pending read or write; its handler sees operation_aborted
+    done_ = true;
+    with_stream([](auto& stream) {
+        beast::error_code ec;
+        beast::get_lowest_layer(stream).shutdown(tcp::socket::shutdown_both, ec);
+        beast::get_lowest_layer(stream).close(ec);
+    });
+}
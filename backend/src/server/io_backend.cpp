@@ -0,0 +1,78 @@
+// src/server/io_backend.cpp
+#include "server/io_backend.hpp"
+#include <linux/io_uring.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+namespace {
+// What boost/asio/detail/impl/io_uring_service.ipp and the socket ops
+// submit.
+constexpr int kRequiredOps[] = {
+    IORING_OP_NOP,
+    IORING_OP_READV,
+    IORING_OP_WRITEV,
+    IORING_OP_POLL_ADD,
+    IORING_OP_POLL_REMOVE,
+    IORING_OP_SENDMSG,
+    IORING_OP_RECVMSG,
+    IORING_OP_TIMEOUT,
+    IORING_OP_TIMEOUT_REMOVE,
+    IORING_OP_ASYNC_CANCEL,
+};
+}
+
+const char* IoBackend::name() {
+#ifdef CHAT_IO_URING
+    return "io_uring";
+#else
+    return "epoll";
+#endif
+}
+
+bool IoBackend::io_uring_supported(std::string& reason) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, 4, &params));
+    if (fd < 0) {
+        reason = std::string("io_uring_setup: ") + std::strerror(errno);
+        return false;
+    }
+    
+    // IORING_REGISTER_PROBE arrived in 5.6, after everything Asio needs
+    std::size_t probe_size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    std::vector<unsigned char> storage(probe_size, 0);
+    auto* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+    long registered = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256);
+    int probe_errno = errno;
+    close(fd);
+    
+    if (registered < 0) {
+        reason = std::string("io_uring probe: ") + std::strerror(probe_errno);
+        return false;
+    }
+    
+    for (int op : kRequiredOps) {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+            reason = "io_uring opcode " + std::to_string(op) + " not supported";
+            return false;
+        }
+    }
+    return true;
+}
+
+unsigned long long IoBackend::raise_fd_limit() {
+    rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+        return 0;
+    }
+    if (limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+        getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    return static_cast<unsigned long long>(limit.rlim_cur);
+}
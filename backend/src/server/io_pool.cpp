@@ -0,0 +1,137 @@
+// src/server/io_pool.cpp
+#include "server/io_pool.hpp"
+#include "utils/cpu_affinity.hpp"
+#include "utils/logger.hpp"
+#include <algorithm>
+#include <thread>
+
+IoPool::IoPool(const PlacementOptions& options)
+    : mode_(options.mode)
+    , next_(0) {
+    
+    std::vector<int> usable = options.cpus.empty() ? CpuAffinity::allowed_cpus() : options.cpus;
+    usable.erase(std::remove_if(usable.begin(), usable.end(), [&](int cpu) {
+        return std::find(options.reserved_cpus.begin(), options.reserved_cpus.end(), cpu) !=
+               options.reserved_cpus.end();
+    }), usable.end());
+    
+    if (usable.empty()) {
+        Logger::get()->warn("No usable CPUs left after reservations, ignoring CPU placement");
+        usable = CpuAffinity::allowed_cpus();
+        mode_ = CpuPlacement::None;
+    } else if (!options.cpus.empty() || !options.reserved_cpus.empty()) {
+        // Inherited by every thread started from here on, including libpq's
+        CpuAffinity::pin_thread(usable);
+    }
+    
+    int threads = options.threads > 0 ? options.threads : static_cast<int>(usable.size());
+    if (threads <= 0) threads = 4;
+    
+    if (mode_ == CpuPlacement::Numa) {
+        for (auto& node : CpuAffinity::numa_nodes(usable)) {
+            add_shard(node.id, std::move(node.cpus));
+        }
+        return;
+    }
+    
+    std::vector<int> cpus;
+    for (int i = 0; i < threads; ++i) {
+        cpus.push_back(mode_ == CpuPlacement::Cores ? usable[i % usable.size()] : -1);
+    }
+    add_shard(-1, std::move(cpus));
+}
+
+void IoPool::add_shard(int node, std::vector<int> cpus) {
+    auto ioc = std::make_unique<net::io_context>(static_cast<int>(cpus.size()));
+    auto work = net::make_work_guard(*ioc);
+    shards_.push_back({std::move(ioc), std::move(work), node, std::move(cpus)});
+}
+
+std::size_t IoPool::next_shard() {
+    return next_.fetch_add(1, std::memory_order_relaxed) % shards_.size();
+}
+
+std::size_t IoPool::thread_count() const {
+    std::size_t count = 0;
+    for (const auto& shard : shards_) {
+        count += shard.cpus.size();
+    }
+    return count;
+}
+
+std::vector<int> IoPool::numa_nodes() const {
+    std::vector<int> nodes;
+    if (mode_ == CpuPlacement::Numa) {
+        for (const auto& shard : shards_) {
+            nodes.push_back(shard.node);
+        }
+    }
+    return nodes;
+}
+
+std::string IoPool::describe() const {
+    if (mode_ == CpuPlacement::None) {
+        return std::to_string(thread_count()) + " threads, unpinned";
+    }
+    
+    std::string out;
+    for (const auto& shard : shards_) {
+        if (!out.empty()) out += "; ";
+        if (mode_ == CpuPlacement::Numa) out += "node " + std::to_string(shard.node) + ": ";
+        out += std::to_string(shard.cpus.size()) + " threads on CPUs " +
+               CpuAffinity::format_list(shard.cpus);
+    }
+    return out;
+}
+
+void IoPool::set_thread_init(std::function<void(std::size_t shard)> init) {
+    thread_init_ = std::move(init);
+}
+
+void IoPool::run() {
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count());
+    
+    std::size_t last_shard = shards_.size() - 1;
+    for (std::size_t s = 0; s < shards_.size(); ++s) {
+        const auto& cpus = shards_[s].cpus;
+        std::size_t spawn = s == last_shard ? cpus.size() - 1 : cpus.size();
+        for (std::size_t i = 0; i < spawn; ++i) {
+            threads.emplace_back([this, s, cpu = cpus[i]] { run_thread(s, cpu); });
+        }
+    }
+    
+    // Run on main thread as well
+    run_thread(last_shard, shards_[last_shard].cpus.back());
+    
+    Logger::get()->info("Waiting for worker threads to finish...");
+    for (auto& t : threads) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+}
+
+void IoPool::stop() {
+    for (auto& shard : shards_) {
+        shard.work.reset();
+        shard.ioc->stop();
+    }
+}
+
+void IoPool::run_thread(std::size_t shard, int cpu) {
+    if (cpu >= 0) {
+        CpuAffinity::pin_thread(cpu);
+    }
+    if (thread_init_) {
+        thread_init_(shard);
+    }
+    
+    Logger::get()->debug("I/O thread started (shard {}, cpu {})", shard, cpu);
+    try {
+        shards_[shard].ioc->run();
+        Logger::get()->debug("I/O thread stopped (shard {}, cpu {})", shard, cpu);
+    } catch (const std::exception& e) {
+        Logger::get()->error("I/O thread error (shard {}, cpu {}): {}", shard, cpu, e.what());
+    }
+}
@@ -0,0 +1,146 @@
+// src/server/rate_limiter.cpp
+#include "server/rate_limiter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace {
+// Sweep idle buckets once a shard or a thread's table grows past this
+constexpr std::size_t kPruneThreshold = 4096;
+}
+
+RateLimiter::RateLimiter(const RateLimits& limits)
+    : limits_(limits) {
+}
+
+OperationClass RateLimiter::classify(const std::string& type) {
+    if (type == "send_message" || type == "send_group_message") {
+        return OperationClass::Message;
+    }
+    if (type == "get_conversation" || type == "get_range" || type == "sync") {
+        return OperationClass::History;
+    }
+    if (type == "send_friend_request" || type == "accept_friend_request" ||
+        type == "create_group" || type == "add_group_member") {
+        return OperationClass::Social;
+    }
+    return OperationClass::Read;
+}
+
+const char* RateLimiter::name(OperationClass op) {
+    switch (op) {
+    case OperationClass::Message: return "message";
+    case OperationClass::History: return "history";
+    case OperationClass::Social: return "social";
+    default: return "read";
+    }
+}
+
+std::chrono::milliseconds RateLimiter::retry_after(OperationClass op) const {
+    double rate = limits_[op].per_second;
+    if (rate <= 0) {
+        return std::chrono::milliseconds(1000);
+    }
+    return std::chrono::milliseconds(static_cast<long long>(std::ceil(1000.0 / rate)));
+}
+
+RateLimiter::LocalBucket& RateLimiter::local_bucket(const std::string& user_id, OperationClass op,
+                                                    std::string& key) {
+    struct ThreadBuckets {
+        const RateLimiter* owner = nullptr;
+        std::unordered_map<std::string, LocalBucket> buckets;
+    };
+    thread_local ThreadBuckets local_table;
+    
+    if (local_table.owner != this) {
+        local_table.owner = this;
+        local_table.buckets.clear();
+    }
+    
+    key = user_id;
+    key += '#';
+    key += name(op);
+    
+    if (local_table.buckets.size() > kPruneThreshold && !local_table.buckets.count(key)) {
+        auto now = Clock::now();
+        for (auto it = local_table.buckets.begin(); it != local_table.buckets.end();) {
+            if (it->second.tokens < 1.0 && now >= it->second.sync_at) {
+                it = local_table.buckets.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    return local_table.buckets[key];
+}
+
+bool RateLimiter::try_acquire(const std::string& user_id, OperationClass op, double count) {
+    std::string key;
+    auto& local = local_bucket(user_id, op, key);
+    auto now = Clock::now();
+    
+    // Fast path: spend from this thread's lease
+    if (local.tokens < count || now >= local.sync_at) {
+        sync(key, op, local, now, count);
+    }
+    
+    if (local.tokens >= count) {
+        local.tokens -= count;
+        return true;
+    }
+    return false;
+}
+
+void RateLimiter::refund(const std::string& user_id, OperationClass op, double count) {
+    // Goes back to the global bucket with the rest of the lease on the next sync
+    std::string key;
+    local_bucket(user_id, op, key).tokens += count;
+}
+
+void RateLimiter::sync(const std::string& key, OperationClass op,
+                       LocalBucket& local, Clock::time_point now, double need) {
+    const RateLimit& limit = limits_[op];
+    auto& shard = shards_[std::hash<std::string>{}(key) % kShards];
+    
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    
+    auto it = shard.buckets.find(key);
+    if (it == shard.buckets.end()) {
+        if (shard.buckets.size() > kPruneThreshold) {
+            prune(shard, now);
+        }
+        it = shard.buckets.emplace(key, GlobalBucket{limit.burst, now, op}).first;
+    }
+    
+    auto& global = it->second;
+    double elapsed = std::chrono::duration<double>(now - global.refilled_at).count();
+    global.tokens = std::min(limit.burst, global.tokens + elapsed * limit.per_second + local.tokens);
+    global.refilled_at = now;
+    
+    // Lease a slice of the bucket so other threads serving the same user
+    // still find tokens in the global table
+    double lease = std::max({1.0, std::floor(limit.burst / 4.0), std::ceil(need)});
+    double granted = std::min(std::floor(global.tokens), lease);
+    // More than the bucket ever holds, e.g. a large batch: a full bucket
+    // grants it and stays in debt until the refill pays it back
+    if (need > limit.burst && global.tokens >= limit.burst) {
+        granted = std::ceil(need);
+    }
+    global.tokens -= granted;
+    
+    local.tokens = granted;
+    local.sync_at = now + limits_.sync_interval;
+}
+
+void RateLimiter::prune(Shard& shard, Clock::time_point now) {
+    // A bucket that has refilled to its burst is the same as no bucket
+    for (auto it = shard.buckets.begin(); it != shard.buckets.end();) {
+        const RateLimit& limit = limits_[it->second.op];
+        double elapsed = std::chrono::duration<double>(now - it->second.refilled_at).count();
+        if (it->second.tokens + elapsed * limit.per_second >= limit.burst) {
+            it = shard.buckets.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
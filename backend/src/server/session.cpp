@@ -1,85 +1,306 @@
 // src/server/session.cpp
 #include "server/session.hpp"
 #include "server/session_manager.hpp"
+#include "server/timing_wheel.hpp"
+#include "auth/jwt_handler.hpp"
+#include "utils/cbor.hpp"
 #include "utils/logger.hpp"
+#include "utils/metrics.hpp"
 #include <boost/json.hpp>
+#include <algorithm>
 
-Session::Session(tcp::socket socket, SessionManager& manager)
-    : ws_(std::move(socket))
+namespace {
+WsStream make_ws(ClientStream stream) {
+    if (auto* tls = std::get_if<TlsStream>(&stream)) {
+        return WsStream(std::in_place_index<1>, CountingStream<TlsStream>(std::move(*tls)));
+    }
+    return WsStream(std::in_place_index<0>,
+                    CountingStream<tcp::socket>(std::move(std::get<tcp::socket>(stream))));
+}
+
+// Write-path CPU of sessions with permessage-deflate, compression included
+std::atomic<std::uint64_t>& deflate_write_cpu() {
+    static auto& counter = Metrics::counter("ws.deflate.write_cpu_us");
+    return counter;
+}
+}
+
+Session::Session(ClientStream stream,
+                 SessionManager& manager,
+                 const SessionLimits& limits,
+                 TimingWheel& wheel,
+                 DeflateBudget& deflate_budget,
+                 net::any_io_executor workers)
+    : ws_(make_ws(std::move(stream)))
+    , executor_(std::visit([](auto& ws) -> net::any_io_executor { return ws.get_executor(); }, ws_))
     , manager_(manager)
-    , authenticated_(false) {
+    , limits_(limits)
+    , wheel_(wheel)
+    , deflate_budget_(deflate_budget)
+    , workers_(std::move(workers))
+    , authenticated_(false)
+    , format_(WireFormat::Json)
+    , queued_bytes_(0)
+    , read_paused_(false)
+    , deflate_(false)
+    , wire_bytes_seen_(0)
+    , in_flight_(0)
+    , pending_requests_(0)
+    , closing_(false)
+    , close_deferred_(false)
+    , close_code_(websocket::close_code::normal)
+    , released_(false)
+    , last_activity_(std::chrono::steady_clock::now())
+    , accepted_(false)
+    , ping_in_flight_(false)
+    , awaiting_pong_(false) {
 }
 
-void Session::run() {
-    ws_.async_accept(
-        beast::bind_front_handler(&Session::on_accept, shared_from_this())
+Session::~Session() {
+    if (deflate_) {
+        deflate_budget_.release();
+    }
+}
+
+void Session::run(UpgradeRequest request, std::string user_id) {
+    upgrade_request_ = std::move(request);
+    user_id_ = std::move(user_id);
+    
+    // The socket was accepted onto a strand; run everything from there
+    net::dispatch(
+        executor_,
+        beast::bind_front_handler(&Session::on_run, shared_from_this())
     );
 }
 
+void Session::on_run() {
+    // The idle timeout also covers a handshake that never completes
+    touch();
+    schedule_heartbeat(limits_.idle_timeout);
+    negotiate_deflate();
+    negotiate_protocol();
+    
+    with_ws([this](auto& ws) {
+        ws.async_accept(
+            upgrade_request_,
+            beast::bind_front_handler(&Session::on_accept, shared_from_this())
+        );
+    });
+}
+
+void Session::negotiate_deflate() {
+    static auto& granted = Metrics::counter("ws.deflate.sessions");
+    static auto& refused = Metrics::counter("ws.deflate.refused");
+    
+    // Only clients that offer the extension take a share of the budget
+    auto extensions = upgrade_request_[http::field::sec_websocket_extensions];
+    if (deflate_budget_.options().enabled &&
+        extensions.find("permessage-deflate") != beast::string_view::npos) {
+        deflate_ = deflate_budget_.try_acquire();
+        (deflate_ ? granted : refused).fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    with_ws([this](auto& ws) {
+        ws.set_option(deflate_budget_.option(deflate_));
+        if (deflate_) {
+            ws.next_layer().charge_write_cpu(&deflate_write_cpu());
+        }
+    });
+}
+
+void Session::negotiate_protocol() {
+    static auto& cbor_sessions = Metrics::counter("ws.cbor.sessions");
+    
+    // Sec-WebSocket-Protocol lists the client's choices in preference order
+    beast::string_view offered = upgrade_request_[http::field::sec_websocket_protocol];
+    std::string chosen;
+    while (!offered.empty() && chosen.empty()) {
+        auto comma = offered.find(',');
+        beast::string_view name = offered.substr(0, comma);
+        while (!name.empty() && name.front() == ' ') name.remove_prefix(1);
+        while (!name.empty() && name.back() == ' ') name.remove_suffix(1);
+        
+        if (name == "chat.cbor.v1" || name == "chat.json.v1") {
+            chosen = std::string(name);
+        }
+        offered = comma == beast::string_view::npos ? beast::string_view() : offered.substr(comma + 1);
+    }
+    if (chosen.empty()) {
+        return;
+    }
+    
+    if (chosen == "chat.cbor.v1") {
+        format_ = WireFormat::Cbor;
+        cbor_sessions.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    with_ws([this, chosen](auto& ws) {
+        ws.binary(format_ == WireFormat::Cbor);
+        ws.set_option(websocket::stream_base::decorator(
+            [chosen](websocket::response_type& res) {
+                res.set(http::field::sec_websocket_protocol, chosen);
+            }));
+    });
+}
+
 void Session::on_accept(beast::error_code ec) {
     if (ec) {
-        Logger::get()->error("WebSocket accept error: {}", ec.message());
+        if (!closing_) {
+            Logger::get()->error("WebSocket accept error: {}", ec.message());
+        }
         return;
     }
     
+    accepted_ = true;
+    upgrade_request_ = {};
+    touch();
+    
+    // Pongs (and client pings) are proof of life even without data frames
+    with_ws([this](auto& ws) {
+        ws.control_callback([this](websocket::frame_type, beast::string_view) {
+            touch();
+        });
+    });
+    
     Logger::get()->info("WebSocket connection accepted");
+    
+    // Authenticated by the upgrade request: no auth frame needed
+    if (!user_id_.empty()) {
+        authenticated_ = true;
+        std::string resume_token = manager_.join(shared_from_this(), user_id_);
+        
+        boost::json::object response;
+        response["type"] = "auth_success";
+        response["user_id"] = user_id_;
+        response["resume_token"] = resume_token;
+        send(boost::json::serialize(response));
+        
+        Logger::get()->info("User authenticated on upgrade: {}", user_id_);
+    }
+    
     do_read();
 }
 
 void Session::do_read() {
-    ws_.async_read(
-        buffer_,
-        beast::bind_front_handler(&Session::on_read, shared_from_this())
-    );
+    with_ws([this](auto& ws) {
+        ws.async_read(
+            buffer_,
+            beast::bind_front_handler(&Session::on_read, shared_from_this())
+        );
+    });
 }
 
-void Session::on_read(beast::error_code ec, std::size_t bytes_transferred) {
+void Session::on_read(beast::error_code ec, std::size_t) {
     if (ec == websocket::error::closed) {
         Logger::get()->info("WebSocket closed gracefully");
-        if (authenticated_) {
-            manager_.leave(user_id_);
-        }
+        release();
         return;
     }
     
     if (ec) {
-        Logger::get()->error("WebSocket read error: {}", ec.message());
+        if (!closing_) {
+            Logger::get()->error("WebSocket read error: {}", ec.message());
+        }
+        release();
         return;
     }
     
+    touch();
+    
     std::string message = beast::buffers_to_string(buffer_.data());
     buffer_.consume(buffer_.size());
     
-    handle_message(message);
+    bool binary = false;
+    with_ws([&binary](auto& ws) { binary = ws.got_binary(); });
+    handle_message(message, binary);
+    
+    if (closing_) {
+        return;
+    }
+    
+    // Stop reading while this client is not draining its responses, or
+    // has pipelined more requests than we are willing to queue
+    if (queued_bytes_ >= limits_.read_pause_bytes ||
+        pending_requests_ >= limits_.max_pending_requests) {
+        static auto& reads_paused = Metrics::counter("session.reads_paused");
+        reads_paused.fetch_add(1, std::memory_order_relaxed);
+        read_paused_ = true;
+        return;
+    }
+    
     do_read();
 }
 
-void Session::handle_message(const std::string& message) {
+void Session::handle_message(const std::string& message, bool binary) {
     try {
         namespace json = boost::json;
-        auto parsed = json::parse(message);
+        
+        // Binary frames carry CBOR, text frames JSON, whatever was negotiated
+        json::value parsed;
+        if (binary) {
+            auto decoded = cbor_decode(message);
+            if (!decoded) {
+                static auto& decode_errors = Metrics::counter("ws.cbor.decode_errors");
+                decode_errors.fetch_add(1, std::memory_order_relaxed);
+                throw std::runtime_error("malformed CBOR frame");
+            }
+            parsed = std::move(*decoded);
+        } else {
+            parsed = json::parse(message);
+        }
         auto& obj = parsed.as_object();
         
         std::string type = obj.at("type").as_string().c_str();
         
-        if (type == "auth") {
+        if (type == "auth" && authenticated_) {
+            // Already authenticated by the upgrade request
+            json::object response;
+            response["type"] = "auth_success";
+            response["user_id"] = user_id_;
+            send(json::serialize(response));
+        } else if (type == "auth") {
+            // Older clients authenticate with a frame after the upgrade
             std::string token = obj.at("token").as_string().c_str();
-            // Validate token and extract user_id
-            // Simplified - in production, properly validate JWT
-            if (!token.empty()) {
-                user_id_ = obj.at("user_id").as_string().c_str();
+            auto token_user = JWTHandler::validate_token(token);
+            auto* claimed = obj.if_contains("user_id");
+            
+            if (!token_user ||
+                (claimed && std::string(claimed->as_string().c_str()) != *token_user)) {
+                json::object response;
+                response["type"] = "auth_failed";
+                response["message"] = "Invalid or expired token";
+                send(json::serialize(response));
+            } else {
+                user_id_ = *token_user;
                 authenticated_ = true;
-                manager_.join(shared_from_this(), user_id_);
+                std::string resume_token = manager_.join(shared_from_this(), user_id_);
                 
                 json::object response;
                 response["type"] = "auth_success";
                 response["user_id"] = user_id_;
+                response["resume_token"] = resume_token;
                 send(json::serialize(response));
                 
                 Logger::get()->info("User authenticated: {}", user_id_);
             }
+        } else if (type == "resume" && !authenticated_) {
+            std::string user_id = obj.at("user_id").as_string().c_str();
+            std::string resume_token = obj.at("resume_token").as_string().c_str();
+            auto last_seq = obj.at("last_seq").to_number<std::uint64_t>();
+            
+            // The manager sends resume_success and the replayed events
+            if (manager_.resume(shared_from_this(), user_id, resume_token, last_seq)) {
+                user_id_ = user_id;
+                authenticated_ = true;
+            } else {
+                json::object response;
+                response["type"] = "resume_failed";
+                response["message"] = "Session expired, authenticate and sync";
+                send(json::serialize(response));
+            }
         } else if (authenticated_) {
-            manager_.handle_client_message(user_id_, message);
+            std::string key = SessionManager::ordering_key(obj);
+            submit_request(PendingRequest{std::move(key), std::move(obj)});
         } else {
             json::object error;
             error["type"] = "error";
@@ -98,18 +319,401 @@ void Session::handle_message(const std::string& message) {
 }
 
 void Session::send(const std::string& message) {
-    auto self = shared_from_this();
-    ws_.async_write(
-        net::buffer(message),
-        [self](beast::error_code ec, std::size_t bytes) {
-            self->on_write(ec, bytes);
+    OutboundFrame frame;
+    if (!encode_frame(message, frame.data)) {
+        return;
+    }
+    queue_frame(std::move(frame));
+}
+
+void Session::send_ephemeral(const std::string& message, const std::string& coalesce_key) {
+    OutboundFrame frame;
+    if (!encode_frame(message, frame.data)) {
+        return;
+    }
+    frame.ephemeral = true;
+    frame.coalesce_key = coalesce_key;
+    queue_frame(std::move(frame));
+}
+
+// Frames are built as JSON everywhere upstream (handlers, event history,
+// cluster envelopes); binary clients get them transcoded here, on the
+// sender's thread, where a fan-out reuses the previous transcoding.
+bool Session::encode_frame(const std::string& message, std::string& out) {
+    if (format_ == WireFormat::Json) {
+        out = message;
+        return true;
+    }
+    
+    auto encoded = json_to_cbor(message);
+    if (!encoded) {
+        Logger::get()->error("Dropping frame that is not valid JSON for a CBOR client");
+        return false;
+    }
+    out = std::move(*encoded);
+    return true;
+}
+
+void Session::queue_frame(OutboundFrame frame) {
+    // Runs inline when called from this session's strand, so responses
+    // produced while handling a read are counted before the throttle check.
+    net::dispatch(
+        executor_,
+        [self = shared_from_this(), frame = std::move(frame)]() mutable {
+            self->on_queue_frame(std::move(frame));
         }
     );
 }
 
+void Session::on_queue_frame(OutboundFrame frame) {
+    if (closing_ || !admit(frame)) {
+        return;
+    }
+    
+    queued_bytes_ += frame.data.size();
+    queue_.push_back(std::move(frame));
+    
+    // A write is already in flight; on_write picks this frame up
+    if (queue_.size() > 1) {
+        return;
+    }
+    
+    do_write();
+}
+
+bool Session::fits(std::size_t extra_bytes, std::size_t extra_frames) const {
+    return queued_bytes_ + extra_bytes <= limits_.max_queued_bytes &&
+           queue_.size() + extra_frames <= limits_.max_queued_frames;
+}
+
+bool Session::admit(OutboundFrame& frame) {
+    if (fits(frame.data.size(), 1)) {
+        return true;
+    }
+    
+    static auto& coalesced = Metrics::counter("session.frames_coalesced");
+    static auto& dropped = Metrics::counter("session.frames_dropped");
+    
+    switch (limits_.policy) {
+    case OverflowPolicy::Coalesce:
+        if (!frame.coalesce_key.empty()) {
+            // Skip the front frame, it is owned by the in-flight write
+            for (auto it = std::next(queue_.begin()); it != queue_.end(); ++it) {
+                if (it->coalesce_key != frame.coalesce_key) {
+                    continue;
+                }
+                std::size_t replaced = it->data.size();
+                if (queued_bytes_ - replaced + frame.data.size() > limits_.max_queued_bytes) {
+                    break;
+                }
+                queued_bytes_ = queued_bytes_ - replaced + frame.data.size();
+                *it = std::move(frame);
+                coalesced.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        [[fallthrough]];
+        
+    case OverflowPolicy::DropEphemeral:
+        if (frame.ephemeral) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        shed_ephemeral();
+        if (fits(frame.data.size(), 1)) {
+            return true;
+        }
+        break;
+        
+    case OverflowPolicy::Disconnect:
+        break;
+    }
+    
+    Logger::get()->warn("Outbound queue full for {} ({} frames, {} bytes), disconnecting",
+                       user_id_, queue_.size(), queued_bytes_);
+    disconnect(websocket::close_code::try_again_later);
+    return false;
+}
+
+void Session::shed_ephemeral() {
+    static auto& evicted = Metrics::counter("session.frames_evicted");
+    
+    if (queue_.size() < 2) {
+        return;
+    }
+    
+    auto first = std::next(queue_.begin());
+    auto kept = std::stable_partition(first, queue_.end(),
+        [](const OutboundFrame& f) { return !f.ephemeral; });
+    
+    for (auto it = kept; it != queue_.end(); ++it) {
+        queued_bytes_ -= it->data.size();
+        evicted.fetch_add(1, std::memory_order_relaxed);
+    }
+    queue_.erase(kept, queue_.end());
+}
+
+void Session::do_write() {
+    // Beast deflates the first chunk of the message inside async_write
+    ThreadCpuScope cpu(deflate_ ? &deflate_write_cpu() : nullptr);
+    with_ws([this](auto& ws) {
+        ws.async_write(
+            net::buffer(queue_.front().data),
+            beast::bind_front_handler(&Session::on_write, shared_from_this())
+        );
+    });
+}
+
 void Session::on_write(beast::error_code ec, std::size_t bytes_transferred) {
     if (ec) {
-        Logger::get()->error("WebSocket write error: {}", ec.message());
+        if (!closing_) {
+            Logger::get()->error("WebSocket write error: {}", ec.message());
+        }
+        queue_.clear();
+        queued_bytes_ = 0;
+        return;
+    }
+    
+    if (deflate_) {
+        account_deflate(bytes_transferred);
+    }
+    
+    queued_bytes_ -= queue_.front().data.size();
+    queue_.pop_front();
+    
+    if (closing_) {
+        return;
+    }
+    
+    maybe_resume_read();
+    
+    if (!queue_.empty()) {
+        do_write();
+    }
+}
+
+// Compares the payload handed to Beast with what reached the socket since
+// the last write completed. Control frames written in between count as
+// wire bytes, so the savings figure errs low.
+void Session::account_deflate(std::size_t payload_bytes) {
+    static auto& payload = Metrics::counter("ws.deflate.payload_bytes");
+    static auto& wire = Metrics::counter("ws.deflate.wire_bytes");
+    static auto& saved = Metrics::counter("ws.deflate.bytes_saved");
+    
+    std::uint64_t written = 0;
+    with_ws([&written](auto& ws) { written = ws.next_layer().bytes_written(); });
+    std::uint64_t sent = written - wire_bytes_seen_;
+    wire_bytes_seen_ = written;
+    
+    payload.fetch_add(payload_bytes, std::memory_order_relaxed);
+    wire.fetch_add(sent, std::memory_order_relaxed);
+    if (sent < payload_bytes) {
+        saved.fetch_add(payload_bytes - sent, std::memory_order_relaxed);
+    }
+}
+
+void Session::maybe_resume_read() {
+    if (!read_paused_ || closing_) {
+        return;
+    }
+    
+    if (queued_bytes_ <= limits_.read_pause_bytes / 2 &&
+        pending_requests_ < limits_.max_pending_requests) {
+        static auto& reads_resumed = Metrics::counter("session.reads_resumed");
+        reads_resumed.fetch_add(1, std::memory_order_relaxed);
+        read_paused_ = false;
+        do_read();
+    }
+}
+
+void Session::submit_request(PendingRequest request) {
+    ++pending_requests_;
+    
+    // Queue behind an earlier request with the same ordering key
+    if (!request.key.empty()) {
+        auto busy = busy_keys_.find(request.key);
+        if (busy != busy_keys_.end()) {
+            busy->second.push_back(std::move(request));
+            return;
+        }
+    }
+    
+    if (in_flight_ >= limits_.max_in_flight || !waiting_.empty()) {
+        waiting_.push_back(std::move(request));
+        return;
+    }
+    
+    start_request(std::move(request));
+}
+
+void Session::start_request(PendingRequest request) {
+    ++in_flight_;
+    if (!request.key.empty()) {
+        busy_keys_[request.key];
+    }
+    
+    // Handlers block on the database, so run them off the session strand
+    net::post(
+        workers_,
+        [self = shared_from_this(), request = std::move(request)]() {
+            self->manager_.handle_client_message(self, self->user_id_, request.request);
+            
+            net::post(
+                self->executor_,
+                [self, key = request.key] { self->on_request_done(key); }
+            );
+        }
+    );
+}
+
+void Session::on_request_done(const std::string& key) {
+    --in_flight_;
+    --pending_requests_;
+    
+    // The next request for the same key inherits the freed slot
+    if (!key.empty()) {
+        auto busy = busy_keys_.find(key);
+        if (busy != busy_keys_.end() && !busy->second.empty()) {
+            PendingRequest next = std::move(busy->second.front());
+            busy->second.pop_front();
+            start_request(std::move(next));
+        } else if (busy != busy_keys_.end()) {
+            busy_keys_.erase(busy);
+        }
+    }
+    
+    while (in_flight_ < limits_.max_in_flight && !waiting_.empty()) {
+        PendingRequest request = std::move(waiting_.front());
+        waiting_.pop_front();
+        
+        auto busy = request.key.empty() ? busy_keys_.end() : busy_keys_.find(request.key);
+        if (busy != busy_keys_.end()) {
+            busy->second.push_back(std::move(request));
+        } else {
+            start_request(std::move(request));
+        }
+    }
+    
+    maybe_resume_read();
+}
+
+void Session::disconnect(websocket::close_code code) {
+    if (closing_) {
+        return;
+    }
+    closing_ = true;
+    
+    static auto& disconnects = Metrics::counter("session.overflow_disconnects");
+    disconnects.fetch_add(1, std::memory_order_relaxed);
+    
+    // Keep only the frame owned by the in-flight write
+    if (!queue_.empty()) {
+        queue_.erase(std::next(queue_.begin()), queue_.end());
+        queued_bytes_ = queue_.front().data.size();
+    }
+    
+    close_code_ = code;
+    
+    // Only one control frame may be in flight; the ping handler closes
+    if (ping_in_flight_) {
+        close_deferred_ = true;
+        return;
+    }
+    
+    do_close();
+}
+
+void Session::do_close() {
+    with_ws([this](auto& ws) {
+        ws.async_close(
+            close_code_,
+            [self = shared_from_this()](beast::error_code) {
+                self->release();
+            }
+        );
+    });
+}
+
+void Session::release() {
+    if (released_) {
         return;
     }
+    released_ = true;
+    
+    if (authenticated_) {
+        manager_.leave(user_id_, this);
+    }
+}
+
+void Session::touch() {
+    last_activity_ = std::chrono::steady_clock::now();
+    awaiting_pong_ = false;
+}
+
+void Session::schedule_heartbeat(std::chrono::milliseconds delay) {
+    // The wheel only holds a weak reference so it never keeps a session alive
+    std::weak_ptr<Session> weak = shared_from_this();
+    wheel_.schedule(delay, [weak = std::move(weak)] {
+        if (auto self = weak.lock()) {
+            net::post(
+                self->executor_,
+                beast::bind_front_handler(&Session::on_heartbeat, self)
+            );
+        }
+    });
+}
+
+void Session::on_heartbeat() {
+    if (released_) {
+        return;
+    }
+    
+    using namespace std::chrono;
+    auto idle = duration_cast<milliseconds>(steady_clock::now() - last_activity_);
+    
+    if (idle >= limits_.idle_timeout) {
+        static auto& timeouts = Metrics::counter("session.idle_timeouts");
+        timeouts.fetch_add(1, std::memory_order_relaxed);
+        
+        Logger::get()->info("Session idle for {}ms, dropping: {}",
+                           idle.count(), authenticated_ ? user_id_ : "<unauthenticated>");
+        
+        // A dead peer will never answer a close frame, so drop the socket
+        closing_ = true;
+        with_ws([](auto& ws) {
+            beast::error_code ec;
+            beast::get_lowest_layer(ws).shutdown(tcp::socket::shutdown_both, ec);
+            beast::get_lowest_layer(ws).close(ec);
+        });
+        queue_.clear();
+        queued_bytes_ = 0;
+        release();
+        return;
+    }
+    
+    if (closing_) {
+        schedule_heartbeat(limits_.idle_timeout - idle);
+        return;
+    }
+    
+    if (accepted_ && idle >= limits_.ping_interval && !awaiting_pong_ && !ping_in_flight_) {
+        static auto& pings = Metrics::counter("session.pings_sent");
+        pings.fetch_add(1, std::memory_order_relaxed);
+        
+        awaiting_pong_ = true;
+        ping_in_flight_ = true;
+        with_ws([this](auto& ws) {
+            ws.async_ping({}, [self = shared_from_this()](beast::error_code ec) {
+                self->ping_in_flight_ = false;
+                if (!ec && self->close_deferred_) {
+                    self->close_deferred_ = false;
+                    self->do_close();
+                }
+            });
+        });
+    }
+    
+    auto next = awaiting_pong_ ? limits_.idle_timeout - idle
+                               : limits_.ping_interval - idle;
+    schedule_heartbeat(std::max(next, wheel_.tick()));
 }
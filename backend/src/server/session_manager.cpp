@@ -2,108 +2,657 @@
 // src/server/session_manager.cpp
 #include "server/session_manager.hpp"
 #include "server/session.hpp"
+#include "server/timing_wheel.hpp"
+#include "server/rate_limiter.hpp"
+#include "server/io_pool.hpp"
+#include "cluster/cluster_node.hpp"
 #include "handlers/message_handler.hpp"
 #include "handlers/group_handler.hpp"
 #include "handlers/friend_handler.hpp"
+#include "handlers/batch_handler.hpp"
+#include "handlers/inbox_handler.hpp"
 #include "utils/logger.hpp"
+#include "utils/metrics.hpp"
+#include "utils/json_frame.hpp"
 #include <boost/json.hpp>
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+std::string generate_resume_token() {
+    unsigned char bytes[16];
+    if (RAND_bytes(bytes, sizeof(bytes)) != 1) {
+        throw std::runtime_error("RAND_bytes failed");
+    }
+    
+    std::stringstream ss;
+    for (unsigned char byte : bytes) {
+        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte);
+    }
+    return ss.str();
+}
+}
 
 SessionManager::SessionManager(MessageHandler& msg_handler,
                               GroupHandler& group_handler,
-                              FriendHandler& friend_handler)
-    : msg_handler_(msg_handler)
+                              FriendHandler& friend_handler,
+                              BatchHandler& batch_handler,
+                              InboxHandler& inbox_handler,
+                              TimingWheel& wheel,
+                              const ResumeOptions& resume_options,
+                              RateLimiter& rate_limiter)
+    : tracked_users_(0)
+    , cluster_(nullptr)
+    , wheel_(wheel)
+    , resume_options_(resume_options)
+    , rate_limiter_(rate_limiter)
+    , msg_handler_(msg_handler)
     , group_handler_(group_handler)
-    , friend_handler_(friend_handler) {
+    , friend_handler_(friend_handler)
+    , batch_handler_(batch_handler)
+    , inbox_handler_(inbox_handler) {
     
     msg_handler_.set_session_manager(this);
     group_handler_.set_session_manager(this);
     friend_handler_.set_session_manager(this);
 }
 
-void SessionManager::join(std::shared_ptr<Session> session, const std::string& user_id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    sessions_[user_id] = session;
+std::string SessionManager::join(std::shared_ptr<Session> session, const std::string& user_id) {
+    if (cluster_) {
+        cluster_->announce(user_id, true);
+    }
+    
+    Stripe& stripe = stripe_for(user_id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    stripe.sessions[user_id] = session;
+    
+    // A fresh login starts a new history; the client resyncs from the DB
+    ResumeState state{
+        EventRing(resume_options_.max_events, resume_options_.max_bytes),
+        generate_resume_token(),
+        false,
+        0
+    };
+    auto it = stripe.resume_states.find(user_id);
+    if (it != stripe.resume_states.end()) {
+        state.generation = it->second.generation + 1;
+        it->second = std::move(state);
+    } else {
+        it = stripe.resume_states.emplace(user_id, std::move(state)).first;
+        tracked_users_.fetch_add(1, std::memory_order_relaxed);
+    }
+    
     Logger::get()->info("Session joined: {}", user_id);
+    return it->second.token;
 }
 
-void SessionManager::leave(const std::string& user_id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    sessions_.erase(user_id);
+bool SessionManager::resume(std::shared_ptr<Session> session,
+                            const std::string& user_id,
+                            const std::string& resume_token,
+                            std::uint64_t last_seq) {
+    static auto& resumed = Metrics::counter("resume.succeeded");
+    static auto& rejected = Metrics::counter("resume.rejected");
+    static auto& replayed = Metrics::counter("resume.events_replayed");
+    
+    Stripe& stripe = stripe_for(user_id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    
+    auto it = stripe.resume_states.find(user_id);
+    if (it == stripe.resume_states.end() ||
+        it->second.token.size() != resume_token.size() ||
+        CRYPTO_memcmp(it->second.token.data(), resume_token.data(), resume_token.size()) != 0) {
+        rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    
+    std::vector<std::string> missed;
+    if (!it->second.ring.replay_after(last_seq, missed)) {
+        rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    
+    auto& state = it->second;
+    state.detached = false;
+    ++state.generation;
+    stripe.sessions[user_id] = session;
+    
+    if (cluster_) {
+        cluster_->announce(user_id, true);
+    }
+    
+    namespace json = boost::json;
+    json::object response;
+    response["type"] = "resume_success";
+    response["user_id"] = user_id;
+    response["replayed"] = missed.size();
+    response["last_seq"] = state.ring.last_seq();
+    session->send(json::serialize(response));
+    
+    // Replayed under the lock so no live event can overtake them
+    for (const auto& frame : missed) {
+        session->send(frame);
+    }
+    
+    resumed.fetch_add(1, std::memory_order_relaxed);
+    replayed.fetch_add(missed.size(), std::memory_order_relaxed);
+    Logger::get()->info("Session resumed: {} ({} events replayed)", user_id, missed.size());
+    return true;
+}
+
+void SessionManager::leave(const std::string& user_id, const Session* session) {
+    Stripe& stripe = stripe_for(user_id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto it = stripe.sessions.find(user_id);
+    if (it == stripe.sessions.end() || it->second.get() != session) {
+        return;
+    }
+    stripe.sessions.erase(it);
+    
+    // Events stop arriving here once the user is gone, so the inbox would go stale
+    inbox_handler_.evict(user_id);
+    
+    // Keep the event history around briefly so a quick reconnect can resume.
+    // The user stays present in the cluster until then, so events from
+    // other nodes still reach the ring.
+    auto state = stripe.resume_states.find(user_id);
+    if (state != stripe.resume_states.end()) {
+        state->second.detached = true;
+        std::uint64_t generation = ++state->second.generation;
+        wheel_.schedule(resume_options_.grace_period, [this, user_id, generation] {
+            expire_resume_state(user_id, generation);
+        });
+    } else if (cluster_) {
+        cluster_->announce(user_id, false);
+    }
+    
     Logger::get()->info("Session left: {}", user_id);
 }
 
+void SessionManager::expire_resume_state(const std::string& user_id, std::uint64_t generation) {
+    Stripe& stripe = stripe_for(user_id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto it = stripe.resume_states.find(user_id);
+    if (it != stripe.resume_states.end() && it->second.detached &&
+        it->second.generation == generation) {
+        stripe.resume_states.erase(it);
+        tracked_users_.fetch_sub(1, std::memory_order_relaxed);
+        if (cluster_) {
+            cluster_->announce(user_id, false);
+        }
+    }
+}
+
+bool SessionManager::record_event(Stripe& stripe, const std::string& user_id, std::string& frame) {
+    auto it = stripe.resume_states.find(user_id);
+    if (it == stripe.resume_states.end()) {
+        return false;
+    }
+    it->second.ring.push(frame);
+    return true;
+}
+
+bool SessionManager::deliver_locked(Stripe& stripe,
+                                    const std::string& user_id,
+                                    const std::string& message,
+                                    Delivery kind,
+                                    const std::string& coalesce_key) {
+    std::string frame = message;
+    bool recorded = kind != Delivery::Response && record_event(stripe, user_id, frame);
+    
+    auto it = stripe.sessions.find(user_id);
+    if (it == stripe.sessions.end()) {
+        // Held for a resume here, so forwarding it would only record it twice
+        return recorded && kind == Delivery::Event;
+    }
+    
+    if (kind == Delivery::Ephemeral) {
+        it->second->send_ephemeral(frame, coalesce_key);
+    } else {
+        it->second->send(frame);
+    }
+    return true;
+}
+
+bool SessionManager::deliver(const std::string& user_id,
+                             const std::string& message,
+                             Delivery kind,
+                             const std::string& coalesce_key) {
+    Stripe& stripe = stripe_for(user_id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    return deliver_locked(stripe, user_id, message, kind, coalesce_key);
+}
+
+bool SessionManager::deliver_local(const std::string& user_id,
+                                   const std::string& message,
+                                   Delivery kind,
+                                   const std::string& coalesce_key) {
+    // Messages sent here reach the inbox directly; forwarded ones only so
+    if (kind == Delivery::Event) {
+        inbox_handler_.on_remote_event({user_id}, message);
+    }
+    return deliver(user_id, message, kind, coalesce_key);
+}
+
+std::vector<std::string> SessionManager::deliver_local_many(const std::vector<std::string>& user_ids,
+                                                            const std::string& message,
+                                                            Delivery kind) {
+    if (kind == Delivery::Event) {
+        inbox_handler_.on_remote_event(user_ids, message);
+    }
+    
+    std::vector<std::string> remaining;
+    for (const auto& user_id : user_ids) {
+        Stripe& stripe = stripe_for(user_id);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        if (!deliver_locked(stripe, user_id, message, kind, "")) {
+            remaining.push_back(user_id);
+        }
+    }
+    return remaining;
+}
+
 void SessionManager::send_to_user(const std::string& user_id, const std::string& message) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto it = sessions_.find(user_id);
-    if (it != sessions_.end()) {
-        it->second->send(message);
+    if (!deliver(user_id, message, Delivery::Response, "") && cluster_) {
+        cluster_->route(user_id, message, Delivery::Response);
+    }
+}
+
+void SessionManager::send_event_to_user(const std::string& user_id, const std::string& message) {
+    if (!deliver(user_id, message, Delivery::Event, "") && cluster_) {
+        cluster_->route(user_id, message, Delivery::Event);
+    }
+}
+
+void SessionManager::send_ephemeral_to_user(const std::string& user_id,
+                                            const std::string& message,
+                                            const std::string& coalesce_key) {
+    if (!deliver(user_id, message, Delivery::Ephemeral, coalesce_key) && cluster_) {
+        cluster_->route(user_id, message, Delivery::Ephemeral, coalesce_key);
+    }
+}
+
+void SessionManager::send_to_group(const IdSetPtr& members, const std::string& message) {
+    static auto& parallel = Metrics::counter("group.fanout_parallel");
+    
+    // Every joined user has resume state, attached or not, and detached
+    // ones still get the event for replay. Without a cluster nobody else
+    // needs the rest, so the smaller side is walked.
+    bool walk_users = !cluster_ &&
+        tracked_users_.load(std::memory_order_relaxed) < members->size();
+    
+    // Decided on group size alone, so messages to a group take the same
+    // path each time and stay in order per recipient
+    if (fanout_strands_.empty() || members->size() < fanout_options_.parallel_threshold) {
+        FanoutResult result;
+        if (walk_users) {
+            for (std::size_t s = 0; s < kStripes; ++s) {
+                deliver_stripe(s, *members, nullptr, message, result);
+            }
+        } else {
+            for (const auto& user_id : *members) {
+                Stripe& stripe = stripe_for(user_id);
+                std::lock_guard<std::mutex> lock(stripe.mutex);
+                if (deliver_locked(stripe, user_id, message, Delivery::Event, "")) {
+                    ++result.delivered;
+                } else if (cluster_) {
+                    result.remaining.push_back(user_id);
+                }
+            }
+        }
+        finish_fanout(result, message);
+        return;
+    }
+    
+    // Bucketed once here so each partition takes only its stripes' members
+    auto buckets = std::make_shared<std::vector<std::vector<std::uint32_t>>>();
+    if (!walk_users) {
+        buckets->resize(kStripes);
+        for (std::size_t i = 0; i < members->size(); ++i) {
+            (*buckets)[stripe_index((*members)[i])].push_back(static_cast<std::uint32_t>(i));
+        }
+    }
+    
+    auto frame = std::make_shared<const std::string>(message);
+    std::size_t partitions = fanout_strands_.size();
+    for (std::size_t p = 0; p < partitions; ++p) {
+        net::post(fanout_strands_[p], [this, members, buckets, frame, p, partitions] {
+            FanoutResult result;
+            for (std::size_t s = p; s < kStripes; s += partitions) {
+                const std::vector<std::uint32_t>* bucket = nullptr;
+                if (!buckets->empty()) {
+                    bucket = &(*buckets)[s];
+                    if (bucket->empty()) {
+                        continue;
+                    }
+                }
+                deliver_stripe(s, *members, bucket, *frame, result);
+            }
+            finish_fanout(result, *frame);
+        });
+    }
+    parallel.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SessionManager::deliver_stripe(std::size_t index,
+                                    const IdSet& members,
+                                    const std::vector<std::uint32_t>* bucket,
+                                    const std::string& message,
+                                    FanoutResult& result) {
+    Stripe& stripe = stripes_[index];
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    
+    if (!bucket) {
+        for (const auto& [user_id, state] : stripe.resume_states) {
+            if (MembershipIndex::contains(members, user_id) &&
+                deliver_locked(stripe, user_id, message, Delivery::Event, "")) {
+                ++result.delivered;
+            }
+        }
+        return;
+    }
+    
+    for (std::uint32_t i : *bucket) {
+        const auto& user_id = members[i];
+        if (deliver_locked(stripe, user_id, message, Delivery::Event, "")) {
+            ++result.delivered;
+        } else if (cluster_) {
+            result.remaining.push_back(user_id);
+        }
+    }
+}
+
+void SessionManager::finish_fanout(FanoutResult& result, const std::string& message) {
+    static auto& delivered = Metrics::counter("group.local_recipients");
+    delivered.fetch_add(result.delivered, std::memory_order_relaxed);
+    
+    if (!result.remaining.empty()) {
+        cluster_->route_many(result.remaining, message, Delivery::Event);
     }
 }
 
 bool SessionManager::is_user_online(const std::string& user_id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return sessions_.find(user_id) != sessions_.end();
+    Stripe& stripe = stripe_for(user_id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    return stripe.sessions.find(user_id) != stripe.sessions.end();
 }
 
-void SessionManager::handle_client_message(const std::string& user_id, const std::string& message) {
+std::vector<std::string> SessionManager::local_users() {
+    std::vector<std::string> users;
+    for (auto& stripe : stripes_) {
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        for (const auto& [user_id, state] : stripe.resume_states) {
+            users.push_back(user_id);
+        }
+    }
+    return users;
+}
+
+void SessionManager::set_cluster(ClusterNode* cluster) {
+    cluster_ = cluster;
+}
+
+void SessionManager::set_fanout(IoPool& pool, const FanoutOptions& options) {
+    fanout_options_ = options;
+    fanout_strands_.clear();
+    
+    std::size_t partitions = options.partitions > 0 ? options.partitions : pool.thread_count();
+    partitions = std::min(partitions, kStripes);
+    if (partitions < 2) {
+        return;
+    }
+    
+    // Spread over the shards so every NUMA node takes its share
+    for (std::size_t p = 0; p < partitions; ++p) {
+        net::any_io_executor executor = pool.context(p % pool.size()).get_executor();
+        fanout_strands_.push_back(net::make_strand(executor));
+    }
+}
+
+std::size_t SessionManager::stripe_index(const std::string& user_id) {
+    return std::hash<std::string>{}(user_id) % kStripes;
+}
+
+SessionManager::Stripe& SessionManager::stripe_for(const std::string& user_id) {
+    return stripes_[stripe_index(user_id)];
+}
+
+std::string SessionManager::ordering_key(const boost::json::object& request) {
+    // Requests sharing a key run one at a time, in arrival order; an empty
+    // key may run concurrently with anything.
+    std::string type = request.at("type").as_string().c_str();
+    
+    if (type == "send_message") {
+        return std::string("dm:") + request.at("recipient_id").as_string().c_str();
+    }
+    if (type == "get_conversation") {
+        return std::string("dm:") + request.at("user_id").as_string().c_str();
+    }
+    if (type == "get_range") {
+        if (auto* group_id = request.if_contains("group_id")) {
+            return std::string("group:") + group_id->as_string().c_str();
+        }
+        return std::string("dm:") + request.at("user_id").as_string().c_str();
+    }
+    if (type == "send_group_message") {
+        return std::string("group:") + request.at("group_id").as_string().c_str();
+    }
+    if (type == "send_friend_request" || type == "accept_friend_request" ||
+        type == "create_group" || type == "add_group_member") {
+        return "social";
+    }
+    if (type == "sync") {
+        return "sync";
+    }
+    if (type == "batch") {
+        return "batch";
+    }
+    return "";
+}
+
+void SessionManager::respond(const std::weak_ptr<Session>& origin,
+                             const std::string& user_id,
+                             std::string frame,
+                             Delivery kind) {
+    auto session = origin.lock();
+    if (kind == Delivery::Response) {
+        if (session) {
+            session->send(frame);
+        }
+        return;
+    }
+    
+    // Sequenced like any other event, so a resumed session replays it if
+    // the requesting connection is already gone
+    Stripe& stripe = stripe_for(user_id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    record_event(stripe, user_id, frame);
+    if (session) {
+        session->send(frame);
+    }
+}
+
+void SessionManager::handle_client_message(const std::weak_ptr<Session>& origin,
+                                           const std::string& user_id,
+                                           const boost::json::object& obj) {
+    namespace json = boost::json;
+    
+    // Echoed on every direct response so pipelining clients can correlate
+    std::string req_id;
+    if (auto* id = obj.if_contains("req_id")) {
+        req_id = json::serialize(*id);
+    }
+    
+    auto reply = [&](std::string frame, Delivery kind = Delivery::Response) {
+        if (!req_id.empty()) {
+            prepend_json_field(frame, "req_id", req_id);
+        }
+        respond(origin, user_id, std::move(frame), kind);
+    };
+    
     try {
-        namespace json = boost::json;
-        auto parsed = json::parse(message);
-        auto& obj = parsed.as_object();
-        
         std::string type = obj.at("type").as_string().c_str();
         
+        // A batch is validated as a whole before anything is charged or run
+        const json::array* operations = nullptr;
+        if (type == "batch") {
+            operations = &obj.at("operations").as_array();
+            std::string invalid = BatchHandler::validate(*operations);
+            if (!invalid.empty()) {
+                reply(std::move(invalid));
+                return;
+            }
+        }
+        
+        // Throttle before any handler (and its DB transaction) runs
+        auto reject = [&](const std::string& op_type, OperationClass op) {
+            static auto& limited = Metrics::counter("rate_limit.rejected");
+            limited.fetch_add(1, std::memory_order_relaxed);
+            
+            json::object error;
+            error["type"] = "error";
+            error["code"] = "rate_limited";
+            error["message"] = "Too many requests";
+            error["operation"] = op_type;
+            error["limit_class"] = RateLimiter::name(op);
+            error["retry_after_ms"] = rate_limiter_.retry_after(op).count();
+            reply(json::serialize(error));
+        };
+        
+        if (operations) {
+            // Each operation costs the same as sending it on its own. The
+            // batch is charged per class, all or nothing: a class that
+            // cannot pay refunds the ones already charged.
+            constexpr auto kClasses = static_cast<std::size_t>(OperationClass::Count);
+            std::array<double, kClasses> cost{};
+            std::array<std::string, kClasses> first_type;
+            for (const auto& operation : *operations) {
+                std::string op_type = operation.as_object().at("type").as_string().c_str();
+                auto index = static_cast<std::size_t>(RateLimiter::classify(op_type));
+                if (cost[index] == 0) {
+                    first_type[index] = op_type;
+                }
+                cost[index] += 1.0;
+            }
+            
+            for (std::size_t i = 0; i < kClasses; ++i) {
+                auto op = static_cast<OperationClass>(i);
+                if (cost[i] == 0 || rate_limiter_.try_acquire(user_id, op, cost[i])) {
+                    continue;
+                }
+                for (std::size_t j = 0; j < i; ++j) {
+                    if (cost[j] > 0) {
+                        rate_limiter_.refund(user_id, static_cast<OperationClass>(j), cost[j]);
+                    }
+                }
+                reject(first_type[i], op);
+                return;
+            }
+            reply(batch_handler_.handle_batch(user_id, *operations));
+            return;
+        }
+        
+        if (!rate_limiter_.try_acquire(user_id, RateLimiter::classify(type))) {
+            reject(type, RateLimiter::classify(type));
+            return;
+        }
+        
+        // Lets a send retried after a timeout be answered with the first ack
+        std::string idempotency_key;
+        if (auto* key = obj.if_contains("idempotency_key")) {
+            idempotency_key = key->as_string().c_str();
+        }
+        
         if (type == "send_message") {
             std::string recipient_id = obj.at("recipient_id").as_string().c_str();
             std::string content = obj.at("content").as_string().c_str();
-            msg_handler_.handle_send_message(user_id, recipient_id, content);
+            reply(msg_handler_.handle_send_message(user_id, recipient_id, content, idempotency_key),
+                  Delivery::Event);
             
         } else if (type == "send_group_message") {
             std::string group_id = obj.at("group_id").as_string().c_str();
             std::string content = obj.at("content").as_string().c_str();
-            msg_handler_.handle_send_group_message(user_id, group_id, content);
+            reply(msg_handler_.handle_send_group_message(user_id, group_id, content, idempotency_key));
             
         } else if (type == "get_conversation") {
             std::string other_user_id = obj.at("user_id").as_string().c_str();
-            std::string response = msg_handler_.handle_get_conversation(user_id, other_user_id);
-            send_to_user(user_id, response);
+            std::uint64_t before_seq = 0;
+            if (auto* before = obj.if_contains("before_seq")) {
+                before_seq = before->to_number<std::uint64_t>();
+            }
+            reply(msg_handler_.handle_get_conversation(user_id, other_user_id, before_seq));
+            
+        } else if (type == "get_range") {
+            std::string other_user_id;
+            std::string group_id;
+            if (auto* group = obj.if_contains("group_id")) {
+                group_id = group->as_string().c_str();
+            } else {
+                other_user_id = obj.at("user_id").as_string().c_str();
+            }
+            reply(msg_handler_.handle_get_range(user_id, other_user_id, group_id,
+                                                obj.at("from_seq").to_number<std::uint64_t>(),
+                                                obj.at("to_seq").to_number<std::uint64_t>()));
+            
+        } else if (type == "sync") {
+            std::string after;
+            if (auto* cursor = obj.if_contains("cursor")) {
+                after = cursor->as_string().c_str();
+            }
+            for (auto& frame : msg_handler_.handle_sync(user_id, after)) {
+                reply(std::move(frame));
+            }
             
         } else if (type == "create_group") {
             std::string group_name = obj.at("group_name").as_string().c_str();
             std::string description = obj.at("description").as_string().c_str();
-            std::string response = group_handler_.handle_create_group(user_id, group_name, description);
-            send_to_user(user_id, response);
+            reply(group_handler_.handle_create_group(user_id, group_name, description));
             
         } else if (type == "add_group_member") {
             std::string group_id = obj.at("group_id").as_string().c_str();
             std::string member_id = obj.at("user_id").as_string().c_str();
-            std::string response = group_handler_.handle_add_member(group_id, member_id);
-            send_to_user(user_id, response);
+            reply(group_handler_.handle_add_member(group_id, member_id));
+            
+        } else if (type == "get_inbox") {
+            reply(inbox_handler_.handle_get_inbox(user_id));
+            
+        } else if (type == "mark_read") {
+            std::string conversation = obj.at("conversation").as_string().c_str();
+            reply(inbox_handler_.handle_mark_read(user_id, conversation));
             
         } else if (type == "get_groups") {
-            std::string response = group_handler_.handle_get_groups(user_id);
-            send_to_user(user_id, response);
+            reply(group_handler_.handle_get_groups(user_id));
             
         } else if (type == "send_friend_request") {
             std::string receiver_username = obj.at("username").as_string().c_str();
-            std::string response = friend_handler_.handle_send_friend_request(user_id, receiver_username);
-            send_to_user(user_id, response);
+            reply(friend_handler_.handle_send_friend_request(user_id, receiver_username));
             
         } else if (type == "accept_friend_request") {
             std::string request_id = obj.at("request_id").as_string().c_str();
-            std::string response = friend_handler_.handle_accept_friend_request(user_id, request_id);
-            send_to_user(user_id, response);
+            reply(friend_handler_.handle_accept_friend_request(user_id, request_id));
             
         } else if (type == "get_friend_requests") {
-            std::string response = friend_handler_.handle_get_friend_requests(user_id);
-            send_to_user(user_id, response);
+            reply(friend_handler_.handle_get_friend_requests(user_id));
             
         } else if (type == "get_friends") {
-            std::string response = friend_handler_.handle_get_friends(user_id);
-            send_to_user(user_id, response);
+            reply(friend_handler_.handle_get_friends(user_id));
+            
+        } else {
+            json::object error;
+            error["type"] = "error";
+            error["message"] = "Unknown message type";
+            reply(json::serialize(error));
         }
         
     } catch (const std::exception& e) {
         Logger::get()->error("Error handling client message: {}", e.what());
+        
+        json::object error;
+        error["type"] = "error";
+        error["message"] = "Invalid request";
+        reply(json::serialize(error));
     }
 }
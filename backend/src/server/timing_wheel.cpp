@@ -0,0 +1,94 @@
+// src/server/timing_wheel.cpp
+#include "server/timing_wheel.hpp"
+#include "utils/logger.hpp"
+
+TimingWheel::TimingWheel(net::io_context& ioc,
+                         std::chrono::milliseconds tick,
+                         std::size_t slots)
+    : strand_(net::make_strand(ioc))
+    , timer_(strand_)
+    , tick_(tick.count() > 0 ? tick : std::chrono::milliseconds(1))
+    , slots_(slots > 0 ? slots : 1)
+    , cursor_(0)
+    , pending_(0)
+    , stopped_(false) {
+}
+
+void TimingWheel::start() {
+    net::dispatch(strand_, [this] {
+        next_tick_ = std::chrono::steady_clock::now() + tick_;
+        arm();
+    });
+    
+    Logger::get()->info("Timing wheel started: {} slots, {}ms tick",
+                       slots_.size(), tick_.count());
+}
+
+void TimingWheel::stop() {
+    net::dispatch(strand_, [this] {
+        stopped_ = true;
+        timer_.cancel();
+    });
+}
+
+void TimingWheel::schedule(std::chrono::milliseconds delay, Task task) {
+    std::size_t ticks = static_cast<std::size_t>((delay + tick_ - std::chrono::milliseconds(1)) / tick_);
+    if (ticks == 0) {
+        ticks = 1;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::size_t slot = (cursor_ + ticks) % slots_.size();
+    slots_[slot].push_back(Entry{(ticks - 1) / slots_.size(), std::move(task)});
+    ++pending_;
+}
+
+std::size_t TimingWheel::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_;
+}
+
+void TimingWheel::arm() {
+    // Schedule against absolute deadlines so the wheel does not drift
+    timer_.expires_at(next_tick_);
+    timer_.async_wait([this](boost::system::error_code ec) { on_tick(ec); });
+}
+
+void TimingWheel::on_tick(boost::system::error_code ec) {
+    if (ec || stopped_) {
+        return;
+    }
+    
+    std::vector<Entry> due;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cursor_ = (cursor_ + 1) % slots_.size();
+        
+        auto& slot = slots_[cursor_];
+        auto keep = slot.begin();
+        for (auto it = slot.begin(); it != slot.end(); ++it) {
+            if (it->rounds > 0) {
+                --it->rounds;
+                if (keep != it) {
+                    *keep = std::move(*it);
+                }
+                ++keep;
+            } else {
+                due.push_back(std::move(*it));
+            }
+        }
+        slot.erase(keep, slot.end());
+        pending_ -= due.size();
+    }
+    
+    for (auto& entry : due) {
+        try {
+            entry.task();
+        } catch (const std::exception& e) {
+            Logger::get()->error("Timing wheel task failed: {}", e.what());
+        }
+    }
+    
+    next_tick_ += tick_;
+    arm();
+}
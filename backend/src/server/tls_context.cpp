@@ -0,0 +1,83 @@
+// src/server/tls_context.cpp
+#include "server/tls_context.hpp"
+#include "utils/logger.hpp"
+#include <openssl/err.h>
+
+namespace {
+std::string openssl_error() {
+    unsigned long code = ERR_get_error();
+    if (code == 0) {
+        return "unknown error";
+    }
+    char buffer[256];
+    ERR_error_string_n(code, buffer, sizeof(buffer));
+    return buffer;
+}
+
+const unsigned char kSessionIdContext[] = "chat_server";
+}
+
+std::unique_ptr<TlsContext> TlsContext::create(const TlsOptions& options) {
+    SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx) {
+        Logger::get()->error("Failed to create TLS context: {}", openssl_error());
+        return nullptr;
+    }
+    
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_options(ctx, SSL_OP_NO_COMPRESSION | SSL_OP_CIPHER_SERVER_PREFERENCE);
+    // Writes are retried from asio wait handlers and may be partial
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                          SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+                          SSL_MODE_RELEASE_BUFFERS);
+    
+    if (SSL_CTX_use_certificate_chain_file(ctx, options.cert_file.c_str()) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx, options.key_file.c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx) != 1) {
+        Logger::get()->error("Failed to load TLS certificate {} / key {}: {}",
+                            options.cert_file, options.key_file, openssl_error());
+        SSL_CTX_free(ctx);
+        return nullptr;
+    }
+    
+    // Resumption: stateless tickets (keys rotate per process, so a client
+    // reconnecting to another node does a full handshake) plus the
+    // server-side cache for clients without ticket support
+    SSL_CTX_set_session_id_context(ctx, kSessionIdContext, sizeof(kSessionIdContext) - 1);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_set_timeout(ctx, static_cast<long>(options.session_lifetime.count()));
+    if (options.session_tickets) {
+        SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+        SSL_CTX_set_num_tickets(ctx, 2);
+    } else {
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+        SSL_CTX_set_num_tickets(ctx, 0);
+    }
+    
+    bool ktls_enabled = false;
+#ifdef SSL_OP_ENABLE_KTLS
+    if (options.ktls) {
+        SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+        ktls_enabled = true;
+    }
+#else
+    if (options.ktls) {
+        Logger::get()->warn("OpenSSL was built without kTLS support; using user-space TLS");
+    }
+#endif
+
+    return std::unique_ptr<TlsContext>(new TlsContext(ctx, ktls_enabled));
+}
+
+TlsContext::TlsContext(SSL_CTX* ctx, bool ktls_enabled)
+    : ctx_(ctx)
+    , ktls_enabled_(ktls_enabled) {
+}
+
+TlsContext::~TlsContext() {
+    SSL_CTX_free(ctx_);
+}
+
+SSL* TlsContext::new_ssl() {
+    return SSL_new(ctx_);
+}
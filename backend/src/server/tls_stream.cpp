@@ -0,0 +1,60 @@
+// src/server/tls_stream.cpp
+#include "server/tls_stream.hpp"
+
+TlsStream::TlsStream(tcp::socket socket, SSL* ssl)
+    : socket_(std::move(socket))
+    , ssl_(ssl) {
+    
+    // OpenSSL drives the descriptor directly; readiness comes from asio
+    socket_.non_blocking(true);
+    SSL_set_fd(ssl_.get(), static_cast<int>(socket_.native_handle()));
+    SSL_set_accept_state(ssl_.get());
+}
+
+bool TlsStream::ktls_send() const {
+    return BIO_get_ktls_send(SSL_get_wbio(ssl_.get())) != 0;
+}
+
+bool TlsStream::ktls_recv() const {
+    return BIO_get_ktls_recv(SSL_get_rbio(ssl_.get())) != 0;
+}
+
+bool TlsStream::session_reused() const {
+    return SSL_session_reused(ssl_.get()) != 0;
+}
+
+void TlsStream::shutdown(beast::error_code& ec) {
+    if (socket_.is_open()) {
+        ERR_clear_error();
+        SSL_shutdown(ssl_.get());
+    }
+    
+    socket_.shutdown(tcp::socket::shutdown_both, ec);
+    socket_.close(ec);
+}
+
+beast::error_code TlsStream::to_error_code(int ssl_error) {
+    if (ssl_error == SSL_ERROR_ZERO_RETURN) {
+        return net::error::eof;
+    }
+    
+    if (ssl_error == SSL_ERROR_SYSCALL) {
+        unsigned long queued = ERR_get_error();
+        if (queued != 0) {
+            return beast::error_code(static_cast<int>(queued), net::error::get_ssl_category());
+        }
+        // The peer closed the connection without a close_notify
+        if (errno == 0) {
+            return net::error::eof;
+        }
+        return beast::error_code(errno, boost::system::system_category());
+    }
+    
+    unsigned long queued = ERR_get_error();
+    return beast::error_code(static_cast<int>(queued ? queued : ssl_error),
+                             net::error::get_ssl_category());
+}
+
+void teardown(beast::role_type, TlsStream& stream, beast::error_code& ec) {
+    stream.shutdown(ec);
+}
@@ -2,12 +2,24 @@
 #include "server/session.hpp"
 #include "utils/logger.hpp"
 
-WebSocketServer::WebSocketServer(net::io_context& ioc,
+WebSocketServer::WebSocketServer(IoPool& pool,
                                 tcp::endpoint endpoint,
-                                SessionManager& manager)
-    : ioc_(ioc)
-    , acceptor_(ioc)
-    , manager_(manager) {
+                                SessionManager& manager,
+                                AuthService& auth,
+                                TlsContext* tls,
+                                const SessionLimits& limits,
+                                const HttpLimits& http_limits,
+                                TimingWheel& wheel)
+    : pool_(pool)
+    , acceptor_(pool.context(0))
+    , manager_(manager)
+    , auth_(auth)
+    , tls_(tls)
+    , limits_(limits)
+    , http_limits_(http_limits)
+    , wheel_(wheel)
+    , deflate_budget_(limits.deflate)
+    , active_requests_(0) {
     
     beast::error_code ec;
     
@@ -44,19 +56,53 @@ void WebSocketServer::run() {
     do_accept();
 }
 
+void WebSocketServer::stop() {
+    beast::error_code ec;
+    acceptor_.close(ec);
+}
+
 void WebSocketServer::do_accept() {
+    std::size_t shard = pool_.next_shard();
     acceptor_.async_accept(
-        net::make_strand(ioc_),
-        beast::bind_front_handler(&WebSocketServer::on_accept, this)
+        net::make_strand(pool_.context(shard)),
+        beast::bind_front_handler(&WebSocketServer::on_accept, this, shard)
     );
 }
 
-void WebSocketServer::on_accept(beast::error_code ec, tcp::socket socket) {
+void WebSocketServer::on_accept(std::size_t shard, beast::error_code ec, tcp::socket socket) {
+    if (ec == net::error::operation_aborted) {
+        return;
+    }
     if (ec) {
         Logger::get()->error("Accept error: {}", ec.message());
     } else {
-        std::make_shared<Session>(std::move(socket), manager_)->run();
+        // Allocate the connection's state from one of its own shard's
+        // threads. Plain HTTP until the client asks for an upgrade
+        auto executor = socket.get_executor();
+        net::post(executor, [this, shard, socket = std::move(socket)]() mutable {
+            std::make_shared<HttpSession>(std::move(socket), *this, shard)->run();
+        });
     }
     
     do_accept();
+}
+
+void WebSocketServer::start_websocket(ClientStream stream,
+                                      UpgradeRequest request,
+                                      std::string user_id,
+                                      std::size_t shard) {
+    std::make_shared<Session>(std::move(stream), manager_, limits_, wheel_, deflate_budget_,
+                              workers(shard))->run(std::move(request), std::move(user_id));
+}
+
+bool WebSocketServer::try_begin_request() {
+    if (active_requests_.fetch_add(1, std::memory_order_acq_rel) >= http_limits_.max_concurrent_requests) {
+        active_requests_.fetch_sub(1, std::memory_order_acq_rel);
+        return false;
+    }
+    return true;
+}
+
+void WebSocketServer::end_request() {
+    active_requests_.fetch_sub(1, std::memory_order_acq_rel);
 }
\ No newline at end of file
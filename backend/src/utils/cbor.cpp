@@ -0,0 +1,353 @@
+// src/utils/cbor.cpp
+#include "utils/cbor.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace json = boost::json;
+
+namespace {
+enum Major : std::uint8_t {
+    Unsigned = 0,
+    Negative = 1,
+    Bytes = 2,
+    Text = 3,
+    Array = 4,
+    Map = 5,
+    Tag = 6,
+    Simple = 7
+};
+
+constexpr int kMaxDepth = 64;
+constexpr std::uint8_t kIndefinite = 31;
+constexpr std::uint8_t kBreak = 0xff;
+
+void write_head(std::string& out, std::uint8_t major, std::uint64_t value) {
+    std::uint8_t type = static_cast<std::uint8_t>(major << 5);
+    if (value < 24) {
+        out += static_cast<char>(type | value);
+        return;
+    }
+    
+    int bytes;
+    if (value <= 0xff) {
+        out += static_cast<char>(type | 24);
+        bytes = 1;
+    } else if (value <= 0xffff) {
+        out += static_cast<char>(type | 25);
+        bytes = 2;
+    } else if (value <= 0xffffffff) {
+        out += static_cast<char>(type | 26);
+        bytes = 4;
+    } else {
+        out += static_cast<char>(type | 27);
+        bytes = 8;
+    }
+    for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+        out += static_cast<char>((value >> shift) & 0xff);
+    }
+}
+
+void write_string(std::string& out, std::uint8_t major, std::string_view s) {
+    write_head(out, major, s.size());
+    out.append(s.data(), s.size());
+}
+
+void encode(std::string& out, const json::value& value) {
+    switch (value.kind()) {
+    case json::kind::null:
+        out += static_cast<char>(0xf6);
+        break;
+    case json::kind::bool_:
+        out += static_cast<char>(value.get_bool() ? 0xf5 : 0xf4);
+        break;
+    case json::kind::int64: {
+        std::int64_t n = value.get_int64();
+        if (n >= 0) {
+            write_head(out, Unsigned, static_cast<std::uint64_t>(n));
+        } else {
+            write_head(out, Negative, static_cast<std::uint64_t>(-(n + 1)));
+        }
+        break;
+    }
+    case json::kind::uint64:
+        write_head(out, Unsigned, value.get_uint64());
+        break;
+    case json::kind::double_: {
+        double d = value.get_double();
+        std::uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        out += static_cast<char>(0xfb);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out += static_cast<char>((bits >> shift) & 0xff);
+        }
+        break;
+    }
+    case json::kind::string: {
+        const auto& s = value.get_string();
+        write_string(out, Text, std::string_view(s.data(), s.size()));
+        break;
+    }
+    case json::kind::array:
+        write_head(out, Array, value.get_array().size());
+        for (const auto& item : value.get_array()) {
+            encode(out, item);
+        }
+        break;
+    case json::kind::object:
+        write_head(out, Map, value.get_object().size());
+        for (const auto& member : value.get_object()) {
+            write_string(out, Text, std::string_view(member.key().data(), member.key().size()));
+            encode(out, member.value());
+        }
+        break;
+    }
+}
+
+class Decoder {
+public:
+    explicit Decoder(std::string_view data) : data_(data), pos_(0) {}
+    
+    bool at_end() const { return pos_ == data_.size(); }
+    
+    bool decode(json::value& out, int depth) {
+        if (depth > kMaxDepth || pos_ >= data_.size()) {
+            return false;
+        }
+        
+        std::uint8_t initial = static_cast<std::uint8_t>(data_[pos_++]);
+        std::uint8_t major = initial >> 5;
+        std::uint8_t info = initial & 0x1f;
+        
+        if (major == Simple) {
+            return decode_simple(out, info);
+        }
+        
+        if (info == kIndefinite) {
+            return decode_indefinite(out, major, depth);
+        }
+        
+        std::uint64_t arg;
+        if (!read_argument(info, arg)) {
+            return false;
+        }
+        
+        switch (major) {
+        case Unsigned:
+            out = arg;
+            return true;
+        case Negative:
+            if (arg > static_cast<std::uint64_t>(INT64_MAX)) {
+                return false;
+            }
+            out = -1 - static_cast<std::int64_t>(arg);
+            return true;
+        case Bytes:
+        case Text: {
+            if (arg > data_.size() - pos_) {
+                return false;
+            }
+            out = json::string(data_.substr(pos_, static_cast<std::size_t>(arg)));
+            pos_ += static_cast<std::size_t>(arg);
+            return true;
+        }
+        case Array: {
+            // Every item takes at least one byte
+            if (arg > data_.size() - pos_) {
+                return false;
+            }
+            json::array array;
+            array.reserve(static_cast<std::size_t>(arg));
+            for (std::uint64_t i = 0; i < arg; ++i) {
+                if (!decode(array.emplace_back(nullptr), depth + 1)) {
+                    return false;
+                }
+            }
+            out = std::move(array);
+            return true;
+        }
+        case Map: {
+            if (arg > (data_.size() - pos_) / 2) {
+                return false;
+            }
+            json::object object;
+            object.reserve(static_cast<std::size_t>(arg));
+            for (std::uint64_t i = 0; i < arg; ++i) {
+                if (!decode_member(object, depth)) {
+                    return false;
+                }
+            }
+            out = std::move(object);
+            return true;
+        }
+        case Tag:
+            return decode(out, depth + 1);
+        default:
+            return false;
+        }
+    }
+
+private:
+    bool read_argument(std::uint8_t info, std::uint64_t& arg) {
+        if (info < 24) {
+            arg = info;
+            return true;
+        }
+        if (info > 27) {
+            return false;
+        }
+        std::size_t bytes = std::size_t{1} << (info - 24);
+        if (bytes > data_.size() - pos_) {
+            return false;
+        }
+        arg = 0;
+        for (std::size_t i = 0; i < bytes; ++i) {
+            arg = (arg << 8) | static_cast<std::uint8_t>(data_[pos_++]);
+        }
+        return true;
+    }
+    
+    bool decode_simple(json::value& out, std::uint8_t info) {
+        switch (info) {
+        case 20: out = false; return true;
+        case 21: out = true; return true;
+        case 22:
+        case 23: out = nullptr; return true;  // null, undefined
+        case 25: {
+            std::uint64_t half;
+            if (!read_argument(25, half)) return false;
+            out = half_to_double(static_cast<std::uint16_t>(half));
+            return true;
+        }
+        case 26: {
+            std::uint64_t bits;
+            if (!read_argument(26, bits)) return false;
+            std::uint32_t narrow = static_cast<std::uint32_t>(bits);
+            float f;
+            std::memcpy(&f, &narrow, sizeof(f));
+            out = static_cast<double>(f);
+            return true;
+        }
+        case 27: {
+            std::uint64_t bits;
+            if (!read_argument(27, bits)) return false;
+            double d;
+            std::memcpy(&d, &bits, sizeof(d));
+            out = d;
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+    
+    bool decode_indefinite(json::value& out, std::uint8_t major, int depth) {
+        if (major == Bytes || major == Text) {
+            // Concatenation of definite-length chunks of the same type
+            std::string joined;
+            while (!at_break()) {
+                json::value chunk;
+                if (pos_ >= data_.size() ||
+                    (static_cast<std::uint8_t>(data_[pos_]) >> 5) != major ||
+                    !decode(chunk, depth + 1)) {
+                    return false;
+                }
+                joined.append(chunk.get_string().data(), chunk.get_string().size());
+            }
+            out = json::string(joined);
+            return true;
+        }
+        if (major == Array) {
+            json::array array;
+            while (!at_break()) {
+                if (pos_ >= data_.size() || !decode(array.emplace_back(nullptr), depth + 1)) {
+                    return false;
+                }
+            }
+            out = std::move(array);
+            return true;
+        }
+        if (major == Map) {
+            json::object object;
+            while (!at_break()) {
+                if (pos_ >= data_.size() || !decode_member(object, depth)) {
+                    return false;
+                }
+            }
+            out = std::move(object);
+            return true;
+        }
+        return false;
+    }
+    
+    bool decode_member(json::object& object, int depth) {
+        json::value key;
+        if (!decode(key, depth + 1) || !key.is_string()) {
+            return false;
+        }
+        json::value value;
+        if (!decode(value, depth + 1)) {
+            return false;
+        }
+        object[key.get_string()] = std::move(value);
+        return true;
+    }
+    
+    bool at_break() {
+        if (pos_ < data_.size() && static_cast<std::uint8_t>(data_[pos_]) == kBreak) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+    
+    static double half_to_double(std::uint16_t half) {
+        int exponent = (half >> 10) & 0x1f;
+        int mantissa = half & 0x3ff;
+        double value;
+        if (exponent == 0) {
+            value = std::ldexp(mantissa, -24);
+        } else if (exponent != 31) {
+            value = std::ldexp(mantissa + 1024, exponent - 25);
+        } else {
+            value = mantissa == 0 ? INFINITY : NAN;
+        }
+        return (half & 0x8000) ? -value : value;
+    }
+    
+    std::string_view data_;
+    std::size_t pos_;
+};
+}
+
+std::string cbor_encode(const json::value& value) {
+    std::string out;
+    encode(out, value);
+    return out;
+}
+
+std::optional<json::value> cbor_decode(std::string_view data) {
+    Decoder decoder(data);
+    json::value value;
+    if (!decoder.decode(value, 0) || !decoder.at_end()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+std::optional<std::string> json_to_cbor(const std::string& frame) {
+    thread_local std::string last_json;
+    thread_local std::string last_cbor;
+    if (!last_json.empty() && frame == last_json) {
+        return last_cbor;
+    }
+    
+    json::error_code ec;
+    json::value parsed = json::parse(frame, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    last_cbor = cbor_encode(parsed);
+    last_json = frame;
+    return last_cbor;
+}
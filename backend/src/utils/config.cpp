@@ -0,0 +1,34 @@
+// src/utils/config.cpp
+#include "utils/config.hpp"
+#include "utils/logger.hpp"
+#include <cstdlib>
+
+std::string Config::get(const std::string& name, const std::string& fallback) {
+    const char* value = std::getenv(name.c_str());
+    if (!value || !*value) {
+        return fallback;
+    }
+    return value;
+}
+
+long long Config::get_int(const std::string& name, long long fallback) {
+    const char* value = std::getenv(name.c_str());
+    if (!value || !*value) {
+        return fallback;
+    }
+    
+    try {
+        return std::stoll(value);
+    } catch (const std::exception&) {
+        Logger::get()->warn("Ignoring invalid integer for {}: {}", name, value);
+        return fallback;
+    }
+}
+
+bool Config::get_bool(const std::string& name, bool fallback) {
+    std::string value = get(name, "");
+    if (value.empty()) {
+        return fallback;
+    }
+    return value == "1" || value == "true" || value == "yes" || value == "on";
+}
@@ -0,0 +1,142 @@
+// src/utils/cpu_affinity.cpp
+#include "utils/cpu_affinity.hpp"
+#include "utils/logger.hpp"
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+std::vector<int> CpuAffinity::parse_list(const std::string& list) {
+    std::vector<int> cpus;
+    std::size_t start = 0;
+    try {
+        while (start < list.size()) {
+            std::size_t end = list.find(',', start);
+            if (end == std::string::npos) end = list.size();
+            std::string range = list.substr(start, end - start);
+            start = end + 1;
+            if (range.empty() || range == "\n") {
+                continue;
+            }
+            
+            std::size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            if (first < 0 || last < first) {
+                return {};
+            }
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+    } catch (const std::exception&) {
+        return {};
+    }
+    
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::string CpuAffinity::format_list(const std::vector<int>& cpus) {
+    std::string out;
+    for (std::size_t i = 0; i < cpus.size();) {
+        std::size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) ++j;
+        if (!out.empty()) out += ',';
+        out += std::to_string(cpus[i]);
+        if (j > i) out += '-' + std::to_string(cpus[j]);
+        i = j + 1;
+    }
+    return out;
+}
+
+std::vector<int> CpuAffinity::allowed_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        return cpus;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+std::vector<NumaNode> CpuAffinity::numa_nodes(const std::vector<int>& cpus) {
+    std::map<int, int> node_of;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.size() < 5 || name.compare(0, 4, "node") != 0 ||
+            !std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+            continue;
+        }
+        std::ifstream file(entry.path() / "cpulist");
+        std::string list;
+        std::getline(file, list);
+        for (int cpu : parse_list(list)) {
+            node_of[cpu] = std::stoi(name.substr(4));
+        }
+    }
+    
+    std::map<int, NumaNode> nodes;
+    for (int cpu : cpus) {
+        auto found = node_of.find(cpu);
+        int node = found == node_of.end() ? 0 : found->second;
+        auto& entry = nodes[node];
+        entry.id = node;
+        entry.cpus.push_back(cpu);
+    }
+    
+    std::vector<NumaNode> result;
+    for (auto& [id, node] : nodes) {
+        result.push_back(std::move(node));
+    }
+    return result;
+}
+
+bool CpuAffinity::pin_thread(int cpu) {
+    return pin_thread(std::vector<int>{cpu});
+}
+
+bool CpuAffinity::pin_thread(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        Logger::get()->warn("Could not pin thread to CPUs {}: {}", format_list(cpus), std::strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool CpuAffinity::prefer_node(int node) {
+    unsigned long mask = 0;
+    long ret;
+    if (node < 0) {
+        ret = syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0);
+    } else if (node < static_cast<int>(sizeof(mask) * 8)) {
+        mask = 1UL << node;
+        ret = syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, sizeof(mask) * 8 + 1);
+    } else {
+        return false;
+    }
+    if (ret != 0) {
+        Logger::get()->warn("Could not set memory policy for node {}: {}", node, std::strerror(errno));
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,105 @@
+// src/utils/id_generator.cpp
+#include "utils/id_generator.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <ctime>
+
+namespace {
+constexpr std::int64_t kEpochMs = 1704067200000;  // 2024-01-01T00:00:00Z
+constexpr std::uint64_t kSequenceMask = (std::uint64_t{1} << IdGenerator::kSequenceBits) - 1;
+
+std::uint64_t now_ms() {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return static_cast<std::uint64_t>(std::max<std::int64_t>(0, ms - kEpochMs));
+}
+}
+
+IdGenerator::IdGenerator(std::uint32_t node)
+    : node_bits_(static_cast<std::uint64_t>(node & kMaxNode) << kSequenceBits)
+    , last_(0) {
+}
+
+std::uint64_t IdGenerator::next() {
+    const std::uint64_t fresh = now_ms() << kSequenceBits;
+    std::uint64_t last = last_.load(std::memory_order_relaxed);
+    std::uint64_t state;
+    do {
+        state = std::max(fresh, last + 1);
+    } while (!last_.compare_exchange_weak(last, state, std::memory_order_relaxed));
+    
+    return ((state >> kSequenceBits) << (kNodeBits + kSequenceBits))
+        | node_bits_
+        | (state & kSequenceMask);
+}
+
+std::chrono::system_clock::time_point IdGenerator::time_of(std::uint64_t id) {
+    auto ms = static_cast<std::int64_t>(id >> (kNodeBits + kSequenceBits)) + kEpochMs;
+    return std::chrono::system_clock::time_point(std::chrono::milliseconds(ms));
+}
+
+std::string IdGenerator::to_uuid(std::uint64_t id) {
+    // Only the variant is set, after the id bits; uuid columns take any version
+    char buf[37];
+    std::snprintf(buf, sizeof(buf), "%08x-%04x-%04x-8000-000000000000",
+                  static_cast<unsigned>(id >> 32),
+                  static_cast<unsigned>((id >> 16) & 0xffff),
+                  static_cast<unsigned>(id & 0xffff));
+    return buf;
+}
+
+std::string IdGenerator::to_timestamp(std::uint64_t id) {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        time_of(id).time_since_epoch()).count();
+    std::time_t seconds = static_cast<std::time_t>(ms / 1000);
+    std::tm utc{};
+    gmtime_r(&seconds, &utc);
+    
+    char buf[40];
+    std::snprintf(buf, sizeof(buf), "%04d-%02d-%02d %02d:%02d:%02d.%03d+00",
+                  utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday,
+                  utc.tm_hour, utc.tm_min, utc.tm_sec,
+                  static_cast<int>(ms % 1000));
+    return buf;
+}
+
+
+std::chrono::system_clock::time_point IdGenerator::parse_timestamp(const std::string& text) {
+    std::tm utc{};
+    int consumed = 0;
+    if (std::sscanf(text.c_str(), "%4d-%2d-%2d%*1[ T]%2d:%2d:%2d%n",
+                    &utc.tm_year, &utc.tm_mon, &utc.tm_mday,
+                    &utc.tm_hour, &utc.tm_min, &utc.tm_sec, &consumed) != 6) {
+        return {};
+    }
+    utc.tm_year -= 1900;
+    utc.tm_mon -= 1;
+    auto point = std::chrono::system_clock::from_time_t(timegm(&utc));
+    
+    const char* rest = text.c_str() + consumed;
+    if (*rest == '.') {
+        long long micros = 0;
+        int digits = 0;
+        for (++rest; std::isdigit(static_cast<unsigned char>(*rest)); ++rest) {
+            if (digits < 6) {
+                micros = micros * 10 + (*rest - '0');
+                ++digits;
+            }
+        }
+        for (; digits < 6; ++digits) {
+            micros *= 10;
+        }
+        point += std::chrono::microseconds(micros);
+    }
+    
+    // "+05", "-08:00", "+05:30"
+    if (*rest == '+' || *rest == '-') {
+        int hours = 0;
+        int minutes = 0;
+        std::sscanf(rest + 1, "%2d:%2d", &hours, &minutes);
+        auto offset = std::chrono::hours(hours) + std::chrono::minutes(minutes);
+        point += *rest == '+' ? -offset : offset;
+    }
+    return point;
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+// src/utils/json_frame.cpp
+#include "utils/json_frame.hpp"
+
+void prepend_json_field(std::string& frame, const std::string& name, const std::string& json_value) {
+    if (frame.empty() || frame.front() != '{') {
+        return;
+    }
+    
+    std::string field = "\"" + name + "\":" + json_value;
+    if (frame.size() > 2) {
+        field += ',';
+    }
+    frame.insert(1, field);
+}
@@ -0,0 +1,36 @@
+// src/utils/metrics.cpp
+#include "utils/metrics.hpp"
+#include "utils/logger.hpp"
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace {
+std::mutex registry_mutex;
+std::map<std::string, std::unique_ptr<std::atomic<std::uint64_t>>> registry;
+}
+
+std::atomic<std::uint64_t>& Metrics::counter(const std::string& name) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto& slot = registry[name];
+    if (!slot) {
+        slot = std::make_unique<std::atomic<std::uint64_t>>(0);
+    }
+    return *slot;
+}
+
+std::vector<std::pair<std::string, std::uint64_t>> Metrics::snapshot() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::vector<std::pair<std::string, std::uint64_t>> values;
+    values.reserve(registry.size());
+    for (const auto& [name, value] : registry) {
+        values.emplace_back(name, value->load(std::memory_order_relaxed));
+    }
+    return values;
+}
+
+void Metrics::log_snapshot() {
+    for (const auto& [name, value] : snapshot()) {
+        Logger::get()->info("  - {}: {}", name, value);
+    }
+}